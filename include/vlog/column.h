@@ -13,6 +13,22 @@
 #include <memory>
 #include <cstring>
 #include <vector>
+#include <mutex>
+#include <atomic>
+
+//Maximum size of the chunks kept by the columns read by several joins (see
+//Column::getView). SemiNaiver::spillTables evicts them first when the memory
+//budget is exceeded
+#define COLUMN_VIEWCACHE_MAX_MB 2048
+
+//The values of the columns that are not contiguous in memory are read by the
+//joins in chunks of 2^COLUMNVIEW_CHUNK_BITS values
+#define COLUMNVIEW_CHUNK_BITS 16
+#define COLUMNVIEW_CHUNK (1ul << COLUMNVIEW_CHUNK_BITS)
+
+//Number of rows copied by the nextBatch methods of the readers and of the
+//iterators. Small enough to keep a batch of a few columns in the L1/L2 cache
+#define BATCH_ROWS 2048
 
 //----- GENERIC INTERFACES -------
 class ColumnReader {
@@ -25,15 +41,139 @@ class ColumnReader {
 
         virtual Term_t next() = 0;
 
+        //Copy the next (at most) maxRows values in out. Returns the number of
+        //values copied, 0 at the end of the column
+        virtual size_t nextBatch(Term_t *out, const size_t maxRows) {
+            size_t n = 0;
+            while (n < maxRows && hasNext()) {
+                out[n++] = next();
+            }
+            return n;
+        }
+
         virtual void clear() = 0;
 
         virtual std::vector<Term_t> asVector() = 0;
 };
 
 class ColumnWriter;
+class Column;
+
+//Values of a column that are not contiguous in memory (compressed, packed or
+//EDB), copied in chunks of COLUMNVIEW_CHUNK values the first time one of them
+//is read. The chunks are filled in order by a single reader, so a join that
+//stops early copies only the first part of the column
+class ColumnChunks {
+    private:
+        const size_t n;
+        std::unique_ptr<ColumnReader> reader;
+        std::vector<std::unique_ptr<Term_t[]>> chunks;
+        std::atomic<size_t> nfilled;
+        std::mutex mutex;
+
+        void fill(const size_t chunk);
+
+    public:
+        ColumnChunks(const Column &column);
+
+        size_t size() const {
+            return n;
+        }
+
+        Term_t get(const size_t pos) {
+            const size_t chunk = pos >> COLUMNVIEW_CHUNK_BITS;
+            if (chunk >= nfilled.load(std::memory_order_acquire)) {
+                fill(chunk);
+            }
+            return chunks[chunk][pos & (COLUMNVIEW_CHUNK - 1)];
+        }
+
+        //Copy the values [begin, begin + len)
+        void copy(const size_t begin, const size_t len, Term_t *out);
+
+        size_t getMemoryBytes() const {
+            return nfilled * COLUMNVIEW_CHUNK * sizeof(Term_t);
+        }
+};
+
+//Read-only array of the values of a column, returned by Column::getView. The
+//columns that keep their values contiguous in memory (vectors, mapped files)
+//lend a pointer and a length, the others are read through ColumnChunks
+class ColumnView {
+    private:
+        const Term_t *values;
+        size_t n;
+        std::shared_ptr<ColumnChunks> chunks;
+
+    public:
+        ColumnView(const Term_t *values, const size_t n) : values(values),
+        n(n) {
+        }
+
+        ColumnView(const std::vector<Term_t> &v) : values(v.data()),
+        n(v.size()) {
+        }
+
+        ColumnView(std::shared_ptr<ColumnChunks> chunks) : values(NULL),
+        n(chunks->size()), chunks(chunks) {
+        }
+
+        size_t size() const {
+            return n;
+        }
+
+        bool empty() const {
+            return n == 0;
+        }
+
+        Term_t operator[](const size_t pos) const {
+            return chunks ? chunks->get(pos) : values[pos];
+        }
+
+        Term_t at(const size_t pos) const {
+            return (*this)[pos];
+        }
+
+        Term_t back() const {
+            return (*this)[n - 1];
+        }
+
+        //The values, NULL if they are read in chunks
+        const Term_t *data() const {
+            return chunks ? NULL : values;
+        }
+
+        //Copy the values [begin, begin + len)
+        void copy(const size_t begin, const size_t len, Term_t *out) const {
+            if (chunks) {
+                chunks->copy(begin, len, out);
+            } else {
+                std::copy(values + begin, values + begin + len, out);
+            }
+        }
+
+        //The values as an array, copied in 'buffer' if they are in chunks
+        const Term_t *contiguous(std::vector<Term_t> &buffer) const {
+            if (!chunks) {
+                return values;
+            }
+            buffer.resize(n);
+            chunks->copy(0, n, buffer.data());
+            return buffer.data();
+        }
+};
 
 class Column {
+    private:
+        //Number of views requested on a column without contiguous values.
+        //The chunks are cached from the second one (the column is read by
+        //more joins)
+        std::atomic<int> viewRequests;
+
     public:
+        Column() : viewRequests(0) {
+        }
+
         virtual bool isEmpty() const = 0;
 
         virtual bool isEDB() const = 0;
@@ -46,6 +186,11 @@ class Column {
 
         virtual size_t estimateSize() const = 0;
 
+        //Bytes used by the values of the column
+        virtual size_t getMemoryBytes() const {
+            return size() * sizeof(Term_t);
+        }
+
         virtual Term_t getValue(const size_t pos) const = 0;
 
         virtual bool supportsDirectAccess() const = 0;
@@ -58,6 +203,29 @@ class Column {
             throw 10; //Should be used only on subclasses that supports this
         }
 
+        //The values if they are contiguous in memory, otherwise NULL
+        virtual const Term_t *getData() {
+            return isBackedByVector() ? getVectorRef().data() : NULL;
+        }
+
+        //The values of the column, without copying them if they are
+        //contiguous (see getData). Otherwise they are read in chunks, which
+        //are kept in a cache of COLUMN_VIEWCACHE_MAX_MB (least recently used
+        //first out) if the column is read more than once. The view must be
+        //returned with releaseView
+        const ColumnView *getView();
+
+        static void releaseView(const ColumnView *v) {
+            delete v;
+        }
+
+        //Bytes of the chunks in the cache
+        static size_t getCachedViewBytes();
+
+        //Drop the least recently used chunks from the cache until at least
+        //'bytes' are freed. Returns the bytes freed
+        static size_t evictViews(const size_t bytes);
+
         virtual bool isIn(const Term_t t) const = 0;
 
         virtual std::unique_ptr<ColumnReader> getReader() const = 0;
@@ -97,8 +265,7 @@ class Column {
                 std::shared_ptr<Column> subsumer,
                 std::shared_ptr<Column> subsumed);
 
-        virtual ~Column() {
-        }
+        virtual ~Column();
 };
 
 //----- COMPRESSED COLUMN ----------
@@ -119,6 +286,9 @@ class CompressedColumn: public Column {
     private:
         std::vector<CompressedColumnBlock> blocks;
         size_t _size;
+        //Position of the first value of every block, for getValue. Empty if
+        //there is only one block
+        std::vector<size_t> starts;
 
         //CompressedColumn(const CompressedColumn &o);
 
@@ -131,6 +301,14 @@ class CompressedColumn: public Column {
         CompressedColumn(std::vector<CompressedColumnBlock> &blocks,
                 const size_t size) : _size(size) {
             this->blocks.swap(blocks);
+            if (this->blocks.size() > 1) {
+                starts.reserve(this->blocks.size());
+                size_t p = 0;
+                for (const auto &block : this->blocks) {
+                    starts.push_back(p);
+                    p += block.size + 1;
+                }
+            }
         }
 
         size_t size() const {
@@ -141,6 +319,11 @@ class CompressedColumn: public Column {
             return _size;
         }
 
+        size_t getMemoryBytes() const {
+            return blocks.size() * sizeof(CompressedColumnBlock) +
+                starts.size() * sizeof(size_t);
+        }
+
         Term_t getValue(const size_t pos) const;
 
         bool supportsDirectAccess() const {
@@ -176,6 +359,121 @@ class CompressedColumn: public Column {
 };
 //----- END COMPRESSED COLUMN ----------
 
+//----- PACKED COLUMN ----------
+//Frame of reference with bit packing: the column is split in blocks of
+//PACKEDCOLUMN_BLOCK values, and every block stores its smallest value and the
+//differences from it with as many bits as the largest one needs. Sorted
+//columns that are not arithmetic runs (most IDB columns) shrink to a few bits
+//per value. Runs of equal values are already covered by CompressedColumn
+#define PACKEDCOLUMN_BLOCK 128
+
+//ColumnWriter::getColumn packs only the columns with at least these rows, and
+//only if they become at most half as large
+#define PACKEDCOLUMN_MIN_ROWS 65536
+
+struct PackedColumnBlock {
+    Term_t base;
+    uint8_t bits;
+    //First word of the block
+    size_t offset;
+
+    PackedColumnBlock(const Term_t base, const uint8_t bits,
+            const size_t offset) : base(base), bits(bits), offset(offset) {}
+};
+
+class PackedColumn: public Column {
+    private:
+        std::vector<PackedColumnBlock> blocks;
+        std::vector<uint64_t> words;
+        size_t _size;
+
+    public:
+        PackedColumn(const std::vector<Term_t> &values);
+
+        //Bytes taken by the packed form of values
+        static size_t estimateBytes(const std::vector<Term_t> &values);
+
+        //Decode the values [start, start + n) of block b in out
+        void unpack(const size_t b, const size_t start, const size_t n,
+                Term_t *out) const;
+
+        size_t size() const {
+            return _size;
+        }
+
+        size_t estimateSize() const {
+            return _size;
+        }
+
+        size_t getMemoryBytes() const {
+            return blocks.size() * sizeof(PackedColumnBlock) +
+                words.size() * sizeof(uint64_t);
+        }
+
+        Term_t getValue(const size_t pos) const;
+
+        bool supportsDirectAccess() const {
+            return true;
+        }
+
+        bool isEmpty() const {
+            return _size == 0;
+        }
+
+        std::unique_ptr<ColumnReader> getReader() const;
+
+        bool isEDB() const {
+            return false;
+        }
+
+        std::shared_ptr<Column> sort() const;
+
+        std::shared_ptr<Column> sort(const int nthreads) const;
+
+        std::shared_ptr<Column> unique() const;
+
+        //Assumes the column is sorted, like InmemoryColumn
+        bool isIn(const Term_t t) const;
+
+        bool isConstant() const;
+};
+
+class PackedColumnReader : public ColumnReader {
+    private:
+        const PackedColumn &column;
+        size_t pos;
+        //The decoded block that contains pos
+        Term_t buffer[PACKEDCOLUMN_BLOCK];
+        size_t bufferBlock;
+
+    public:
+        PackedColumnReader(const PackedColumn &column) : column(column),
+        pos(0), bufferBlock(~(size_t) 0) {
+        }
+
+        Term_t first() {
+            return column.getValue(0);
+        }
+
+        Term_t last() {
+            return column.getValue(column.size() - 1);
+        }
+
+        std::vector<Term_t> asVector();
+
+        bool hasNext() {
+            return pos < column.size();
+        }
+
+        Term_t next();
+
+        size_t nextBatch(Term_t *out, const size_t maxRows);
+
+        void clear() {
+        }
+};
+//----- END PACKED COLUMN ----------
+
 class ColumnWriter {
     private:
         bool cached;
@@ -233,6 +531,23 @@ class ColumnWriter {
             _size++;
         }
 
+        void add(const Term_t *v, const size_t n) {
+            if (n == 0) {
+                return;
+            }
+#ifdef USE_COMPRESSED_COLUMNS
+            if (compressed) {
+                for (size_t i = 0; i < n; ++i) {
+                    add(v[i]);
+                }
+                return;
+            }
+#endif
+            values.insert(values.end(), v, v + n);
+            lastv = v[n - 1];
+            _size += n;
+        }
+
         bool isEmpty() const { return _size == 0; }
 
         size_t size() const { return _size; }
@@ -248,6 +563,18 @@ class ColumnWriter {
         static std::shared_ptr<Column> getColumn(std::vector<Term_t> &values, bool isSorted);
 };
 
+//Buffers for a batch of BATCH_ROWS rows, one array per column
+struct ColumnBatch {
+    std::vector<Term_t> buffer;
+    Term_t *columns[SIZETUPLE];
+
+    ColumnBatch(const uint8_t ncolumns) : buffer(ncolumns * BATCH_ROWS) {
+        for (uint8_t i = 0; i < ncolumns; ++i) {
+            columns[i] = buffer.data() + i * BATCH_ROWS;
+        }
+    }
+};
+
 //----- END GENERIC INTERFACES -------
 
 class ColumnReaderImpl : public ColumnReader {
@@ -281,6 +608,8 @@ class ColumnReaderImpl : public ColumnReader {
 
         Term_t next();
 
+        size_t nextBatch(Term_t *out, const size_t maxRows);
+
         void clear() {
         }
 };
@@ -322,6 +651,14 @@ class InmemColumnReader : public ColumnReader {
             return col[currentPos++];
         }
 
+        size_t nextBatch(Term_t *out, const size_t maxRows) {
+            const size_t n = std::min(maxRows, end - currentPos);
+            std::copy(col.begin() + currentPos, col.begin() + currentPos + n,
+                    out);
+            currentPos += n;
+            return n;
+        }
+
         void clear() {
         }
 };
@@ -477,6 +814,11 @@ class SubColumn : public Column {
             return len;
         }
 
+        //The values belong to the parent column
+        size_t getMemoryBytes() const {
+            return 0;
+        }
+
         bool isEmpty() const {
             return len == 0;
         }
@@ -485,6 +827,10 @@ class SubColumn : public Column {
             return values[start + pos];
         }
 
+        const Term_t *getData() {
+            return values.data() + start;
+        }
+
         bool supportsDirectAccess() const {
             return true;
         }
@@ -665,6 +1011,11 @@ class EDBColumn : public Column {
 
         size_t estimateSize() const;
 
+        //The values are stored in the EDB layer
+        size_t getMemoryBytes() const {
+            return 0;
+        }
+
         bool isEmpty() const {
             return false;
         }
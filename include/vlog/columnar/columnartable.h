@@ -0,0 +1,190 @@
+#ifndef _COLUMNAR_H
+#define _COLUMNAR_H
+
+#include <vlog/column.h>
+#include <vlog/edbtable.h>
+#include <vlog/edbiterator.h>
+#include <vlog/segment.h>
+#include <vlog/fcstore.h>
+#include <vlog/inmemory/inmemorytable.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Read-only EDB table stored in the binary file <repository>/<table>.vcol.
+ * The file is written from <table>.csv the first time the table is opened,
+ * afterwards it is only mapped. It contains the rows sorted in several column
+ * orders (all of them up to COLUMNAR_ALLORDERS_MAXARITY columns, otherwise
+ * one for every leading column), so that sorted iterators and lookups on
+ * constants are ranges of the mapped columns:
+ *
+ *   header:    magic, version, sizeof(Term_t), arity, nrows, norders
+ *   per order: the arity fields of the order, the offset of its columns,
+ *              the number of distinct values of its first field, the offset
+ *              of these values and the offset of the rows where they start
+ *   data:      for every order, the arity columns (in the positions of the
+ *              table) sorted by the order, then the distinct values of the
+ *              first field and their nkeys + 1 starting rows
+ *
+ * All fields are 8 bytes. The terms are numbered by a dictionary shared by the
+ * columnar tables of the repository (<repository>/dict.vcol):
+ *
+ *   header: magic, version, nterms
+ *   data:   nterms + 1 offsets in the text, the nterms ids sorted by text,
+ *           the text of the terms (id i is the term i - 1)
+ *
+ * Since the ids of two dictionaries would clash, the COLUMNAR tables of a
+ * configuration must all be in the same repository and cannot be mixed with
+ * tables of other types (see EDBLayer::checkDictionaries).
+ */
+
+#define COLUMNAR_MAGIC 0x4C4F4356u //"VCOL"
+#define COLUMNAR_DICT_MAGIC 0x54434456u //"VDCT"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_EXT ".vcol"
+#define COLUMNAR_DICT "dict.vcol"
+
+#define COLUMNAR_ALLORDERS_MAXARITY 3
+
+class ColumnarDict {
+    private:
+        std::shared_ptr<const MmapFile> file;
+        uint64_t nterms;
+        const uint64_t *offsets;
+        const uint64_t *sorted;
+        const char *text;
+
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const ColumnarDict>> dicts;
+
+        int compare(const uint64_t id, const char *t, const size_t len) const;
+
+    public:
+        ColumnarDict(const std::string &path);
+
+        //Dictionary of the repository, NULL if it does not exist yet
+        static std::shared_ptr<const ColumnarDict> get(
+                const std::string &repository);
+
+        //Write the terms of 'dict' as the dictionary of the repository. The
+        //tables that are already open keep their ids, since terms are only
+        //appended
+        static void write(const std::string &repository, Dictionary &dict);
+
+        //Add the terms to 'dict', in the order of their ids
+        void copyTo(Dictionary &dict) const;
+
+        bool getText(const uint64_t id, char *text) const;
+
+        //Text of the term 'id' in the mapped file (not zero-terminated)
+        const char *getText(const uint64_t id, size_t &len) const;
+
+        bool getID(const char *text, const size_t sizeText,
+                uint64_t &id) const;
+
+        uint64_t getNTerms() const {
+            return nterms;
+        }
+};
+
+struct ColumnarOrder {
+    std::vector<uint8_t> fields;
+    //Indexed by the position of the column in the table
+    std::vector<const Term_t*> columns;
+    uint64_t nkeys;
+    const Term_t *keys;
+    const uint64_t *starts;
+};
+
+class ColumnarTable : public EDBTable {
+    private:
+        const std::string repository;
+        PredId_t predid;
+        uint8_t arity;
+        uint64_t nrows;
+        std::shared_ptr<const MmapFile> file;
+        std::vector<ColumnarOrder> orders;
+
+        static void convert(const std::string &repository,
+                const std::string &tablename, int nthreads);
+
+        //The first order that starts with the columns 'constants' (in any
+        //order) followed by 'fields'. NULL if there is none
+        const ColumnarOrder *findOrder(const std::vector<uint8_t> &constants,
+                const std::vector<uint8_t> &fields) const;
+
+        //Rows [begin, end) of 'order' with the values 'values' in the columns
+        //'constants', which must be the first ones of the order
+        void getRange(const ColumnarOrder &order,
+                const std::vector<uint8_t> &constants,
+                const std::vector<Term_t> &values,
+                size_t &begin, size_t &end) const;
+
+        //Rows [begin, end) of 'order', without copying them
+        std::shared_ptr<const Segment> getSegment(const ColumnarOrder &order,
+                const size_t begin, const size_t end,
+                const std::vector<uint8_t> &constants) const;
+
+        //Rows of the table that match 'query', sorted by 'fields'. Copies
+        //the rows only if no order of the file fits
+        std::shared_ptr<const Segment> getMatchingRows(const Literal &query,
+                const std::vector<uint8_t> &fields);
+
+    public:
+        //Open (or create from the CSV file) <repository>/<tablename>.vcol
+        ColumnarTable(std::string repository, std::string tablename,
+                PredId_t predid, int nthreads);
+
+        uint8_t getArity() const {
+            return arity;
+        }
+
+        std::vector<std::shared_ptr<Column>> checkNewIn(
+                std::vector<std::shared_ptr<Column>> &checkValues,
+                const Literal &l2,
+                std::vector<uint8_t> &posInL2);
+
+        std::shared_ptr<Column> checkIn(
+                std::vector<Term_t> &values,
+                const Literal &l2,
+                uint8_t posInL2,
+                size_t &sizeOutput);
+
+        void query(QSQQuery *query, TupleTable *outputTable,
+                std::vector<uint8_t> *posToFilter,
+                std::vector<Term_t> *valuesToFilter);
+
+        size_t estimateCardinality(const Literal &query);
+
+        size_t getCardinality(const Literal &query);
+
+        size_t getCardinalityColumn(const Literal &query, uint8_t posColumn);
+
+        bool isEmpty(const Literal &query, std::vector<uint8_t> *posToFilter,
+                std::vector<Term_t> *valuesToFilter);
+
+        EDBIterator *getIterator(const Literal &query);
+
+        EDBIterator *getSortedIterator(const Literal &query,
+                const std::vector<uint8_t> &fields);
+
+        void releaseIterator(EDBIterator *itr);
+
+        bool getDictNumber(const char *text, const size_t sizeText,
+                uint64_t &id);
+
+        bool getDictText(const uint64_t id, char *text);
+
+        const char *getDictTextPtr(const uint64_t id, size_t &len);
+
+        uint64_t getNTerms();
+
+        uint64_t getSize();
+
+        ~ColumnarTable();
+};
+
+#endif
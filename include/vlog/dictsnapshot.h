@@ -0,0 +1,67 @@
+#ifndef _DICTSNAPSHOT_H
+#define _DICTSNAPSHOT_H
+
+#include <inttypes.h>
+#include <memory>
+#include <string>
+
+/*
+ * Read-only snapshot of the dictionary of an EDB table, stored in a file that
+ * is mapped in memory. The text of a term is a pointer in the mapped file, so
+ * decompressing the output does not look up or copy anything:
+ *
+ *   header: magic, version, first id, nterms
+ *   data:   nterms + 1 offsets in the text, the text of the terms, each one
+ *           followed by a '\0' (id i is the term i - first id)
+ *
+ * All fields are 8 bytes.
+ */
+
+#define DICTSNAPSHOT_MAGIC 0x4E534456u //"VDSN"
+#define DICTSNAPSHOT_VERSION 1
+
+class MmapFile;
+class EDBTable;
+
+class DictSnapshot {
+    private:
+        std::shared_ptr<const MmapFile> file;
+        uint64_t first;
+        uint64_t nterms;
+        const uint64_t *offsets;
+        const char *text;
+
+    public:
+        DictSnapshot(const std::string &path);
+
+        //Write the dictionary of 'table' in 'path'
+        static void write(const std::string &path, EDBTable &table);
+
+        //First id of the dictionary of 'table' (0 or 1)
+        static uint64_t getFirstId(EDBTable &table);
+
+        //True if the snapshot has the ids of the dictionary of 'table', and
+        //the same text for the first and the last of them
+        bool matches(EDBTable &table) const;
+
+        //Text of the term 'id' (zero-terminated), NULL if it is not in the
+        //snapshot
+        const char *get(const uint64_t id, size_t &len) const {
+            if (id < first || id - first >= nterms) {
+                return NULL;
+            }
+            const uint64_t i = id - first;
+            len = offsets[i + 1] - offsets[i] - 1;
+            return text + offsets[i];
+        }
+
+        uint64_t getFirstId() const {
+            return first;
+        }
+
+        uint64_t getNTerms() const {
+            return nterms;
+        }
+};
+
+#endif
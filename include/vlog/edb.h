@@ -10,6 +10,7 @@
 #include <vlog/edbtable.h>
 #include <vlog/edbiterator.h>
 #include <vlog/edbconf.h>
+#include <vlog/dictsnapshot.h>
 
 #include <kognac/factory.h>
 
@@ -78,6 +79,9 @@ class EDBLayer {
         Factory<EDBMemIterator> memItrFactory;
         IndexedTupleTable *tmpRelations[MAX_NPREDS];
 
+        //If set, the text of the terms is read from it
+        std::unique_ptr<DictSnapshot> dictSnapshot;
+
         void addTridentTable(const EDBConf::Table &tableConf, bool multithreaded);
 
 #ifdef MYSQL
@@ -94,9 +98,15 @@ class EDBLayer {
 #endif
         void addInmemoryTable(const EDBConf::Table &tableConf);
 
+        void addColumnarTable(const EDBConf::Table &tableConf);
+
+        //Throws if the tables do not share the same term ids
+        static void checkDictionaries(const std::vector<EDBConf::Table> &tables);
+
     public:
         EDBLayer(EDBConf &conf, bool multithreaded) {
             const std::vector<EDBConf::Table> tables = conf.getTables();
+            checkDictionaries(tables);
             for (const auto &table : tables) {
                 if (table.type == "Trident") {
                     addTridentTable(table, multithreaded);
@@ -118,6 +128,8 @@ class EDBLayer {
 #endif
                 } else if (table.type == "INMEMORY") {
                     addInmemoryTable(table);
+                } else if (table.type == "COLUMNAR") {
+                    addColumnarTable(table);
                 } else {
                     LOG(ERRORL) << "Type of table is not supported";
                     throw 10;
@@ -212,6 +224,15 @@ class EDBLayer {
 
         bool getDictText(const uint64_t id, char *text);
 
+        //Text of the term 'id' and its length. It is copied in 'buffer' only
+        //if neither the snapshot nor the table have it in memory. NULL if the
+        //term is not in the dictionary
+        const char *getDictText(const uint64_t id, char *buffer, size_t &len);
+
+        //Map the snapshot of the dictionary in 'path', after writing it if the
+        //file does not exist or does not match the dictionary of the tables
+        void useDictSnapshot(const std::string &path);
+
         Predicate getDBPredicate(int idx);
 
         std::shared_ptr<EDBTable> getEDBTable(PredId_t id) {
@@ -19,6 +19,22 @@ class EDBIterator {
 
         virtual void skipDuplicatedFirstColumn() = 0;
 
+        //Copy the next (at most) maxRows rows in out: out[i] receives the
+        //values at positions[i]. The iterator is left on the last copied row.
+        //Returns the number of rows, 0 at the end
+        virtual size_t nextBatch(Term_t **out, const uint8_t ncolumns,
+                const uint8_t *positions, const size_t maxRows) {
+            size_t n = 0;
+            while (n < maxRows && hasNext()) {
+                next();
+                for (uint8_t i = 0; i < ncolumns; ++i) {
+                    out[i][n] = getElementAt(positions[i]);
+                }
+                n++;
+            }
+            return n;
+        }
+
         virtual void clear() = 0;
 
         virtual const char *getUnderlyingArray(uint8_t column) {
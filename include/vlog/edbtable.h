@@ -48,6 +48,12 @@ public:
 
     virtual bool getDictText(const uint64_t id, char *text) = 0;
 
+    //Text of the term 'id' and its length, if the table keeps it in memory
+    //and it does not have to be copied. Otherwise NULL
+    virtual const char *getDictTextPtr(const uint64_t id, size_t &len) {
+        return NULL;
+    }
+
     virtual uint64_t getNTerms() = 0;
 
     virtual uint64_t getSize() = 0;
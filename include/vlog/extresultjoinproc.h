@@ -78,11 +78,11 @@ class ExistentialRuleProcessor : public FinalRuleProcessor {
         }
 
         void processResults(const int blockid,
-                const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+                const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const bool unique);
 
-        void processResults(std::vector<int> &blockid, Term_t *p, std::vector<bool> &unique, std::mutex *m) {
+        void processResults(std::vector<int> &blockid, Term_t *p, std::vector<uint8_t> &unique, std::mutex *m) {
             //TODO: Chase...
             LOG(ERRORL) << "Not implemented yet";
             throw 10;
@@ -27,6 +27,23 @@ class FCInternalTableItr {
 
         virtual void next() = 0;
 
+        //Copy the next (at most) maxRows rows in out, one array of
+        //getNColumns() columns (see ColumnBatch). The iterator is left on the
+        //last copied row, as if next() was called for every row. Returns the
+        //number of rows, 0 at the end
+        virtual size_t nextBatch(Term_t **out, const size_t maxRows) {
+            const uint8_t ncolumns = getNColumns();
+            size_t n = 0;
+            while (n < maxRows && hasNext()) {
+                next();
+                for (uint8_t i = 0; i < ncolumns; ++i) {
+                    out[i][n] = getCurrentValue(i);
+                }
+                n++;
+            }
+            return n;
+        }
+
         virtual void clear() {
         }
 
@@ -51,24 +68,18 @@ class FCInternalTableItr {
             return true;
         }
 
-        std::vector<const std::vector<Term_t> *> getAllVectors() {
+        std::vector<const ColumnView *> getAllVectors() {
             std::vector<std::shared_ptr<Column>> cols = getAllColumns();
-            std::vector<const std::vector<Term_t> *> vectors(cols.size());
+            std::vector<const ColumnView *> vectors(cols.size());
             for (int i = 0; i < cols.size(); i++) {
-                if (cols[i]->isBackedByVector()) {
-                    vectors[i] = &cols[i]->getVectorRef();
-                } else {
-                    std::vector<Term_t> *v = new std::vector<Term_t>();
-                    *v = cols[i]->getReader()->asVector();
-                    vectors[i] = v;
-                }
+                vectors[i] = cols[i]->getView();
             }
             return vectors;
         }
 
-        std::vector<const std::vector<Term_t> *> getAllVectors(int nthreads) {
+        std::vector<const ColumnView *> getAllVectors(int nthreads) {
             std::vector<std::shared_ptr<Column>> cols = getAllColumns();
-            std::vector<const std::vector<Term_t> *> vectors(cols.size());
+            std::vector<const ColumnView *> vectors(cols.size());
             int count = cols.size();
             for (int i = 0; i < cols.size(); i++) {
                 if (cols[i]->isBackedByVector()) {
@@ -83,25 +94,17 @@ class FCInternalTableItr {
                         GetVectors(cols, vectors));
             } else {
                 for (int i = 0; i < cols.size(); i++) {
-                    if (! cols[i]->isBackedByVector()) {
-                        std::vector<Term_t> *v = new std::vector<Term_t>();
-                        *v = cols[i]->getReader()->asVector();
-                        vectors[i] = v;
-                    } else {
-                        vectors[i] = &cols[i]->getVectorRef();
-                    }
+                    vectors[i] = cols[i]->getView();
                 }
             }
 
             return vectors;
         }
 
-        void deleteAllVectors(std::vector<const std::vector<Term_t> *> vectors) {
+        void deleteAllVectors(std::vector<const ColumnView *> vectors) {
             std::vector<std::shared_ptr<Column>> cols = getAllColumns();
             for (int i = 0; i < cols.size(); i++) {
-                if (! cols[i]->isBackedByVector()) {
-                    delete vectors[i];
-                }
+                cols[i]->releaseView(vectors[i]);
             }
         }
 
@@ -177,19 +180,19 @@ class FCInternalTable {
 
 class VectorFCInternalTableItr : public FCInternalTableItr {
     private:
-        const std::vector<const std::vector<Term_t> *> vectors;
+        const std::vector<const ColumnView *> vectors;
         int beginIndex;
         int endIndex;
         int currentIndex;
         bool first;
 
     public:
-        VectorFCInternalTableItr(const std::vector<const std::vector<Term_t> *> &vectors,
+        VectorFCInternalTableItr(const std::vector<const ColumnView *> &vectors,
                 int beginIndex, int endIndex) :
             vectors(vectors), beginIndex(beginIndex), endIndex(endIndex),
             currentIndex(beginIndex), first(true) {
                 if (endIndex > vectors[0]->size()) {
-                    endIndex = vectors[0]->size();
+                    this->endIndex = vectors[0]->size();
                 }
             }
 
@@ -230,6 +233,20 @@ class VectorFCInternalTableItr : public FCInternalTableItr {
             first = false;
         }
 
+        size_t nextBatch(Term_t **out, const size_t maxRows) {
+            const int begin = first ? currentIndex : currentIndex + 1;
+            if (begin >= endIndex) {
+                return 0;
+            }
+            const size_t n = std::min(maxRows, (size_t) (endIndex - begin));
+            for (size_t i = 0; i < vectors.size(); ++i) {
+                vectors[i]->copy(begin, n, out[i]);
+            }
+            currentIndex = begin + n - 1;
+            first = false;
+            return n;
+        }
+
         void clear() {
         }
 
@@ -282,6 +299,10 @@ class InmemoryFCInternalTableItr : public FCInternalTableItr {
             segmentIterator->next();
         }
 
+        size_t nextBatch(Term_t **out, const size_t maxRows) {
+            return segmentIterator->nextBatch(out, maxRows);
+        }
+
         void clear() {
             if (segmentIterator != NULL) {
                 segmentIterator->clear();
@@ -342,6 +363,8 @@ class EDBFCInternalTableItr : public FCInternalTableItr {
 
         inline void next();
 
+        size_t nextBatch(Term_t **out, const size_t maxRows);
+
         FCInternalTableItr *copy() const ;
 
         ~EDBFCInternalTableItr() {}
@@ -0,0 +1,205 @@
+#ifndef _FCSTORE_H
+#define _FCSTORE_H
+
+#include <vlog/column.h>
+#include <vlog/fctable.h>
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+/*
+ * Binary snapshot of the content of a FCTable. Every predicate is stored in
+ * its own file with the layout
+ *
+ *   header:    magic, version, sizeof(Term_t), sizeRow, nblocks
+ *   per block: iteration, nrows, posQueryInRule, ruleExecOrder, isCompleted,
+ *              the terms of the query literal (var id and value),
+ *              for every column a flag "constant" and the offset of its data
+ *   data:      for every column of every block, nrows Term_t values
+ *
+ * All fields are 8 bytes, so the column data is aligned and can be used
+ * directly from the mapped file.
+ */
+
+#define FCSTORE_MAGIC 0x56464354u //"VFCT"
+#define FCSTORE_VERSION 1
+#define FCSTORE_EXT ".fct"
+#define FCSTORE_SPILL_EXT ".spill"
+
+//Columns that are compressed at least by this factor are not worth spilling
+#define FCSTORE_SPILL_MINRATIO 8
+
+//Read-only mapping of a whole file. It is shared among all the columns
+//that point inside it and unmapped when the last one is released
+class MmapFile {
+    private:
+        char *data;
+        size_t length;
+
+        MmapFile(const MmapFile &);
+
+    public:
+        MmapFile(const std::string &path);
+
+        const char *getData() const {
+            return data;
+        }
+
+        size_t getLength() const {
+            return length;
+        }
+
+        ~MmapFile();
+};
+
+class MmapColumnReader : public ColumnReader {
+    private:
+        const Term_t *values;
+        const size_t len;
+        size_t currentPos;
+
+    public:
+        MmapColumnReader(const Term_t *values, const size_t len) :
+            values(values), len(len), currentPos(0) {
+            }
+
+        Term_t first() {
+            return values[0];
+        }
+
+        Term_t last() {
+            return values[len - 1];
+        }
+
+        std::vector<Term_t> asVector() {
+            return std::vector<Term_t>(values, values + len);
+        }
+
+        bool hasNext() {
+            return currentPos < len;
+        }
+
+        Term_t next() {
+            return values[currentPos++];
+        }
+
+        size_t nextBatch(Term_t *out, const size_t maxRows) {
+            const size_t n = std::min(maxRows, len - currentPos);
+            std::memcpy(out, values + currentPos, n * sizeof(Term_t));
+            currentPos += n;
+            return n;
+        }
+
+        void clear() {
+        }
+};
+
+//Column whose values live in a mapped snapshot file
+class MmapColumn : public Column {
+    private:
+        std::shared_ptr<const MmapFile> file;
+        const Term_t *values;
+        const size_t len;
+        const bool constant;
+
+        std::vector<Term_t> copy() const {
+            return std::vector<Term_t>(values, values + len);
+        }
+
+    public:
+        MmapColumn(std::shared_ptr<const MmapFile> file, const Term_t *values,
+                const size_t len, const bool constant) : file(file),
+        values(values), len(len), constant(constant) {
+        }
+
+        size_t size() const {
+            return len;
+        }
+
+        size_t estimateSize() const {
+            return len;
+        }
+
+        bool isEmpty() const {
+            return len == 0;
+        }
+
+        bool isEDB() const {
+            return false;
+        }
+
+        bool containsDuplicates() const {
+            return len > 1;
+        }
+
+        Term_t getValue(const size_t pos) const {
+            return values[pos];
+        }
+
+        const Term_t *getData() {
+            return values;
+        }
+
+        bool supportsDirectAccess() const {
+            return true;
+        }
+
+        std::unique_ptr<ColumnReader> getReader() const {
+            return std::unique_ptr<ColumnReader>(
+                    new MmapColumnReader(values, len));
+        }
+
+        std::shared_ptr<Column> sort() const;
+
+        std::shared_ptr<Column> sort(const int nthreads) const;
+
+        std::shared_ptr<Column> unique() const;
+
+        bool isConstant() const {
+            return constant;
+        }
+
+        bool isIn(const Term_t t) const {
+            return std::binary_search(values, values + len, t);
+        }
+
+        //The pages are backed by the file, the kernel can drop them
+        size_t getMemoryBytes() const {
+            return 0;
+        }
+};
+
+class FCStore {
+    private:
+        static void writeTable(const std::string &path, FCTable *table);
+
+    public:
+        //Write all the non-empty IDB tables in the directory 'path'
+        static void store(const std::string &path, Program *program,
+                FCTable **tables);
+
+        //Map the file 'path' and return the blocks it contains. The blocks
+        //are not linked to any rule.
+        static std::vector<FCBlock> load(const std::string &path,
+                const Predicate &pred);
+
+        //False for the columns that spilling would not shrink: the ones
+        //compressed by at least FCSTORE_SPILL_MINRATIO and the ones that are
+        //already in a file
+        static bool isWorthSpilling(const Column &column);
+
+        //Write the columns of 'table' (sorted) that are worth it in a new
+        //file in 'dir', map it and return a table that reads them from the
+        //mapping. Returns 'table' itself if no column is worth it. The file
+        //is unlinked right away, so it disappears with the last column that
+        //uses it. The values are stored plain so they can be used in place,
+        //and the kernel pages them in and out as needed
+        static std::shared_ptr<const FCInternalTable> spill(
+                const std::string &dir,
+                std::shared_ptr<const FCInternalTable> table,
+                const size_t iteration);
+};
+
+#endif
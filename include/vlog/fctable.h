@@ -4,11 +4,15 @@
 #include <trident/model/table.h>
 #include <vlog/concepts.h>
 #include <vlog/fcinttable.h>
+#include <vlog/rowindex.h>
+#include <vlog/hll.h>
 
 #include <inttypes.h>
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <future>
+#include <atomic>
 
 struct RuleExecutionDetails;
 class FCTable;
@@ -20,9 +24,71 @@ struct FCRow {
     FCRow(const Term_t *row, const size_t iteration) : row(row), iteration(iteration) {}
 };
 
+#define FCZONEMAP_BLOOM_BITS 512
+#define FCZONEMAP_BLOOM_WORDS (FCZONEMAP_BLOOM_BITS / 64)
+//Larger blocks would saturate the bloom filter
+#define FCZONEMAP_BLOOM_MAXROWS 128
+
+//Summary of the values of every column of a block: min, max, a sketch of the
+//distinct values and, for small blocks, a bloom filter. It tells when a block
+//cannot contain a tuple
+class FCZoneMap {
+    private:
+        const uint8_t ncols;
+        Term_t min[SIZETUPLE];
+        Term_t max[SIZETUPLE];
+        std::vector<uint64_t> bloom;
+        std::vector<HyperLogLog> sketches;
+
+        FCZoneMap(const uint8_t ncols) : ncols(ncols), sketches(ncols) {
+        }
+
+        static void bloomBits(const Term_t v, size_t &b1, size_t &b2) {
+            const uint64_t h = (uint64_t) v * 0x9E3779B97F4A7C15ull;
+            b1 = (h >> 40) % FCZONEMAP_BLOOM_BITS;
+            b2 = (h >> 20) % FCZONEMAP_BLOOM_BITS;
+        }
+
+        void addToBloom(const uint8_t col, const Term_t v);
+
+        bool bloomContains(const uint8_t col, const Term_t v) const;
+
+    public:
+        //NULL if the table is a view on the EDB layer (too expensive to scan)
+        static std::shared_ptr<const FCZoneMap> create(
+                std::shared_ptr<const FCInternalTable> table);
+
+        //Zone map of the union of two blocks
+        static std::shared_ptr<const FCZoneMap> merge(
+                std::shared_ptr<const FCZoneMap> z1,
+                std::shared_ptr<const FCZoneMap> z2);
+
+        //False only if no row has all the values at the given positions
+        bool mayContain(const uint8_t nconstants, const uint8_t *posConstants,
+                const Term_t *valueConstants) const;
+
+        Term_t getMin(const uint8_t pos) const {
+            return min[pos];
+        }
+
+        Term_t getMax(const uint8_t pos) const {
+            return max[pos];
+        }
+
+        const HyperLogLog &getSketch(const uint8_t pos) const {
+            return sketches[pos];
+        }
+
+        //False only if the two columns cannot share a value
+        bool mayOverlap(const uint8_t pos1, const uint8_t pos2) const {
+            return min[pos1] <= max[pos2] && min[pos2] <= max[pos1];
+        }
+};
+
 struct FCBlock {
     size_t iteration;
     std::shared_ptr<const FCInternalTable> table;
+    std::shared_ptr<const FCZoneMap> zonemap; //Can be NULL
 
     Literal query;
     uint8_t posQueryInRule;
@@ -31,6 +97,13 @@ struct FCBlock {
 
     bool isCompleted;
 
+    //Blocks without zone map might be views on the EDB layer, which must not
+    //be read from another thread (compaction) nor replaced by a copy on disk
+    //(spilling)
+    bool isIDBBacked() const {
+        return zonemap != NULL;
+    }
+
     FCBlock(size_t iteration, std::shared_ptr<const FCInternalTable> table,
             Literal query, uint8_t posQueryInRule, const RuleExecutionDetails *rule,
             const uint8_t ruleExecOrder, bool isCompleted) : iteration(iteration),
@@ -79,6 +152,43 @@ class FCIterator {
 
 typedef std::unordered_map<std::string, FCCacheBlock, std::hash<std::string>, std::equal_to<std::string>> FCCache;
 
+//Blocks are compacted when there are at least FCTABLE_COMPACT_MINBLOCKS
+//consecutive ones with less than FCTABLE_COMPACT_MAXROWS rows
+#define FCTABLE_COMPACT_MINBLOCKS 8
+#define FCTABLE_COMPACT_MAXROWS 65536
+
+//retainFrom switches to a hash index of the rows (see RowIndex) on tables
+//with at least FCTABLE_HASHRETAIN_MINARITY columns and
+//FCTABLE_HASHRETAIN_MINROWS rows, when the new rows are at most
+//1/FCTABLE_HASHRETAIN_RATIO of them. Measured with vlog_bench_retain: from a
+//delta of 1/16 the lookups beat the merge on tables of up to 1M rows (1M
+//rows, 1/16: 14ms against 31ms), and the index, built once per table, pays
+//off after 2-4 retains. On smaller tables the merge takes less than 1ms
+//(10K rows) and is not worth the memory of the index
+#define FCTABLE_HASHRETAIN_MINARITY 3
+#define FCTABLE_HASHRETAIN_MINROWS 100000
+#define FCTABLE_HASHRETAIN_RATIO 16
+
+//Only blocks with at least this number of rows are moved to disk when the
+//memory budget is exceeded. Smaller blocks are left to the compaction, so a
+//block is never spilled while it is merged
+#define FCTABLE_SPILL_MINROWS FCTABLE_COMPACT_MAXROWS
+
+//Block that can be moved to disk (see FCTable::spill)
+struct FCSpillCandidate {
+    FCTable *table;
+    size_t block;
+    size_t lastRead;
+    size_t iteration;
+    size_t bytes;
+};
+
+//Merge of a run of blocks, computed in the background
+struct FCCompaction {
+    std::vector<std::shared_ptr<const FCInternalTable>> sources;
+    std::future<std::shared_ptr<const FCInternalTable>> result;
+};
+
 class FCTable {
     private:
         const uint8_t sizeRow;
@@ -93,6 +203,48 @@ class FCTable {
 
         void removeBlock(const size_t iteration);
 
+        std::unique_ptr<FCCompaction> compaction;
+
+        static bool canBeCompacted(const FCBlock &block,
+                const size_t maxIteration);
+
+        void startCompaction(const size_t begin, const size_t end);
+
+        size_t installCompaction();
+
+        //Built by retainFrom the first time it pays off, then kept up to
+        //date by every method that adds, replaces or drops a block
+        mutable std::unique_ptr<RowIndex> rowIndex;
+        //Set when the index was dropped to stay within the memory budget,
+        //so that retainFrom does not build it again
+        bool rowIndexDisabled;
+
+        //Replace the rows of 'oldTable' with the ones of 'newTable' in the
+        //index. Either can be NULL
+        void indexBlock(std::shared_ptr<const FCInternalTable> oldTable,
+                std::shared_ptr<const FCInternalTable> newTable);
+
+        //Value of readClock at the last read of the table, to spill the
+        //blocks of the tables that were not used for the longest time
+        mutable std::atomic<size_t> lastRead;
+        static std::atomic<size_t> readClock;
+
+        void touch() const {
+            lastRead = ++readClock;
+        }
+
+        //Running totals of getMemoryBytes, updated by every method that
+        //adds, replaces or drops a block
+        size_t memoryBytes;
+        size_t uncompressedBytes;
+
+        //Add the columns of 'table' to the totals, or remove them
+        void countMemory(std::shared_ptr<const FCInternalTable> table,
+                const bool add);
+
+        //Compute the totals again from all the blocks
+        void recountMemory();
+
     public:
         FCTable(std::mutex *mutex, const uint8_t sizeRow);
 
@@ -129,8 +281,36 @@ class FCTable {
 
         size_t getNAllRows() const;
 
+        //Bytes used by the columns of the IDB blocks. 'uncompressed' receives
+        //what they would take as plain vectors
+        size_t getMemoryBytes(size_t &uncompressed) const {
+            uncompressed = uncompressedBytes;
+            return memoryBytes;
+        }
+
+        //Bytes used by the hash index of the rows (see retainFrom)
+        size_t getIndexMemoryBytes() const {
+            return rowIndex != NULL ? rowIndex->getMemoryBytes() : 0;
+        }
+
+        //Drop the hash index of the rows for good. Returns the number of
+        //bytes freed
+        size_t dropIndex();
+
         size_t getNRows(const size_t iteration) const;
 
+        //Append to 'out' the blocks that can be moved to disk: completed
+        //IDB blocks with some column worth spilling (see
+        //FCStore::isWorthSpilling), with iteration < maxIteration and at
+        //least FCTABLE_SPILL_MINROWS rows. The last block is never included
+        void getSpillCandidates(const size_t maxIteration,
+                std::vector<FCSpillCandidate> &out);
+
+        //Move the columns of the block 'idx' in a file in 'dir' (see
+        //FCStore::spill). Returns the number of bytes freed, 0 if the block
+        //was left as it is
+        size_t spill(const size_t idx, const std::string &dir);
+
         bool isEmpty() const;
 
         bool isEmpty(size_t count) const;
@@ -141,6 +321,12 @@ class FCTable {
 
         size_t estimateCardinality(const Literal &literal, const size_t min, const size_t max) const;
 
+        //Number of distinct values in the column 'pos' of the blocks in
+        //[min, max], from the sketches of the blocks. Blocks without a
+        //sketch (views on the EDB layer) count all their rows
+        size_t estimateDistinct(const uint8_t pos, const size_t min,
+                const size_t max) const;
+
         uint8_t getSizeRow() const {
             return sizeRow;
         }
@@ -152,6 +338,25 @@ class FCTable {
 
         void addBlock(FCBlock block);
 
+        //Remove the rows in 'rows' from all the blocks. Blocks that become
+        //empty are dropped. Returns the number of removed rows
+        size_t removeRows(std::shared_ptr<const FCInternalTable> rows,
+                int nthreads);
+
+        //Drop the blocks that were not derived by one of 'rules'. Returns
+        //the number of removed rows
+        size_t retainBlocksFrom(
+                const std::vector<const RuleExecutionDetails*> &rules);
+
+        //LSM-style compaction. Runs of small consecutive blocks produced by
+        //the same rule and literal, all with iteration < maxIteration, are
+        //merged in a single sorted block in the background. The merged block
+        //takes the iteration of the last block of the run, so it must be
+        //called only if every reader of the table has already seen all the
+        //blocks before maxIteration. A merge that is ready is installed by
+        //the next call. Returns the number of blocks removed
+        size_t compact(const size_t maxIteration);
+
         bool add(std::shared_ptr<const FCInternalTable> t, const Literal &literal,
                 const uint8_t posLiteralInRule, const RuleExecutionDetails *detailsRule,
                 const uint8_t ruleExecOrder,
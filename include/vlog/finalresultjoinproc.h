@@ -109,7 +109,7 @@ class SingleHeadFinalRuleProcessor: public ResultJoinProcessor {
         bool isEmpty() const;
 
         void processResults(std::vector<int> &blockid, Term_t *p,
-                std::vector<bool> &unique, std::mutex *m);
+                std::vector<uint8_t> &unique, std::mutex *m);
 
         void processResults(const int blockid, const Term_t *first,
                 FCInternalTableItr* second, const bool unique);
@@ -118,8 +118,8 @@ class SingleHeadFinalRuleProcessor: public ResultJoinProcessor {
                 std::mutex *m);
 
         void processResults(const int blockid,
-                const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+                const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const bool unique);
 
         void processResults(const int blockid, FCInternalTableItr *first,
@@ -198,14 +198,14 @@ class FinalRuleProcessor: public ResultJoinProcessor {
                 std::mutex *m);
 
         virtual void processResults(std::vector<int> &blockid, Term_t *p,
-                std::vector<bool> &unique, std::mutex *m);
+                std::vector<uint8_t> &unique, std::mutex *m);
 
         virtual void processResults(const int blockid, const Term_t *first,
                 FCInternalTableItr* second, const bool unique);
 
         virtual void processResults(const int blockid,
-                const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+                const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const bool unique);
 
         virtual void processResults(const int blockid, FCInternalTableItr *first,
@@ -0,0 +1,50 @@
+#ifndef _HLL_H
+#define _HLL_H
+
+#include <vlog/concepts.h>
+
+#include <inttypes.h>
+#include <cstring>
+
+/*
+ * HyperLogLog sketch (Flajolet et al., 2007) of the distinct values of a
+ * column. The value is hashed, the first HLL_PRECISION bits select a register
+ * and the register keeps the largest number of leading zeros seen in the
+ * rest of the hash. Two sketches are merged with the maximum of every
+ * register, so the sketch of a union of blocks is the merge of their
+ * sketches. The standard error is 1.04 / sqrt(HLL_REGISTERS), i.e. 6.5%.
+ */
+
+#define HLL_PRECISION 8
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+
+class HyperLogLog {
+    private:
+        uint8_t registers[HLL_REGISTERS];
+
+    public:
+        HyperLogLog() {
+            memset(registers, 0, HLL_REGISTERS);
+        }
+
+        void add(const Term_t v) {
+            //Finalizer of splitmix64
+            uint64_t h = (uint64_t) v;
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+            h ^= h >> 31;
+            const size_t idx = h >> (64 - HLL_PRECISION);
+            const uint64_t rest = h << HLL_PRECISION;
+            const uint8_t rank = rest == 0 ? 64 - HLL_PRECISION + 1 :
+                __builtin_clzll(rest) + 1;
+            if (rank > registers[idx]) {
+                registers[idx] = rank;
+            }
+        }
+
+        void merge(const HyperLogLog &other);
+
+        double estimate() const;
+};
+
+#endif
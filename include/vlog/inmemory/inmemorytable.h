@@ -5,54 +5,7 @@
 #include <vlog/edbtable.h>
 #include <vlog/edbiterator.h>
 #include <vlog/segment.h>
-
-class InmemoryDict {
-    private:
-	std::unordered_map<uint64_t, string> dict;
-        std::unordered_map<string, uint64_t> invdict;
-        // bool isloaded;
-	uint64_t nextNum;
-
-    public:
-        InmemoryDict() : /* isloaded(false), */ nextNum(1) {
-        }
-
-//        bool isDictLoaded() {
-//            return isloaded;
-//        }
-//
-//        void add(uint64_t id, string value) {
-//            dict.insert(make_pair(id, value));
-//            invdict.insert(make_pair(value, id));
-//        }
-//
-        uint64_t getOrAdd(string value) {
-	    if (invdict.count(value)) {
-		return invdict[value];
-	    }
-	    uint64_t id = nextNum++;
-            dict.insert(make_pair(id, value));
-            invdict.insert(make_pair(value, id));
-	    return id;
-        }
-
-	string get(uint64_t v) {
-	    if (dict.count(v)) {
-		return dict[v];
-	    }
-	    return "";
-	}
-
-        bool getText(uint64_t id, char *text);
-
-        bool getID(const char *text, uint64_t sizetext, uint64_t &id);
-
-        uint64_t getNTerms() {
-            return dict.size();
-        }
-
-//        void load(string pathfile);
-};
+#include <vlog/support.h>
 
 class InmemoryIterator : public EDBIterator {
     private:
@@ -86,9 +39,17 @@ class InmemoryIterator : public EDBIterator {
 
         void skipDuplicatedFirstColumn();
 
+        size_t nextBatch(Term_t **out, const uint8_t ncolumns,
+                const uint8_t *positions, const size_t maxRows);
+
         void clear();
 };
 
+//The CSV files are parsed in chunks of at least INMEMORY_CSV_MINCHUNK bytes,
+//INMEMORY_CSV_CHUNKS_PER_THREAD per thread to balance the load
+#define INMEMORY_CSV_MINCHUNK (1 << 20)
+#define INMEMORY_CSV_CHUNKS_PER_THREAD 4
+
 class InmemoryTable : public EDBTable {
     private:
         struct Coordinates {
@@ -120,7 +81,15 @@ class InmemoryTable : public EDBTable {
                 const std::vector<uint8_t> &filterBy);
 
     public:
-        InmemoryTable(string repository, string tablename, PredId_t predid);
+        //Load the file <repository>/<tablename>.csv with 'nthreads' threads
+        InmemoryTable(string repository, string tablename, PredId_t predid,
+                int nthreads);
+
+        //Parse the CSV file 'tablefile' with 'nthreads' threads, one vector
+        //per column. The terms are added to 'dict' in the order in which
+        //they appear in the file. Returns the arity
+        static uint8_t loadCSV(const string &tablefile, int nthreads,
+                Dictionary &dict, std::vector<std::vector<Term_t>> &values);
 
         uint8_t getArity() const;
 
@@ -147,6 +116,8 @@ class InmemoryTable : public EDBTable {
 
         bool getDictText(const uint64_t id, char *text);
 
+        const char *getDictTextPtr(const uint64_t id, size_t &len);
+
         uint64_t getNTerms();
 
         void releaseIterator(EDBIterator *itr);
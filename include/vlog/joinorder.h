@@ -0,0 +1,44 @@
+#ifndef _JOINORDER_H
+#define _JOINORDER_H
+
+#include <vlog/concepts.h>
+
+#include <vector>
+
+/*
+ * Cost-based ordering of the body literals (dynamic programming over the
+ * subsets of the body, as in System R). Only left-deep orders are considered,
+ * since the joins are executed one literal at a time. The cost of an order is
+ * the sum of the estimated sizes of its intermediate results. The size of a
+ * join is |R||S| / max(V(R,x), V(S,x)) for every shared variable x, where
+ * V(R,x) is the number of distinct values of x in R.
+ */
+
+//Below this number of literals the heuristics in SemiNaiver::reorderPlan
+//are good enough, above it the search is too expensive
+#define JOINORDER_MIN_LITERALS 3
+#define JOINORDER_MAX_LITERALS 12
+
+//A plan is optimized again when the cardinality of a literal changes by this
+//factor
+#define JOINORDER_REPLAN_FACTOR 10
+
+struct JoinOrderStats {
+    double card;
+    //Number of distinct values of every variable of the literal
+    std::vector<std::pair<uint8_t, double>> distinct;
+};
+
+class JoinOrder {
+    public:
+        //Returns the order of the literals. 'estimates' receives the
+        //estimated size of the result after every literal of the order.
+        //Cartesian products are chosen only if there is no other option.
+        //Returns an empty order if the body has more than 64 variables
+        static std::vector<uint8_t> optimize(
+                const std::vector<const Literal*> &literals,
+                const std::vector<JoinOrderStats> &stats,
+                std::vector<double> &estimates);
+};
+
+#endif
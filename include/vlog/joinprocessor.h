@@ -7,8 +7,10 @@
 #include <vlog/seminaiver.h>
 #include <vlog/filterer.h>
 #include <vlog/resultjoinproc.h>
+#include <vlog/joinstrategy.h>
 
 #include <inttypes.h>
+#include <atomic>
 #include <mutex>
 
 typedef google::dense_hash_map<Term_t, std::pair<size_t, size_t>, std::hash<Term_t>, std::equal_to<Term_t>> JoinHashMap;
@@ -30,48 +32,39 @@ struct LessTwoTuples {
     }
 };
 
-//If the previous table has less than these lines, then it executes an hash join
-#define THRESHOLD_HASHJOIN 100
-
-#define FLUSH_SIZE (1 << 20)
-
+//Results of a join. If 'buffered', the rows are kept in a buffer private to
+//the thread that produces them, and are passed to the ResultJoinProcessor
+//only by flush(). The parallel joins give every thread its own Output and
+//flush them one after the other once all the threads are done, so there is
+//no lock on the ResultJoinProcessor during the join. The buffers of all the
+//threads are in memory at the same time: flushAll() records their total size
+//(see getPeakBufferedBytes)
 class Output {
     private:
+        static std::atomic<size_t> peakBufferedBytes;
 
         ResultJoinProcessor *output;
-        std::mutex *m;
+        const bool buffered;
         const uint8_t nCopyFromFirst;
         const uint8_t nCopyFromSecond;
-        const uint8_t rowsize;
         const std::pair<uint8_t, uint8_t> *posFromFirst;
         const std::pair<uint8_t, uint8_t> *posFromSecond;
         std::vector<Term_t> resultTerms;
         std::vector<int> resultBlockId;
-        std::vector<bool> resultUnique;
-        const bool mustFlush;
+        std::vector<uint8_t> resultUnique;
 
     public:
-        Output(ResultJoinProcessor *output, std::mutex *m) :
-            output(output), m(m),
-            nCopyFromFirst(output->getNCopyFromFirst()),
-            nCopyFromSecond(output->getNCopyFromSecond()),
-            rowsize(output->getRowSize()),
-            posFromFirst(output->getPosFromFirst()),
-            posFromSecond(output->getPosFromSecond()), mustFlush(true) {
-            }
-
-        Output(ResultJoinProcessor *output, std::mutex *m, bool mustFlush) :
-            output(output), m(m),
+        Output(ResultJoinProcessor *output, const bool buffered) :
+            output(output), buffered(buffered),
             nCopyFromFirst(output->getNCopyFromFirst()),
             nCopyFromSecond(output->getNCopyFromSecond()),
-            rowsize(output->getRowSize()),
             posFromFirst(output->getPosFromFirst()),
-            posFromSecond(output->getPosFromSecond()), mustFlush(mustFlush) {
+            posFromSecond(output->getPosFromSecond()) {
             }
 
         void processResults(const int blockid, const Term_t *first,
                 FCInternalTableItr* second, const bool unique) {
-            if (m == NULL) {
+            if (!buffered) {
                 output->processResults(blockid, first, second, unique);
                 return;
             }
@@ -83,16 +76,13 @@ class Output {
             }
             resultBlockId.push_back(blockid);
             resultUnique.push_back(unique);
-            if (mustFlush && resultBlockId.size() >= FLUSH_SIZE) {
-                flush();
-            }
         }
 
         void processResults(const int blockid,
-                const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+                const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const bool unique) {
-            if (m == NULL) {
+            if (!buffered) {
                 output->processResults(blockid, vectors1, i1, vectors2, i2, unique);
                 return;
             }
@@ -104,14 +94,11 @@ class Output {
             }
             resultBlockId.push_back(blockid);
             resultUnique.push_back(unique);
-            if (mustFlush && resultBlockId.size() >= FLUSH_SIZE) {
-                flush();
-            }
         }
 
         void processResults(const int blockid, FCInternalTableItr *first,
                 FCInternalTableItr* second, const bool unique) {
-            if (m == NULL) {
+            if (!buffered) {
                 output->processResults(blockid, first, second, unique);
                 return;
             }
@@ -123,21 +110,33 @@ class Output {
             }
             resultBlockId.push_back(blockid);
             resultUnique.push_back(unique);
-            if (mustFlush && resultBlockId.size() >= FLUSH_SIZE) {
-                flush();
-            }
         }
 
+        //Must not be called concurrently with other operations on the
+        //ResultJoinProcessor
         void flush() {
-            if (m == NULL) {
+            if (resultBlockId.empty()) {
                 return;
             }
-            Term_t *p = &resultTerms[0];
-            std::lock_guard<std::mutex> lock(*m);
-            output->processResults(resultBlockId, p, resultUnique, m);
-            resultUnique.clear();
-            resultBlockId.clear();
-            resultTerms.clear();
+            output->processResults(resultBlockId, resultTerms.data(),
+                    resultUnique, NULL);
+            std::vector<Term_t>().swap(resultTerms);
+            std::vector<int>().swap(resultBlockId);
+            std::vector<uint8_t>().swap(resultUnique);
+        }
+
+        size_t getBufferedBytes() const {
+            return resultTerms.capacity() * sizeof(Term_t) +
+                resultBlockId.capacity() * sizeof(int) +
+                resultUnique.capacity() * sizeof(uint8_t);
+        }
+
+        //Flush the outputs of a parallel join in their order and delete them
+        static void flushAll(std::vector<Output *> &outputs);
+
+        //Largest total size of the buffers of a parallel join so far
+        static size_t getPeakBufferedBytes() {
+            return peakBufferedBytes;
         }
 
         ~Output() {
@@ -225,12 +224,12 @@ class JoinExecutor {
                 const std::vector<uint8_t> &fields1,
                 const std::vector<uint8_t> &fields2);
 
-        static int cmp(const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+        static int cmp(const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const std::vector<uint8_t> &fields1,
                 const std::vector<uint8_t> &fields2);
 
-        static bool sameAs(const std::vector<const std::vector<Term_t> *> &vectors,
+        static bool sameAs(const std::vector<const ColumnView *> &vectors,
                 size_t i1,  size_t i2,
                 const std::vector<uint8_t> &fields1);
 
@@ -268,7 +267,8 @@ class JoinExecutor {
         static void do_mergejoin(const FCInternalTable *filteredT1, std::vector<uint8_t> &fieldsToSortInMap,
                 std::vector<std::shared_ptr<const FCInternalTable>> &tables2,
                 const std::vector<uint8_t> &fields1, const uint8_t *posOtherVars, const std::vector<Term_t> *valuesOtherVars,
-                const std::vector<uint8_t> &fields2, ResultJoinProcessor *output, int nthreads);
+                const std::vector<uint8_t> &fields2, ResultJoinProcessor *output,
+                JoinTimings &timings, int nthreads);
 
     public:
         static void do_merge_join_classicalgo(FCInternalTableItr *sortedItr1,
@@ -279,9 +279,9 @@ class JoinExecutor {
                 const Term_t *valBlocks,
                 Output *output);
 
-        static void do_merge_join_classicalgo(const std::vector<const std::vector<Term_t> *> &vectors1,
+        static void do_merge_join_classicalgo(const std::vector<const ColumnView *> &vectors1,
                 size_t l1, size_t u1,
-                const std::vector<const std::vector<Term_t> *> &vectors2,
+                const std::vector<const ColumnView *> &vectors2,
                 size_t l2, size_t u2,
                 const std::vector<uint8_t> &fields1,
                 const std::vector<uint8_t> &fields2,
@@ -305,7 +305,8 @@ class JoinExecutor {
                 const Literal &literalToQuery,
                 const uint32_t min, const uint32_t max,
                 std::vector<std::pair<uint8_t, uint8_t>> joinsCoordinates,
-                ResultJoinProcessor * output, int nthreads);
+                ResultJoinProcessor * output, JoinTimings &timings,
+                int nthreads);
 
         static void hashjoin(const FCInternalTable * t1,
                 SemiNaiver *naiver, const std::vector<Literal> *outputLiterals,
@@ -315,7 +316,14 @@ class JoinExecutor {
                 ResultJoinProcessor *output, const int lastLiteral,
                 const RuleExecutionDetails &ruleDetails,
                 const RuleExecutionPlan &hv,
-                int &processedTables, int nthreads);
+                int &processedTables, JoinTimings &timings, int nthreads);
+
+        static void partitionedHashjoin(const FCInternalTable * t1,
+                SemiNaiver *naiver, const Literal &literal,
+                const size_t min, const size_t max,
+                const std::vector<std::pair<uint8_t, uint8_t>> &joinsCoordinates,
+                ResultJoinProcessor *output, JoinTimings &timings,
+                const int nthreads);
 
         static int cmp(const Term_t *r1, const Term_t *r2, const uint8_t s);
 };
@@ -0,0 +1,99 @@
+#ifndef _JOINSTRATEGY_H
+#define _JOINSTRATEGY_H
+
+#include <map>
+#include <mutex>
+
+/*
+ * Choice between the joins of JoinExecutor::join. The hash join builds a map
+ * of the left side and queries the right side once for every key, so its
+ * cost is (build + probe) * |left|. The merge join sorts both sides (the right
+ * side only if it is not already sorted on the join fields) and merges them,
+ * so its cost is sort * (|left| log |left| + |right| log |right|) + merge *
+ * (|left| + |right|). The partitioned hash join scans both sides a few times
+ * with all the threads, so its cost is partition * (|left| + |right|) /
+ * nthreads. The constants start from the defaults below and are replaced by a
+ * moving average of the measured times, separately for every literal of
+ * every rule, so the choice follows the data from one iteration to the next.
+ */
+
+//Initial constants, in nanoseconds per unit of work
+#define JOINSTRATEGY_BUILD_NS 50
+#define JOINSTRATEGY_PROBE_NS 5000
+#define JOINSTRATEGY_SORT_NS 20
+#define JOINSTRATEGY_MERGE_NS 10
+#define JOINSTRATEGY_PARTITION_NS 100
+
+//Weight of the last measurement in the moving averages
+#define JOINSTRATEGY_ALPHA 0.3
+
+//A strategy that was never measured is tried once if it is estimated at most
+//this factor slower than the best one
+#define JOINSTRATEGY_EXPLORE_FACTOR 2
+
+//The timings of smaller joins are dominated by fixed overheads
+#define JOINSTRATEGY_MIN_ROWS 64
+
+enum JoinStrategy {
+    HASHJOIN = 0,
+    MERGEJOIN = 1,
+    PARTITIONEDJOIN = 2
+};
+#define JOINSTRATEGY_N 3
+
+//Time spent in the phases of a join, in seconds. The join fills 'build' or
+//'sort', the rest of its time is the probe or the merge
+struct JoinTimings {
+    double build;
+    double sort;
+    JoinTimings() : build(0), sort(0) {}
+};
+
+struct JoinStrategyStats {
+    //Nanoseconds per unit of work
+    double buildNs, probeNs, sortNs, mergeNs, partitionNs;
+
+    size_t count[JOINSTRATEGY_N];
+    double seconds[JOINSTRATEGY_N];
+    //How often the choice changed from one execution to the next
+    size_t nSwitches;
+    JoinStrategy last;
+
+    JoinStrategyStats();
+
+    double cost(const JoinStrategy strategy, const double left,
+            const double right, const bool rightSorted,
+            const int nthreads) const;
+
+    void update(const JoinStrategy strategy, const double left,
+            const double right, const bool rightSorted, const int nthreads,
+            const JoinTimings &timings, const double seconds);
+};
+
+class JoinStrategies {
+    private:
+        //Indexed by the rule and the position of the literal in its body
+        std::map<std::pair<size_t, size_t>, JoinStrategyStats> stats;
+        std::mutex mutex;
+
+    public:
+        //The cheapest of the strategies for which 'available' is true (at
+        //least one must be)
+        JoinStrategy choose(const size_t ruleid, const size_t literal,
+                const bool *available, const size_t left, const size_t right,
+                const bool rightSorted, const int nthreads);
+
+        //Estimated nanoseconds of the cheapest strategy
+        double estimate(const size_t ruleid, const size_t literal,
+                const double left, const double right,
+                const bool rightSorted, const int nthreads);
+
+        void record(const size_t ruleid, const size_t literal,
+                const JoinStrategy strategy, const size_t left,
+                const size_t right, const bool rightSorted, const int nthreads,
+                const JoinTimings &timings, const double seconds);
+
+        std::map<std::pair<size_t, size_t>, JoinStrategyStats> getStats();
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _LEAPFROG_H
+#define _LEAPFROG_H
+
+#include <vlog/concepts.h>
+#include <vlog/ruleexecplan.h>
+
+#include <vector>
+
+class SemiNaiver;
+class ResultJoinProcessor;
+
+/*
+ * Leapfrog triejoin (Veldhuizen, 2014). Instead of joining the body one
+ * literal at a time, the variables are bound one at a time: the values of a
+ * variable are the intersection of the columns of all the literals that
+ * contain it, computed by leaping over sorted tries. No intermediate result
+ * is materialized, and the running time is bounded by the worst-case output
+ * size. This is what makes cyclic bodies (triangles, etc.) tractable.
+ */
+
+//Below this number of literals the body cannot be cyclic
+#define LEAPFROG_MIN_LITERALS 3
+
+class LeapfrogJoin {
+    public:
+        //True if the plan can be evaluated with the leapfrog join: the body
+        //is cyclic, there are no cartesian products and no existential
+        //variables, and every literal has a variable. Whether it should is
+        //decided by the costs (see SemiNaiver::preferLeapfrog)
+        static bool isApplicable(RuleExecutionPlan &plan, const Rule &rule);
+
+        //Estimated nanoseconds of the join, with the constants of the merge
+        //join: every literal is read once, and sorted unless sorted[i]. The
+        //size of the output is not counted, since the plan with binary joins
+        //produces it too
+        static double estimateCost(const std::vector<double> &cards,
+                const std::vector<bool> &sorted);
+
+        //Order in which the variables are bound: first the ones of the first
+        //literal of the plan, then the new ones of the second, etc.
+        static std::vector<uint8_t> getVariableOrder(
+                const RuleExecutionPlan &plan);
+
+        //Positions to copy from the bindings (in the order above) to the
+        //heads, in the format of ResultJoinProcessor::posFromFirst
+        static std::vector<std::pair<uint8_t, uint8_t>> getPosFromFirst(
+                const std::vector<Literal> &heads,
+                const std::vector<uint8_t> &variables);
+
+        //Evaluate the body. ranges[i] is the range of iterations to read for
+        //the i-th literal of the plan. Every binding is passed to the output
+        //as the "first" row
+        static void join(SemiNaiver *naiver, const RuleExecutionPlan &plan,
+                const std::vector<std::pair<size_t, size_t>> &ranges,
+                const std::vector<uint8_t> &variables,
+                const std::vector<Literal> &heads,
+                ResultJoinProcessor *output, const int nthreads);
+};
+
+#endif
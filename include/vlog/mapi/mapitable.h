@@ -10,6 +10,25 @@ class MAPITable : public SQLTable {
 private:
     Mapi con;
 
+protected:
+    bool supportsTempTable() const {
+        return true;
+    }
+
+    void executeUpdate(const string &sql);
+
+    EDBIterator *executeQuery(const string &sql, const Literal &query,
+                              const uint8_t ncolumns);
+
+    void createTempTable(const string &name, const uint8_t ncolumns);
+
+    void insertTempRows(const string &name, const uint8_t ncolumns,
+                        const std::vector<Term_t> &rows);
+
+    void indexTempTable(const string &name, const uint8_t ncolumns) {
+        //MonetDB builds the hash indexes it needs by itself
+    }
+
 public:
     MAPITable(string host, int port, string user, string pwd, string dbname,
 	                           string tablename, string tablefields);
@@ -10,6 +10,7 @@
 #include <cppconn/exception.h>
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
+#include <cppconn/prepared_statement.h>
 
 #define MYSQLCALL(stat) \
     try { \
@@ -28,6 +29,19 @@ private:
     sql::Driver *driver;
     sql::Connection *con;
 
+protected:
+    bool supportsTempTable() const {
+        return true;
+    }
+
+    void executeUpdate(const string &sql);
+
+    EDBIterator *executeQuery(const string &sql, const Literal &query,
+                              const uint8_t ncolumns);
+
+    void insertTempRows(const string &name, const uint8_t ncolumns,
+                        const std::vector<Term_t> &rows);
+
 public:
     MySQLTable(string host, string user, string pwd, string dbname,
                string tablename, string tablefields);
@@ -19,11 +19,19 @@ private:
     bool skipDuplicatedFirst;
     int posFirstVar;
     SQLSMALLINT columns;
+    //The rows are fetched SQLTABLE_BATCH at a time, column by column
     SQLLEN *indicator;
     SQLUBIGINT *values;
+    SQLULEN nfetched;
+    SQLULEN currentRow;
 
     SQLHANDLE stmt;
 
+    void execute(SQLHANDLE con, const string &sqlQuery);
+
+    //Move to the next row, false if there is none
+    bool fetch();
+
 public:
     ODBCIterator(SQLHANDLE con,
                   string tableName,
@@ -13,6 +13,19 @@ private:
     SQLHANDLE env;
     SQLHANDLE con;
 
+protected:
+    bool supportsTempTable() const {
+        return true;
+    }
+
+    void executeUpdate(const string &sql);
+
+    EDBIterator *executeQuery(const string &sql, const Literal &query,
+                              const uint8_t ncolumns);
+
+    void insertTempRows(const string &name, const uint8_t ncolumns,
+                        const std::vector<Term_t> &rows);
+
 public:
     ODBCTable(string user, string pwd, string dbname,
                string tablename, string tablefields);
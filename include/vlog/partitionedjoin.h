@@ -0,0 +1,64 @@
+#ifndef _PARTITIONEDJOIN_H
+#define _PARTITIONEDJOIN_H
+
+#include <vlog/concepts.h>
+
+#include <vector>
+
+class ResultJoinProcessor;
+class ColumnView;
+
+/*
+ * Radix-partitioned hash join. Both sides are split by the top bits of the
+ * hash of their join key, with every thread partitioning a chunk of the rows
+ * (histogram, prefix sums, scatter). Matching rows end up in the same
+ * partition, so the partitions are joined independently and in parallel:
+ * a chained hash table is built on the left rows of the partition and probed
+ * with the right rows. The partitions are small enough to stay in the cache.
+ * Every partition writes its results in its own buffered Output.
+ */
+
+//Below this number of rows on the left side the other joins are faster
+#define PARTITIONEDJOIN_MIN_ROWS 100000
+
+//Partitions per thread, to balance the load when the keys are skewed
+#define PARTITIONEDJOIN_PARTITIONS_PER_THREAD 8
+#define PARTITIONEDJOIN_MAX_BITS 12
+
+//Rows sorted by the partition of their hash
+struct HashPartitions {
+    std::vector<uint64_t> hashes;
+    std::vector<size_t> rows;
+    //Partition p is [start[p], start[p + 1])
+    std::vector<size_t> start;
+};
+
+class PartitionedHashJoin {
+    private:
+        const std::vector<const ColumnView *> &left;
+        const std::vector<uint8_t> fields1;
+        const int nthreads;
+        uint8_t bits;
+        HashPartitions leftPartitions;
+
+        void partition(const std::vector<const ColumnView *> &vectors,
+                const std::vector<uint8_t> &fields,
+                HashPartitions &out) const;
+
+    public:
+        //Partition the left side (the columns in 'left'), which is joined on
+        //the columns 'fields1'
+        PartitionedHashJoin(
+                const std::vector<const ColumnView *> &left,
+                const std::vector<uint8_t> &fields1,
+                const int nthreads);
+
+        //Join the left side with the columns of 'right' on 'fields2'. The
+        //results are copied in the output with its posFromFirst (from the
+        //left side) and posFromSecond (from the right side)
+        void join(const std::vector<const ColumnView *> &right,
+                const std::vector<uint8_t> &fields2,
+                ResultJoinProcessor *output) const;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _RADIXSORT_H
+#define _RADIXSORT_H
+
+#include <vlog/concepts.h>
+
+#include <vector>
+
+class ColumnView;
+
+/*
+ * LSD radix sort of the rows of up to three columns. Every row is packed in a
+ * single key (64 or 128 bits) using only the bits needed to represent the
+ * range [min, max] of each column, so that the keys compare like the rows.
+ * The keys are sorted one byte at a time (bytes that are equal in all keys are
+ * skipped) and unpacked in the output columns.
+ */
+
+//Below this size std::sort on the rows is faster
+#define RADIXSORT_MIN_ROWS 4096
+#define RADIXSORT_MAX_COLUMNS 3
+
+class RadixSort {
+    public:
+        //Sort the rows of 'columns' (all of the same size) lexicographically
+        //and write them in 'out'. If 'filterDupl' is set, repeated rows are
+        //written once. Returns false (and leaves 'out' untouched) if the rows
+        //cannot be packed in 128 bits
+        static bool sort(const std::vector<const ColumnView *> &columns,
+                std::vector<std::vector<Term_t>> &out,
+                const bool filterDupl, const int nthreads);
+};
+
+#endif
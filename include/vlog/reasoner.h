@@ -21,6 +21,9 @@ private:
 
     const uint64_t threshold;
 
+    //Directory of a snapshot written by SemiNaiver::storeOnMmapFiles
+    std::string matSnapshot;
+
     void cleanBindings(std::vector<Term_t> &bindings, std::vector<uint8_t> * posJoins,
                        TupleTable *input);
 
@@ -46,6 +49,12 @@ public:
 
     Reasoner(const uint64_t threshold) : threshold(threshold) {}
 
+    //Answer materialization queries from a snapshot instead of running
+    //the materialization
+    void setMaterializationSnapshot(std::string path) {
+        matSnapshot = path;
+    }
+
     size_t estimate(Literal &query, std::vector<uint8_t> *posBindings,
                     std::vector<Term_t> *valueBindings, EDBLayer &layer,
                     Program &program);
@@ -108,11 +108,11 @@ class ResultJoinProcessor {
                 FCInternalTableItr* second, const bool unique) = 0;
 
         virtual void processResults(const int blockid,
-                const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+                const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const bool unique) = 0;
 
-        virtual void processResults(std::vector<int> &blockid, Term_t *p, std::vector<bool> &unique, std::mutex *m) = 0;
+        virtual void processResults(std::vector<int> &blockid, Term_t *p, std::vector<uint8_t> &unique, std::mutex *m) = 0;
 
         virtual void processResults(const int blockid, FCInternalTableItr *first,
                 FCInternalTableItr* second, const bool unique) = 0;
@@ -231,7 +231,7 @@ class InterTableJoinProcessor: public ResultJoinProcessor {
                 std::vector<std::pair<uint8_t, uint8_t>> &posFromSecond,
                 const int nthreads);
 
-        void processResults(std::vector<int> &blockid, Term_t *p, std::vector<bool> &unique, std::mutex *m);
+        void processResults(std::vector<int> &blockid, Term_t *p, std::vector<uint8_t> &unique, std::mutex *m);
 
         void processResults(const int blockid, const Term_t *first,
                 FCInternalTableItr* second, const bool unique);
@@ -240,8 +240,8 @@ class InterTableJoinProcessor: public ResultJoinProcessor {
                 FCInternalTableItr* second, const bool unique);
 
         void processResults(const int blockid,
-                const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-                const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+                const std::vector<const ColumnView *> &vectors1, size_t i1,
+                const std::vector<const ColumnView *> &vectors2, size_t i2,
                 const bool unique);
 
         void processResultsAtPos(const int blockid, const uint8_t pos,
@@ -0,0 +1,104 @@
+#ifndef _ROWINDEX_H
+#define _ROWINDEX_H
+
+#include <vlog/concepts.h>
+
+#include <inttypes.h>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+class Column;
+class FCInternalTable;
+class Segment;
+
+//An entry of the index is the source of the row (high bits) and its position
+//in the source
+#define ROWINDEX_ROW_BITS 40
+#define ROWINDEX_MAX_SOURCES (1u << (64 - ROWINDEX_ROW_BITS))
+
+/*
+ * Set of the rows of some tables of the same arity. The rows are not copied:
+ * an open-addressing table with linear probing stores a 64-bit fingerprint of
+ * every row and its position in the table it comes from. Two rows with the
+ * same fingerprint are told apart by reading the columns of the tables, so
+ * only tables with direct access can be indexed (see canIndex). Lookups cost
+ * O(1) regardless of the number of rows, while the sort-merge in
+ * SegmentInserter::retain has to scan all the existing rows.
+ *
+ * The index keeps a reference to the columns of the tables. Whoever replaces
+ * or drops one of them must call remove or replace.
+ */
+class RowIndex {
+    private:
+        struct Source {
+            std::shared_ptr<const FCInternalTable> table;
+            std::vector<std::shared_ptr<Column>> columns;
+        };
+
+        const uint8_t sizeRow;
+        std::vector<uint64_t> fingerprints; //0 is an empty slot
+        std::vector<uint64_t> entries;
+        size_t nrows;
+
+        std::vector<Source> sources;
+        std::vector<uint32_t> freeSources;
+        std::unordered_map<const FCInternalTable*, uint32_t> sourceIds;
+
+        uint64_t fingerprint(const Term_t *row) const;
+
+        bool equals(const uint64_t entry, const Term_t *row) const;
+
+        //Slot of the row, or of the empty slot where it should go
+        size_t find(const Term_t *row, const uint64_t fp) const;
+
+        void grow();
+
+        //Empty the slot, moving back the next entries of its cluster
+        void erase(size_t slot);
+
+        uint32_t addSource(std::shared_ptr<const FCInternalTable> table,
+                std::vector<std::shared_ptr<Column>> &columns);
+
+        //Add the row 'pos' of the source, whose values are 'row'. Returns
+        //false if the row was already there
+        bool insert(const uint32_t source, const size_t pos,
+                const Term_t *row);
+
+    public:
+        RowIndex(const uint8_t sizeRow);
+
+        static bool canIndex(std::shared_ptr<const FCInternalTable> table);
+
+        size_t getNRows() const {
+            return nrows;
+        }
+
+        //Bytes of the fingerprints and of the entries
+        size_t getMemoryBytes() const;
+
+        bool contains(const Term_t *row) const;
+
+        bool contains(std::shared_ptr<const FCInternalTable> table) const {
+            return sourceIds.count(table.get()) > 0;
+        }
+
+        //Add the rows of 'table', which must satisfy canIndex
+        void insert(std::shared_ptr<const FCInternalTable> table);
+
+        //Remove the rows of a table added with insert
+        void remove(std::shared_ptr<const FCInternalTable> table);
+
+        //'newTable' has the same rows of 'oldTable' in the same order (e.g.,
+        //it was moved to disk)
+        void replace(std::shared_ptr<const FCInternalTable> oldTable,
+                std::shared_ptr<const FCInternalTable> newTable);
+
+        //Rows of 'segment' that are not in the index, in the same order. If
+        //'duplicates' is set, a row repeated in the segment is returned once
+        std::shared_ptr<const Segment> retain(
+                std::shared_ptr<const Segment> segment,
+                const bool duplicates) const;
+};
+
+#endif
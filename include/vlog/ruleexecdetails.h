@@ -26,6 +26,13 @@ struct RuleExecutionDetails {
 
     void createExecutionPlans();
 
+    //Plans for an incremental run: besides the usual plans on the new IDB
+    //tuples, there is one plan for every body atom over a predicate in
+    //'deltaEDBs' that reads only the new tuples of that atom
+    void createExecutionPlans(const std::vector<PredId_t> &deltaEDBs);
+
+    bool readsPredicate(const std::vector<PredId_t> &preds) const;
+
     void calculateNVarsInHeadFromEDB();
 
     //static void checkWhetherEDBsRedundantHead(RuleExecutionPlan &plan,
@@ -57,6 +57,11 @@ struct RuleExecutionPlan {
             const std::vector<Literal> &heads) const;
 
     bool hasCartesian();
+
+    //True if the hypergraph of the body (one edge per literal, on its
+    //variables) is not alpha-acyclic, e.g. a triangle. Such bodies are
+    //better evaluated with LeapfrogJoin
+    bool isCyclic() const;
 };
 
 #endif
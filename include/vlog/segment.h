@@ -13,29 +13,23 @@
 
 struct GetVectors {
     const std::vector<std::shared_ptr<Column>> &cols;
-    std::vector<const std::vector<Term_t> *> &vectors;
+    std::vector<const ColumnView *> &vectors;
 
-    GetVectors(const std::vector<std::shared_ptr<Column>> &cols, std::vector<const std::vector<Term_t> *> &vectors) : cols(cols), vectors(vectors) {
+    GetVectors(const std::vector<std::shared_ptr<Column>> &cols, std::vector<const ColumnView *> &vectors) : cols(cols), vectors(vectors) {
     }
 
     void operator()(const ParallelRange& r) const {
         for (int i = r.begin(); i != r.end(); ++i) {
-            if (! cols[i]->isBackedByVector()) {
-                std::vector<Term_t> *v = new std::vector<Term_t>();
-                *v = cols[i]->getReader()->asVector();
-                vectors[i] = v;
-            } else {
-                vectors[i] = &cols[i]->getVectorRef();
-            }
+            vectors[i] = cols[i]->getView();
         }
     }
 };
 
 struct SegmentSorter {
-    const std::vector<const std::vector<Term_t> *> &vectors;
+    const std::vector<const ColumnView *> &vectors;
     size_t maxSize;
 
-    SegmentSorter(const std::vector<const std::vector<Term_t> *> &vectors)
+    SegmentSorter(const std::vector<const ColumnView *> &vectors)
         : vectors(vectors) {
             maxSize = vectors[0]->size();
         }
@@ -83,6 +77,25 @@ class SegmentIterator {
             }
         }
 
+        //Copy the next (at most) maxRows rows in out, one array per column.
+        //The iterator is left on the last copied row, as if next() was
+        //called for every row. Returns the number of rows, 0 at the end
+        virtual size_t nextBatch(Term_t **out, const size_t maxRows) {
+            if (readers.empty()) {
+                return 0;
+            }
+            size_t n = maxRows;
+            for (size_t i = 0; i < readers.size(); ++i) {
+                n = std::min(n, readers[i]->nextBatch(out[i], maxRows));
+            }
+            if (n > 0) {
+                for (size_t i = 0; i < readers.size(); ++i) {
+                    values[i] = out[i][n - 1];
+                }
+            }
+            return n;
+        }
+
         virtual void clear() {
             for (const auto  &reader : readers) {
                 reader->clear();
@@ -99,14 +112,14 @@ class SegmentIterator {
 
 class VectorSegmentIterator : public SegmentIterator {
     private:
-        const std::vector<const std::vector<Term_t> *> vectors;
+        const std::vector<const ColumnView *> vectors;
         int currentIndex;
         bool first;
         int endIndex;
         int ncols;
         std::vector<bool> *allocatedVectors;
     public:
-        VectorSegmentIterator(const std::vector<const std::vector<Term_t> *> &vectors, int firstIndex, int endIndex, std::vector<bool> *allocatedVectors)
+        VectorSegmentIterator(const std::vector<const ColumnView *> &vectors, int firstIndex, int endIndex, std::vector<bool> *allocatedVectors)
             : vectors(vectors), currentIndex(firstIndex), first(true), endIndex(endIndex), ncols(vectors.size()), allocatedVectors(allocatedVectors) {
                 if (endIndex > vectors[0]->size()) {
                     this->endIndex = vectors[0]->size();
@@ -127,6 +140,21 @@ class VectorSegmentIterator : public SegmentIterator {
             }
         }
 
+        size_t nextBatch(Term_t **out, const size_t maxRows) {
+            const int begin = first ? currentIndex : currentIndex + 1;
+            if (begin >= endIndex) {
+                return 0;
+            }
+            const size_t n = std::min(maxRows, (size_t) (endIndex - begin));
+            for (int i = 0; i < ncols; i++) {
+                vectors[i]->copy(begin, n, out[i]);
+                values[i] = out[i][n - 1];
+            }
+            currentIndex = begin + n - 1;
+            first = false;
+            return n;
+        }
+
         void clear() {
             if (allocatedVectors != NULL) {
                 for (int i = 0; i < allocatedVectors->size(); i++) {
@@ -280,22 +308,16 @@ class Segment {
             return nfields > 0;
         }
 
-        static std::vector<const std::vector<Term_t> *> getAllVectors(const std::vector<std::shared_ptr<Column>> &cols) {
-            std::vector<const std::vector<Term_t> *> vectors(cols.size());
+        static std::vector<const ColumnView *> getAllVectors(const std::vector<std::shared_ptr<Column>> &cols) {
+            std::vector<const ColumnView *> vectors(cols.size());
             for (int i = 0; i < cols.size(); i++) {
-                if (cols[i]->isBackedByVector()) {
-                    vectors[i] = &cols[i]->getVectorRef();
-                } else {
-                    std::vector<Term_t> *v = new std::vector<Term_t>();
-                    *v = cols[i]->getReader()->asVector();
-                    vectors[i] = v;
-                }
+                vectors[i] = cols[i]->getView();
             }
             return vectors;
         }
 
-        static std::vector<const std::vector<Term_t> *> getAllVectors(const std::vector<std::shared_ptr<Column>> &cols, int nthreads) {
-            std::vector<const std::vector<Term_t> *> vectors(cols.size());
+        static std::vector<const ColumnView *> getAllVectors(const std::vector<std::shared_ptr<Column>> &cols, int nthreads) {
+            std::vector<const ColumnView *> vectors(cols.size());
             int count = cols.size();
             for (int i = 0; i < cols.size(); i++) {
                 if (cols[i]->isBackedByVector()) {
@@ -310,20 +332,14 @@ class Segment {
                         GetVectors(cols, vectors));
             } else {
                 for (int i = 0; i < cols.size(); i++) {
-                    if (! cols[i]->isBackedByVector()) {
-                        std::vector<Term_t> *v = new std::vector<Term_t>();
-                        *v = cols[i]->getReader()->asVector();
-                        vectors[i] = v;
-                    } else {
-                        vectors[i] = &cols[i]->getVectorRef();
-                    }
+                    vectors[i] = cols[i]->getView();
                 }
             }
 
             return vectors;
         }
 
-        std::vector<const std::vector<Term_t> *> getAllVectors() const {
+        std::vector<const ColumnView *> getAllVectors() const {
             std::vector<std::shared_ptr<Column>> cols;
             for (int i = 0; i < nfields; i++) {
                 cols.push_back(columns[i]);
@@ -331,7 +347,7 @@ class Segment {
             return getAllVectors(cols);
         }
 
-        std::vector<const std::vector<Term_t> *> getAllVectors(int nthreads) const {
+        std::vector<const ColumnView *> getAllVectors(int nthreads) const {
             std::vector<std::shared_ptr<Column>> cols;
             for (int i = 0; i < nfields; i++) {
                 cols.push_back(columns[i]);
@@ -339,15 +355,13 @@ class Segment {
             return Segment::getAllVectors(cols, nthreads);
         }
 
-        static void deleteAllVectors(const std::vector<std::shared_ptr<Column>> &cols, std::vector<const std::vector<Term_t> *> vectors) {
+        static void deleteAllVectors(const std::vector<std::shared_ptr<Column>> &cols, std::vector<const ColumnView *> vectors) {
             for (int i = 0; i < cols.size(); i++) {
-                if (! cols[i]->isBackedByVector()) {
-                    delete vectors[i];
-                }
+                cols[i]->releaseView(vectors[i]);
             }
         }
 
-        void deleteAllVectors(std::vector<const std::vector<Term_t> *> vectors) const {
+        void deleteAllVectors(std::vector<const ColumnView *> vectors) const {
             std::vector<std::shared_ptr<Column>> cols;
             for (int i = 0; i < nfields; i++) {
                 cols.push_back(columns[i]);
@@ -437,6 +451,9 @@ class SegmentInserter {
 
         void addRow(FCInternalTableItr *itr, const uint8_t *posToCopy);
 
+        //Add n rows, given as one array per column (see nextBatch)
+        void addRows(Term_t **rows, const size_t n);
+
         void addAt(const uint8_t p, const Term_t v);
 
         void addColumns(std::vector<std::shared_ptr<Column>> &columns,
@@ -44,11 +44,11 @@ struct CreateColumns2 {
 
 struct CreateColumns {
     const std::vector<size_t> &idxs;
-    const std::vector<const std::vector<Term_t> *> &vectors;
+    const std::vector<const ColumnView *> &vectors;
     std::vector<std::vector<Term_t>> &out;
 
     CreateColumns(const std::vector<size_t> &idxs,
-            const std::vector<const std::vector<Term_t> *> &vectors,
+            const std::vector<const ColumnView *> &vectors,
             std::vector<std::vector<Term_t>> &out) : idxs(idxs), vectors(vectors), out(out) {
     }
 
@@ -7,12 +7,20 @@
 #include <vlog/ruleexecplan.h>
 #include <vlog/ruleexecdetails.h>
 #include <vlog/chasemgmt.h>
+#include <vlog/joinstrategy.h>
 
 #include <trident/model/table.h>
 
 #include <vector>
+#include <map>
+#include <mutex>
+#include <unordered_set>
 #include <unordered_map>
 
+//Blocks of the last SEMINAIVER_SPILL_WINDOW iterations are never spilled,
+//since the next rules will read them as deltas
+#define SEMINAIVER_SPILL_WINDOW 4
+
 struct StatIteration {
     size_t iteration;
     const Rule *rule;
@@ -39,6 +47,14 @@ struct StatsSizeIDB {
     long derivation;
 };
 
+//Join order chosen for a plan, with the cardinalities of the literals it was
+//computed with
+struct JoinOrderCache {
+    std::vector<size_t> cards;
+    std::vector<uint8_t> order;
+    std::vector<double> estimates;
+};
+
 typedef std::unordered_map<std::string, FCTable*> EDBCache;
 class ResultJoinProcessor;
 class SemiNaiver {
@@ -48,8 +64,37 @@ class SemiNaiver {
         bool opt_filtering;
         bool multithreaded;
         bool restrictedChase;
+        bool sccEvaluation;
         std::shared_ptr<ChaseMgmt> chaseMgmt;
 
+        //EDB predicates that received new facts since the last run
+        std::vector<PredId_t> deltaEDBs;
+
+        //EDB predicates that lost facts since the last run, and the rules
+        //that must be evaluated again from scratch by runDRed()
+        std::vector<PredId_t> removedEDBs;
+        std::unordered_set<size_t> dredRules;
+
+        //False when not all the rules are in the ruleset given to
+        //saturateRules (the split execution of the restricted chase)
+        bool compactBlocks;
+
+        //Budget of the IDB columns and of the cached vectors, in bytes (0 is
+        //unlimited). Above it, blocks are moved to files in spillDir
+        size_t maxMemory;
+        std::string spillDir;
+        size_t nSpilledBlocks;
+
+        //Join orders chosen by optimizeJoinOrder for every (rule, plan), and
+        //the distinct values of the columns of the EDB literals
+        std::map<std::pair<size_t, int>, JoinOrderCache> joinOrders;
+        std::unordered_map<std::string, size_t> edbDistinct;
+        std::mutex joinOrdersMutex;
+
+        //Timings of the hash and merge joins of every literal, used to
+        //choose between them
+        JoinStrategies joinStrategies;
+
         std::chrono::system_clock::time_point startTime;
         bool running;
 
@@ -96,6 +141,30 @@ class SemiNaiver {
                 const std::vector<size_t> &cards,
                 const std::vector<Literal> &headLiteral);
 
+        //Cost-based alternative to reorderPlan for bodies with at least
+        //JOINORDER_MIN_LITERALS literals (see JoinOrder). The order of a plan
+        //is computed again only if the cardinality of a literal changed by
+        //JOINORDER_REPLAN_FACTOR. Returns false if no order was chosen
+        bool optimizeJoinOrder(const RuleExecutionDetails &ruleDetails,
+                const int orderExecution, RuleExecutionPlan &plan,
+                const std::vector<size_t> &cards,
+                const std::vector<Literal> &heads,
+                std::vector<double> &estimates);
+
+        size_t estimateDistinct(const Literal &literal, const size_t min,
+                const size_t max, const uint8_t pos);
+
+        //Forget the join orders and the distinct values of the EDB literals,
+        //after the EDB facts change
+        void clearJoinOrders();
+
+        //True if the leapfrog join of the plan is estimated to be cheaper
+        //than joining its literals one at a time in the order of 'estimates'
+        //(see JoinStrategies::estimate and LeapfrogJoin::estimateCost)
+        bool preferLeapfrog(const RuleExecutionDetails &ruleDetails,
+                const RuleExecutionPlan &plan,
+                const std::vector<double> &estimates);
+
         bool executeRules(std::vector<RuleExecutionDetails> &allEDBRules,
                 std::vector<RuleExecutionDetails> &allIDBRules,
                 std::vector<StatIteration> &costRules,
@@ -110,6 +179,30 @@ class SemiNaiver {
                 const size_t minIteration,
                 const size_t maxIteration);
 
+        //Split the rules in strongly connected components of the
+        //dependency graph, in topological order
+        static void computeSCCs(const std::vector<std::vector<int>> &dependents,
+                std::vector<std::vector<int>> &components);
+
+        //Start or install the compaction of the blocks of the IDB tables
+        //(see FCTable::compact) that all the rules in 'ruleset' have seen
+        void compactTables(const std::vector<RuleExecutionDetails> &ruleset);
+
+        //If the memory used is above maxMemory, move blocks to disk (see
+        //FCTable::spill) until it is below, starting from the tables that
+        //were read least recently and from the oldest blocks
+        void spillTables();
+
+        bool saturateRules(std::vector<RuleExecutionDetails> &ruleset,
+                const std::vector<int> &positions,
+                std::vector<StatIteration> &costRules,
+                bool fixpoint);
+
+        bool executeSCCsUntilSaturation(
+                std::vector<RuleExecutionDetails> &ruleset,
+                std::vector<StatIteration> &costRules,
+                bool fixpoint);
+
     protected:
         FCTable *predicatesTables[MAX_NPREDS];
         EDBLayer &layer;
@@ -124,6 +217,12 @@ class SemiNaiver {
 
         virtual FCIterator getTableFromEDBLayer(const Literal & literal);
 
+        //For every rule in the ruleset, the positions of the rules that
+        //read one of the predicates it derives
+        void computeDependentRules(
+                const std::vector<RuleExecutionDetails> &ruleset,
+                std::vector<std::vector<int>> &dependents);
+
         virtual long getNLastDerivationsFromList();
 
         virtual void saveDerivationIntoDerivationList(FCTable *endTable);
@@ -162,13 +261,55 @@ class SemiNaiver {
             return opt_intersect;
         }
 
+        //Saturate the strongly connected components of the rule dependency
+        //graph one after the other, instead of looping over all the rules
+        void setSCCEvaluation(bool scc) {
+            sccEvaluation = scc;
+        }
+
+        //Keep the memory of the IDB tables below 'maxMemory' bytes, moving
+        //old blocks to files in 'dir'. Not used by the inter-rule threads
+        void setMemoryBudget(const size_t maxMemory, const std::string &dir) {
+            this->maxMemory = maxMemory;
+            spillDir = dir;
+        }
+
         virtual FCTable *getTable(const PredId_t pred, const uint8_t card);
 
         void run(size_t lastIteration, size_t iteration);
 
+        //Add new facts to an EDB predicate. They are kept in a new block of
+        //the table of the predicate (the EDB layer is not changed) and are
+        //propagated by the next call to runIncremental()
+        void addEDBFacts(const Predicate pred,
+                std::shared_ptr<const Segment> facts);
+
+        //Continue the materialization from the current tables, evaluating
+        //only the consequences of the facts added with addEDBFacts
+        void runIncremental();
+
+        //Remove facts from an EDB predicate. The facts are removed from the
+        //table of the predicate (the EDB layer is not changed) and the
+        //derivations are updated by the next call to runDRed()
+        void removeEDBFacts(const Predicate pred,
+                std::shared_ptr<const Segment> facts);
+
+        //Update the materialization after removeEDBFacts (DRed): delete
+        //everything that might depend on the removed facts and re-derive
+        //what is still derivable. Facts added with addEDBFacts in the
+        //meantime are propagated as well
+        void runDRed();
+
         void storeOnFiles(std::string path, const bool decompress,
                 const int minLevel, const bool csv);
 
+        //Write the IDB tables as a binary snapshot (see fcstore.h)
+        void storeOnMmapFiles(std::string path);
+
+        //Reopen the IDB tables of a snapshot written by storeOnMmapFiles
+        //instead of computing them. Returns the last iteration found
+        size_t loadFromMmapFiles(std::string path);
+
         FCIterator getTable(const Literal &literal, const size_t minIteration,
                 const size_t maxIteration) {
             return getTable(literal, minIteration, maxIteration, NULL);
@@ -211,6 +352,15 @@ class SemiNaiver {
 
         void printCountAllIDBs(string prefix);
 
+        //Number and duration of the hash and merge joins
+        void printJoinStatistics();
+
+        void printMemoryIDBs();
+
+        JoinStrategies &getJoinStrategies() {
+            return joinStrategies;
+        }
+
         size_t getCurrentIteration();
 
 #ifdef WEBINTERFACE
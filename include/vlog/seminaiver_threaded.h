@@ -5,6 +5,9 @@
 
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 
 struct SemiNaiver_Threadlocal {
     std::vector<FCBlock> listDerivations;
@@ -16,18 +19,76 @@ class StatusRuleExecution_ThreadSafe {
     private:
         //Internal data structures
 
-        //Hold all rules to execution
-        std::mutex mutexRules;
-        int rulecount;
+        //Every thread owns a deque of rules. A thread pops rules from the
+        //back of its own deque, and steals from the front of the others
+        //when its own deque is empty.
+        struct RuleQueue {
+            std::mutex mutex;
+            std::deque<int> rules;
+        };
+        const int nqueues;
+        std::unique_ptr<RuleQueue[]> queues;
+
+        //Rules that are in some deque and not yet started
         const int nrules;
+        std::unique_ptr<std::atomic<bool>[]> queued;
 
+        //Number of rules that are either queued or being executed. When it
+        //reaches zero, there is no more work to do.
+        std::atomic<int> pending;
+
+        //Number of rules in the deques. The threads that find no rule sleep
+        //on 'wakeup' until it becomes positive or 'pending' reaches zero.
+        std::atomic<int> available;
+        std::mutex mutexWait;
+        std::condition_variable wakeup;
+
+        //Rules that could not take the locks on their predicates. They are
+        //put back in a deque when some thread releases its locks.
+        std::vector<int> parked;
+        std::atomic<uint64_t> releases;
+
+        void push(const int ruleid, const int queue, const bool front);
+
+        void notify(const bool all);
+
+        std::mutex mutexDerivations;
         std::vector<ResultJoinProcessor*> tmpderivations;
 
+        bool pop(const int queue, int &ruleid);
+
+        bool steal(const int queue, int &ruleid);
+
     public:
 
-        StatusRuleExecution_ThreadSafe(const int nrules);
+        StatusRuleExecution_ThreadSafe(const int nrules, const int nqueues);
+
+        //Add the rule to the deque of the thread. Returns false if the rule
+        //was already waiting to be executed.
+        bool schedule(const int ruleid, const int queue);
 
-        int getRuleIDToExecute();
+        //Number of times the threads released their locks so far
+        uint64_t getReleases() const {
+            return releases.load();
+        }
+
+        //Set aside a rule that could not take the locks on its predicates.
+        //'releasesSeen' is the value of getReleases() before trying the
+        //locks: if some locks were released since then, the rule goes back
+        //to the deque straight away.
+        void park(const int ruleid, const int queue,
+                const uint64_t releasesSeen);
+
+        //Called after a thread released the locks of its rule. Puts the
+        //parked rules back in its deque.
+        void released(const int queue);
+
+        //Return -1 if there are no more rules to execute.
+        int getRuleIDToExecute(const int queue);
+
+        void startRule(const int ruleid);
+
+        void finishRule(const int ruleid);
 
         void registerDerivations(ResultJoinProcessor *res);
 
@@ -40,11 +101,6 @@ class SemiNaiverThreaded: public SemiNaiver {
 
     private:
         //const int nthreads;
-        //TODO This variable is only visible to the thread
-        std::shared_ptr<SemiNaiver_Threadlocal> thread_data;
-
-        bool marked[MAX_NPREDS];
-        bool newMarked[MAX_NPREDS];
 
         /*** VARIOUS MUTEXES */
         std::mutex mutexInsert;
@@ -82,12 +138,6 @@ class SemiNaiverThreaded: public SemiNaiver {
                     program, opt_intersect, opt_filtering, true,
                     nthreads, shuffleRules),
                 interRuleThreads(interRuleThreads) {
-
-                    // Marks for parallel version
-                    for (int i = 0; i < MAX_NPREDS; i++) {
-                        marked[i] = true;
-                        newMarked[i] = false;
-                    }
                 }
 
     protected:
@@ -102,10 +152,13 @@ class SemiNaiverThreaded: public SemiNaiver {
         FCIterator getTableFromEDBLayer(const Literal & literal);
 
         void runThread(
+                const int threadId,
                 std::vector<RuleExecutionDetails> &ruleset,
+                const std::vector<std::vector<int>> &dependents,
                 StatusRuleExecution_ThreadSafe *status,
                 std::vector<StatIteration> *costRules,
-                size_t lastExec);
+                const bool fixpoint,
+                bool *newDer);
 
         bool executeUntilSaturation(
                 std::vector<RuleExecutionDetails> &ruleset,
@@ -0,0 +1,44 @@
+#ifndef _SORTEDINTS_H
+#define _SORTEDINTS_H
+
+#include <vlog/concepts.h>
+
+#include <inttypes.h>
+#include <cstddef>
+
+class ColumnWriter;
+
+/*
+ * Kernels on sorted arrays of terms. Two sequences are scanned with a
+ * lower-bound search that either moves linearly (in blocks of 2 or 4 terms
+ * with SSE4.2/AVX2, if the CPU supports them) or gallops, when one of the two
+ * arrays is much larger than the other.
+ */
+
+//If an array is this many times larger than the other one, we gallop on it
+#define SORTEDINTS_GALLOP_RATIO 32
+
+class SortedInts {
+    public:
+        //Name of the linear kernel selected at runtime ("avx2", "sse4.2" or
+        //"scalar")
+        static const char *getKernelName();
+
+        //First position >= pos with v[position] >= x (n if there is none)
+        static size_t lowerBound(const Term_t *v, size_t pos, const size_t n,
+                const Term_t x);
+
+        static size_t gallop(const Term_t *v, size_t pos, const size_t n,
+                const Term_t x);
+
+        //Same semantics of a merge: a value that occurs k times in one array
+        //and m times in the other is added min(k,m) times
+        static void intersection(const Term_t *v1, const size_t n1,
+                const Term_t *v2, const size_t n2, ColumnWriter &writer);
+
+        //Number of values in v2 that also occur in v1
+        static uint64_t countMatches(const Term_t *v1, const size_t n1,
+                const Term_t *v2, const size_t n2);
+};
+
+#endif
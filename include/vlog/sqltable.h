@@ -4,11 +4,95 @@
 #include <vlog/column.h>
 #include <vlog/edbiterator.h>
 
+//Rows sent to the server with one statement, and rows fetched from it in one
+//round trip
+#define SQLTABLE_BATCH 4096
+
+//Prefix of the temporary tables that hold the values of a semi-join, with the
+//columns vlog_x0, vlog_x1, ... Every table gets a number of its own
+#define SQLTABLE_TMPTABLE "vlog_semijoin"
+
 class SQLTable : public EDBTable {
+protected:
+    //The backends that implement the methods below compute the semi-joins on
+    //the server, the others read the table with a sorted iterator
+    virtual bool supportsTempTable() const {
+        return false;
+    }
+
+    //Execute a statement that does not return rows
+    virtual void executeUpdate(const string &sql);
+
+    //Iterator over the rows returned by 'sql', which has 'ncolumns' columns
+    virtual EDBIterator *executeQuery(const string &sql, const Literal &query,
+                                      const uint8_t ncolumns);
+
+    //Create the temporary table 'name', with 'ncolumns' columns
+    virtual void createTempTable(const string &name, const uint8_t ncolumns);
+
+    //Add 'rows' (ncolumns values each, one row after the other) to the
+    //temporary table, SQLTABLE_BATCH rows at a time in one transaction
+    virtual void insertTempRows(const string &name, const uint8_t ncolumns,
+                                const std::vector<Term_t> &rows);
+
+    //Index the temporary table once it is filled, so that it can be probed
+    //by the rows of the table
+    virtual void indexTempTable(const string &name, const uint8_t ncolumns);
+
+    //Temporary table created, filled and indexed with 'rows'. It is dropped
+    //when it goes out of scope, also if the query that reads it throws
+    class TempTable {
+    private:
+        SQLTable *table;
+        string name;
+
+    public:
+        TempTable(SQLTable *table, const uint8_t ncolumns,
+                  const std::vector<Term_t> &rows);
+
+        const string &getName() const {
+            return name;
+        }
+
+        ~TempTable();
+    };
+
+    static string tempColumn(const uint8_t i) {
+        return "vlog_x" + to_string(i);
+    }
+
+    //Definition of the columns of the temporary table
+    static string tempTableColumns(const uint8_t ncolumns);
+
+    //Condition that matches the fields 'posToFilter' of the table with the
+    //rows of the temporary table 'name'
+    string tempTableToSQLQuery(const string &name,
+                               const std::vector<uint8_t> &posToFilter);
+
+    //Constants and repeated variables of 'query'
+    static string conditionsToSQLQuery(const Literal &query,
+                                       const std::vector<string> &fieldTables);
+
 public:
     string tablename;
     std::vector<string> fieldTables;
 
+    using EDBTable::checkNewIn;
+
+    //The values to check are sent to the server in a temporary table, which
+    //computes the semi-join and returns the result sorted
+    std::vector<std::shared_ptr<Column>> checkNewIn(
+                std::vector <
+                std::shared_ptr<Column >> &checkValues,
+                const Literal &l2,
+                std::vector<uint8_t> &posInL2);
+
+    std::shared_ptr<Column> checkIn(
+        std::vector<Term_t> &values,
+        const Literal &l2,
+        uint8_t posInL2,
+        size_t &sizeOutput);
+
     void releaseIterator(EDBIterator *itr);
 
     size_t estimateCardinality(const Literal &query);
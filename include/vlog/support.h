@@ -7,72 +7,11 @@
 #include <vector>
 
 #include "term.h"
+#include "termdict.h"
 
-struct vlog_eqstr {
-    bool operator()(const std::string &v1, const std::string &v2) const {
-        return v1.compare(v2) == 0;
-    }
-};
-typedef google::dense_hash_map<const std::string,
-        Term_t, std::hash<std::string>, vlog_eqstr> SimpleHashmap;
-typedef google::dense_hash_map<Term_t, const std::string> SimpleInverseHashMap;
-
-class Dictionary {
-private:
-    SimpleHashmap map;
-    SimpleInverseHashMap inverseMap;
-    uint64_t counter;
-public:
-    Dictionary(const Dictionary &extDict) {
-        map = extDict.map;
-        inverseMap = extDict.inverseMap;
-        counter = extDict.counter;
-    }
-
-    Dictionary() : Dictionary(1) {
-    }
-
-    Dictionary(uint64_t startingCounter) : counter(startingCounter) {
-        map.set_empty_key("");
-        inverseMap.set_empty_key((Term_t) -1);
-    }
-
-    SimpleHashmap &getMap() {
-        return map;
-    }
-
-    Term_t getOrAdd(const std::string &rawValue) {
-        SimpleHashmap::iterator itr = map.find(rawValue);
-        if (itr == map.end()) {
-            //Add value
-            map.insert(std::make_pair(rawValue, (Term_t) counter));
-            inverseMap.insert(std::make_pair((Term_t) counter, rawValue));
-            return (Term_t) counter++;
-        } else {
-            return itr->second;
-        }
-    }
-
-    std::string getRawValue(const Term_t id) {
-        SimpleInverseHashMap::iterator itr = inverseMap.find(id);
-        if (itr == inverseMap.end()) {
-            return std::string("");
-        }
-        return itr->second;
-    }
-
-    std::string tostring() {
-        std::string output = "";
-        for (SimpleHashmap::iterator itr = map.begin(); itr != map.end(); ++itr) {
-            output += itr->first + std::string(" ") + std::to_string(itr->second) + std::string(" ");
-        }
-        return output;
-    }
-
-    size_t size() {
-        return map.size();
-    }
-};
+//Predicates, variables and the constants of the rules are numbered by the
+//concurrent dictionary
+typedef TermDictionary Dictionary;
 
 class ReasoningUtils {
 public:
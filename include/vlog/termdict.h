@@ -0,0 +1,146 @@
+#ifndef _TERMDICT_H
+#define _TERMDICT_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vlog/term.h>
+
+/*
+ * Dictionary of terms that can be used by many threads. Every term is stored
+ * once, in an append-only arena, as its length (4 bytes), its text and a
+ * terminating zero. The ids are consecutive from the first one given to the
+ * constructor:
+ *
+ * - id -> term: a segmented array of pointers in the arena. The segments
+ *   double in size and never move, so the lookups do not lock.
+ * - term -> id: TERMDICT_SHARDS open-addressing tables, chosen by the hash of
+ *   the term. A slot is 8 bytes: the position of the term in the dictionary
+ *   (40 bits) and a tag of its hash (24 bits). A table is replaced by one
+ *   twice as large when it is half full. The old tables are kept until the
+ *   dictionary is destroyed, so the lookups do not lock either. Inserts lock
+ *   only the shard of the term, which also owns the arena of its terms.
+ */
+
+#define TERMDICT_SHARD_BITS 6
+#define TERMDICT_SHARDS (1 << TERMDICT_SHARD_BITS)
+#define TERMDICT_TAG_BITS 24
+#define TERMDICT_MIN_SLOTS 16
+
+//The arena blocks of a shard grow from the min to the max size. A term larger
+//than the min size gets a block of its own
+#define TERMDICT_ARENA_MINBLOCK 4096
+#define TERMDICT_ARENA_MAXBLOCK (1 << 20)
+
+//Segment k of the id index has TERMDICT_INDEX_BASE << k entries
+#define TERMDICT_INDEX_BASE 1024
+#define TERMDICT_INDEX_SEGMENTS 40
+
+class TermDictionary {
+    private:
+        struct Table {
+            const size_t mask;
+            std::unique_ptr<std::atomic<uint64_t>[]> slots;
+            Table(const size_t size);
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::atomic<Table*> table;
+            //The current table is the last one
+            std::vector<std::unique_ptr<Table>> tables;
+            size_t count;
+
+            std::vector<std::unique_ptr<char[]>> blocks;
+            size_t blockSize;
+            size_t blockUsed;
+            size_t arenaBytes;
+
+            Shard() : table(NULL), count(0), blockSize(0), blockUsed(0),
+            arenaBytes(0) {
+            }
+        };
+
+        Term_t first;
+        std::atomic<uint64_t> counter;
+        std::unique_ptr<Shard[]> shards;
+        std::atomic<std::atomic<const char*>*> index[TERMDICT_INDEX_SEGMENTS];
+        std::mutex indexMutex;
+
+        static uint64_t hash(const char *text, const size_t len);
+
+        static size_t getShard(const uint64_t h) {
+            return h >> (64 - TERMDICT_SHARD_BITS);
+        }
+
+        static uint64_t getTag(const uint64_t h) {
+            return (h >> 16) & ((1ull << TERMDICT_TAG_BITS) - 1);
+        }
+
+        //Entry of the term at position 'pos', NULL if it is not there yet
+        const char *getEntry(const uint64_t pos) const;
+
+        void setEntry(const uint64_t pos, const char *entry);
+
+        //Position of the term in 'table', or -1
+        int64_t find(const Table *table, const char *text, const size_t len,
+                const uint64_t h) const;
+
+        const char *store(Shard &shard, const char *text, const size_t len);
+
+        void insert(Table *table, const uint64_t pos, const uint64_t h);
+
+        void grow(Shard &shard);
+
+        void copyFrom(const TermDictionary &other);
+
+    public:
+        TermDictionary() : TermDictionary(1) {
+        }
+
+        TermDictionary(const Term_t first);
+
+        //The copy has the same ids
+        TermDictionary(const TermDictionary &other);
+
+        TermDictionary &operator=(const TermDictionary &other);
+
+        ~TermDictionary();
+
+        Term_t getOrAdd(const char *text, const size_t len);
+
+        Term_t getOrAdd(const std::string &text) {
+            return getOrAdd(text.c_str(), text.size());
+        }
+
+        bool getID(const char *text, const size_t len, Term_t &id) const;
+
+        //Text of the term 'id' in the dictionary (zero-terminated), NULL if
+        //there is no such term
+        const char *get(const Term_t id, size_t &len) const;
+
+        //Copy the text of the term 'id' in 'text'
+        bool getText(const Term_t id, char *text) const;
+
+        std::string getRawValue(const Term_t id) const;
+
+        Term_t getFirstId() const {
+            return first;
+        }
+
+        size_t size() const {
+            return counter.load();
+        }
+
+        //Bytes of the arena and of the indexes
+        size_t getMemoryBytes() const;
+
+        std::string tostring() const;
+};
+
+#endif
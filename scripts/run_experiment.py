@@ -3,10 +3,27 @@
 # Input file contains rules and data, and possibly prefixes.
 # Format is same as RDFOX input, but Vlog-rules also work.
 # TODO: query the result
+#
+# With --dred, compare the DRed maintenance (--removeEDB) with a full
+# re-materialization, after removing a random fraction of the triples:
+#   run_experiment.py --dred <vlog> <triples (.ttl or .ttl.gz, one per line)> <rules> [fractions]
+# e.g. from examples/:
+#   ../scripts/run_experiment.py --dred ../build/vlog ttl/lubm_1.ttl.gz \
+#       rules/dlog/LUBM1_LE.dlog 0.001 0.01 0.1
+#
+# With --threads, time one large join of two generated INMEMORY tables with
+# --nthreads 1, 2, 4, ... up to maxthreads, and report the peak size of the
+# per-thread result buffers and the peak resident memory of vlog:
+#   run_experiment.py --threads <vlog> [nrows] [maxthreads]
 
 import sys
 import os
 import cStringIO
+import gzip
+import random
+import re
+import subprocess
+import time
 
 kbPred = 'TE'
 
@@ -197,6 +214,166 @@ def parsePrefix(prefixes, prefix):
     uri = prefix[prefix.find(" ") + 2:-1]
     prefixes[id] = uri
 
+def runVLog(args):
+    start = time.time()
+    proc = subprocess.Popen(args, stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT)
+    out = proc.communicate()[0]
+    wall = (time.time() - start) * 1000
+    if proc.returncode != 0:
+        print out
+        raise Exception('Failed: ' + ' '.join(args))
+    runtimes = {}
+    for m in re.finditer(r'Runtime ([a-zA-Z ]+) = ([0-9.e+]+) milliseconds', out):
+        runtimes[m.group(1)] = float(m.group(2))
+    derivations = re.findall(r'Total # derivations: ([0-9]+)', out)
+    return runtimes, derivations, wall
+
+def writeEdbConf(path, db):
+    f1 = open(path, 'w+')
+    print >> f1, "EDB0_predname=TE"
+    print >> f1, "EDB0_type=Trident"
+    print >> f1, "EDB0_param0=" + db
+    f1.close()
+
+def runDRedExperiment(args):
+    if len(args) < 3:
+        print 'Usage: run_experiment.py --dred <vlog> <triples> <rules> [fractions]'
+        sys.exit(1)
+    vlog = os.path.abspath(args[0])
+    triplesFile = args[1]
+    rules = args[2]
+    fractions = [float(a) for a in args[3:]] or [0.001, 0.01, 0.1]
+    random.seed(42)
+
+    if triplesFile.endswith('.gz'):
+        triples = [l.strip() for l in gzip.open(triplesFile) if l.strip()]
+    else:
+        triples = [l.strip() for l in open(triplesFile) if l.strip()]
+    # Only the triples without literals can be written as facts
+    candidates = [i for i, t in enumerate(triples) if '"' not in t]
+
+    cleanupDRed()
+    ensure_dir("./.dred/full/")
+    os.system("cp " + triplesFile + " ./.dred/full/")
+    runVLog([vlog, 'load', '-i', './.dred/full', '-o', './.dred/db_full'])
+    writeEdbConf('./.dred/edb_full.conf', './.dred/db_full')
+
+    print 'fraction removed dred_ms remat_ms full_mat_ms dred_derivations remat_derivations'
+    for fraction in fractions:
+        nremoved = int(len(triples) * fraction)
+        removed = set(random.sample(candidates, min(nremoved, len(candidates))))
+
+        # The facts to remove, for --removeEDB
+        f1 = open('./.dred/removed', 'w+')
+        for i in removed:
+            t = triples[i].rstrip(' .').split(' ')
+            print >> f1, 'TE(' + ','.join(t[:3]) + ')'
+        f1.close()
+
+        # The remaining triples, for the re-materialization
+        os.system("rm -rf ./.dred/rest ./.dred/db_rest")
+        ensure_dir("./.dred/rest/")
+        f1 = gzip.open('./.dred/rest/rest.ttl.gz', 'w')
+        for i, t in enumerate(triples):
+            if i not in removed:
+                print >> f1, t
+        f1.close()
+        runVLog([vlog, 'load', '-i', './.dred/rest', '-o', './.dred/db_rest'])
+        writeEdbConf('./.dred/edb_rest.conf', './.dred/db_rest')
+
+        runtimes, dredDerivations, _ = runVLog([vlog, 'mat', '-e',
+            './.dred/edb_full.conf', '--rules', rules, '-l', 'info',
+            '--removeEDB', './.dred/removed'])
+        dred = runtimes.get('DRed maintenance', -1)
+        fullMat = runtimes.get('materialization', -1)
+        runtimes, rematDerivations, _ = runVLog([vlog, 'mat', '-e',
+            './.dred/edb_rest.conf', '--rules', rules, '-l', 'info'])
+        remat = runtimes.get('materialization', -1)
+
+        # Both must end with the same number of derivations
+        dredCount = dredDerivations[-1] if dredDerivations else '?'
+        rematCount = rematDerivations[-1] if rematDerivations else '?'
+        print fraction, len(removed), dred, remat, fullMat, dredCount, rematCount
+        if dredCount != rematCount:
+            print 'WARNING: DRed and the re-materialization differ'
+    cleanupDRed()
+
+def runThreadsExperiment(args):
+    if len(args) < 1:
+        print 'Usage: run_experiment.py --threads <vlog> [nrows] [maxthreads]'
+        sys.exit(1)
+    vlog = os.path.abspath(args[0])
+    nrows = int(args[1]) if len(args) > 1 else 2000000
+    maxThreads = int(args[2]) if len(args) > 2 else 64
+    random.seed(42)
+
+    # Every join value occurs about 4 times on each side, so the join
+    # derives about 4 * nrows rows
+    cleanupThreads()
+    ensure_dir("./.threads/data/")
+    nkeys = max(1, nrows / 4)
+    for name in ['A', 'B']:
+        f1 = open('./.threads/data/' + name + '.csv', 'w+')
+        for i in xrange(nrows):
+            print >> f1, 'a%d,b%d' % (random.randint(0, nkeys - 1),
+                    random.randint(0, nkeys - 1))
+        f1.close()
+    f1 = open('./.threads/edb.conf', 'w+')
+    for i, name in enumerate(['A', 'B']):
+        print >> f1, 'EDB%d_predname=%s' % (i, name)
+        print >> f1, 'EDB%d_type=INMEMORY' % i
+        print >> f1, 'EDB%d_param0=./.threads/data' % i
+        print >> f1, 'EDB%d_param1=%s' % (i, name)
+    f1.close()
+    # Copy the tables to IDB predicates, so that the last rule is a join of
+    # two derived tables
+    f1 = open('./.threads/rules', 'w+')
+    print >> f1, 'A1(X,Y) :- A(X,Y)'
+    print >> f1, 'B1(X,Y) :- B(X,Y)'
+    print >> f1, 'Q(X,Z) :- A1(X,Y),B1(Y,Z)'
+    f1.close()
+
+    print 'nthreads mat_ms join_buffers_mb max_rss_mb derivations'
+    nthreads = 1
+    while nthreads <= maxThreads:
+        proc = subprocess.Popen([vlog, 'mat', '-e', './.threads/edb.conf',
+            '--rules', './.threads/rules', '-l', 'info', '--multithreaded',
+            '--nthreads', str(nthreads)], stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT)
+        out = proc.stdout.read()
+        _, status, rusage = os.wait4(proc.pid, 0)
+        if status != 0:
+            print out
+            raise Exception('Failed with --nthreads ' + str(nthreads))
+        mat = re.findall(r'Runtime materialization = ([0-9.e+]+) milliseconds', out)
+        buffers = re.findall(r'buffered results of a parallel join: ([0-9]+) MB', out)
+        derivations = re.findall(r'Total # derivations: ([0-9]+)', out)
+        # ru_maxrss is in KB on Linux
+        print nthreads, mat[-1] if mat else '?', \
+            buffers[-1] if buffers else '?', rusage.ru_maxrss / 1024, \
+            derivations[-1] if derivations else '?'
+        nthreads *= 2
+    cleanupThreads()
+
+def cleanupThreads():
+    os.system("rm -rf .threads")
+
+def cleanupDRed():
+    os.system("rm -rf .dred")
+
+def ensure_dir(f):
+    d = os.path.dirname(f)
+    if not os.path.exists(d):
+        os.makedirs(d)
+
+if len(sys.argv) > 1 and sys.argv[1] == '--dred':
+    runDRedExperiment(sys.argv[2:])
+    sys.exit(0)
+if len(sys.argv) > 1 and sys.argv[1] == '--threads':
+    runThreadsExperiment(sys.argv[2:])
+    sys.exit(0)
+
 print 'Extracting rules and input from ' + sys.argv[1]
 
 for line in open(sys.argv[1], 'r'):
@@ -212,11 +389,6 @@ for line in open(sys.argv[1], 'r'):
     else:
         parseInput(inputs, line)
 
-def ensure_dir(f):
-    d = os.path.dirname(f)
-    if not os.path.exists(d):
-        os.makedirs(d)
-
 def cleanup():
     os.system("rm -rf .data .edbconf .rules")
 
@@ -0,0 +1,129 @@
+#include <vlog/rowindex.h>
+#include <vlog/fcinttable.h>
+#include <vlog/segment.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*
+ * Micro-benchmark of the two ways FCTable::retainFrom removes the known rows
+ * from new ones: the sort-merge of SegmentInserter::retain against every
+ * block, and the lookups in a RowIndex of the table. It measures both, and
+ * the cost of building the index, for tables of three columns and deltas of
+ * a fraction of their size (half of the delta rows are already in the
+ * table). These are the numbers behind FCTABLE_HASHRETAIN_MINROWS and
+ * FCTABLE_HASHRETAIN_RATIO. Usage:
+ *
+ *   vlog_bench_retain [repetitions]
+ */
+
+#define BENCHRETAIN_ARITY 3
+
+typedef std::vector<std::vector<Term_t>> Rows;
+
+static std::shared_ptr<const Segment> toSegment(Rows rows) {
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    std::vector<std::shared_ptr<Column>> columns;
+    for (uint8_t i = 0; i < BENCHRETAIN_ARITY; ++i) {
+        ColumnWriter writer;
+        for (const auto &row : rows) {
+            writer.add(row[i]);
+        }
+        columns.push_back(writer.getColumn());
+    }
+    return std::shared_ptr<const Segment>(new Segment(BENCHRETAIN_ARITY,
+                columns));
+}
+
+static std::vector<Term_t> randomRow(std::mt19937_64 &gen,
+        const Term_t universe) {
+    std::vector<Term_t> row;
+    for (uint8_t i = 0; i < BENCHRETAIN_ARITY; ++i) {
+        row.push_back(gen() % universe);
+    }
+    return row;
+}
+
+//Best time in milliseconds of 'reps' runs of f
+template<typename F>
+static double timeBest(const int reps, F f) {
+    double best = -1;
+    for (int i = 0; i < reps; ++i) {
+        std::chrono::system_clock::time_point start =
+            std::chrono::system_clock::now();
+        f();
+        std::chrono::duration<double> sec = std::chrono::system_clock::now()
+            - start;
+        if (best < 0 || sec.count() < best) {
+            best = sec.count();
+        }
+    }
+    return best * 1000;
+}
+
+static void run(std::mt19937_64 &gen, const size_t nrows, const size_t ratio,
+        const int reps) {
+    const Term_t universe = nrows;
+    Rows tableRows, deltaRows;
+    for (size_t i = 0; i < nrows; ++i) {
+        tableRows.push_back(randomRow(gen, universe));
+    }
+    for (size_t i = 0; i < nrows / ratio; ++i) {
+        if (i % 2 == 0) {
+            deltaRows.push_back(tableRows[gen() % nrows]);
+        } else {
+            deltaRows.push_back(randomRow(gen, universe));
+        }
+    }
+    std::shared_ptr<const FCInternalTable> table(new InmemoryFCInternalTable(
+                (uint8_t) BENCHRETAIN_ARITY, (size_t) 1, true,
+                toSegment(tableRows)));
+    std::shared_ptr<const Segment> delta = toSegment(deltaRows);
+
+    std::unique_ptr<RowIndex> index;
+    const double build = timeBest(reps, [&]() {
+            index = std::unique_ptr<RowIndex>(new RowIndex(
+                        BENCHRETAIN_ARITY));
+            index->insert(table);
+            });
+    size_t sizeIndex = 0, sizeMerge = 0;
+    const double lookup = timeBest(reps, [&]() {
+            sizeIndex = index->retain(delta, false)->getNRows();
+            });
+    const double merge = timeBest(reps, [&]() {
+            std::shared_ptr<const Segment> d = delta;
+            sizeMerge = SegmentInserter::retain(d, table, false, 1)->getNRows();
+            });
+    if (sizeIndex != sizeMerge) {
+        std::cerr << "The results differ on " << nrows << " rows, delta 1/" <<
+            ratio << std::endl;
+        exit(1);
+    }
+    std::cout << nrows << "\t1/" << ratio << "\t" << build << "\t" <<
+        lookup << "\t" << merge << "\t";
+    //Number of retains after which building the index has paid off
+    if (merge > lookup) {
+        std::cout << build / (merge - lookup);
+    } else {
+        std::cout << "never";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, const char **argv) {
+    const int reps = argc > 1 ? atoi(argv[1]) : 3;
+    std::mt19937_64 gen(42);
+    std::cout << "rows\tdelta\tbuild_ms\tindex_ms\tmerge_ms\tbreak_even" <<
+        std::endl;
+    for (size_t nrows : { 10000, 100000, 1000000 }) {
+        for (size_t ratio : { 1, 4, 16, 64, 256 }) {
+            run(gen, nrows, ratio, reps);
+        }
+    }
+    return 0;
+}
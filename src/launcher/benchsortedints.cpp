@@ -0,0 +1,167 @@
+#include <vlog/sortedints.h>
+#include <vlog/column.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*
+ * Micro-benchmark of SortedInts::intersection and SortedInts::countMatches
+ * against the loops on the column readers that they replaced (see
+ * Column::intersection and Column::countMatches). Usage:
+ *
+ *   vlog_bench_sortedints [repetitions]
+ */
+
+//Sorted distinct values drawn from [0, universe)
+static std::vector<Term_t> generate(std::mt19937_64 &gen, const size_t n,
+        const Term_t universe) {
+    std::vector<Term_t> v;
+    v.reserve(n + n / 4);
+    while (v.size() < n) {
+        while (v.size() < n) {
+            v.push_back(gen() % universe);
+        }
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+    }
+    return v;
+}
+
+static void readerIntersection(std::shared_ptr<Column> c1,
+        std::shared_ptr<Column> c2, ColumnWriter &writer) {
+    std::unique_ptr<ColumnReader> r1 = c1->getReader();
+    std::unique_ptr<ColumnReader> r2 = c2->getReader();
+    if (!r1->hasNext() || !r2->hasNext()) {
+        return;
+    }
+    Term_t v1 = r1->next();
+    Term_t v2 = r2->next();
+    for (;;) {
+        if (v1 < v2) {
+            if (!r1->hasNext()) {
+                return;
+            }
+            v1 = r1->next();
+        } else if (v1 > v2) {
+            if (!r2->hasNext()) {
+                return;
+            }
+            v2 = r2->next();
+        } else {
+            writer.add(v1);
+            if (!r1->hasNext() || !r2->hasNext()) {
+                return;
+            }
+            v1 = r1->next();
+            v2 = r2->next();
+        }
+    }
+}
+
+static uint64_t readerCountMatches(std::shared_ptr<Column> c1,
+        std::shared_ptr<Column> c2) {
+    std::unique_ptr<ColumnReader> r1 = c1->getReader();
+    std::unique_ptr<ColumnReader> r2 = c2->getReader();
+    bool ok1 = r1->hasNext();
+    Term_t v1 = ok1 ? r1->next() : 0;
+    bool ok2 = r2->hasNext();
+    Term_t v2 = ok2 ? r2->next() : 0;
+    uint64_t count = 0;
+    while (ok1 && ok2) {
+        if (v1 < v2) {
+            ok1 = r1->hasNext();
+            if (ok1) {
+                v1 = r1->next();
+            }
+        } else {
+            if (v1 == v2) {
+                count++;
+            }
+            ok2 = r2->hasNext();
+            if (ok2) {
+                v2 = r2->next();
+            }
+        }
+    }
+    return count;
+}
+
+//Best time in milliseconds of 'reps' runs of f
+template<typename F>
+static double timeBest(const int reps, F f) {
+    double best = -1;
+    for (int i = 0; i < reps; ++i) {
+        std::chrono::system_clock::time_point start =
+            std::chrono::system_clock::now();
+        f();
+        std::chrono::duration<double> sec = std::chrono::system_clock::now()
+            - start;
+        if (best < 0 || sec.count() < best) {
+            best = sec.count();
+        }
+    }
+    return best * 1000;
+}
+
+static void run(std::mt19937_64 &gen, const std::string &name,
+        const size_t n1, const size_t n2, const int reps) {
+    //Both arrays come from a universe twice as large as the larger one, so
+    //about half of the values of the smaller one match
+    const Term_t universe = 2 * std::max(n1, n2);
+    std::vector<Term_t> v1 = generate(gen, n1, universe);
+    std::vector<Term_t> v2 = generate(gen, n2, universe);
+    std::vector<Term_t> copy1 = v1, copy2 = v2;
+    std::shared_ptr<Column> c1(new InmemoryColumn(copy1, true));
+    std::shared_ptr<Column> c2(new InmemoryColumn(copy2, true));
+
+    size_t sizeKernel = 0, sizeReader = 0;
+    const double kernelInt = timeBest(reps, [&]() {
+            ColumnWriter writer;
+            SortedInts::intersection(v1.data(), v1.size(), v2.data(),
+                    v2.size(), writer);
+            sizeKernel = writer.size();
+            });
+    const double readerInt = timeBest(reps, [&]() {
+            ColumnWriter writer;
+            readerIntersection(c1, c2, writer);
+            sizeReader = writer.size();
+            });
+    uint64_t countKernel = 0, countReader = 0;
+    const double kernelCount = timeBest(reps, [&]() {
+            countKernel = SortedInts::countMatches(v1.data(), v1.size(),
+                    v2.data(), v2.size());
+            });
+    const double readerCount = timeBest(reps, [&]() {
+            countReader = readerCountMatches(c1, c2);
+            });
+    if (sizeKernel != sizeReader || countKernel != countReader) {
+        std::cerr << "The results differ on " << name << std::endl;
+        exit(1);
+    }
+
+    std::cout << name << " (" << n1 << " x " << n2 << ", " << countKernel <<
+        " matches)" << std::endl;
+    std::cout << "  intersection: kernel " << kernelInt << "ms, reader " <<
+        readerInt << "ms, speedup " << readerInt / kernelInt << std::endl;
+    std::cout << "  countMatches: kernel " << kernelCount << "ms, reader " <<
+        readerCount << "ms, speedup " << readerCount / kernelCount <<
+        std::endl;
+}
+
+int main(int argc, const char **argv) {
+    const int reps = argc > 1 ? atoi(argv[1]) : 5;
+    std::mt19937_64 gen(42);
+    std::cout << "Linear kernel: " << SortedInts::getKernelName() <<
+        std::endl;
+    run(gen, "balanced small", 10000, 10000, reps);
+    run(gen, "balanced large", 5000000, 5000000, reps);
+    run(gen, "skewed 1:8", 500000, 4000000, reps);
+    //Above SORTEDINTS_GALLOP_RATIO the kernels gallop
+    run(gen, "skewed 1:1000", 5000, 5000000, reps);
+    run(gen, "skewed 1000:1", 5000000, 5000, reps);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <vlog/odbc/odbctable.h>
+#include <vlog/concepts.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*
+ * Compares the semi-joins that ODBCTable computes on the server (checkIn and
+ * checkNewIn with a temporary table) with the generic ones of EDBTable, which
+ * read the table through a sorted iterator. It fills the table vlog_check of
+ * the data source, e.g. a SQLite file registered in odbc.ini with the SQLite
+ * ODBC driver:
+ *
+ *   vlog_check_odbc <dsn> [nrows]
+ */
+
+#define CHECKODBC_TABLE "vlog_check"
+
+class CheckedODBCTable : public ODBCTable {
+    public:
+        CheckedODBCTable(std::string dsn) : ODBCTable("", "", dsn,
+                CHECKODBC_TABLE, "x,y") {
+        }
+
+        using ODBCTable::executeUpdate;
+        using ODBCTable::insertTempRows;
+};
+
+//Sorted distinct rows of 'ncolumns' values drawn from [0, universe)
+static std::vector<Term_t> generate(std::mt19937_64 &gen, const size_t nrows,
+        const uint8_t ncolumns, const Term_t universe) {
+    std::vector<std::vector<Term_t>> rows(nrows);
+    for (auto &row : rows) {
+        for (uint8_t i = 0; i < ncolumns; ++i) {
+            row.push_back(gen() % universe);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    std::vector<Term_t> out;
+    for (const auto &row : rows) {
+        out.insert(out.end(), row.begin(), row.end());
+    }
+    return out;
+}
+
+static std::vector<Term_t> readColumn(std::shared_ptr<Column> column) {
+    return column->getReader()->asVector();
+}
+
+static bool same(const std::string &name,
+        const std::vector<std::shared_ptr<Column>> &server,
+        const std::vector<std::shared_ptr<Column>> &generic) {
+    bool ok = server.size() == generic.size();
+    for (size_t i = 0; ok && i < server.size(); ++i) {
+        ok = readColumn(server[i]) == readColumn(generic[i]);
+    }
+    std::cout << name << ": " << (ok ? "ok" : "DIFFERENT") << " (" <<
+        (server.empty() ? 0 : server[0]->size()) << " rows)" << std::endl;
+    return ok;
+}
+
+int main(int argc, const char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: vlog_check_odbc <dsn> [nrows]" << std::endl;
+        return 1;
+    }
+    const size_t nrows = argc > 2 ? atol(argv[2]) : 100000;
+    //Half of the values that are checked occur in the table
+    const Term_t universe = nrows;
+    std::mt19937_64 gen(42);
+    CheckedODBCTable table(argv[1]);
+    table.executeUpdate("DROP TABLE IF EXISTS " CHECKODBC_TABLE);
+    table.executeUpdate("CREATE TABLE " CHECKODBC_TABLE
+            " (x BIGINT, y BIGINT)");
+    table.insertTempRows(CHECKODBC_TABLE, 2, generate(gen, nrows, 2,
+                universe));
+
+    const Predicate pred(0, 0, EDB, 2);
+    VTuple vars(2);
+    vars.set(VTerm(1, 0), 0);
+    vars.set(VTerm(2, 0), 1);
+    const Literal all(pred, vars);
+    VTuple constant(2);
+    constant.set(VTerm(0, gen() % universe), 0);
+    constant.set(VTerm(1, 0), 1);
+    const Literal withConstant(pred, constant);
+
+    bool ok = true;
+    //checkIn on the first and the second column, and with a constant
+    std::vector<Term_t> values = generate(gen, nrows / 2, 1, universe);
+    for (uint8_t pos = 0; pos < 2; ++pos) {
+        size_t sizeServer, sizeGeneric;
+        std::vector<std::shared_ptr<Column>> server, generic;
+        server.push_back(table.checkIn(values, all, pos, sizeServer));
+        generic.push_back(table.EDBTable::checkIn(values, all, pos,
+                    sizeGeneric));
+        ok &= sizeServer == sizeGeneric;
+        ok &= same("checkIn on column " + std::to_string(pos), server,
+                generic);
+    }
+    size_t sizeServer, sizeGeneric;
+    std::vector<std::shared_ptr<Column>> server, generic;
+    server.push_back(table.checkIn(values, withConstant, 0, sizeServer));
+    generic.push_back(table.EDBTable::checkIn(values, withConstant, 0,
+                sizeGeneric));
+    ok &= sizeServer == sizeGeneric;
+    ok &= same("checkIn with a constant", server, generic);
+
+    //checkNewIn on one and on two columns
+    for (uint8_t ncolumns = 1; ncolumns <= 2; ++ncolumns) {
+        std::vector<Term_t> rows = generate(gen, nrows / 2, ncolumns,
+                universe);
+        std::vector<std::shared_ptr<Column>> checkValues;
+        std::vector<uint8_t> posInL;
+        for (uint8_t i = 0; i < ncolumns; ++i) {
+            ColumnWriter writer;
+            for (size_t r = i; r < rows.size(); r += ncolumns) {
+                writer.add(rows[r]);
+            }
+            checkValues.push_back(writer.getColumn());
+            posInL.push_back(i);
+        }
+        ok &= same("checkNewIn on " + std::to_string(ncolumns) +
+                " columns", table.checkNewIn(checkValues, all, posInL),
+                table.EDBTable::checkNewIn(checkValues, all, posInL));
+    }
+
+    table.executeUpdate("DROP TABLE " CHECKODBC_TABLE);
+    return ok ? 0 : 1;
+}
@@ -6,6 +6,7 @@
 #include <vlog/edb.h>
 #include <vlog/webinterface.h>
 #include <vlog/fcinttable.h>
+#include <vlog/segment.h>
 #include <vlog/exporter.h>
 
 //Used to load a Trident KB
@@ -35,6 +36,7 @@
 #include <fstream>
 #include <chrono>
 #include <thread>
+#include <map>
 
 using namespace std;
 
@@ -173,6 +175,28 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv) {
                 return false;
             }
         }
+        if (cmd == "mat") {
+            string delta = vm["deltaEDB"].as<string>();
+            if (delta != "" && !Utils::exists(delta)) {
+                printErrorMsg((string("The file '") +
+                            delta + string("' does not exists")).c_str());
+                return false;
+            }
+            string removed = vm["removeEDB"].as<string>();
+            if (removed != "" && !Utils::exists(removed)) {
+                printErrorMsg((string("The file '") +
+                            removed + string("' does not exists")).c_str());
+                return false;
+            }
+        }
+        if (cmd == "mat" || cmd == "queryLiteral") {
+            string loadmat = vm["loadmat"].as<string>();
+            if (loadmat != "" && !Utils::exists(loadmat)) {
+                printErrorMsg((string("The materialization directory '") +
+                            loadmat + string("' does not exists")).c_str());
+                return false;
+            }
+        }
     }
 
     return true;
@@ -210,6 +234,12 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     query_options.add<int>("", "interRuleThreads", 0,
             "Set maximum number of threads to use for inter-rule parallelism. Default is 0", false);
 
+    query_options.add<bool>("", "sccEvaluation", false,
+            "Saturate the strongly connected components of the rule dependency graph one at a time, in topological order (only for <mat>, and not with interRuleThreads).", false);
+    query_options.add<int>("", "maxMemory", 0,
+            "Memory budget of the derived tables in MB. Above it, the column chunks cached for the joins are dropped, old blocks are moved to files in --spillDir and read back from there, and then the hash indexes of the rows are dropped (only for <mat>, and not with interRuleThreads). Default is 0 (unlimited).", false);
+    query_options.add<string>("", "spillDir", "",
+            "Directory for the blocks moved out of memory by --maxMemory. Default is '' (the temporary directory of the system).", false);
     query_options.add<bool>("", "shufflerules", false,
             "shuffle rules randomly instead of using heuristics (only for <mat>, and only when running multithreaded).", false);
     query_options.add<int>("r", "repeatQuery", 0,
@@ -217,11 +247,19 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     query_options.add<string>("","storemat_path", "",
             "Directory where to store all results of the materialization. Default is '' (disable).",false);
     query_options.add<string>("","storemat_format", "files",
-            "Format in which to dump the materialization. 'files' simply dumps the IDBs in files. 'csv' creates comma-separated files. 'db' creates a new RDF database. Default is 'files'.",false);
+            "Format in which to dump the materialization. 'files' simply dumps the IDBs in files. 'csv' creates comma-separated files. 'db' creates a new RDF database. 'fct' creates a binary snapshot that can be reopened with --loadmat. Default is 'files'.",false);
+    query_options.add<string>("","loadmat", "",
+            "Directory of a materialization stored with --storemat_format fct. With <mat>, the snapshot is loaded instead of running the materialization. With <queryLiteral> and --reasoningAlgo mat, the query is answered on the snapshot. Default is '' (disable).",false);
+    query_options.add<string>("","deltaEDB", "",
+            "File with new EDB facts, one per line (e.g. 'pred(a,b)'). With <mat>, the facts are added after the materialization (or after --loadmat) and only their consequences are computed. Default is '' (disable).",false);
+    query_options.add<string>("","removeEDB", "",
+            "File with EDB facts to remove, one per line (e.g. 'pred(a,b)'). With <mat>, the facts are removed after the materialization (or after --loadmat) and the derivations are updated with DRed. Applied before --deltaEDB. Default is '' (disable).",false);
     query_options.add<bool>("","explain", false,
             "Explain the query instead of executing it. Default is false.",false);
     query_options.add<bool>("","decompressmat", false,
             "Decompress the results of the materialization when we write it to a file. Default is false.",false);
+    query_options.add<string>("","dictsnapshot", "",
+            "File with a snapshot of the dictionary, which is mapped to decompress the materialization. It is created from the EDB layer if it does not exist. Default is '' (disable).",false);
 
 #ifdef WEBINTERFACE
     query_options.add<bool>("","webinterface", false,
@@ -337,6 +375,43 @@ void startServer(int argc,
 }
 #endif
 
+//Read the ground EDB facts in the file, grouped by predicate
+std::map<PredId_t, std::shared_ptr<const Segment>> readEDBFactsFromFile(
+        Program &p, string path) {
+    std::map<PredId_t, std::unique_ptr<SegmentInserter>> facts;
+    Dictionary dictVariables;
+    std::ifstream in(path);
+    string line;
+    long nfacts = 0;
+    while (std::getline(in, line)) {
+        if (line == "" || line[0] == '#') {
+            continue;
+        }
+        Literal l = p.parseLiteral(line, dictVariables);
+        if (l.getPredicate().getType() != EDB || l.getNVars() > 0) {
+            LOG(ERRORL) << "'" << line << "' is not a fact over an EDB predicate";
+            throw 10;
+        }
+        const uint8_t card = l.getTupleSize();
+        Term_t row[SIZETUPLE];
+        for (uint8_t i = 0; i < card; ++i) {
+            row[i] = l.getTermAtPos(i).getValue();
+        }
+        std::unique_ptr<SegmentInserter> &inserter = facts[l.getPredicate().getId()];
+        if (!inserter) {
+            inserter = std::unique_ptr<SegmentInserter>(new SegmentInserter(card));
+        }
+        inserter->addRow(row, card);
+        nfacts++;
+    }
+    LOG(INFOL) << "Read " << nfacts << " facts from " << path;
+    std::map<PredId_t, std::shared_ptr<const Segment>> out;
+    for (auto &el : facts) {
+        out[el.first] = el.second->getSegment();
+    }
+    return out;
+}
+
 void launchFullMat(int argc,
         const char** argv,
         string pathExec,
@@ -394,6 +469,17 @@ void launchFullMat(int argc,
                 nthreads,
                 interRuleThreads,
                 ! vm["shufflerules"].empty());
+        sn->setSCCEvaluation(! vm["sccEvaluation"].empty());
+        if (vm["maxMemory"].as<int>() > 0) {
+            string spillDir = vm["spillDir"].as<string>();
+            if (spillDir == "") {
+                const char *tmp = getenv("TMPDIR");
+                spillDir = tmp != NULL ? tmp : "/tmp";
+            }
+            Utils::create_directories(spillDir);
+            sn->setMemoryBudget((size_t) vm["maxMemory"].as<int>() << 20,
+                    spillDir);
+        }
 
 #ifdef WEBINTERFACE
         //Start the web interface if requested
@@ -408,12 +494,46 @@ void launchFullMat(int argc,
         }
 #endif
 
-        LOG(INFOL) << "Starting full materialization";
-        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-        sn->run();
-        std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
-        LOG(INFOL) << "Runtime materialization = " << sec.count() * 1000 << " milliseconds";
+        if (vm["loadmat"].as<string>() != "") {
+            LOG(INFOL) << "Loading the materialization from " << vm["loadmat"].as<string>();
+            std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+            sn->loadFromMmapFiles(vm["loadmat"].as<string>());
+            std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+            LOG(INFOL) << "Runtime loading materialization = " << sec.count() * 1000 << " milliseconds";
+        } else {
+            LOG(INFOL) << "Starting full materialization";
+            std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+            sn->run();
+            std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+            LOG(INFOL) << "Runtime materialization = " << sec.count() * 1000 << " milliseconds";
+        }
         sn->printCountAllIDBs("");
+        sn->printJoinStatistics();
+        sn->printMemoryIDBs();
+
+        if (vm["removeEDB"].as<string>() != "") {
+            auto facts = readEDBFactsFromFile(p, vm["removeEDB"].as<string>());
+            for (auto &el : facts) {
+                sn->removeEDBFacts(p.getPredicate(el.first), el.second);
+            }
+            std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+            sn->runDRed();
+            std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+            LOG(INFOL) << "Runtime DRed maintenance = " << sec.count() * 1000 << " milliseconds";
+            sn->printCountAllIDBs("");
+        }
+
+        if (vm["deltaEDB"].as<string>() != "") {
+            auto facts = readEDBFactsFromFile(p, vm["deltaEDB"].as<string>());
+            for (auto &el : facts) {
+                sn->addEDBFacts(p.getPredicate(el.first), el.second);
+            }
+            std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+            sn->runIncremental();
+            std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+            LOG(INFOL) << "Runtime incremental materialization = " << sec.count() * 1000 << " milliseconds";
+            sn->printCountAllIDBs("");
+        }
 
         if (vm["storemat_path"].as<string>() != "") {
             std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
@@ -422,6 +542,12 @@ void launchFullMat(int argc,
 
             string storemat_format = vm["storemat_format"].as<string>();
 
+            if (vm["decompressmat"].as<bool>() &&
+                    vm["dictsnapshot"].as<string>() != "") {
+                sn->getEDBLayer().useDictSnapshot(
+                        vm["dictsnapshot"].as<string>());
+            }
+
             if (storemat_format == "files" || storemat_format == "csv") {
                 sn->storeOnFiles(vm["storemat_path"].as<string>(),
                         vm["decompressmat"].as<bool>(), 0, storemat_format == "csv");
@@ -430,6 +556,8 @@ void launchFullMat(int argc,
                 exp.generateTridentDiffIndex(vm["storemat_path"].as<string>());
             } else if (storemat_format == "nt") {
                 exp.generateNTTriples(vm["storemat_path"].as<string>(), vm["decompressmat"].as<bool>());
+            } else if (storemat_format == "fct") {
+                sn->storeOnMmapFiles(vm["storemat_path"].as<string>());
             } else {
                 LOG(ERRORL) << "Option 'storemat_format' not recognized";
                 throw 10;
@@ -775,6 +903,7 @@ void execLiteralQuery(EDBLayer &edb, ProgramArgs &vm) {
     Dictionary dictVariables;
     Literal literal = p.parseLiteral(query, dictVariables);
     Reasoner reasoner(vm["reasoningThreshold"].as<long>());
+    reasoner.setMaterializationSnapshot(vm["loadmat"].as<string>());
     runLiteralQuery(edb, p, literal, reasoner, vm);
 }
 
@@ -0,0 +1,718 @@
+#include <vlog/columnar/columnartable.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+#include <trident/utils/parallel.h>
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <numeric>
+
+static void writeField(std::ofstream &out, const uint64_t v) {
+    out.write((const char*) &v, sizeof(uint64_t));
+}
+
+static uint64_t readField(const char *data, size_t &pos, const size_t len) {
+    if (pos + sizeof(uint64_t) > len) {
+        LOG(ERRORL) << "Columnar file truncated";
+        throw 10;
+    }
+    uint64_t v;
+    memcpy(&v, data + pos, sizeof(uint64_t));
+    pos += sizeof(uint64_t);
+    return v;
+}
+
+//Constants and repeated variables of a literal
+struct ColumnarQuery {
+    std::vector<uint8_t> constants;
+    std::vector<Term_t> values;
+    //(position, earlier position with the same variable)
+    std::vector<std::pair<uint8_t, uint8_t>> repeated;
+
+    ColumnarQuery(const Literal &query) {
+        for (uint8_t i = 0; i < query.getTupleSize(); ++i) {
+            const VTerm t = query.getTermAtPos(i);
+            if (!t.isVariable()) {
+                constants.push_back(i);
+                values.push_back(t.getValue());
+                continue;
+            }
+            for (uint8_t j = 0; j < i; ++j) {
+                const VTerm t2 = query.getTermAtPos(j);
+                if (t2.isVariable() && t2.getId() == t.getId()) {
+                    repeated.push_back(std::make_pair(i, j));
+                    break;
+                }
+            }
+        }
+    }
+
+    bool matches(SegmentIterator &itr) const {
+        for (size_t i = 0; i < constants.size(); ++i) {
+            if (itr.get(constants[i]) != values[i]) {
+                return false;
+            }
+        }
+        for (const auto &r : repeated) {
+            if (itr.get(r.first) != itr.get(r.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//----- DICTIONARY ----------
+std::mutex ColumnarDict::mutex;
+std::map<std::string, std::shared_ptr<const ColumnarDict>> ColumnarDict::dicts;
+
+ColumnarDict::ColumnarDict(const std::string &path) {
+    file = std::shared_ptr<const MmapFile>(new MmapFile(path));
+    const char *data = file->getData();
+    const size_t len = file->getLength();
+    size_t pos = 0;
+    if (readField(data, pos, len) != COLUMNAR_DICT_MAGIC ||
+            readField(data, pos, len) != COLUMNAR_VERSION) {
+        LOG(ERRORL) << "The file " << path << " is not a valid dictionary";
+        throw 10;
+    }
+    nterms = readField(data, pos, len);
+    if (pos + (2 * nterms + 1) * sizeof(uint64_t) > len) {
+        LOG(ERRORL) << "The dictionary " << path << " is truncated";
+        throw 10;
+    }
+    offsets = (const uint64_t*) (data + pos);
+    sorted = offsets + nterms + 1;
+    text = (const char*) (sorted + nterms);
+    if ((text - data) + offsets[nterms] > len) {
+        LOG(ERRORL) << "The dictionary " << path << " is truncated";
+        throw 10;
+    }
+}
+
+std::shared_ptr<const ColumnarDict> ColumnarDict::get(
+        const std::string &repository) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto itr = dicts.find(repository);
+    if (itr != dicts.end()) {
+        return itr->second;
+    }
+    const std::string path = repository + "/" + COLUMNAR_DICT;
+    if (!Utils::exists(path)) {
+        return std::shared_ptr<const ColumnarDict>();
+    }
+    std::shared_ptr<const ColumnarDict> dict(new ColumnarDict(path));
+    dicts[repository] = dict;
+    return dict;
+}
+
+void ColumnarDict::write(const std::string &repository, Dictionary &dict) {
+    //The terms are not copied, they point to the arena of the dictionary
+    const uint64_t nterms = dict.size();
+    std::vector<std::pair<const char*, size_t>> terms(nterms);
+    for (uint64_t i = 0; i < nterms; ++i) {
+        terms[i].first = dict.get(i + 1, terms[i].second);
+    }
+    std::vector<uint64_t> sorted(nterms);
+    for (uint64_t i = 0; i < nterms; ++i) {
+        sorted[i] = i + 1;
+    }
+    std::sort(sorted.begin(), sorted.end(),
+            [&terms](const uint64_t a, const uint64_t b) {
+            const auto &ta = terms[a - 1];
+            const auto &tb = terms[b - 1];
+            const int r = memcmp(ta.first, tb.first,
+                    std::min(ta.second, tb.second));
+            return r < 0 || (r == 0 && ta.second < tb.second);
+            });
+
+    //Write in a new file and rename it, so the tables that mapped the old
+    //one can still use it
+    const std::string path = repository + "/" + COLUMNAR_DICT;
+    const std::string tmppath = path + ".tmp";
+    std::ofstream out(tmppath, std::ios_base::binary);
+    if (!out.good()) {
+        LOG(ERRORL) << "Cannot write the file " << tmppath;
+        throw 10;
+    }
+    writeField(out, COLUMNAR_DICT_MAGIC);
+    writeField(out, COLUMNAR_VERSION);
+    writeField(out, nterms);
+    uint64_t offset = 0;
+    writeField(out, offset);
+    for (const auto &t : terms) {
+        offset += t.second;
+        writeField(out, offset);
+    }
+    for (const auto id : sorted) {
+        writeField(out, id);
+    }
+    for (const auto &t : terms) {
+        out.write(t.first, t.second);
+    }
+    out.close();
+    if (!out.good() || rename(tmppath.c_str(), path.c_str()) != 0) {
+        LOG(ERRORL) << "Cannot write the file " << path;
+        throw 10;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    dicts[repository] = std::shared_ptr<const ColumnarDict>(
+            new ColumnarDict(path));
+}
+
+void ColumnarDict::copyTo(Dictionary &dict) const {
+    for (uint64_t i = 0; i < nterms; ++i) {
+        dict.getOrAdd(text + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+}
+
+int ColumnarDict::compare(const uint64_t id, const char *t,
+        const size_t len) const {
+    const char *s = text + offsets[id - 1];
+    const size_t slen = offsets[id] - offsets[id - 1];
+    const int c = memcmp(s, t, std::min(slen, len));
+    if (c != 0) {
+        return c;
+    }
+    return slen < len ? -1 : (slen > len ? 1 : 0);
+}
+
+bool ColumnarDict::getText(const uint64_t id, char *t) const {
+    if (id == 0 || id > nterms) {
+        return false;
+    }
+    const size_t len = offsets[id] - offsets[id - 1];
+    memcpy(t, text + offsets[id - 1], len);
+    t[len] = '\0';
+    return true;
+}
+
+const char *ColumnarDict::getText(const uint64_t id, size_t &len) const {
+    if (id == 0 || id > nterms) {
+        return NULL;
+    }
+    len = offsets[id] - offsets[id - 1];
+    return text + offsets[id - 1];
+}
+
+bool ColumnarDict::getID(const char *t, const size_t sizeText,
+        uint64_t &id) const {
+    size_t lo = 0, hi = nterms;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        const int c = compare(sorted[mid], t, sizeText);
+        if (c == 0) {
+            id = sorted[mid];
+            return true;
+        } else if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+//----- END DICTIONARY ----------
+
+static std::vector<std::vector<uint8_t>> getOrders(const uint8_t arity) {
+    std::vector<std::vector<uint8_t>> orders;
+    std::vector<uint8_t> fields(arity);
+    std::iota(fields.begin(), fields.end(), 0);
+    if (arity == 0) {
+        return orders;
+    }
+    if (arity <= COLUMNAR_ALLORDERS_MAXARITY) {
+        do {
+            orders.push_back(fields);
+        } while (std::next_permutation(fields.begin(), fields.end()));
+    } else {
+        for (uint8_t i = 0; i < arity; ++i) {
+            std::vector<uint8_t> order;
+            order.push_back(i);
+            for (uint8_t j = 0; j < arity; ++j) {
+                if (j != i) {
+                    order.push_back(j);
+                }
+            }
+            orders.push_back(order);
+        }
+    }
+    return orders;
+}
+
+void ColumnarTable::convert(const std::string &repository,
+        const std::string &tablename, int nthreads) {
+    const std::string csvfile = repository + "/" + tablename + ".csv";
+    const std::string path = repository + "/" + tablename + COLUMNAR_EXT;
+    LOG(INFOL) << "Converting " << csvfile << " to " << path;
+
+    Dictionary dict;
+    std::shared_ptr<const ColumnarDict> oldDict = ColumnarDict::get(
+            repository);
+    if (oldDict != NULL) {
+        oldDict->copyTo(dict);
+    }
+    std::vector<std::vector<Term_t>> values;
+    const uint8_t arity = InmemoryTable::loadCSV(csvfile, nthreads, dict,
+            values);
+    if (oldDict == NULL || dict.size() > oldDict->getNTerms()) {
+        ColumnarDict::write(repository, dict);
+    }
+    const uint64_t nrows = arity == 0 ? 0 : values[0].size();
+    const std::vector<std::vector<uint8_t>> orders = getOrders(arity);
+
+    //The header is written again at the end, with the offsets
+    const std::string tmppath = path + ".tmp";
+    std::ofstream out(tmppath, std::ios_base::binary);
+    if (!out.good()) {
+        LOG(ERRORL) << "Cannot write the file " << tmppath;
+        throw 10;
+    }
+    const size_t sizeHeader = 6 + orders.size() * (arity + 4);
+    for (size_t i = 0; i < sizeHeader; ++i) {
+        writeField(out, 0);
+    }
+    uint64_t offset = sizeHeader * sizeof(uint64_t);
+    std::vector<uint64_t> columnOffsets, nkeys, keysOffsets, startsOffsets;
+    std::vector<uint64_t> perm(nrows);
+    std::vector<Term_t> column(nrows);
+    for (const auto &fields : orders) {
+        std::iota(perm.begin(), perm.end(), 0);
+        ParallelTasks::sort_int(perm.begin(), perm.end(),
+                [&values, &fields](const uint64_t a, const uint64_t b) {
+                for (const auto f : fields) {
+                if (values[f][a] != values[f][b]) {
+                return values[f][a] < values[f][b];
+                }
+                }
+                return a < b;
+                }, std::max(1, nthreads));
+        columnOffsets.push_back(offset);
+        for (uint8_t j = 0; j < arity; ++j) {
+            for (uint64_t i = 0; i < nrows; ++i) {
+                column[i] = values[j][perm[i]];
+            }
+            out.write((const char*) column.data(), nrows * sizeof(Term_t));
+            offset += nrows * sizeof(Term_t);
+        }
+
+        //Distinct values of the first field, and where they start
+        const std::vector<Term_t> &first = values[fields[0]];
+        std::vector<Term_t> keys;
+        std::vector<uint64_t> starts;
+        for (uint64_t i = 0; i < nrows; ++i) {
+            const Term_t v = first[perm[i]];
+            if (keys.empty() || keys.back() != v) {
+                keys.push_back(v);
+                starts.push_back(i);
+            }
+        }
+        starts.push_back(nrows);
+        nkeys.push_back(keys.size());
+        keysOffsets.push_back(offset);
+        out.write((const char*) keys.data(), keys.size() * sizeof(Term_t));
+        offset += keys.size() * sizeof(Term_t);
+        startsOffsets.push_back(offset);
+        out.write((const char*) starts.data(), starts.size() *
+                sizeof(uint64_t));
+        offset += starts.size() * sizeof(uint64_t);
+    }
+
+    out.seekp(0);
+    writeField(out, COLUMNAR_MAGIC);
+    writeField(out, COLUMNAR_VERSION);
+    writeField(out, sizeof(Term_t));
+    writeField(out, arity);
+    writeField(out, nrows);
+    writeField(out, orders.size());
+    for (size_t o = 0; o < orders.size(); ++o) {
+        for (const auto f : orders[o]) {
+            writeField(out, f);
+        }
+        writeField(out, columnOffsets[o]);
+        writeField(out, nkeys[o]);
+        writeField(out, keysOffsets[o]);
+        writeField(out, startsOffsets[o]);
+    }
+    out.close();
+    if (!out.good() || rename(tmppath.c_str(), path.c_str()) != 0) {
+        LOG(ERRORL) << "Cannot write the file " << path;
+        throw 10;
+    }
+}
+
+ColumnarTable::ColumnarTable(std::string repository, std::string tablename,
+        PredId_t predid, int nthreads) : repository(repository),
+    predid(predid), arity(0), nrows(0) {
+    const std::string path = repository + "/" + tablename + COLUMNAR_EXT;
+    if (!Utils::exists(path)) {
+        if (!Utils::exists(repository + "/" + tablename + ".csv")) {
+            LOG(WARNL) << "tablefile " << path << " does not exist";
+            return;
+        }
+        convert(repository, tablename, nthreads);
+    }
+
+    file = std::shared_ptr<const MmapFile>(new MmapFile(path));
+    const char *data = file->getData();
+    const size_t len = file->getLength();
+    size_t pos = 0;
+    if (readField(data, pos, len) != COLUMNAR_MAGIC ||
+            readField(data, pos, len) != COLUMNAR_VERSION) {
+        LOG(ERRORL) << "The file " << path << " is not a columnar table";
+        throw 10;
+    }
+    if (readField(data, pos, len) != sizeof(Term_t)) {
+        LOG(ERRORL) << "The file " << path <<
+            " was written with a different term size";
+        throw 10;
+    }
+    arity = (uint8_t) readField(data, pos, len);
+    nrows = readField(data, pos, len);
+    const uint64_t norders = readField(data, pos, len);
+    for (uint64_t o = 0; o < norders; ++o) {
+        ColumnarOrder order;
+        for (uint8_t i = 0; i < arity; ++i) {
+            order.fields.push_back((uint8_t) readField(data, pos, len));
+        }
+        const uint64_t columnsOffset = readField(data, pos, len);
+        order.nkeys = readField(data, pos, len);
+        const uint64_t keysOffset = readField(data, pos, len);
+        const uint64_t startsOffset = readField(data, pos, len);
+        if (columnsOffset + arity * nrows * sizeof(Term_t) > len ||
+                keysOffset + order.nkeys * sizeof(Term_t) > len ||
+                startsOffset + (order.nkeys + 1) * sizeof(uint64_t) > len) {
+            LOG(ERRORL) << "The file " << path << " is truncated";
+            throw 10;
+        }
+        for (uint8_t i = 0; i < arity; ++i) {
+            order.columns.push_back((const Term_t*) (data + columnsOffset) +
+                    i * nrows);
+        }
+        order.keys = (const Term_t*) (data + keysOffset);
+        order.starts = (const uint64_t*) (data + startsOffset);
+        orders.push_back(order);
+    }
+}
+
+const ColumnarOrder *ColumnarTable::findOrder(
+        const std::vector<uint8_t> &constants,
+        const std::vector<uint8_t> &fields) const {
+    //Sorting on a constant column changes nothing
+    std::vector<uint8_t> sortFields;
+    for (const auto f : fields) {
+        if (std::find(constants.begin(), constants.end(), f) ==
+                constants.end() && std::find(sortFields.begin(),
+                    sortFields.end(), f) == sortFields.end()) {
+            sortFields.push_back(f);
+        }
+    }
+    for (const auto &order : orders) {
+        if (constants.size() + sortFields.size() > order.fields.size()) {
+            return NULL;
+        }
+        if (!std::is_permutation(constants.begin(), constants.end(),
+                    order.fields.begin())) {
+            continue;
+        }
+        if (std::equal(sortFields.begin(), sortFields.end(),
+                    order.fields.begin() + constants.size())) {
+            return &order;
+        }
+    }
+    return NULL;
+}
+
+void ColumnarTable::getRange(const ColumnarOrder &order,
+        const std::vector<uint8_t> &constants,
+        const std::vector<Term_t> &values,
+        size_t &begin, size_t &end) const {
+    begin = 0;
+    end = nrows;
+    for (size_t k = 0; k < constants.size() && begin < end; ++k) {
+        const uint8_t field = order.fields[k];
+        const Term_t v = values[std::find(constants.begin(), constants.end(),
+                field) - constants.begin()];
+        if (k == 0) {
+            const Term_t *key = std::lower_bound(order.keys,
+                    order.keys + order.nkeys, v);
+            if (key == order.keys + order.nkeys || *key != v) {
+                end = begin;
+            } else {
+                begin = order.starts[key - order.keys];
+                end = order.starts[key - order.keys + 1];
+            }
+        } else {
+            const Term_t *column = order.columns[field];
+            const auto range = std::equal_range(column + begin, column + end,
+                    v);
+            begin = range.first - column;
+            end = range.second - column;
+        }
+    }
+}
+
+std::shared_ptr<const Segment> ColumnarTable::getSegment(
+        const ColumnarOrder &order, const size_t begin, const size_t end,
+        const std::vector<uint8_t> &constants) const {
+    std::vector<std::shared_ptr<Column>> columns;
+    for (uint8_t i = 0; i < arity; ++i) {
+        const bool constant = std::find(constants.begin(), constants.end(),
+                i) != constants.end();
+        columns.push_back(std::shared_ptr<Column>(new MmapColumn(file,
+                        order.columns[i] + begin, end - begin, constant)));
+    }
+    return std::shared_ptr<const Segment>(new Segment(arity, columns));
+}
+
+std::shared_ptr<const Segment> ColumnarTable::getMatchingRows(
+        const Literal &query, const std::vector<uint8_t> &fields) {
+    if (nrows == 0) {
+        return std::shared_ptr<const Segment>();
+    }
+    ColumnarQuery q(query);
+    size_t begin, end;
+    if (q.repeated.empty()) {
+        const ColumnarOrder *order = findOrder(q.constants, fields);
+        if (order != NULL) {
+            getRange(*order, q.constants, q.values, begin, end);
+            if (begin == end) {
+                return std::shared_ptr<const Segment>();
+            }
+            return getSegment(*order, begin, end, q.constants);
+        }
+    }
+
+    //Restrict the rows with the first constant, then filter and sort a copy
+    std::vector<uint8_t> prefix;
+    std::vector<Term_t> prefixValues;
+    if (!q.constants.empty()) {
+        prefix.push_back(q.constants[0]);
+        prefixValues.push_back(q.values[0]);
+    }
+    const ColumnarOrder *order = findOrder(prefix, std::vector<uint8_t>());
+    getRange(*order, prefix, prefixValues, begin, end);
+    std::shared_ptr<const Segment> seg = getSegment(*order, begin, end,
+            prefix);
+    std::vector<ColumnWriter> writers(arity);
+    std::unique_ptr<SegmentIterator> itr = seg->iterator();
+    while (itr->hasNext()) {
+        itr->next();
+        if (q.matches(*itr)) {
+            for (uint8_t i = 0; i < arity; ++i) {
+                writers[i].add(itr->get(i));
+            }
+        }
+    }
+    if (writers[0].size() == 0) {
+        return std::shared_ptr<const Segment>();
+    }
+    std::vector<std::shared_ptr<Column>> columns;
+    for (uint8_t i = 0; i < arity; ++i) {
+        columns.push_back(writers[i].getColumn());
+    }
+    std::shared_ptr<const Segment> filtered(new Segment(arity, columns));
+    if (!fields.empty()) {
+        filtered = filtered->sortBy(&fields);
+    }
+    return filtered;
+}
+
+EDBIterator *ColumnarTable::getSortedIterator(const Literal &query,
+        const std::vector<uint8_t> &fields) {
+    return new InmemoryIterator(getMatchingRows(query, fields), predid,
+            fields);
+}
+
+EDBIterator *ColumnarTable::getIterator(const Literal &query) {
+    return getSortedIterator(query, std::vector<uint8_t>());
+}
+
+void ColumnarTable::releaseIterator(EDBIterator *itr) {
+    delete itr;
+}
+
+void ColumnarTable::query(QSQQuery *query, TupleTable *outputTable,
+        std::vector<uint8_t> *posToFilter,
+        std::vector<Term_t> *valuesToFilter) {
+    LOG(ERRORL) << "Not implemented yet";
+    throw 10;
+}
+
+size_t ColumnarTable::getCardinality(const Literal &query) {
+    if (arity == 0) {
+        return nrows > 0 ? 1 : 0;
+    }
+    std::shared_ptr<const Segment> seg = getMatchingRows(query,
+            std::vector<uint8_t>());
+    return seg == NULL ? 0 : seg->getNRows();
+}
+
+size_t ColumnarTable::estimateCardinality(const Literal &query) {
+    return getCardinality(query);
+}
+
+size_t ColumnarTable::getCardinalityColumn(const Literal &query,
+        uint8_t posColumn) {
+    ColumnarQuery q(query);
+    if (q.constants.empty() && q.repeated.empty()) {
+        const ColumnarOrder *order = findOrder(q.constants,
+                std::vector<uint8_t>(1, posColumn));
+        if (order != NULL) {
+            return order->nkeys;
+        }
+    }
+    //Count the runs of the column in the sorted rows
+    std::shared_ptr<const Segment> seg = getMatchingRows(query,
+            std::vector<uint8_t>(1, posColumn));
+    if (seg == NULL) {
+        return 0;
+    }
+    std::unique_ptr<ColumnReader> reader =
+        seg->getColumn(posColumn)->getReader();
+    size_t count = 0;
+    Term_t prev = 0;
+    while (reader->hasNext()) {
+        const Term_t v = reader->next();
+        if (count == 0 || v != prev) {
+            count++;
+            prev = v;
+        }
+    }
+    return count;
+}
+
+bool ColumnarTable::isEmpty(const Literal &query,
+        std::vector<uint8_t> *posToFilter,
+        std::vector<Term_t> *valuesToFilter) {
+    if (posToFilter == NULL) {
+        return getCardinality(query) == 0;
+    }
+    //Add the filter as constants of the query
+    VTuple tuple = query.getTuple();
+    for (size_t i = 0; i < posToFilter->size(); ++i) {
+        tuple.set(VTerm(0, valuesToFilter->at(i)), posToFilter->at(i));
+    }
+    return getCardinality(Literal(query.getPredicate(), tuple)) == 0;
+}
+
+std::shared_ptr<Column> ColumnarTable::checkIn(
+        std::vector<Term_t> &values,
+        const Literal &l2,
+        uint8_t posInL2,
+        size_t &sizeOutput) {
+    ColumnarQuery q(l2);
+    const uint8_t field = l2.getPosVars()[posInL2];
+    const ColumnarOrder *order = q.repeated.empty() ? findOrder(q.constants,
+            std::vector<uint8_t>(1, field)) : NULL;
+    if (order == NULL) {
+        return EDBTable::checkIn(values, l2, posInL2, sizeOutput);
+    }
+
+    //Sorted values of the column, distinct if there are no constants
+    const Term_t *begin, *end;
+    if (q.constants.empty()) {
+        begin = order->keys;
+        end = order->keys + order->nkeys;
+    } else {
+        size_t b, e;
+        getRange(*order, q.constants, q.values, b, e);
+        begin = order->columns[field] + b;
+        end = order->columns[field] + e;
+    }
+    ColumnWriter out;
+    sizeOutput = 0;
+    for (const auto v : values) {
+        begin = std::lower_bound(begin, end, v);
+        if (begin == end) {
+            break;
+        }
+        if (*begin == v) {
+            out.add(v);
+            sizeOutput++;
+        }
+    }
+    return out.getColumn();
+}
+
+std::vector<std::shared_ptr<Column>> ColumnarTable::checkNewIn(
+        std::vector<std::shared_ptr<Column>> &checkValues,
+        const Literal &l2,
+        std::vector<uint8_t> &posInL2) {
+    ColumnarQuery q(l2);
+    const ColumnarOrder *order = NULL;
+    uint8_t field = 0;
+    if (checkValues.size() == 1 && q.repeated.empty()) {
+        field = l2.getPosVars()[posInL2[0]];
+        order = findOrder(q.constants, std::vector<uint8_t>(1, field));
+    }
+    if (order == NULL) {
+        return EDBTable::checkNewIn(checkValues, l2, posInL2);
+    }
+
+    const Term_t *begin, *end;
+    if (q.constants.empty()) {
+        begin = order->keys;
+        end = order->keys + order->nkeys;
+    } else {
+        size_t b, e;
+        getRange(*order, q.constants, q.values, b, e);
+        begin = order->columns[field] + b;
+        end = order->columns[field] + e;
+    }
+    //The values to check are sorted: keep the distinct ones that are not in
+    //the table
+    ColumnWriter out;
+    std::unique_ptr<ColumnReader> reader = checkValues[0]->getReader();
+    bool first = true;
+    Term_t prev = 0;
+    while (reader->hasNext()) {
+        const Term_t v = reader->next();
+        if (!first && v == prev) {
+            continue;
+        }
+        first = false;
+        prev = v;
+        begin = std::lower_bound(begin, end, v);
+        if (begin == end || *begin != v) {
+            out.add(v);
+        }
+    }
+    std::vector<std::shared_ptr<Column>> output;
+    output.push_back(out.getColumn());
+    return output;
+}
+
+bool ColumnarTable::getDictNumber(const char *text, const size_t sizeText,
+        uint64_t &id) {
+    std::shared_ptr<const ColumnarDict> dict = ColumnarDict::get(repository);
+    return dict != NULL && dict->getID(text, sizeText, id);
+}
+
+bool ColumnarTable::getDictText(const uint64_t id, char *text) {
+    std::shared_ptr<const ColumnarDict> dict = ColumnarDict::get(repository);
+    return dict != NULL && dict->getText(id, text);
+}
+
+const char *ColumnarTable::getDictTextPtr(const uint64_t id, size_t &len) {
+    //The dictionary stays mapped until the repository gets a new one, that
+    //is only while tables are being loaded
+    std::shared_ptr<const ColumnarDict> dict = ColumnarDict::get(repository);
+    return dict == NULL ? NULL : dict->getText(id, len);
+}
+
+uint64_t ColumnarTable::getNTerms() {
+    std::shared_ptr<const ColumnarDict> dict = ColumnarDict::get(repository);
+    return dict == NULL ? 0 : dict->getNTerms();
+}
+
+uint64_t ColumnarTable::getSize() {
+    return nrows;
+}
+
+ColumnarTable::~ColumnarTable() {
+}
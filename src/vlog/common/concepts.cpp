@@ -720,7 +720,9 @@ void Program::readFromFile(std::string pathFile, bool rewriteMultihead) {
                 parseRule(line, rewriteMultihead);
             }
         }
-        LOG(INFOL) << "New assigned constants: " << additionalConstants.size();
+        LOG(INFOL) << "New assigned constants: " << additionalConstants.size()
+            << " (" << additionalConstants.getMemoryBytes() /
+            std::max((size_t) 1, additionalConstants.size()) << " bytes/term)";
     }
 }
 
@@ -733,7 +735,9 @@ void Program::readFromString(std::string rules, bool rewriteMultihead) {
             parseRule(rule, rewriteMultihead);
         }
     }
-    LOG(INFOL) << "New assigned constants: " << additionalConstants.size();
+    LOG(INFOL) << "New assigned constants: " << additionalConstants.size()
+        << " (" << additionalConstants.getMemoryBytes() /
+        std::max((size_t) 1, additionalConstants.size()) << " bytes/term)";
 }
 
 std::string Program::compressRDFOWLConstants(std::string input) {
@@ -914,8 +918,9 @@ bool Program::isPredicateIDB(const PredId_t id) {
 
 int Program::getNEDBPredicates() {
     int n = 0;
-    for (const auto &el : dictPredicates.getMap()) {
-        if (kb->doesPredExists(el.second)) {
+    const Term_t first = dictPredicates.getFirstId();
+    for (Term_t id = first; id < first + dictPredicates.size(); ++id) {
+        if (kb->doesPredExists((PredId_t) id)) {
             n++;
         }
     }
@@ -924,8 +929,9 @@ int Program::getNEDBPredicates() {
 
 int Program::getNIDBPredicates() {
     int n = 0;
-    for (const auto &el : dictPredicates.getMap()) {
-        if (!kb->doesPredExists(el.second)) {
+    const Term_t first = dictPredicates.getFirstId();
+    for (Term_t id = first; id < first + dictPredicates.size(); ++id) {
+        if (!kb->doesPredExists((PredId_t) id)) {
             n++;
         }
     }
@@ -0,0 +1,130 @@
+#include <vlog/dictsnapshot.h>
+#include <vlog/edb.h>
+#include <vlog/fcstore.h>
+
+#include <kognac/consts.h>
+#include <kognac/logs.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define DICTSNAPSHOT_HEADER 4
+
+static void writeField(std::ofstream &out, const uint64_t v) {
+    out.write((const char*) &v, sizeof(uint64_t));
+}
+
+DictSnapshot::DictSnapshot(const std::string &path) {
+    file = std::shared_ptr<const MmapFile>(new MmapFile(path));
+    const char *data = file->getData();
+    const size_t len = file->getLength();
+    if (len < DICTSNAPSHOT_HEADER * sizeof(uint64_t)) {
+        LOG(ERRORL) << "The file " << path << " is not a dictionary snapshot";
+        throw 10;
+    }
+    const uint64_t *header = (const uint64_t*) data;
+    if (header[0] != DICTSNAPSHOT_MAGIC || header[1] != DICTSNAPSHOT_VERSION) {
+        LOG(ERRORL) << "The file " << path << " is not a dictionary snapshot";
+        throw 10;
+    }
+    first = header[2];
+    nterms = header[3];
+    offsets = header + DICTSNAPSHOT_HEADER;
+    text = (const char*) (offsets + nterms + 1);
+    if ((DICTSNAPSHOT_HEADER + nterms + 1) * sizeof(uint64_t) > len ||
+            (text - data) + offsets[nterms] > len) {
+        LOG(ERRORL) << "The dictionary snapshot " << path << " is truncated";
+        throw 10;
+    }
+}
+
+uint64_t DictSnapshot::getFirstId(EDBTable &table) {
+    //The ids of the tables start either from 0 or from 1
+    char buffer[MAX_TERM_SIZE];
+    return table.getDictText(0, buffer) ? 0 : 1;
+}
+
+//Text of the term 'id' in the table, "" if it has none (as in the snapshot)
+static std::string getTableText(EDBTable &table, const uint64_t id) {
+    size_t len = 0;
+    const char *t = table.getDictTextPtr(id, len);
+    if (t != NULL) {
+        return std::string(t, len);
+    }
+    char buffer[MAX_TERM_SIZE];
+    if (table.getDictText(id, buffer)) {
+        return std::string(buffer);
+    }
+    return std::string();
+}
+
+bool DictSnapshot::matches(EDBTable &table) const {
+    if (first != getFirstId(table) || nterms != table.getNTerms()) {
+        return false;
+    }
+    if (nterms == 0) {
+        return true;
+    }
+    for (const uint64_t id : { first, first + nterms - 1 }) {
+        size_t len = 0;
+        const char *t = get(id, len);
+        if (getTableText(table, id) != std::string(t, len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DictSnapshot::write(const std::string &path, EDBTable &table) {
+    char buffer[MAX_TERM_SIZE];
+    const uint64_t nterms = table.getNTerms();
+    const uint64_t first = getFirstId(table);
+
+    //The offsets are written after the text, when they are known
+    const std::string tmppath = path + ".tmp";
+    std::ofstream out(tmppath, std::ios_base::binary);
+    if (!out.good()) {
+        LOG(ERRORL) << "Cannot write the file " << tmppath;
+        throw 10;
+    }
+    writeField(out, DICTSNAPSHOT_MAGIC);
+    writeField(out, DICTSNAPSHOT_VERSION);
+    writeField(out, first);
+    writeField(out, nterms);
+    std::vector<uint64_t> offsets(nterms + 1);
+    out.write((const char*) offsets.data(), offsets.size() * sizeof(uint64_t));
+    uint64_t offset = 0;
+    size_t nmissing = 0;
+    for (uint64_t i = 0; i < nterms; ++i) {
+        offsets[i] = offset;
+        size_t len = 0;
+        const char *t = table.getDictTextPtr(first + i, len);
+        if (t == NULL) {
+            if (table.getDictText(first + i, buffer)) {
+                t = buffer;
+                len = strlen(buffer);
+            } else {
+                t = "";
+                nmissing++;
+            }
+        }
+        out.write(t, len);
+        out.put('\0');
+        offset += len + 1;
+    }
+    offsets[nterms] = offset;
+    out.seekp(DICTSNAPSHOT_HEADER * sizeof(uint64_t));
+    out.write((const char*) offsets.data(), offsets.size() * sizeof(uint64_t));
+    out.close();
+    if (!out.good() || rename(tmppath.c_str(), path.c_str()) != 0) {
+        LOG(ERRORL) << "Cannot write the file " << path;
+        throw 10;
+    }
+    if (nmissing > 0) {
+        LOG(WARNL) << nmissing << " ids of the dictionary have no text";
+    }
+    LOG(INFOL) << "Stored a snapshot of " << nterms << " terms in " << path;
+}
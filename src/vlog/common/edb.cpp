@@ -17,9 +17,15 @@
 #include <vlog/mdlite/mdlitetable.h>
 #endif
 #include <vlog/inmemory/inmemorytable.h>
+#include <vlog/columnar/columnartable.h>
+
+#include <trident/utils/tridentutils.h>
 
 #include <unordered_map>
 #include <climits>
+#include <cstring>
+#include <thread>
+#include <algorithm>
 
 void EDBLayer::addTridentTable(const EDBConf::Table &tableConf, bool multithreaded) {
     EDBInfoTable infot;
@@ -92,18 +98,73 @@ void EDBLayer::addMDLiteTable(const EDBConf::Table &tableConf) {
 }
 #endif
 
+//The optional third parameter of the local tables is the number of threads
+//used to parse their CSV file
+static int getLoadingThreads(const EDBConf::Table &tableConf) {
+    if (tableConf.params.size() > 2 && tableConf.params[2] != "") {
+        return TridentUtils::lexical_cast<int>(tableConf.params[2]);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
 void EDBLayer::addInmemoryTable(const EDBConf::Table &tableConf) {
     EDBInfoTable infot;
     const string pn = tableConf.predname;
     infot.id = (PredId_t) predDictionary.getOrAdd(pn);
     infot.type = tableConf.type;
     InmemoryTable *table = new InmemoryTable(tableConf.params[0],
-            tableConf.params[1], infot.id);
+            tableConf.params[1], infot.id, getLoadingThreads(tableConf));
+    infot.manager = std::shared_ptr<EDBTable>(table);
+    infot.arity = table->getArity();
+    dbPredicates.insert(make_pair(infot.id, infot));
+}
+
+void EDBLayer::addColumnarTable(const EDBConf::Table &tableConf) {
+    EDBInfoTable infot;
+    const string pn = tableConf.predname;
+    infot.id = (PredId_t) predDictionary.getOrAdd(pn);
+    infot.type = tableConf.type;
+    ColumnarTable *table = new ColumnarTable(tableConf.params[0],
+            tableConf.params[1], infot.id, getLoadingThreads(tableConf));
     infot.manager = std::shared_ptr<EDBTable>(table);
     infot.arity = table->getArity();
     dbPredicates.insert(make_pair(infot.id, infot));
 }
 
+void EDBLayer::checkDictionaries(const std::vector<EDBConf::Table> &tables) {
+    //The COLUMNAR tables number the terms with the dictionary of their
+    //repository, starting from 1 like the other dictionaries. The ids of
+    //two dictionaries would clash in the joins, and the constants and the
+    //output are translated with the dictionary of the first table only
+    std::string repository = "";
+    for (const auto &table : tables) {
+        if (table.type != "COLUMNAR") {
+            continue;
+        }
+        std::string r = table.params[0];
+        while (r.size() > 1 && r.back() == '/') {
+            r.pop_back();
+        }
+        if (repository == "") {
+            repository = r;
+        } else if (r != repository) {
+            LOG(ERRORL) << "All the COLUMNAR tables must be in the same "
+                "repository (" << repository << " and " << r << ")";
+            throw 10;
+        }
+    }
+    if (repository != "") {
+        for (const auto &table : tables) {
+            if (table.type != "COLUMNAR") {
+                LOG(ERRORL) << "COLUMNAR tables cannot be used together with "
+                    "tables of type " << table.type << " (" <<
+                    table.predname << ")";
+                throw 10;
+            }
+        }
+    }
+}
+
 bool EDBLayer::doesPredExists(PredId_t id) const {
     return dbPredicates.count(id);
 }
@@ -801,6 +862,15 @@ bool EDBLayer::getDictNumber(const char *text, const size_t sizeText, uint64_t &
 }
 
 bool EDBLayer::getDictText(const uint64_t id, char *text) {
+    if (dictSnapshot != NULL) {
+        size_t len;
+        const char *t = dictSnapshot->get(id, len);
+        if (t != NULL) {
+            memcpy(text, t, len + 1);
+            return true;
+        }
+        return false;
+    }
     if (dbPredicates.size() > 0) {
         //Get the number from the first edb table
         return dbPredicates.begin()->second.manager->getDictText(id, text);
@@ -808,6 +878,52 @@ bool EDBLayer::getDictText(const uint64_t id, char *text) {
     return false;
 }
 
+const char *EDBLayer::getDictText(const uint64_t id, char *buffer,
+        size_t &len) {
+    if (dictSnapshot != NULL) {
+        return dictSnapshot->get(id, len);
+    }
+    if (dbPredicates.size() > 0) {
+        EDBTable *table = dbPredicates.begin()->second.manager.get();
+        const char *t = table->getDictTextPtr(id, len);
+        if (t == NULL && table->getDictText(id, buffer)) {
+            t = buffer;
+            len = strlen(buffer);
+        }
+        return t;
+    }
+    return NULL;
+}
+
+void EDBLayer::useDictSnapshot(const std::string &path) {
+    if (dbPredicates.empty()) {
+        LOG(ERRORL) << "There is no dictionary to store in " << path;
+        throw 10;
+    }
+    EDBTable &table = *dbPredicates.begin()->second.manager;
+    dictSnapshot.reset();
+    if (Utils::exists(path)) {
+        //The snapshot may come from another database or from an older
+        //version of this one
+        std::unique_ptr<DictSnapshot> snapshot(new DictSnapshot(path));
+        if (snapshot->matches(table)) {
+            dictSnapshot = std::move(snapshot);
+        } else {
+            LOG(WARNL) << "The snapshot in " << path << " (" <<
+                snapshot->getNTerms() << " terms from id " <<
+                snapshot->getFirstId() << ") does not match the dictionary ("
+                << table.getNTerms() << " terms from id " <<
+                DictSnapshot::getFirstId(table) << "). Writing it again";
+        }
+    }
+    if (dictSnapshot == NULL) {
+        DictSnapshot::write(path, table);
+        dictSnapshot = std::unique_ptr<DictSnapshot>(new DictSnapshot(path));
+    }
+    LOG(INFOL) << "Mapped the snapshot of " << dictSnapshot->getNTerms() <<
+        " terms in " << path;
+}
+
 uint64_t EDBLayer::getNTerms() {
     if (dbPredicates.size() > 0) {
         //Get the number from the first edb table
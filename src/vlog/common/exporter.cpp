@@ -414,6 +414,8 @@ void Exporter::generateNTTriples(string outputdir, bool decompress) {
     std::unique_ptr<zstr::ofstream> out;
 
     char supportBuffer[MAX_TERM_SIZE];
+    const char *text;
+    size_t len;
     size_t idx = 0;
     for (int i = 0; i < all_s.size(); ++i) {
         if (i % 10000000 == 0) {
@@ -426,22 +428,28 @@ void Exporter::generateNTTriples(string outputdir, bool decompress) {
             out = std::unique_ptr<zstr::ofstream>(new zstr::ofstream(filename));
         }
         if (decompress) {
-            if (edb.getDictText(all_s[i], supportBuffer)) {
-                *out << supportBuffer << " ";
+            text = edb.getDictText(all_s[i], supportBuffer, len);
+            if (text != NULL) {
+                out->write(text, len);
+                *out << " ";
             } else {
                 std::string t = sn->getProgram()->getFromAdditional(all_s[i]);
                 if (t == std::string("")) t = std::to_string(all_s[i]);
                 *out << t << " ";
             }
-            if (edb.getDictText(all_p[i], supportBuffer)) {
-                *out << supportBuffer << " ";
+            text = edb.getDictText(all_p[i], supportBuffer, len);
+            if (text != NULL) {
+                out->write(text, len);
+                *out << " ";
             } else {
                 std::string t = sn->getProgram()->getFromAdditional(all_p[i]);
                 if (t == std::string("")) t = std::to_string(all_p[i]);
                 *out << t << " ";
             }
-            if (edb.getDictText(all_o[i], supportBuffer)) {
-                *out << supportBuffer << " ." << endl;
+            text = edb.getDictText(all_o[i], supportBuffer, len);
+            if (text != NULL) {
+                out->write(text, len);
+                *out << " ." << endl;
             } else {
                 std::string t = sn->getProgram()->getFromAdditional(all_o[i]);
                 if (t == std::string("")) t = std::to_string(all_o[i]);
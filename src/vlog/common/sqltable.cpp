@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -44,3 +47,228 @@ void SQLTable::releaseIterator(EDBIterator *itr) {
     delete itr;
 }
 
+
+string SQLTable::conditionsToSQLQuery(const Literal &q,
+        const std::vector<string> &fieldTables) {
+    string cond = literalConstraintsToSQLQuery(q, fieldTables);
+    string cond1 = repeatedToSQLQuery(q, fieldTables);
+    if (cond1 != "") {
+	if (cond != "") {
+	    cond += " and ";
+	}
+	cond += cond1;
+    }
+    return cond;
+}
+
+void SQLTable::executeUpdate(const string &sql) {
+    LOG(ERRORL) << "Updates are not supported by the table " << tablename;
+    throw 10;
+}
+
+EDBIterator *SQLTable::executeQuery(const string &sql, const Literal &query,
+	const uint8_t ncolumns) {
+    LOG(ERRORL) << "Queries are not supported by the table " << tablename;
+    throw 10;
+}
+
+void SQLTable::insertTempRows(const string &name, const uint8_t ncolumns,
+	const std::vector<Term_t> &rows) {
+    LOG(ERRORL) << "Temporary tables are not supported by the table " <<
+	tablename;
+    throw 10;
+}
+
+string SQLTable::tempTableColumns(const uint8_t ncolumns) {
+    //No primary key: the values of query() can contain duplicates
+    string cols = "";
+    for (uint8_t i = 0; i < ncolumns; i++) {
+	if (i > 0) {
+	    cols += ", ";
+	}
+	cols += tempColumn(i) + " BIGINT";
+    }
+    return cols;
+}
+
+string SQLTable::tempTableToSQLQuery(const string &name,
+	const std::vector<uint8_t> &posToFilter) {
+    string cond = "EXISTS (SELECT * FROM " + name + " s WHERE ";
+    for (int i = 0; i < posToFilter.size(); i++) {
+	if (i != 0) {
+	    cond += " AND ";
+	}
+	cond += tablename + "." + fieldTables[posToFilter[i]] + " = s." +
+	    tempColumn(i);
+    }
+    return cond + ")";
+}
+
+void SQLTable::createTempTable(const string &name, const uint8_t ncolumns) {
+    string sql = "CREATE TEMPORARY TABLE " + name +
+	" (" + tempTableColumns(ncolumns) + ")";
+    LOG(DEBUGL) << "SQL create temp table: " << sql;
+    executeUpdate(sql);
+}
+
+void SQLTable::indexTempTable(const string &name, const uint8_t ncolumns) {
+    string cols = "";
+    for (uint8_t i = 0; i < ncolumns; i++) {
+	if (i > 0) {
+	    cols += ", ";
+	}
+	cols += tempColumn(i);
+    }
+    executeUpdate("CREATE INDEX " + name + "_idx ON " + name + " (" + cols +
+	    ")");
+}
+
+//Numbers the temporary tables, so that two semi-joins never share one
+static std::atomic<uint64_t> tempTableCounter(0);
+
+SQLTable::TempTable::TempTable(SQLTable *table, const uint8_t ncolumns,
+	const std::vector<Term_t> &rows) : table(table),
+    name(string(SQLTABLE_TMPTABLE) + "_" + to_string(++tempTableCounter)) {
+    table->createTempTable(name, ncolumns);
+    try {
+	table->insertTempRows(name, ncolumns, rows);
+	table->indexTempTable(name, ncolumns);
+    } catch (...) {
+	try {
+	    table->executeUpdate("DROP TABLE " + name);
+	} catch (...) {
+	}
+	throw;
+    }
+}
+
+SQLTable::TempTable::~TempTable() {
+    try {
+	table->executeUpdate("DROP TABLE " + name);
+    } catch (...) {
+	//The table goes away with the connection anyway
+	LOG(WARNL) << "Could not drop the temporary table " << name;
+    }
+}
+
+//Distinct rows of the sorted columns, one row after the other
+static void readDistinctRows(
+	std::vector<std::unique_ptr<ColumnReader>> &readers,
+	std::vector<Term_t> &rows) {
+    const size_t ncolumns = readers.size();
+    std::vector<Term_t> row(ncolumns);
+    while (true) {
+	for (size_t i = 0; i < ncolumns; i++) {
+	    if (!readers[i]->hasNext()) {
+		return;
+	    }
+	    row[i] = readers[i]->next();
+	}
+	if (rows.empty() || !std::equal(row.begin(), row.end(),
+		    rows.end() - ncolumns)) {
+	    rows.insert(rows.end(), row.begin(), row.end());
+	}
+    }
+}
+
+std::vector<std::shared_ptr<Column>> SQLTable::checkNewIn(
+	std::vector<std::shared_ptr<Column>> &checkValues,
+	const Literal &l,
+	std::vector<uint8_t> &posInL) {
+    if (!supportsTempTable()) {
+	return EDBTable::checkNewIn(checkValues, l, posInL);
+    }
+    const uint8_t ncolumns = (uint8_t) checkValues.size();
+    std::vector<std::unique_ptr<ColumnReader>> readers;
+    for (const auto &c : checkValues) {
+	readers.push_back(c->getReader());
+    }
+    std::vector<Term_t> rows;
+    readDistinctRows(readers, rows);
+
+    std::vector<std::unique_ptr<ColumnWriter>> cols;
+    for (uint8_t i = 0; i < ncolumns; i++) {
+	cols.push_back(std::unique_ptr<ColumnWriter>(new ColumnWriter()));
+    }
+    if (!rows.empty()) {
+	TempTable temp(this, ncolumns, rows);
+
+	//The rows of the temporary table without a match in the table
+	std::vector<uint8_t> posVars = l.getPosVars();
+	string sqlQuery = "SELECT ";
+	string order = "";
+	string match = conditionsToSQLQuery(l, fieldTables);
+	for (uint8_t i = 0; i < ncolumns; i++) {
+	    if (i > 0) {
+		sqlQuery += ", ";
+		order += ", ";
+	    }
+	    sqlQuery += "s." + tempColumn(i);
+	    order += "s." + tempColumn(i);
+	    if (match != "") {
+		match += " and ";
+	    }
+	    match += tablename + "." + fieldTables[posVars[posInL[i]]] +
+		" = s." + tempColumn(i);
+	}
+	sqlQuery += " FROM " + temp.getName() +
+	    " s WHERE NOT EXISTS (SELECT * FROM " + tablename + " WHERE " +
+	    match + ") ORDER BY " + order;
+
+	//Closed before the temporary table is dropped
+	std::unique_ptr<EDBIterator> iter(executeQuery(sqlQuery, l, ncolumns));
+	while (iter->hasNext()) {
+	    iter->next();
+	    for (uint8_t i = 0; i < ncolumns; i++) {
+		cols[i]->add(iter->getElementAt(i));
+	    }
+	}
+	iter->clear();
+    }
+
+    std::vector<std::shared_ptr<Column>> output;
+    for (auto &el : cols) {
+	output.push_back(el->getColumn());
+    }
+    return output;
+}
+
+std::shared_ptr<Column> SQLTable::checkIn(
+	std::vector<Term_t> &values,
+	const Literal &l,
+	uint8_t posInL,
+	size_t &sizeOutput) {
+    if (!supportsTempTable()) {
+	return EDBTable::checkIn(values, l, posInL, sizeOutput);
+    }
+    std::unique_ptr<ColumnWriter> col(new ColumnWriter());
+    sizeOutput = 0;
+    std::vector<Term_t> rows(values);
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.empty()) {
+	return col->getColumn();
+    }
+    TempTable temp(this, 1, rows);
+
+    //The values of the temporary table that occur in the table
+    const string field = fieldTables[l.getPosVars()[posInL]];
+    string sqlQuery = "SELECT DISTINCT " + field + " FROM " + tablename +
+	", " + temp.getName() + " s WHERE ";
+    string cond = conditionsToSQLQuery(l, fieldTables);
+    if (cond != "") {
+	sqlQuery += cond + " and ";
+    }
+    sqlQuery += tablename + "." + field + " = s." + tempColumn(0) +
+	" ORDER BY " + field;
+
+    //Closed before the temporary table is dropped
+    std::unique_ptr<EDBIterator> iter(executeQuery(sqlQuery, l, 1));
+    while (iter->hasNext()) {
+	iter->next();
+	col->add(iter->getElementAt(0));
+	sizeOutput++;
+    }
+    iter->clear();
+    return col->getColumn();
+}
@@ -0,0 +1,286 @@
+#include <vlog/termdict.h>
+
+#include <cstring>
+
+TermDictionary::Table::Table(const size_t size) : mask(size - 1),
+    slots(new std::atomic<uint64_t>[size]) {
+    for (size_t i = 0; i < size; ++i) {
+        slots[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+TermDictionary::TermDictionary(const Term_t first) : first(first), counter(0),
+    shards(new Shard[TERMDICT_SHARDS]) {
+    for (int i = 0; i < TERMDICT_INDEX_SEGMENTS; ++i) {
+        index[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+TermDictionary::TermDictionary(const TermDictionary &other) :
+    TermDictionary(other.first) {
+    copyFrom(other);
+}
+
+TermDictionary &TermDictionary::operator=(const TermDictionary &other) {
+    if (this != &other) {
+        counter = 0;
+        shards.reset(new Shard[TERMDICT_SHARDS]);
+        for (int i = 0; i < TERMDICT_INDEX_SEGMENTS; ++i) {
+            delete[] index[i].load();
+            index[i].store(NULL);
+        }
+        first = other.first;
+        copyFrom(other);
+    }
+    return *this;
+}
+
+TermDictionary::~TermDictionary() {
+    for (int i = 0; i < TERMDICT_INDEX_SEGMENTS; ++i) {
+        delete[] index[i].load();
+    }
+}
+
+void TermDictionary::copyFrom(const TermDictionary &other) {
+    const size_t n = other.size();
+    for (size_t i = 0; i < n; ++i) {
+        size_t len;
+        const char *text = other.get(other.first + i, len);
+        getOrAdd(text, len);
+    }
+}
+
+uint64_t TermDictionary::hash(const char *text, const size_t len) {
+    //FNV-1a, with the finalizer of splitmix64 to spread the top bits, which
+    //select the shard
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (uint8_t) text[i]) * 1099511628211ull;
+    }
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+static void indexPosition(const uint64_t pos, int &segment, uint64_t &offset) {
+    const uint64_t j = pos / TERMDICT_INDEX_BASE + 1;
+    segment = 63 - __builtin_clzll(j);
+    offset = pos - (uint64_t) TERMDICT_INDEX_BASE * ((1ull << segment) - 1);
+}
+
+const char *TermDictionary::getEntry(const uint64_t pos) const {
+    int segment;
+    uint64_t offset;
+    indexPosition(pos, segment, offset);
+    std::atomic<const char*> *s = index[segment].load(
+            std::memory_order_acquire);
+    if (s == NULL) {
+        return NULL;
+    }
+    return s[offset].load(std::memory_order_acquire);
+}
+
+void TermDictionary::setEntry(const uint64_t pos, const char *entry) {
+    int segment;
+    uint64_t offset;
+    indexPosition(pos, segment, offset);
+    std::atomic<const char*> *s = index[segment].load(
+            std::memory_order_acquire);
+    if (s == NULL) {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        s = index[segment].load(std::memory_order_acquire);
+        if (s == NULL) {
+            const size_t size = (size_t) TERMDICT_INDEX_BASE << segment;
+            s = new std::atomic<const char*>[size];
+            for (size_t i = 0; i < size; ++i) {
+                s[i].store(NULL, std::memory_order_relaxed);
+            }
+            index[segment].store(s, std::memory_order_release);
+        }
+    }
+    s[offset].store(entry, std::memory_order_release);
+}
+
+int64_t TermDictionary::find(const Table *table, const char *text,
+        const size_t len, const uint64_t h) const {
+    if (table == NULL) {
+        return -1;
+    }
+    const uint64_t tag = getTag(h);
+    for (size_t i = h & table->mask; ; i = (i + 1) & table->mask) {
+        const uint64_t v = table->slots[i].load(std::memory_order_acquire);
+        if (v == 0) {
+            return -1;
+        }
+        if ((v & ((1ull << TERMDICT_TAG_BITS) - 1)) == tag) {
+            const uint64_t pos = (v >> TERMDICT_TAG_BITS) - 1;
+            const char *entry = getEntry(pos);
+            uint32_t l;
+            memcpy(&l, entry, sizeof(uint32_t));
+            if (l == len && memcmp(entry + sizeof(uint32_t), text, len) == 0) {
+                return pos;
+            }
+        }
+    }
+}
+
+const char *TermDictionary::store(Shard &shard, const char *text,
+        const size_t len) {
+    const size_t size = sizeof(uint32_t) + len + 1;
+    char *entry;
+    if (size > TERMDICT_ARENA_MINBLOCK) {
+        //A large term gets its own block, the current one stays the last
+        entry = new char[size];
+        shard.blocks.insert(shard.blocks.begin(),
+                std::unique_ptr<char[]>(entry));
+        shard.arenaBytes += size;
+    } else {
+        if (shard.blocks.empty() || shard.blockUsed + size > shard.blockSize) {
+            if (shard.blockSize < TERMDICT_ARENA_MAXBLOCK) {
+                shard.blockSize = shard.blockSize == 0 ?
+                    TERMDICT_ARENA_MINBLOCK : shard.blockSize * 2;
+            }
+            shard.blocks.push_back(std::unique_ptr<char[]>(
+                        new char[shard.blockSize]));
+            shard.blockUsed = 0;
+            shard.arenaBytes += shard.blockSize;
+        }
+        entry = shard.blocks.back().get() + shard.blockUsed;
+        shard.blockUsed += size;
+    }
+    const uint32_t l = (uint32_t) len;
+    memcpy(entry, &l, sizeof(uint32_t));
+    memcpy(entry + sizeof(uint32_t), text, len);
+    entry[sizeof(uint32_t) + len] = '\0';
+    return entry;
+}
+
+void TermDictionary::insert(Table *table, const uint64_t pos,
+        const uint64_t h) {
+    size_t i = h & table->mask;
+    while (table->slots[i].load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) & table->mask;
+    }
+    table->slots[i].store(((pos + 1) << TERMDICT_TAG_BITS) | getTag(h),
+            std::memory_order_release);
+}
+
+void TermDictionary::grow(Shard &shard) {
+    Table *old = shard.table.load(std::memory_order_relaxed);
+    const size_t size = old == NULL ? TERMDICT_MIN_SLOTS : (old->mask + 1) * 2;
+    Table *table = new Table(size);
+    if (old != NULL) {
+        for (size_t i = 0; i <= old->mask; ++i) {
+            const uint64_t v = old->slots[i].load(std::memory_order_relaxed);
+            if (v != 0) {
+                const uint64_t pos = (v >> TERMDICT_TAG_BITS) - 1;
+                const char *entry = getEntry(pos);
+                uint32_t len;
+                memcpy(&len, entry, sizeof(uint32_t));
+                insert(table, pos, hash(entry + sizeof(uint32_t), len));
+            }
+        }
+    }
+    shard.tables.push_back(std::unique_ptr<Table>(table));
+    shard.table.store(table, std::memory_order_release);
+}
+
+Term_t TermDictionary::getOrAdd(const char *text, const size_t len) {
+    const uint64_t h = hash(text, len);
+    Shard &shard = shards[getShard(h)];
+    int64_t pos = find(shard.table.load(std::memory_order_acquire), text, len,
+            h);
+    if (pos >= 0) {
+        return first + pos;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    //Another thread might have added it in the meantime
+    Table *table = shard.table.load(std::memory_order_acquire);
+    pos = find(table, text, len, h);
+    if (pos >= 0) {
+        return first + pos;
+    }
+    if (table == NULL || (shard.count + 1) * 2 > table->mask + 1) {
+        grow(shard);
+        table = shard.table.load(std::memory_order_relaxed);
+    }
+    const char *entry = store(shard, text, len);
+    const uint64_t newPos = counter.fetch_add(1);
+    setEntry(newPos, entry);
+    insert(table, newPos, h);
+    shard.count++;
+    return first + newPos;
+}
+
+bool TermDictionary::getID(const char *text, const size_t len,
+        Term_t &id) const {
+    const uint64_t h = hash(text, len);
+    const Shard &shard = shards[getShard(h)];
+    const int64_t pos = find(shard.table.load(std::memory_order_acquire),
+            text, len, h);
+    if (pos < 0) {
+        return false;
+    }
+    id = first + pos;
+    return true;
+}
+
+const char *TermDictionary::get(const Term_t id, size_t &len) const {
+    if (id < first || id - first >= size()) {
+        return NULL;
+    }
+    const char *entry = getEntry(id - first);
+    if (entry == NULL) {
+        return NULL;
+    }
+    uint32_t l;
+    memcpy(&l, entry, sizeof(uint32_t));
+    len = l;
+    return entry + sizeof(uint32_t);
+}
+
+bool TermDictionary::getText(const Term_t id, char *text) const {
+    size_t len;
+    const char *t = get(id, len);
+    if (t == NULL) {
+        return false;
+    }
+    memcpy(text, t, len + 1);
+    return true;
+}
+
+std::string TermDictionary::getRawValue(const Term_t id) const {
+    size_t len;
+    const char *t = get(id, len);
+    if (t == NULL) {
+        return std::string("");
+    }
+    return std::string(t, len);
+}
+
+size_t TermDictionary::getMemoryBytes() const {
+    size_t bytes = 0;
+    for (int i = 0; i < TERMDICT_SHARDS; ++i) {
+        bytes += shards[i].arenaBytes;
+        for (const auto &t : shards[i].tables) {
+            bytes += (t->mask + 1) * sizeof(uint64_t);
+        }
+    }
+    for (int i = 0; i < TERMDICT_INDEX_SEGMENTS; ++i) {
+        if (index[i].load() != NULL) {
+            bytes += ((size_t) TERMDICT_INDEX_BASE << i) * sizeof(const char*);
+        }
+    }
+    return bytes;
+}
+
+std::string TermDictionary::tostring() const {
+    std::string output = "";
+    const size_t n = size();
+    for (size_t i = 0; i < n; ++i) {
+        output += getRawValue(first + i) + std::string(" ") +
+            std::to_string(first + i) + std::string(" ");
+    }
+    return output;
+}
@@ -1,11 +1,14 @@
 #include <vlog/column.h>
 #include <vlog/segment.h>
+#include <vlog/sortedints.h>
 #include <vlog/qsqquery.h>
 #include <vlog/trident/tridentiterator.h>
 #include <kognac/utils.h>
 
 #include <iostream>
 #include <inttypes.h>
+#include <list>
+#include <unordered_map>
 
 /*CompressedColumn::CompressedColumn(const CompressedColumn &o) : blocks(o.blocks), offsetsize(o.offsetsize),
   deltas(o.deltas), _size(o._size) {
@@ -134,16 +137,208 @@ std::unique_ptr<ColumnReader> CompressedColumn::getReader() const {
 }
 
 Term_t CompressedColumn::getValue(const size_t pos) const {
-    //Linear search -- inefficient. I can improve it with binary search
-    size_t p = 0;
+    if (pos >= _size) {
+        throw 10;
+    }
+    if (starts.empty()) {
+        return blocks[0].value + pos * blocks[0].delta;
+    }
+    //Last block that starts at or before pos
+    const size_t b = std::upper_bound(starts.begin(), starts.end(), pos) -
+        starts.begin() - 1;
+    return blocks[b].value + (pos - starts[b]) * blocks[b].delta;
+}
+
+static uint8_t bitsFor(uint64_t v) {
+    uint8_t bits = 0;
+    while (v != 0) {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+//Smallest value and bits of the differences from it of a block of values
+static std::pair<Term_t, uint8_t> frameOf(const Term_t *values,
+        const size_t n) {
+    Term_t min = values[0];
+    Term_t max = values[0];
+    for (size_t i = 1; i < n; ++i) {
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+    }
+    return std::make_pair(min, bitsFor((uint64_t) max - (uint64_t) min));
+}
+
+size_t PackedColumn::estimateBytes(const std::vector<Term_t> &values) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < values.size(); i += PACKEDCOLUMN_BLOCK) {
+        const size_t n = std::min((size_t) PACKEDCOLUMN_BLOCK,
+                values.size() - i);
+        const uint8_t bits = frameOf(values.data() + i, n).second;
+        bytes += sizeof(PackedColumnBlock) + PACKEDCOLUMN_BLOCK * bits / 8;
+    }
+    return bytes;
+}
+
+PackedColumn::PackedColumn(const std::vector<Term_t> &values) :
+    _size(values.size()) {
+    size_t nwords = 0;
+    for (size_t i = 0; i < _size; i += PACKEDCOLUMN_BLOCK) {
+        const size_t n = std::min((size_t) PACKEDCOLUMN_BLOCK, _size - i);
+        std::pair<Term_t, uint8_t> frame = frameOf(values.data() + i, n);
+        blocks.push_back(PackedColumnBlock(frame.first, frame.second, nwords));
+        nwords += PACKEDCOLUMN_BLOCK * frame.second / 64;
+    }
+    words.resize(nwords);
+
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const PackedColumnBlock &block = blocks[b];
+        if (block.bits == 0) {
+            continue;
+        }
+        uint64_t *w = words.data() + block.offset;
+        const size_t first = b * PACKEDCOLUMN_BLOCK;
+        const size_t n = std::min((size_t) PACKEDCOLUMN_BLOCK, _size - first);
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t v = (uint64_t) values[first + i] - block.base;
+            const size_t bitpos = i * block.bits;
+            const unsigned shift = bitpos & 63;
+            w[bitpos >> 6] |= v << shift;
+            if (shift + block.bits > 64) {
+                w[(bitpos >> 6) + 1] |= v >> (64 - shift);
+            }
+        }
+    }
+}
+
+void PackedColumn::unpack(const size_t b, const size_t start, const size_t n,
+        Term_t *out) const {
+    const PackedColumnBlock &block = blocks[b];
+    if (block.bits == 0) {
+        std::fill(out, out + n, block.base);
+        return;
+    }
+    //One shift and mask per value, without branches on the common path
+    const uint64_t *w = words.data() + block.offset;
+    const uint8_t bits = block.bits;
+    const uint64_t mask = bits == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << bits) - 1;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t bitpos = (start + i) * bits;
+        const unsigned shift = bitpos & 63;
+        uint64_t v = w[bitpos >> 6] >> shift;
+        if (shift + bits > 64) {
+            v |= w[(bitpos >> 6) + 1] << (64 - shift);
+        }
+        out[i] = block.base + (v & mask);
+    }
+}
+
+Term_t PackedColumn::getValue(const size_t pos) const {
+    Term_t v;
+    unpack(pos / PACKEDCOLUMN_BLOCK, pos % PACKEDCOLUMN_BLOCK, 1, &v);
+    return v;
+}
+
+std::unique_ptr<ColumnReader> PackedColumn::getReader() const {
+    return std::unique_ptr<ColumnReader>(new PackedColumnReader(*this));
+}
+
+std::shared_ptr<Column> PackedColumn::sort() const {
+    std::vector<Term_t> newValues = getReader()->asVector();
+    std::sort(newValues.begin(), newValues.end());
+    ColumnWriter writer(newValues);
+    return writer.getColumn();
+}
+
+std::shared_ptr<Column> PackedColumn::sort(const int nthreads) const {
+    if (nthreads <= 1) {
+        return sort();
+    }
+    std::vector<Term_t> newValues = getReader()->asVector();
+    ParallelTasks::sort_int(newValues.begin(), newValues.end());
+    ColumnWriter writer(newValues);
+    return writer.getColumn();
+}
+
+std::shared_ptr<Column> PackedColumn::unique() const {
+    //I assume the column is already sorted
+    ColumnWriter writer;
+    std::unique_ptr<ColumnReader> reader = getReader();
+    Term_t batch[PACKEDCOLUMN_BLOCK];
+    bool first = true;
+    Term_t prev = 0;
+    size_t n;
+    while ((n = reader->nextBatch(batch, PACKEDCOLUMN_BLOCK)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            if (first || batch[i] != prev) {
+                writer.add(batch[i]);
+                prev = batch[i];
+                first = false;
+            }
+        }
+    }
+    return writer.getColumn();
+}
+
+bool PackedColumn::isIn(const Term_t t) const {
+    size_t lo = 0;
+    size_t hi = _size;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const Term_t v = getValue(mid);
+        if (v == t) {
+            return true;
+        } else if (v < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+bool PackedColumn::isConstant() const {
     for (const auto &block : blocks) {
-        if (pos < p + block.size + 1) {
-            return block.value + (pos - p) * block.delta;
+        if (block.bits != 0 || block.base != blocks[0].base) {
+            return false;
         }
-        p += block.size + 1;
     }
+    return true;
+}
+
+std::vector<Term_t> PackedColumnReader::asVector() {
+    std::vector<Term_t> values(column.size());
+    for (size_t i = 0; i < values.size(); i += PACKEDCOLUMN_BLOCK) {
+        column.unpack(i / PACKEDCOLUMN_BLOCK, 0,
+                std::min((size_t) PACKEDCOLUMN_BLOCK, values.size() - i),
+                values.data() + i);
+    }
+    return values;
+}
 
-    throw 10;
+Term_t PackedColumnReader::next() {
+    const size_t b = pos / PACKEDCOLUMN_BLOCK;
+    if (b != bufferBlock) {
+        column.unpack(b, 0, std::min((size_t) PACKEDCOLUMN_BLOCK,
+                    column.size() - b * PACKEDCOLUMN_BLOCK), buffer);
+        bufferBlock = b;
+    }
+    return buffer[pos++ % PACKEDCOLUMN_BLOCK];
+}
+
+size_t PackedColumnReader::nextBatch(Term_t *out, const size_t maxRows) {
+    const size_t n = std::min(maxRows, column.size() - pos);
+    size_t copied = 0;
+    while (copied < n) {
+        const size_t b = pos / PACKEDCOLUMN_BLOCK;
+        const size_t start = pos % PACKEDCOLUMN_BLOCK;
+        const size_t len = std::min(n - copied, PACKEDCOLUMN_BLOCK - start);
+        column.unpack(b, start, len, out + copied);
+        copied += len;
+        pos += len;
+    }
+    return n;
 }
 
 bool ColumnReaderImpl::hasNext() {
@@ -169,6 +364,157 @@ Term_t ColumnReaderImpl::next() {
     }
 }
 
+ColumnChunks::ColumnChunks(const Column &column) : n(column.size()),
+    reader(column.getReader()),
+    chunks((n + COLUMNVIEW_CHUNK - 1) >> COLUMNVIEW_CHUNK_BITS), nfilled(0) {
+}
+
+void ColumnChunks::fill(const size_t chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t i = nfilled.load(std::memory_order_relaxed);
+    for (; i <= chunk; ++i) {
+        const size_t len = std::min(COLUMNVIEW_CHUNK, n - (i <<
+                    COLUMNVIEW_CHUNK_BITS));
+        chunks[i] = std::unique_ptr<Term_t[]>(new Term_t[len]);
+        size_t copied = 0;
+        while (copied < len) {
+            const size_t c = reader->nextBatch(chunks[i].get() + copied,
+                    len - copied);
+            if (c == 0) {
+                LOG(ERRORL) << "The column has less values than its size";
+                throw 10;
+            }
+            copied += c;
+        }
+        nfilled.store(i + 1, std::memory_order_release);
+    }
+    if (i == chunks.size()) {
+        reader.reset();
+    }
+}
+
+void ColumnChunks::copy(const size_t begin, const size_t len, Term_t *out) {
+    size_t pos = begin;
+    const size_t end = begin + len;
+    while (pos < end) {
+        const size_t chunk = pos >> COLUMNVIEW_CHUNK_BITS;
+        if (chunk >= nfilled.load(std::memory_order_acquire)) {
+            fill(chunk);
+        }
+        const size_t offset = pos & (COLUMNVIEW_CHUNK - 1);
+        const size_t c = std::min(COLUMNVIEW_CHUNK - offset, end - pos);
+        std::copy(chunks[chunk].get() + offset,
+                chunks[chunk].get() + offset + c, out);
+        out += c;
+        pos += c;
+    }
+}
+
+//Chunks of the columns read by more joins, the least recently used first
+struct ColumnViewCache {
+    typedef std::list<std::pair<const Column*, std::shared_ptr<ColumnChunks>>>
+        Entries;
+    Entries lru;
+    std::unordered_map<const Column*, Entries::iterator> positions;
+    //Bytes of the columns in the cache, as if all their chunks were read
+    size_t bytes;
+    std::mutex mutex;
+
+    ColumnViewCache() : bytes(0) {
+    }
+
+    void evict(Entries::iterator el) {
+        bytes -= el->second->size() * sizeof(Term_t);
+        positions.erase(el->first);
+        lru.erase(el);
+    }
+};
+
+//Never deleted, since columns can be destroyed after the static objects
+static ColumnViewCache *viewCache = new ColumnViewCache();
+
+const ColumnView *Column::getView() {
+    const Term_t *data = getData();
+    if (data != NULL || isEmpty()) {
+        return new ColumnView(data, size());
+    }
+    if (++viewRequests < 2) {
+        return new ColumnView(std::shared_ptr<ColumnChunks>(
+                    new ColumnChunks(*this)));
+    }
+
+    std::lock_guard<std::mutex> lock(viewCache->mutex);
+    auto el = viewCache->positions.find(this);
+    if (el != viewCache->positions.end()) {
+        viewCache->lru.splice(viewCache->lru.end(), viewCache->lru,
+                el->second);
+        return new ColumnView(el->second->second);
+    }
+    std::shared_ptr<ColumnChunks> chunks(new ColumnChunks(*this));
+    const size_t bytes = size() * sizeof(Term_t);
+    const size_t max = (size_t) COLUMN_VIEWCACHE_MAX_MB * 1024 * 1024;
+    if (bytes <= max) {
+        while (viewCache->bytes + bytes > max) {
+            viewCache->evict(viewCache->lru.begin());
+        }
+        viewCache->lru.push_back(std::make_pair(this, chunks));
+        viewCache->positions[this] = std::prev(viewCache->lru.end());
+        viewCache->bytes += bytes;
+    }
+    return new ColumnView(chunks);
+}
+
+size_t Column::getCachedViewBytes() {
+    std::lock_guard<std::mutex> lock(viewCache->mutex);
+    size_t bytes = 0;
+    for (const auto &el : viewCache->lru) {
+        bytes += el.second->getMemoryBytes();
+    }
+    return bytes;
+}
+
+size_t Column::evictViews(const size_t bytes) {
+    std::lock_guard<std::mutex> lock(viewCache->mutex);
+    size_t freed = 0;
+    while (freed < bytes && !viewCache->lru.empty()) {
+        //The chunks are freed when the joins that read them finish
+        freed += viewCache->lru.front().second->getMemoryBytes();
+        viewCache->evict(viewCache->lru.begin());
+    }
+    return freed;
+}
+
+Column::~Column() {
+    if (viewRequests > 1) {
+        std::lock_guard<std::mutex> lock(viewCache->mutex);
+        auto el = viewCache->positions.find(this);
+        if (el != viewCache->positions.end()) {
+            viewCache->evict(el->second);
+        }
+    }
+}
+
+size_t ColumnReaderImpl::nextBatch(Term_t *out, const size_t maxRows) {
+    size_t n = 0;
+    while (n < maxRows && !blocks.empty()) {
+        const CompressedColumnBlock &block = blocks[currentBlock];
+        if (posInBlock == block.size + 1) {
+            if (currentBlock == blocks.size() - 1) {
+                break;
+            }
+            currentBlock++;
+            posInBlock = 0;
+            continue;
+        }
+        //Decode the rest of the block in one go
+        const size_t len = std::min(block.size + 1 - posInBlock, maxRows - n);
+        for (size_t i = 0; i < len; ++i) {
+            out[n++] = block.value + block.delta * posInBlock++;
+        }
+    }
+    return n;
+}
+
 /*Term_t ColumnReaderImpl::get(const size_t pos) {
 
   if (pos >= beginRange && pos < endRange) {
@@ -531,6 +877,18 @@ void ColumnWriter::concatenate(Column * c) {
     }
 }
 
+#ifdef USE_COMPRESSED_COLUMNS
+//Bit-pack large columns that are not arithmetic runs, if it pays off
+static std::shared_ptr<Column> pack(std::vector<Term_t> &values) {
+    if (values.size() >= PACKEDCOLUMN_MIN_ROWS &&
+            PackedColumn::estimateBytes(values) * 2 <=
+            values.size() * sizeof(Term_t)) {
+        return std::shared_ptr<Column>(new PackedColumn(values));
+    }
+    return std::shared_ptr<Column>(new InmemoryColumn(values, true));
+}
+#endif
+
 std::shared_ptr<Column> ColumnWriter::getColumn() {
     if (cached) {
         //The column was already being requested
@@ -548,10 +906,10 @@ std::shared_ptr<Column> ColumnWriter::getColumn() {
         } else {
             CompressedColumn col(blocks, /*offsetsize, deltas,*/ _size);
             std::vector<Term_t> values = col.getReader()->asVector();
-            cachedColumn = std::shared_ptr<Column>(new InmemoryColumn(values, true));
+            cachedColumn = pack(values);
         }
     } else {
-        cachedColumn = std::shared_ptr<Column>(new InmemoryColumn(values, true));
+        cachedColumn = pack(values);
     }
 #else
     cachedColumn = std::shared_ptr<Column>(new InmemoryColumn(values, true));
@@ -621,8 +979,38 @@ std::shared_ptr<Column> ColumnWriter::getColumn(std::vector<Term_t> &values, boo
 #endif
 }
 
+//Pointer to the values of the column. EDB columns are not copied (they are
+//better scanned lazily); the other columns are decoded in 'tmp' if they are
+//not backed by a vector
+static const Term_t *getSortedValues(std::shared_ptr<Column> c,
+        std::vector<Term_t> &tmp, size_t &n) {
+    if (c->isBackedByVector()) {
+        const std::vector<Term_t> &values = c->getVectorRef();
+        n = values.size();
+        return values.data();
+    }
+    if (c->isEDB()) {
+        return NULL;
+    }
+    tmp = c->getReader()->asVector();
+    n = tmp.size();
+    return tmp.data();
+}
+
 void Column::intersection(std::shared_ptr<Column> c1,
         std::shared_ptr<Column> c2, ColumnWriter &writer) {
+    if (c1->isEmpty() || c2->isEmpty()) {
+        return;
+    }
+    std::vector<Term_t> tmp1, tmp2;
+    size_t n1, n2;
+    const Term_t *vals1 = getSortedValues(c1, tmp1, n1);
+    const Term_t *vals2 = vals1 != NULL ? getSortedValues(c2, tmp2, n2) : NULL;
+    if (vals1 != NULL && vals2 != NULL) {
+        SortedInts::intersection(vals1, n1, vals2, n2, writer);
+        return;
+    }
+
     std::unique_ptr<ColumnReader> r1 = c1->getReader();
     std::unique_ptr<ColumnReader> r2 = c2->getReader();
     Term_t v1, v2;
@@ -635,44 +1023,29 @@ void Column::intersection(std::shared_ptr<Column> c1,
     }
     v2 = r2->next();
 
-    // long count1 = ok1 ? 1 : 0;
-    // long count2 = ok2 ? 1 : 0;
-    // long countout = 0;
-
-    //std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-
-
     for (;;) {
         if (v1 < v2) {
             if (! r1->hasNext()) {
                 return;
             }
             v1 = r1->next();
-            // count1++;
         } else if (v1 > v2) {
             if (! r2->hasNext()) {
                 return;
             }
             v2 = r2->next();
-            // count2++;
         } else {
             writer.add(v1);
-            // countout++;
             if (! r1->hasNext()) {
                 return;
             }
             v1 = r1->next();
-            // count1++;
             if (! r2->hasNext()) {
                 return;
             }
             v2 = r2->next();
-            // count2++;
         }
     }
-    //std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
-    //LOG(INFOL) << "Count1=" << count1 << " Count2=" << count2 <<
-    //                        " countout=" << countout << " " << sec.count() * 1000;
 }
 
 // The parallel version may very well be slower than the sequential one, because the parallel
@@ -685,43 +1058,29 @@ void Column::intersection(std::shared_ptr<Column> c1,
     std::vector<std::shared_ptr<Column>> cols;
     cols.push_back(c1);
     cols.push_back(c2);
-    const std::vector<const std::vector<Term_t> *> vectors = Segment::getAllVectors(cols);
-    size_t c1Size = vectors[0]->size();
-    size_t c2Size = vectors[1]->size();
+    const std::vector<const ColumnView *> vectors = Segment::getAllVectors(cols);
 
     // TODO: parallelize this!
-    Term_t v1, v2;
-    size_t i1 = 1, i2 = 1;
-    v1 = (*vectors[0])[0];
-    v2 = (*vectors[1])[0];
-    for (;;) {
-        if (v1 < v2) {
-            if (i1 >= c1Size) {
-                return;
-            }
-            v1 = (*vectors[0])[i1++];
-        } else if (v1 > v2) {
-            if (i2 >= c2Size) {
-                return;
-            }
-            v2 = (*vectors[1])[i2++];
-        } else {
-            writer.add(v1);
-            if (i1 >= c1Size) {
-                return;
-            }
-            v1 = (*vectors[0])[i1++];
-            if (i2 >= c2Size) {
-                return;
-            }
-            v2 = (*vectors[1])[i2++];
-        }
-    }
+    std::vector<Term_t> buffer1, buffer2;
+    SortedInts::intersection(vectors[0]->contiguous(buffer1),
+            vectors[0]->size(), vectors[1]->contiguous(buffer2),
+            vectors[1]->size(), writer);
+    Segment::deleteAllVectors(cols, vectors);
 }
 
 uint64_t Column::countMatches(
         std::shared_ptr<Column> c1,
         std::shared_ptr<Column> c2) {
+    if (c1->isEmpty() || c2->isEmpty()) {
+        return 0;
+    }
+    std::vector<Term_t> tmp1, tmp2;
+    size_t n1, n2;
+    const Term_t *vals1 = getSortedValues(c1, tmp1, n1);
+    const Term_t *vals2 = vals1 != NULL ? getSortedValues(c2, tmp2, n2) : NULL;
+    if (vals1 != NULL && vals2 != NULL) {
+        return SortedInts::countMatches(vals1, n1, vals2, n2);
+    }
 
     std::unique_ptr<ColumnReader> r1 = c1->getReader();
     std::unique_ptr<ColumnReader> r2 = c2->getReader();
@@ -735,8 +1094,6 @@ uint64_t Column::countMatches(
 
     long countout = 0;
 
-    //std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-
     while (ok1 && ok2) {
         if (v1 < v2) {
             ok1 = r1->hasNext();
@@ -753,7 +1110,6 @@ uint64_t Column::countMatches(
             }
         }
     }
-    //std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     return countout;
 }
 
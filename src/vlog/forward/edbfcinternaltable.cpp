@@ -189,6 +189,11 @@ inline void EDBFCInternalTableItr::next() {
     compiled = false;
 }
 
+size_t EDBFCInternalTableItr::nextBatch(Term_t **out, const size_t maxRows) {
+    compiled = false;
+    return edbItr->nextBatch(out, nfields, posFields, maxRows);
+}
+
 uint8_t EDBFCInternalTableItr::getNColumns() const {
     return nfields;
 }
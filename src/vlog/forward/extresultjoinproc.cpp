@@ -340,8 +340,8 @@ void ExistentialRuleProcessor::addColumns(const int blockid,
 }
 
 void ExistentialRuleProcessor::processResults(const int blockid,
-        const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-        const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+        const std::vector<const ColumnView *> &vectors1, size_t i1,
+        const std::vector<const ColumnView *> &vectors2, size_t i2,
         const bool unique) {
     for (int i = 0; i < nCopyFromFirst; i++) {
         row[posFromFirst[i].first] = (*vectors1[posFromFirst[i].second])[i1];
@@ -460,7 +460,7 @@ std::shared_ptr<const Segment> InmemoryFCInternalTable::filter_row(std::shared_p
         size_t chunk = (sz + nthreads - 1) / nthreads;
 
         if (sz > 4096) {
-            std::vector<const std::vector<Term_t> *> vectors = seg->getAllVectors(nthreads);
+            std::vector<const ColumnView *> vectors = seg->getAllVectors(nthreads);
             std::vector<VectorSegmentIterator *> iterators;
             std::vector<std::shared_ptr<const Segment>> segments(nthreads);
             size_t index = 0;
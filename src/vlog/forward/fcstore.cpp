@@ -0,0 +1,303 @@
+#include <vlog/fcstore.h>
+#include <vlog/fcinttable.h>
+#include <vlog/segment.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MmapFile::MmapFile(const std::string &path) : data(NULL), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        LOG(ERRORL) << "Cannot open the file " << path;
+        throw 10;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        LOG(ERRORL) << "Cannot stat the file " << path;
+        throw 10;
+    }
+    length = st.st_size;
+    if (length > 0) {
+        void *addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            LOG(ERRORL) << "Cannot map the file " << path;
+            throw 10;
+        }
+        data = (char*) addr;
+    }
+    //The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MmapFile::~MmapFile() {
+    if (data != NULL) {
+        munmap(data, length);
+    }
+}
+
+std::shared_ptr<Column> MmapColumn::sort() const {
+    std::vector<Term_t> newvals = copy();
+    std::sort(newvals.begin(), newvals.end());
+    return std::shared_ptr<Column>(new InmemoryColumn(newvals, true));
+}
+
+std::shared_ptr<Column> MmapColumn::sort(const int nthreads) const {
+    if (nthreads <= 1) {
+        return sort();
+    }
+    std::vector<Term_t> newvals = copy();
+    ParallelTasks::sort_int(newvals.begin(), newvals.end());
+    return std::shared_ptr<Column>(new InmemoryColumn(newvals, true));
+}
+
+std::shared_ptr<Column> MmapColumn::unique() const {
+    //I assume the column is already sorted
+    std::vector<Term_t> newvals;
+    newvals.reserve(len);
+    for (size_t i = 0; i < len; ++i) {
+        if (i == 0 || values[i] != values[i - 1]) {
+            newvals.push_back(values[i]);
+        }
+    }
+    newvals.shrink_to_fit();
+    return std::shared_ptr<Column>(new InmemoryColumn(newvals, true));
+}
+
+static void writeField(std::ofstream &out, const uint64_t v) {
+    out.write((const char*) &v, sizeof(uint64_t));
+}
+
+static uint64_t readField(const char *data, size_t &pos, const size_t len) {
+    if (pos + sizeof(uint64_t) > len) {
+        LOG(ERRORL) << "Snapshot file is truncated";
+        throw 10;
+    }
+    uint64_t v;
+    memcpy(&v, data + pos, sizeof(uint64_t));
+    pos += sizeof(uint64_t);
+    return v;
+}
+
+void FCStore::writeTable(const std::string &path, FCTable *table) {
+    const uint8_t sizeRow = table->getSizeRow();
+
+    //Collect the blocks. Every block is stored as a single sorted segment,
+    //so that it can be reopened as a sorted InmemoryFCInternalTable
+    std::vector<const FCBlock*> blocks;
+    std::vector<std::vector<std::shared_ptr<Column>>> columns;
+    FCIterator itr = table->read(0);
+    while (!itr.isEmpty()) {
+        const FCBlock *block = itr.getCurrentBlock();
+        if (!block->table->isEmpty()) {
+            FCInternalTableItr *iitr = block->table->getSortedIterator();
+            blocks.push_back(block);
+            columns.push_back(iitr->getAllColumns());
+            block->table->releaseIterator(iitr);
+        }
+        itr.moveNextCount();
+    }
+
+    std::ofstream out(path, std::ios_base::binary);
+    if (!out.good()) {
+        LOG(ERRORL) << "Cannot write the file " << path;
+        throw 10;
+    }
+    writeField(out, FCSTORE_MAGIC);
+    writeField(out, FCSTORE_VERSION);
+    writeField(out, sizeof(Term_t));
+    writeField(out, sizeRow);
+    writeField(out, blocks.size());
+
+    //Directory
+    const uint64_t sizeBlockHeader = 5 + 2 * sizeRow + 2 * sizeRow;
+    uint64_t offset = (5 + blocks.size() * sizeBlockHeader) * sizeof(uint64_t);
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const FCBlock *block = blocks[b];
+        const uint64_t nrows = columns[b][0]->size();
+        writeField(out, block->iteration);
+        writeField(out, nrows);
+        writeField(out, block->posQueryInRule);
+        writeField(out, block->ruleExecOrder);
+        writeField(out, block->isCompleted);
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            VTerm t = block->query.getTermAtPos(i);
+            writeField(out, t.getId());
+            writeField(out, t.getValue());
+        }
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            writeField(out, columns[b][i]->isConstant());
+            writeField(out, offset);
+            offset += nrows * sizeof(Term_t);
+        }
+    }
+
+    //Data
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            std::unique_ptr<ColumnReader> reader = columns[b][i]->getReader();
+            while (reader->hasNext()) {
+                const Term_t v = reader->next();
+                out.write((const char*) &v, sizeof(Term_t));
+            }
+            reader->clear();
+        }
+    }
+    out.close();
+}
+
+void FCStore::store(const std::string &path, Program *program,
+        FCTable **tables) {
+    Utils::create_directories(path);
+    for (PredId_t i = 0; i < MAX_NPREDS; ++i) {
+        FCTable *table = tables[i];
+        if (table != NULL && !table->isEmpty() &&
+                program->isPredicateIDB(i)) {
+            if (table->getSizeRow() == 0) {
+                LOG(WARNL) << "Skipping the predicate " <<
+                    program->getPredicateName(i) << " (no columns)";
+                continue;
+            }
+            writeTable(path + "/" + program->getPredicateName(i) +
+                    FCSTORE_EXT, table);
+        }
+    }
+}
+
+std::vector<FCBlock> FCStore::load(const std::string &path,
+        const Predicate &pred) {
+    std::shared_ptr<const MmapFile> file(new MmapFile(path));
+    const char *data = file->getData();
+    const size_t len = file->getLength();
+    size_t pos = 0;
+
+    if (readField(data, pos, len) != FCSTORE_MAGIC ||
+            readField(data, pos, len) != FCSTORE_VERSION) {
+        LOG(ERRORL) << "The file " << path << " is not a valid snapshot";
+        throw 10;
+    }
+    if (readField(data, pos, len) != sizeof(Term_t)) {
+        LOG(ERRORL) << "The file " << path <<
+            " was written with a different term size";
+        throw 10;
+    }
+    const uint8_t sizeRow = (uint8_t) readField(data, pos, len);
+    if (sizeRow != pred.getCardinality()) {
+        LOG(ERRORL) << "The file " << path << " has " << (int) sizeRow <<
+            " columns, but the predicate has cardinality " <<
+            (int) pred.getCardinality();
+        throw 10;
+    }
+    const uint64_t nblocks = readField(data, pos, len);
+
+    std::vector<FCBlock> blocks;
+    for (uint64_t b = 0; b < nblocks; ++b) {
+        const size_t iteration = readField(data, pos, len);
+        const uint64_t nrows = readField(data, pos, len);
+        const uint8_t posQueryInRule = (uint8_t) readField(data, pos, len);
+        const uint8_t ruleExecOrder = (uint8_t) readField(data, pos, len);
+        const bool isCompleted = readField(data, pos, len) != 0;
+
+        VTuple tuple(sizeRow);
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            const uint8_t id = (uint8_t) readField(data, pos, len);
+            const uint64_t value = readField(data, pos, len);
+            tuple.set(VTerm(id, value), i);
+        }
+
+        std::vector<std::shared_ptr<Column>> columns;
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            const bool constant = readField(data, pos, len) != 0;
+            const uint64_t offset = readField(data, pos, len);
+            if (offset + nrows * sizeof(Term_t) > len) {
+                LOG(ERRORL) << "Snapshot file " << path << " is truncated";
+                throw 10;
+            }
+            columns.push_back(std::shared_ptr<Column>(new MmapColumn(file,
+                            (const Term_t*) (data + offset), nrows,
+                            constant)));
+        }
+
+        std::shared_ptr<const Segment> seg(new Segment(sizeRow, columns));
+        std::shared_ptr<const FCInternalTable> table(
+                new InmemoryFCInternalTable(sizeRow, iteration, true, seg));
+        blocks.push_back(FCBlock(iteration, table, Literal(pred, tuple),
+                    posQueryInRule, NULL, ruleExecOrder, isCompleted));
+    }
+    return blocks;
+}
+
+bool FCStore::isWorthSpilling(const Column &column) {
+    return column.getMemoryBytes() * FCSTORE_SPILL_MINRATIO >
+        column.size() * sizeof(Term_t);
+}
+
+std::shared_ptr<const FCInternalTable> FCStore::spill(const std::string &dir,
+        std::shared_ptr<const FCInternalTable> table,
+        const size_t iteration) {
+    static std::atomic<size_t> counter(0);
+    const uint8_t sizeRow = table->getRowSize();
+    FCInternalTableItr *itr = table->getSortedIterator();
+    std::vector<std::shared_ptr<Column>> columns = itr->getAllColumns();
+    table->releaseIterator(itr);
+    const size_t nrows = columns[0]->size();
+    std::vector<bool> spilled(sizeRow);
+    bool any = false;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        spilled[i] = isWorthSpilling(*columns[i]);
+        any |= spilled[i];
+    }
+    if (!any) {
+        return table;
+    }
+
+    const std::string path = dir + "/" + std::to_string(counter++) +
+        FCSTORE_SPILL_EXT;
+    std::ofstream out(path, std::ios_base::binary);
+    if (!out.good()) {
+        LOG(ERRORL) << "Cannot write the file " << path;
+        throw 10;
+    }
+    std::unique_ptr<Term_t[]> buffer(new Term_t[BATCH_ROWS]);
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        if (!spilled[i]) {
+            continue;
+        }
+        std::unique_ptr<ColumnReader> reader = columns[i]->getReader();
+        size_t n;
+        while ((n = reader->nextBatch(buffer.get(), BATCH_ROWS)) > 0) {
+            out.write((const char*) buffer.get(), n * sizeof(Term_t));
+        }
+        reader->clear();
+    }
+    out.close();
+    if (!out.good()) {
+        LOG(ERRORL) << "Cannot write the file " << path;
+        throw 10;
+    }
+
+    std::shared_ptr<const MmapFile> file(new MmapFile(path));
+    unlink(path.c_str());
+    const Term_t *data = (const Term_t*) file->getData();
+    std::vector<std::shared_ptr<Column>> newColumns;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        if (spilled[i]) {
+            newColumns.push_back(std::shared_ptr<Column>(new MmapColumn(file,
+                            data, nrows, columns[i]->isConstant())));
+            data += nrows;
+        } else {
+            newColumns.push_back(columns[i]);
+        }
+    }
+    std::shared_ptr<const Segment> seg(new Segment(sizeRow, newColumns));
+    return std::shared_ptr<const FCInternalTable>(
+            new InmemoryFCInternalTable(sizeRow, iteration, true, seg));
+}
@@ -2,14 +2,141 @@
 #include <vlog/fctable.h>
 #include <vlog/joinprocessor.h>
 #include <vlog/concepts.h>
+#include <vlog/fcstore.h>
 
 #include <trident/model/table.h>
 
+#include <algorithm>
+
 // Note: When running multithreaded, mutex != NULL.
 
+void FCZoneMap::addToBloom(const uint8_t col, const Term_t v) {
+    size_t b1, b2;
+    bloomBits(v, b1, b2);
+    uint64_t *words = &bloom[col * FCZONEMAP_BLOOM_WORDS];
+    words[b1 / 64] |= 1ull << (b1 % 64);
+    words[b2 / 64] |= 1ull << (b2 % 64);
+}
+
+bool FCZoneMap::bloomContains(const uint8_t col, const Term_t v) const {
+    size_t b1, b2;
+    bloomBits(v, b1, b2);
+    const uint64_t *words = &bloom[col * FCZONEMAP_BLOOM_WORDS];
+    return (words[b1 / 64] & (1ull << (b1 % 64))) &&
+        (words[b2 / 64] & (1ull << (b2 % 64)));
+}
+
+std::shared_ptr<const FCZoneMap> FCZoneMap::create(
+        std::shared_ptr<const FCInternalTable> table) {
+    if (table->isEDB() || table->isEmpty()) {
+        return std::shared_ptr<const FCZoneMap>();
+    }
+    const uint8_t ncols = table->getRowSize();
+    std::shared_ptr<FCZoneMap> z(new FCZoneMap(ncols));
+    const bool withBloom = table->getNRows() <= FCZONEMAP_BLOOM_MAXROWS;
+    if (withBloom) {
+        z->bloom.resize(ncols * FCZONEMAP_BLOOM_WORDS, 0);
+    }
+    for (uint8_t i = 0; i < ncols; ++i) {
+        if (table->isColumnConstant(i)) {
+            const Term_t v = table->getValueConstantColumn(i);
+            z->min[i] = z->max[i] = v;
+            z->sketches[i].add(v);
+            if (withBloom) {
+                z->addToBloom(i, v);
+            }
+            continue;
+        }
+        std::shared_ptr<Column> column = table->getColumn(i);
+        if (column->isEDB()) {
+            return std::shared_ptr<const FCZoneMap>();
+        }
+        Term_t mn = (Term_t) -1, mx = 0;
+        std::unique_ptr<ColumnReader> reader = column->getReader();
+        while (reader->hasNext()) {
+            const Term_t v = reader->next();
+            mn = std::min(mn, v);
+            mx = std::max(mx, v);
+            z->sketches[i].add(v);
+            if (withBloom) {
+                z->addToBloom(i, v);
+            }
+        }
+        z->min[i] = mn;
+        z->max[i] = mx;
+    }
+    return z;
+}
+
+std::shared_ptr<const FCZoneMap> FCZoneMap::merge(
+        std::shared_ptr<const FCZoneMap> z1,
+        std::shared_ptr<const FCZoneMap> z2) {
+    if (z1 == NULL || z2 == NULL) {
+        return std::shared_ptr<const FCZoneMap>();
+    }
+    std::shared_ptr<FCZoneMap> z(new FCZoneMap(z1->ncols));
+    for (uint8_t i = 0; i < z1->ncols; ++i) {
+        z->min[i] = std::min(z1->min[i], z2->min[i]);
+        z->max[i] = std::max(z1->max[i], z2->max[i]);
+        z->sketches[i] = z1->sketches[i];
+        z->sketches[i].merge(z2->sketches[i]);
+    }
+    if (!z1->bloom.empty() && !z2->bloom.empty()) {
+        z->bloom = z1->bloom;
+        for (size_t i = 0; i < z->bloom.size(); ++i) {
+            z->bloom[i] |= z2->bloom[i];
+        }
+    }
+    return z;
+}
+
+bool FCZoneMap::mayContain(const uint8_t nconstants, const uint8_t *posConstants,
+        const Term_t *valueConstants) const {
+    for (uint8_t i = 0; i < nconstants; ++i) {
+        const uint8_t pos = posConstants[i];
+        const Term_t v = valueConstants[i];
+        if (v < min[pos] || v > max[pos]) {
+            return false;
+        }
+        if (!bloom.empty() && !bloomContains(pos, v)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::atomic<size_t> FCTable::readClock(0);
+
 FCTable::FCTable(std::mutex *mutex, const uint8_t sizeRow) :
-    sizeRow(sizeRow), mutex(mutex) {
+    sizeRow(sizeRow), mutex(mutex), rowIndexDisabled(false), lastRead(0),
+    memoryBytes(0), uncompressedBytes(0) {
+    }
+
+void FCTable::countMemory(std::shared_ptr<const FCInternalTable> table,
+        const bool add) {
+    if (table == NULL || table->isEDB() || table->isEmpty()) {
+        return;
+    }
+    size_t bytes = 0;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        bytes += table->getColumn(i)->getMemoryBytes();
     }
+    const size_t uncompressed = table->getNRows() * sizeRow * sizeof(Term_t);
+    if (add) {
+        memoryBytes += bytes;
+        uncompressedBytes += uncompressed;
+    } else {
+        memoryBytes -= std::min(bytes, memoryBytes);
+        uncompressedBytes -= std::min(uncompressed, uncompressedBytes);
+    }
+}
+
+void FCTable::recountMemory() {
+    memoryBytes = uncompressedBytes = 0;
+    for (const auto &block : blocks) {
+        countMemory(block.table, true);
+    }
+}
 
 std::string FCTable::getSignature(const Literal &literal) {
     std::string out = "";
@@ -34,6 +161,7 @@ std::string FCTable::getSignature(const Literal &literal) {
 
 FCIterator FCTable::read(const size_t iteration) const {
     FCIterator i;
+    touch();
 
     std::vector<FCBlock>::const_iterator itr = blocks.begin();
     while (itr != blocks.end() && itr->iteration < iteration) {
@@ -50,11 +178,12 @@ FCIterator FCTable::read(const size_t iteration) const {
 
 FCIterator FCTable::read(const size_t mincount, const size_t maxcount) const {
     FCIterator i;
+    touch();
     std::vector<FCBlock>::const_iterator itr = blocks.begin();
     while (itr != blocks.end() && itr->iteration < mincount) {
         itr++;
     }
-    if (itr != blocks.end()) {
+    if (itr != blocks.end() && itr->iteration <= maxcount) {
         std::vector<FCBlock>::const_iterator endrange = itr + 1;
         while (endrange != blocks.end() && endrange->iteration <= maxcount) {
             endrange++;
@@ -85,16 +214,54 @@ size_t FCTable::estimateCardinality(const Literal &literal, const size_t min, co
     }
     size_t estimation = 0;
     while (!itr.isEmpty()) {
-        estimation += itr.getCurrentTable()->estimateNRows(
-                nconstants, posConstants,
-                valueConstants);
+        const FCBlock *block = itr.getCurrentBlock();
+        if (block->zonemap == NULL) {
+            estimation += block->table->estimateNRows(
+                    nconstants, posConstants,
+                    valueConstants);
+        } else if (block->zonemap->mayContain(nconstants, posConstants,
+                    valueConstants)) {
+            //Assume the values are uniformly distributed
+            double rows = block->table->getNRows();
+            for (uint8_t i = 0; i < nconstants; ++i) {
+                rows /= std::max(1.0, block->zonemap->getSketch(
+                            posConstants[i]).estimate());
+            }
+            estimation += std::max<size_t>(1, (size_t) rows);
+        }
         itr.moveNextCount();
     }
     return estimation;
 }
 
+size_t FCTable::estimateDistinct(const uint8_t pos, const size_t min,
+        const size_t max) const {
+    FCIterator itr = read(min, max);
+    HyperLogLog sketch;
+    bool sketched = false;
+    size_t rows = 0, unsketchedRows = 0;
+    while (!itr.isEmpty()) {
+        const FCBlock *block = itr.getCurrentBlock();
+        const size_t n = block->table->getNRows();
+        if (block->zonemap != NULL) {
+            sketch.merge(block->zonemap->getSketch(pos));
+            sketched = true;
+        } else {
+            unsketchedRows += n;
+        }
+        rows += n;
+        itr.moveNextCount();
+    }
+    size_t estimation = unsketchedRows;
+    if (sketched) {
+        estimation += (size_t) (sketch.estimate() + 0.5);
+    }
+    return std::min(estimation, rows);
+}
+
 std::shared_ptr<const FCTable> FCTable::filter(const Literal &literal,
         const size_t minIteration, TableFilterer *filterer, int nthreads) {
+    touch();
     bool shouldFilter = literal.getNUniqueVars() < literal.getTupleSize();
 
     if (shouldFilter) {
@@ -175,6 +342,16 @@ std::shared_ptr<const FCTable> FCTable::filter(const Literal &literal,
             bool shouldFilter = filterer == NULL ||
                 TableFilterer::intersection(literal, *itr);
 #endif
+            if (shouldFilter && itr->zonemap != NULL) {
+                //Skip the blocks that cannot contain the constants or the
+                //repeated variables
+                shouldFilter = itr->zonemap->mayContain(nConstantsToFilter,
+                        posConstantsToFilter, valuesConstantsToFilter);
+                for (uint8_t i = 0; i < nRepeatedVars && shouldFilter; ++i) {
+                    shouldFilter = itr->zonemap->mayOverlap(
+                            repeatedVars[i].first, repeatedVars[i].second);
+                }
+            }
             if (shouldFilter) {
                 //Extract only relevant facts with a linear scan
                 std::shared_ptr<const FCInternalTable> filteredTable =
@@ -258,6 +435,37 @@ std::shared_ptr<const Segment> FCTable::retainFrom(
             ++itr) {
         sz += itr->table->getNRows();
     }
+
+    //With a hash index the cost depends only on the new rows. Building it
+    //costs a scan of the table, so we do it only when the new rows are few
+    //compared to the existing ones. Once built, it is always used
+    if (rowIndex == NULL && !rowIndexDisabled &&
+            sizeRow >= FCTABLE_HASHRETAIN_MINARITY &&
+            sz >= FCTABLE_HASHRETAIN_MINROWS &&
+            t->getNRows() * FCTABLE_HASHRETAIN_RATIO <= sz) {
+        LOG(DEBUGL) << "Building the hash index of a table with " << sz <<
+            " rows";
+        rowIndex = std::unique_ptr<RowIndex>(new RowIndex(sizeRow));
+        for (const auto &block : blocks) {
+            if (RowIndex::canIndex(block.table)) {
+                rowIndex->insert(block.table);
+            }
+        }
+    }
+    if (rowIndex != NULL) {
+        t = rowIndex->retain(t, dupl);
+        //The blocks without direct access (views on the EDB layer, blocks
+        //with unmerged segments) are not in the index
+        for (const auto &block : blocks) {
+            if (!rowIndex->contains(block.table)) {
+                t = SegmentInserter::retain(t, block.table, false, nthreads);
+            }
+        }
+        std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+        LOG(TRACEL) << "Time retainFrom (hash) = " << sec.count() * 1000;
+        return t;
+    }
+
     //    LOG(TRACEL) << "retainFrom: t.size() = " << t->getNRows() << ", blocks.size() = " << blocks.size() << ", sz = " << sz;
     for (std::vector<FCBlock>::const_iterator itr = blocks.cbegin();
             itr != blocks.cend();
@@ -310,7 +518,15 @@ bool FCTable::add(std::shared_ptr<const FCInternalTable> t,
 
         if (lastItr == iteration) {
             FCBlock *lastBlock = &blocks[sz - 1];
+            std::shared_ptr<const FCInternalTable> old = lastBlock->table;
             lastBlock->table = lastBlock->table->merge(t, nthreads);
+            countMemory(old, false);
+            countMemory(lastBlock->table, true);
+            lastBlock->zonemap = FCZoneMap::merge(lastBlock->zonemap,
+                    FCZoneMap::create(t));
+            if (rowIndex != NULL) {
+                indexBlock(old, lastBlock->table);
+            }
 
             //Invalidate possible subtables which contain partial results
             for (FCCache::iterator itr = cache.begin(); itr != cache.end(); ++itr) {
@@ -330,18 +546,230 @@ bool FCTable::add(std::shared_ptr<const FCInternalTable> t,
 
     FCBlock block(iteration, t, literal, posLiteralInRule,
             rule, ruleExecOrder, isCompleted);
+    block.zonemap = FCZoneMap::create(t);
     blocks.push_back(block);
+    countMemory(t, true);
+    if (rowIndex != NULL) {
+        indexBlock(std::shared_ptr<const FCInternalTable>(), t);
+    }
     return true;
 }
 
 void FCTable::addBlock(FCBlock block) {
     assert(blocks.size() == 0 || blocks.back().iteration < block.iteration);
     blocks.push_back(block);
+    countMemory(block.table, true);
+    if (rowIndex != NULL) {
+        indexBlock(std::shared_ptr<const FCInternalTable>(), block.table);
+    }
+}
+
+void FCTable::indexBlock(std::shared_ptr<const FCInternalTable> oldTable,
+        std::shared_ptr<const FCInternalTable> newTable) {
+    //The old rows go first: a row already in the index keeps its entry
+    if (oldTable != NULL) {
+        rowIndex->remove(oldTable);
+    }
+    if (newTable != NULL && RowIndex::canIndex(newTable)) {
+        rowIndex->insert(newTable);
+    }
+}
+
+size_t FCTable::removeRows(std::shared_ptr<const FCInternalTable> rows,
+        int nthreads) {
+    size_t removed = 0;
+    std::vector<FCBlock> newBlocks;
+    for (const auto &block : blocks) {
+        //Copy the block in a sorted segment (it might be an EDB view)
+        SegmentInserter inserter(sizeRow);
+        FCInternalTableItr *itr = block.table->getSortedIterator(nthreads);
+        ColumnBatch batch(sizeRow);
+        size_t n;
+        while ((n = itr->nextBatch(batch.columns, BATCH_ROWS)) > 0) {
+            inserter.addRows(batch.columns, n);
+        }
+        block.table->releaseIterator(itr);
+        std::shared_ptr<const Segment> seg = inserter.getSegment();
+        const size_t nrows = seg->getNRows();
+
+        seg = SegmentInserter::retain(seg, rows, false, nthreads);
+        removed += nrows - seg->getNRows();
+        if (seg->getNRows() == nrows) {
+            newBlocks.push_back(block);
+        } else if (!seg->isEmpty()) {
+            std::shared_ptr<const FCInternalTable> table(
+                    new InmemoryFCInternalTable(sizeRow, block.iteration,
+                        true, seg));
+            newBlocks.push_back(FCBlock(block.iteration, table, block.query,
+                        block.posQueryInRule, block.rule, block.ruleExecOrder,
+                        block.isCompleted));
+            newBlocks.back().zonemap = FCZoneMap::create(table);
+        }
+    }
+    blocks.swap(newBlocks);
+    cache.clear();
+    rowIndex.reset();
+    recountMemory();
+    return removed;
+}
+
+size_t FCTable::retainBlocksFrom(
+        const std::vector<const RuleExecutionDetails*> &rules) {
+    size_t removed = 0;
+    std::vector<FCBlock> newBlocks;
+    for (const auto &block : blocks) {
+        if (block.rule != NULL && std::find(rules.begin(), rules.end(),
+                    block.rule) != rules.end()) {
+            newBlocks.push_back(block);
+        } else {
+            removed += block.table->getNRows();
+        }
+    }
+    blocks.swap(newBlocks);
+    cache.clear();
+    rowIndex.reset();
+    recountMemory();
+    return removed;
+}
+
+bool FCTable::canBeCompacted(const FCBlock &block, const size_t maxIteration) {
+    return block.iteration < maxIteration && block.isIDBBacked() &&
+        block.table->getNRows() < FCTABLE_COMPACT_MAXROWS;
+}
+
+static std::shared_ptr<const FCInternalTable> mergeSegments(
+        std::vector<std::shared_ptr<const Segment>> segments,
+        const uint8_t sizeRow, const size_t iteration) {
+    std::shared_ptr<const Segment> seg = SegmentInserter::concatenate(segments);
+    seg = SegmentInserter::unique(seg->sortBy(NULL));
+    return std::shared_ptr<const FCInternalTable>(
+            new InmemoryFCInternalTable(sizeRow, iteration, true, seg));
+}
+
+void FCTable::startCompaction(const size_t begin, const size_t end) {
+    compaction = std::unique_ptr<FCCompaction>(new FCCompaction());
+    std::vector<std::shared_ptr<const Segment>> segments;
+    for (size_t i = begin; i < end; ++i) {
+        std::shared_ptr<const FCInternalTable> table = blocks[i].table;
+        compaction->sources.push_back(table);
+        FCInternalTableItr *itr = table->getSortedIterator();
+        std::vector<std::shared_ptr<Column>> columns = itr->getAllColumns();
+        table->releaseIterator(itr);
+        segments.push_back(std::shared_ptr<const Segment>(
+                    new Segment(sizeRow, columns)));
+    }
+    compaction->result = std::async(std::launch::async, mergeSegments,
+            segments, sizeRow, blocks[end - 1].iteration);
+}
+
+size_t FCTable::installCompaction() {
+    std::shared_ptr<const FCInternalTable> merged = compaction->result.get();
+    const std::vector<std::shared_ptr<const FCInternalTable>> &sources =
+        compaction->sources;
+
+    //The blocks might have been removed in the meantime
+    size_t begin = 0;
+    while (begin < blocks.size() && blocks[begin].table != sources[0]) {
+        begin++;
+    }
+    const size_t end = begin + sources.size();
+    if (end > blocks.size()) {
+        return 0;
+    }
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (blocks[begin + i].table != sources[i]) {
+            return 0;
+        }
+    }
+
+    const FCBlock &first = blocks[begin];
+    const FCBlock &last = blocks[end - 1];
+    const size_t firstIteration = first.iteration;
+    bool isCompleted = true;
+    std::shared_ptr<const FCZoneMap> zonemap = first.zonemap;
+    for (size_t i = begin; i < end; ++i) {
+        isCompleted &= blocks[i].isCompleted;
+        zonemap = FCZoneMap::merge(zonemap, blocks[i].zonemap);
+    }
+    std::vector<FCBlock> newBlocks;
+    newBlocks.reserve(blocks.size() - sources.size() + 1);
+    for (size_t i = 0; i < begin; ++i) {
+        newBlocks.push_back(blocks[i]);
+    }
+    newBlocks.push_back(FCBlock(last.iteration, merged, first.query,
+                first.posQueryInRule, first.rule, first.ruleExecOrder,
+                isCompleted));
+    newBlocks.back().zonemap = zonemap;
+    for (size_t i = end; i < blocks.size(); ++i) {
+        newBlocks.push_back(blocks[i]);
+    }
+    blocks.swap(newBlocks);
+    for (const auto &source : sources) {
+        countMemory(source, false);
+    }
+    countMemory(merged, true);
+    //A filtered table that stops inside the run would read the merged block
+    //again, with the rows it already has
+    for (FCCache::iterator itr = cache.begin(); itr != cache.end();) {
+        if (itr->second.end >= firstIteration) {
+            itr = cache.erase(itr);
+        } else {
+            itr++;
+        }
+    }
+    if (rowIndex != NULL) {
+        for (const auto &source : sources) {
+            rowIndex->remove(source);
+        }
+        indexBlock(std::shared_ptr<const FCInternalTable>(), merged);
+    }
+    return sources.size() - 1;
+}
+
+size_t FCTable::compact(const size_t maxIteration) {
+    size_t removed = 0;
+    if (compaction != NULL) {
+        if (compaction->result.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready) {
+            return 0;
+        }
+        removed = installCompaction();
+        compaction.reset();
+    }
+
+    //Look for a new run. The last block is never included, since it can
+    //still receive rows of its iteration
+    size_t begin = 0;
+    while (begin + 1 < blocks.size()) {
+        const FCBlock &first = blocks[begin];
+        if (!canBeCompacted(first, maxIteration)) {
+            begin++;
+            continue;
+        }
+        size_t end = begin + 1;
+        while (end + 1 < blocks.size() &&
+                canBeCompacted(blocks[end], maxIteration) &&
+                blocks[end].rule == first.rule &&
+                blocks[end].posQueryInRule == first.posQueryInRule &&
+                blocks[end].query == first.query) {
+            end++;
+        }
+        if (end - begin >= FCTABLE_COMPACT_MINBLOCKS) {
+            startCompaction(begin, end);
+            break;
+        }
+        begin = end;
+    }
+    return removed;
 }
 
 void FCTable::removeBlock(const size_t iteration) {
     assert(blocks.size() == 0 || blocks.back().iteration <= iteration);
     if (blocks.size() > 0 && blocks.back().iteration == iteration) {
+        if (rowIndex != NULL) {
+            rowIndex->remove(blocks.back().table);
+        }
+        countMemory(blocks.back().table, false);
         blocks.pop_back();
     }
 }
@@ -368,6 +796,74 @@ size_t FCTable::getNAllRows() const {
     return output;
 }
 
+void FCTable::getSpillCandidates(const size_t maxIteration,
+        std::vector<FCSpillCandidate> &out) {
+    for (size_t i = 0; i + 1 < blocks.size(); ++i) {
+        const FCBlock &block = blocks[i];
+        if (!block.isCompleted || !block.isIDBBacked() ||
+                block.iteration >= maxIteration ||
+                block.table->getNRows() < FCTABLE_SPILL_MINROWS) {
+            continue;
+        }
+        //Only the columns that FCStore::spill would write. A block whose
+        //columns are all compressed or already on disk is left alone
+        size_t bytes = 0;
+        for (uint8_t j = 0; j < sizeRow; ++j) {
+            std::shared_ptr<Column> column = block.table->getColumn(j);
+            if (FCStore::isWorthSpilling(*column)) {
+                bytes += column->getMemoryBytes();
+            }
+        }
+        if (bytes == 0) {
+            continue;
+        }
+        FCSpillCandidate c;
+        c.table = this;
+        c.block = i;
+        c.lastRead = lastRead;
+        c.iteration = block.iteration;
+        c.bytes = bytes;
+        out.push_back(c);
+    }
+}
+
+size_t FCTable::spill(const size_t idx, const std::string &dir) {
+    FCBlock &block = blocks[idx];
+    size_t before = 0;
+    for (uint8_t j = 0; j < sizeRow; ++j) {
+        before += block.table->getColumn(j)->getMemoryBytes();
+    }
+    std::shared_ptr<const FCInternalTable> table = FCStore::spill(dir,
+            block.table, block.iteration);
+    if (table == block.table) {
+        return 0;
+    }
+    size_t after = 0;
+    for (uint8_t j = 0; j < sizeRow; ++j) {
+        after += table->getColumn(j)->getMemoryBytes();
+    }
+    //The zone map and the cached filters do not change, since the rows
+    //are the same. The index reads the rows from the file from now on
+    if (rowIndex != NULL && rowIndex->contains(block.table)) {
+        if (block.table->isSorted()) {
+            rowIndex->replace(block.table, table);
+        } else {
+            indexBlock(block.table, table);
+        }
+    }
+    countMemory(block.table, false);
+    countMemory(table, true);
+    block.table = table;
+    return before > after ? before - after : 0;
+}
+
+size_t FCTable::dropIndex() {
+    const size_t bytes = getIndexMemoryBytes();
+    rowIndex.reset();
+    rowIndexDisabled = true;
+    return bytes;
+}
+
 FCTable::~FCTable() {
 }
 
@@ -401,15 +401,20 @@ void FilterHashJoin::run_processitr_columnversion(FCInternalTableItr *itr,
 
             //Add the element
             //for (uint32_t i = 1; i < singleC->size(); ++i) {
-            while (singleCReader->hasNext()) {
-                Term_t v = singleCReader->next();
-                if (v != prevEl) {
-                    if (valueColumnsToFilter == NULL || v != valueToFilter) {
-                        p.add(v);
-                        size++;
+            ColumnBatch batch(1);
+            size_t n;
+            while ((n = singleCReader->nextBatch(batch.columns[0], BATCH_ROWS)) > 0) {
+                const Term_t *values = batch.columns[0];
+                for (size_t j = 0; j < n; ++j) {
+                    const Term_t v = values[j];
+                    if (v != prevEl) {
+                        if (valueColumnsToFilter == NULL || v != valueToFilter) {
+                            p.add(v);
+                            size++;
+                        }
                     }
+                    prevEl = v;
                 }
-                prevEl = v;
                 //}
         }
 
@@ -440,22 +445,27 @@ void FilterHashJoin::run_processitr_columnversion(FCInternalTableItr *itr,
 
             //Add the element
             //for (uint32_t i = 1; i < c1->size(); ++i) {
-            while (c1R->hasNext() && c2R->hasNext()) {
-                const Term_t valueC1R = c1R->next();
-                const Term_t valueC2R = c2R->next();
-                if (valueC1R != prevEl1 || valueC2R != prevEl2) {
-                    if (columnsToFilterOut == NULL || (valueC1R != valueC2R)) {
-                        if (valueColumnsToFilter == NULL ||
-                                (posColumnToFilter == 0 && prevEl1 != valueToFilter) ||
-                                (posColumnToFilter == 1 && prevEl2 != valueToFilter)) {
-                            p1.add(valueC1R);
-                            p2.add(valueC2R);
-                            size++;
+            ColumnBatch batch(2);
+            size_t n;
+            while ((n = std::min(c1R->nextBatch(batch.columns[0], BATCH_ROWS),
+                            c2R->nextBatch(batch.columns[1], BATCH_ROWS))) > 0) {
+                for (size_t j = 0; j < n; ++j) {
+                    const Term_t valueC1R = batch.columns[0][j];
+                    const Term_t valueC2R = batch.columns[1][j];
+                    if (valueC1R != prevEl1 || valueC2R != prevEl2) {
+                        if (columnsToFilterOut == NULL || (valueC1R != valueC2R)) {
+                            if (valueColumnsToFilter == NULL ||
+                                    (posColumnToFilter == 0 && prevEl1 != valueToFilter) ||
+                                    (posColumnToFilter == 1 && prevEl2 != valueToFilter)) {
+                                p1.add(valueC1R);
+                                p2.add(valueC2R);
+                                size++;
+                            }
                         }
                     }
+                    prevEl1 = valueC1R;
+                    prevEl2 = valueC2R;
                 }
-                prevEl1 = valueC1R;
-                prevEl2 = valueC2R;
             }
 
             columns[posValuesHead[0].first] = p1.getColumn();
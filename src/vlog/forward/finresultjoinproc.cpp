@@ -3,7 +3,7 @@
 #include <climits>
 
 void SingleHeadFinalRuleProcessor::processResults(std::vector<int> &blockid, Term_t *p,
-        std::vector<bool> &unique, std::mutex *m) {
+        std::vector<uint8_t> &unique, std::mutex *m) {
 
     for (int j = 0; j < blockid.size(); j++) {
         for (uint8_t i = 0; i < nCopyFromFirst; ++i) {
@@ -136,8 +136,8 @@ void SingleHeadFinalRuleProcessor::processResults(const int blockid, FCInternalT
 }
 
 void SingleHeadFinalRuleProcessor::processResults(const int blockid,
-        const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-        const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+        const std::vector<const ColumnView *> &vectors1, size_t i1,
+        const std::vector<const ColumnView *> &vectors2, size_t i2,
         const bool unique) {
     for (int i = 0; i < nCopyFromFirst; i++) {
         row[posFromFirst[i].first] = (*vectors1[posFromFirst[i].second])[i1];
@@ -800,7 +800,7 @@ void FinalRuleProcessor::processResults(const int blockid, const bool unique,
 }
 
 void FinalRuleProcessor::processResults(std::vector<int> &blockid, Term_t *p,
-        std::vector<bool> &unique, std::mutex *m) {
+        std::vector<uint8_t> &unique, std::mutex *m) {
     for (int j = 0; j < blockid.size(); j++) {
         for (uint8_t i = 0; i < nCopyFromFirst; ++i) {
             row[posFromFirst[i].first] = *p;
@@ -827,8 +827,8 @@ void FinalRuleProcessor::processResults(const int blockid, const Term_t *first,
 }
 
 void FinalRuleProcessor::processResults(const int blockid,
-        const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-        const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+        const std::vector<const ColumnView *> &vectors1, size_t i1,
+        const std::vector<const ColumnView *> &vectors2, size_t i2,
         const bool unique) {
     for (int i = 0; i < nCopyFromFirst; i++) {
         row[posFromFirst[i].first] = (*vectors1[posFromFirst[i].second])[i1];
@@ -0,0 +1,30 @@
+#include <vlog/hll.h>
+
+#include <cmath>
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+    for (size_t i = 0; i < HLL_REGISTERS; ++i) {
+        if (other.registers[i] > registers[i]) {
+            registers[i] = other.registers[i];
+        }
+    }
+}
+
+double HyperLogLog::estimate() const {
+    const double m = HLL_REGISTERS;
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < HLL_REGISTERS; ++i) {
+        sum += std::ldexp(1.0, -registers[i]);
+        if (registers[i] == 0) {
+            zeros++;
+        }
+    }
+    const double e = alpha * m * m / sum;
+    //With few values, linear counting on the empty registers is more precise
+    if (e <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / zeros);
+    }
+    return e;
+}
@@ -0,0 +1,124 @@
+#include <vlog/joinorder.h>
+
+#include <algorithm>
+#include <limits>
+
+std::vector<uint8_t> JoinOrder::optimize(
+        const std::vector<const Literal*> &literals,
+        const std::vector<JoinOrderStats> &stats,
+        std::vector<double> &estimates) {
+    const size_t n = literals.size();
+    const size_t nsubsets = (size_t) 1 << n;
+
+    //Give a dense index to the variables
+    std::vector<uint8_t> variables;
+    std::vector<uint64_t> varsOfLiteral(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        for (const auto v : literals[i]->getAllVars()) {
+            auto p = std::find(variables.begin(), variables.end(), v);
+            if (p == variables.end()) {
+                variables.push_back(v);
+                p = variables.end() - 1;
+            }
+            if (p - variables.begin() < 64) {
+                varsOfLiteral[i] |= (uint64_t) 1 << (p - variables.begin());
+            }
+        }
+    }
+    const size_t nvars = variables.size();
+    if (nvars > 64) {
+        estimates.clear();
+        return std::vector<uint8_t>();
+    }
+    std::vector<std::vector<double>> distinctOfLiteral(n);
+    for (size_t i = 0; i < n; ++i) {
+        distinctOfLiteral[i].resize(nvars, 1);
+        for (const auto &d : stats[i].distinct) {
+            const size_t idx = std::find(variables.begin(), variables.end(),
+                    d.first) - variables.begin();
+            distinctOfLiteral[i][idx] = std::max(1.0,
+                    std::min(d.second, stats[i].card));
+        }
+    }
+
+    const double inf = std::numeric_limits<double>::max();
+    std::vector<double> cost(nsubsets, inf);
+    std::vector<double> card(nsubsets, 0);
+    std::vector<uint64_t> vars(nsubsets, 0);
+    std::vector<std::vector<double>> distinct(nsubsets);
+    std::vector<int> last(nsubsets, -1);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t s = (size_t) 1 << i;
+        card[s] = stats[i].card;
+        cost[s] = stats[i].card;
+        vars[s] = varsOfLiteral[i];
+        distinct[s] = distinctOfLiteral[i];
+        last[s] = i;
+    }
+
+    //The subsets are visited in increasing order, so all the subsets of s
+    //are done before s
+    for (size_t s = 1; s < nsubsets; ++s) {
+        if ((s & (s - 1)) == 0) {
+            continue;
+        }
+        //Is there a literal in s that joins with the rest?
+        bool connected = false;
+        for (size_t i = 0; i < n && !connected; ++i) {
+            const size_t bit = (size_t) 1 << i;
+            connected = (s & bit) && (vars[s & ~bit] & varsOfLiteral[i]) &&
+                cost[s & ~bit] != inf;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const size_t bit = (size_t) 1 << i;
+            const size_t prev = s & ~bit;
+            if (!(s & bit) || cost[prev] == inf) {
+                continue;
+            }
+            const uint64_t shared = vars[prev] & varsOfLiteral[i];
+            if (connected && shared == 0) {
+                continue;
+            }
+            double size = card[prev] * stats[i].card;
+            for (size_t v = 0; v < nvars; ++v) {
+                if (shared & ((uint64_t) 1 << v)) {
+                    size /= std::max(distinct[prev][v],
+                            distinctOfLiteral[i][v]);
+                }
+            }
+            //The full body is the same for all the orders
+            const double c = cost[prev] + (s == nsubsets - 1 ? 0 : size);
+            if (c < cost[s]) {
+                cost[s] = c;
+                card[s] = size;
+                vars[s] = vars[prev] | varsOfLiteral[i];
+                last[s] = i;
+                distinct[s].resize(nvars);
+                for (size_t v = 0; v < nvars; ++v) {
+                    double d;
+                    if (shared & ((uint64_t) 1 << v)) {
+                        d = std::min(distinct[prev][v],
+                                distinctOfLiteral[i][v]);
+                    } else if (varsOfLiteral[i] & ((uint64_t) 1 << v)) {
+                        d = distinctOfLiteral[i][v];
+                    } else {
+                        d = distinct[prev][v];
+                    }
+                    distinct[s][v] = std::max(1.0, std::min(d, size));
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> order;
+    estimates.clear();
+    size_t s = nsubsets - 1;
+    while (s != 0) {
+        order.push_back(last[s]);
+        estimates.push_back(card[s]);
+        s &= ~((size_t) 1 << last[s]);
+    }
+    std::reverse(order.begin(), order.end());
+    std::reverse(estimates.begin(), estimates.end());
+    return order;
+}
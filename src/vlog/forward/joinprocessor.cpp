@@ -3,6 +3,7 @@
 #include <vlog/seminaiver.h>
 #include <vlog/filterhashjoin.h>
 #include <vlog/finalresultjoinproc.h>
+#include <vlog/partitionedjoin.h>
 #include <trident/model/table.h>
 
 #include <google/dense_hash_map>
@@ -10,6 +11,24 @@
 #include <vector>
 #include <inttypes.h>
 
+std::atomic<size_t> Output::peakBufferedBytes(0);
+
+void Output::flushAll(std::vector<Output *> &outputs) {
+    size_t bytes = 0;
+    for (const auto output : outputs) {
+        bytes += output->getBufferedBytes();
+    }
+    size_t peak = peakBufferedBytes;
+    while (bytes > peak && !peakBufferedBytes.compare_exchange_weak(peak,
+                bytes)) {
+    }
+    for (auto output : outputs) {
+        output->flush();
+        delete output;
+    }
+    outputs.clear();
+}
+
 bool JoinExecutor::isJoinTwoToOneJoin(const RuleExecutionPlan &hv,
         const int currentLiteral) {
     return hv.joinCoordinates[currentLiteral].size() == 1 &&
@@ -46,7 +65,7 @@ void _joinTwoToOne_cur(std::shared_ptr<Column> firstColumn,
     cols.push_back(firstColumn);
     LOG(TRACEL) << "Getting all vectors";
 
-    std::vector<const std::vector<Term_t> *> vectors = Segment::getAllVectors(cols, nthreads);
+    std::vector<const ColumnView *> vectors = Segment::getAllVectors(cols, nthreads);
 
     LOG(TRACEL) << "Got all vectors";
 
@@ -558,31 +577,113 @@ void JoinExecutor::join(SemiNaiver * naiver, const FCInternalTable * t1,
         joinTwoToOne(naiver, t1, literal, min, max, output, hv,
                 currentLiteral, nthreads);
     } else {
-        //This code is to execute more generic joins. We do hash join if
-        //keys are few and there is no ordering. Otherwise, merge join.
-        if (t1->estimateNRows() <= THRESHOLD_HASHJOIN
-                && joinsCoordinates.size() < 3
+        //This code is to execute more generic joins. The hash join supports
+        //only few keys, and no joins on the first column alone (there the
+        //merge join needs no sorting). The partitioned hash join pays off
+        //only with several threads and a large left side. Among these, the
+        //cheapest according to the timings of the previous executions.
+        bool available[JOINSTRATEGY_N];
+        available[HASHJOIN] = joinsCoordinates.size() < 3
                 && (joinsCoordinates.size() > 1 ||
                     joinsCoordinates[0].first != joinsCoordinates[0].second ||
-                    joinsCoordinates[0].first != 0)) {
+                    joinsCoordinates[0].first != 0);
+        available[MERGEJOIN] = true;
+        const size_t left = t1->estimateNRows();
+        available[PARTITIONEDJOIN] = nthreads > 1 &&
+            left >= PARTITIONEDJOIN_MIN_ROWS &&
+            !ruleDetails.rule.isExistential();
+        const bool choice = available[HASHJOIN] || available[PARTITIONEDJOIN];
+
+        //The tables are sorted by their columns, so the right side needs no
+        //sorting if the join fields are its first columns
+        bool rightSorted = true;
+        for (size_t i = 0; i < joinsCoordinates.size(); ++i) {
+            rightSorted &= joinsCoordinates[i].second == i;
+        }
+        const size_t posLiteral = hv.plan[currentLiteral] -
+            &(ruleDetails.bodyLiterals[0]);
+        JoinStrategies &strategies = naiver->getJoinStrategies();
+        size_t right = 0;
+        JoinStrategy strategy = MERGEJOIN;
+        if (choice) {
+            right = naiver->estimateCardinality(literal, min, max);
+            strategy = strategies.choose(ruleDetails.ruleid, posLiteral,
+                    available, left, right, rightSorted, nthreads);
+        }
+
+        JoinTimings timings;
+        std::chrono::system_clock::time_point start =
+            std::chrono::system_clock::now();
+        if (strategy == HASHJOIN) {
             LOG(TRACEL) << "Executing hashjoin. t1->getNRows()=" << t1->getNRows();
             hashjoin(t1, naiver, outputLiterals, literal, min, max, filterValueVars,
                     joinsCoordinates, output,
-                    lastLiteral, ruleDetails, hv, processedTables, nthreads);
-#ifdef DEBUG
-            output->checkSizes();
-#endif
+                    lastLiteral, ruleDetails, hv, processedTables, timings,
+                    nthreads);
+        } else if (strategy == PARTITIONEDJOIN) {
+            LOG(TRACEL) << "Executing partitioned hashjoin. t1->getNRows()=" << t1->getNRows();
+            partitionedHashjoin(t1, naiver, literal, min, max,
+                    joinsCoordinates, output, timings, nthreads);
         } else {
             LOG(TRACEL) << "Executing mergejoin. t1->getNRows()=" << t1->getNRows();
             mergejoin(t1, naiver, outputLiterals, literal, min, max,
-                    joinsCoordinates, output, nthreads);
+                    joinsCoordinates, output, timings, nthreads);
+        }
 #ifdef DEBUG
-            output->checkSizes();
+        output->checkSizes();
 #endif
+        if (choice) {
+            std::chrono::duration<double> sec =
+                std::chrono::system_clock::now() - start;
+            LOG(DEBUGL) << "Join strategy " << strategy << ": left=" << left
+                << " right=" << right << " sorted=" << rightSorted
+                << " time=" << sec.count() * 1000 << "ms";
+            strategies.record(ruleDetails.ruleid, posLiteral, strategy, left,
+                    right, rightSorted, nthreads, timings, sec.count());
         }
     }
 }
 
+void JoinExecutor::partitionedHashjoin(const FCInternalTable * t1,
+        SemiNaiver * naiver, const Literal & literal,
+        const size_t min, const size_t max,
+        const std::vector<std::pair<uint8_t, uint8_t>> &joinsCoordinates,
+        ResultJoinProcessor * output, JoinTimings &timings,
+        const int nthreads) {
+    std::vector<uint8_t> fields1;
+    std::vector<uint8_t> fields2;
+    for (const auto &c : joinsCoordinates) {
+        fields1.push_back(c.first);
+        fields2.push_back(c.second);
+    }
+
+    //Partition the left side once for all the tables of the right side
+    std::chrono::system_clock::time_point startBuild =
+        std::chrono::system_clock::now();
+    FCInternalTableItr *itr1 = t1->getIterator();
+    std::vector<const ColumnView *> vectors1 =
+        itr1->getAllVectors(nthreads);
+    PartitionedHashJoin join(vectors1, fields1, nthreads);
+    timings.build = std::chrono::duration<double>(
+            std::chrono::system_clock::now() - startBuild).count();
+
+    TableFilterer filterer(naiver);
+    FCIterator it = naiver->getTable(literal, min, max, &filterer);
+    while (!it.isEmpty()) {
+        std::shared_ptr<const FCInternalTable> t2 = it.getCurrentTable();
+        FCInternalTableItr *itr2 = t2->getIterator();
+        std::vector<const ColumnView *> vectors2 =
+            itr2->getAllVectors(nthreads);
+        join.join(vectors2, fields2, output);
+        itr2->deleteAllVectors(vectors2);
+        t2->releaseIterator(itr2);
+        it.moveNextCount();
+    }
+
+    itr1->deleteAllVectors(vectors1);
+    t1->releaseIterator(itr1);
+}
+
 bool JoinExecutor::isJoinSelective(JoinHashMap & map, const Literal & literal,
         const size_t minIteration, const size_t maxIteration,
         SemiNaiver * naiver, const uint8_t joinPos) {
@@ -902,7 +1003,10 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
         const RuleExecutionDetails & ruleDetails,
         const RuleExecutionPlan &hv,
         int &processedTables,
+        JoinTimings &timings,
         int nthreads) {
+    std::chrono::system_clock::time_point startBuild =
+        std::chrono::system_clock::now();
 
     bool literalSharesVarsWithHead;
     std::vector<uint8_t> lastPosToSort;
@@ -931,6 +1035,8 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
         }
         // No parallel sort, t1 is not supposed to be large.
         FCInternalTableItr *t2 = t1->sortBy(fields);
+        const uint8_t rowSize = t1->getRowSize();
+        ColumnBatch batch(t2->getNColumns());
 
         size_t startpos = 0;
         bool first = true;
@@ -955,25 +1061,26 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
                 }
             }
 
-            while (t2->hasNext()) {
-                t2->next();
-
-                if (filterRowsInhashMap &&
-                        t2->getCurrentValue(filterRowsPosJoin) == t2->getCurrentValue(filterRowsPosOther)) {
-                    continue;
-                }
-                Term_t newKey = t2->getCurrentValue(keyField);
-                if (first) {
-                    currentKey = newKey;
-                    first = false;
-                } else if (newKey != currentKey) {
-                    size_t end = values.size();
-                    map.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
-                    currentKey = newKey;
-                    startpos = values.size();
+            size_t n;
+            while ((n = t2->nextBatch(batch.columns, BATCH_ROWS)) > 0) {
+                for (size_t r = 0; r < n; ++r) {
+                    if (filterRowsInhashMap &&
+                            batch.columns[filterRowsPosJoin][r] == batch.columns[filterRowsPosOther][r]) {
+                        continue;
+                    }
+                    Term_t newKey = batch.columns[keyField][r];
+                    if (first) {
+                        currentKey = newKey;
+                        first = false;
+                    } else if (newKey != currentKey) {
+                        size_t end = values.size();
+                        map.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
+                        currentKey = newKey;
+                        startpos = values.size();
+                    }
+                    for (uint8_t j = 0; j < rowSize; ++j)
+                        values.push_back(batch.columns[j][r]);
                 }
-                for (uint8_t j = 0; j < t1->getRowSize(); ++j)
-                    values.push_back(t2->getCurrentValue(j));
             }
 
             if (!first) {
@@ -984,6 +1091,8 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
             //If the map does not contain any entry, then I can safetly exit
             if (map.size() == 0) {
                 t1->releaseIterator(t2);
+                timings.build = std::chrono::duration<double>(
+                        std::chrono::system_clock::now() - startBuild).count();
                 return;
             }
 
@@ -991,26 +1100,28 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
             const uint8_t keyField1 = joinsCoordinates[0].first;
             const uint8_t keyField2 = joinsCoordinates[1].first;
             std::pair<Term_t, Term_t> currentKey;
-            while (t2->hasNext()) {
-                t2->next();
-                Term_t newFirst = t2->getCurrentValue(keyField1);
-                Term_t newSecond = t2->getCurrentValue(keyField2);
-                if (first) {
-                    currentKey.first = newFirst;
-                    currentKey.second = newSecond;
-                    first = false;
-                } else {
-                    if (newFirst != currentKey.first ||
-                            newSecond != currentKey.second) {
-                        size_t end = values.size();
-                        doublemap.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
+            size_t n;
+            while ((n = t2->nextBatch(batch.columns, BATCH_ROWS)) > 0) {
+                for (size_t r = 0; r < n; ++r) {
+                    Term_t newFirst = batch.columns[keyField1][r];
+                    Term_t newSecond = batch.columns[keyField2][r];
+                    if (first) {
                         currentKey.first = newFirst;
                         currentKey.second = newSecond;
-                        startpos = values.size();
+                        first = false;
+                    } else {
+                        if (newFirst != currentKey.first ||
+                                newSecond != currentKey.second) {
+                            size_t end = values.size();
+                            doublemap.insert(std::make_pair(currentKey, std::make_pair(startpos, end)));
+                            currentKey.first = newFirst;
+                            currentKey.second = newSecond;
+                            startpos = values.size();
+                        }
                     }
+                    for (uint8_t j = 0; j < rowSize; ++j)
+                        values.push_back(batch.columns[j][r]);
                 }
-                for (uint8_t j = 0; j < t1->getRowSize(); ++j)
-                    values.push_back(t2->getCurrentValue(j));
             }
 
             if (!first) {
@@ -1020,12 +1131,16 @@ void JoinExecutor::hashjoin(const FCInternalTable * t1, SemiNaiver * naiver,
 
             if (doublemap.size() == 0) {
                 t1->releaseIterator(t2);
+                timings.build = std::chrono::duration<double>(
+                        std::chrono::system_clock::now() - startBuild).count();
                 return;
             }
         }
 
         t1->releaseIterator(t2);
     }
+    timings.build = std::chrono::duration<double>(
+            std::chrono::system_clock::now() - startBuild).count();
 
     if (joinsCoordinates.size() < 2) {
         LOG(DEBUGL) << "Hashmap size = " << map.size();
@@ -1083,6 +1198,7 @@ void JoinExecutor::mergejoin(const FCInternalTable * t1, SemiNaiver * naiver,
         const uint32_t min, const uint32_t max,
         std::vector<std::pair<uint8_t, uint8_t>> joinsCoordinates,
         ResultJoinProcessor * output,
+        JoinTimings &timings,
         int nthreads) {
     //Find whether some of the join fields have a very low cardinality. We can group them.
     std::vector<uint8_t> idxColumnsLowCardInMap;
@@ -1170,7 +1286,7 @@ void JoinExecutor::mergejoin(const FCInternalTable * t1, SemiNaiver * naiver,
 
         if (tablesToMergeJoin.size() > 0)
             do_mergejoin(t1, fields1, tablesToMergeJoin, fields1, NULL, NULL,
-                    fields2, output, nthreads);
+                    fields2, output, timings, nthreads);
     } else {
         //Positions to return when filtering the input query
         std::vector<uint8_t> posToCopy;
@@ -1273,10 +1389,10 @@ void JoinExecutor::mergejoin(const FCInternalTable * t1, SemiNaiver * naiver,
                 //std::chrono::system_clock::time_point startJ = std::chrono::system_clock::now();
                 if (idxOtherPos.size() > 0 && valueOtherPos[0].size() > 1) {
                     do_mergejoin(filteredT1.get(), fieldsToSortInMap, tablesToMergeJoin,
-                            fields1, &(idxOtherPos[0]), &(valueOtherPos[0]), fields2, output, nthreads);
+                            fields1, &(idxOtherPos[0]), &(valueOtherPos[0]), fields2, output, timings, nthreads);
                 } else {
                     do_mergejoin(filteredT1.get(), fieldsToSortInMap, tablesToMergeJoin,
-                            fields1, NULL, NULL, fields2, output, nthreads);
+                            fields1, NULL, NULL, fields2, output, timings, nthreads);
                 }
                 //std::chrono::duration<double> secJ = std::chrono::system_clock::now() - startJ;
 
@@ -1448,8 +1564,8 @@ void JoinExecutor::do_merge_join_classicalgo(FCInternalTableItr * sortedItr1,
 #endif
 }
 
-int JoinExecutor::cmp(const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-        const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+int JoinExecutor::cmp(const std::vector<const ColumnView *> &vectors1, size_t i1,
+        const std::vector<const ColumnView *> &vectors2, size_t i2,
         const std::vector<uint8_t> &fields1,
         const std::vector<uint8_t> &fields2) {
     for (int i = 0; i < fields1.size(); ++i) {
@@ -1464,7 +1580,7 @@ int JoinExecutor::cmp(const std::vector<const std::vector<Term_t> *> &vectors1,
     return 0;
 }
 
-bool JoinExecutor::sameAs(const std::vector<const std::vector<Term_t> *> &vectors, size_t i1, size_t i2,
+bool JoinExecutor::sameAs(const std::vector<const ColumnView *> &vectors, size_t i1, size_t i2,
         const std::vector<uint8_t> &fields) {
     for (int i = 0; i < fields.size(); ++i) {
         uint8_t p = fields[i];
@@ -1475,8 +1591,8 @@ bool JoinExecutor::sameAs(const std::vector<const std::vector<Term_t> *> &vector
     return true;
 }
 
-void JoinExecutor::do_merge_join_classicalgo(const std::vector<const std::vector<Term_t> *> &vectors1, size_t l1, size_t u1,
-        const std::vector<const std::vector<Term_t> *> &vectors2, size_t l2, size_t u2,
+void JoinExecutor::do_merge_join_classicalgo(const std::vector<const ColumnView *> &vectors1, size_t l1, size_t u1,
+        const std::vector<const ColumnView *> &vectors2, size_t l2, size_t u2,
         const std::vector<uint8_t> &fields1,
         const std::vector<uint8_t> &fields2,
         const uint8_t posBlocks,
@@ -1661,25 +1777,30 @@ void JoinExecutor::do_merge_join_fasteralgo(FCInternalTableItr * sortedItr1,
     bool isFirst = true;
     const uint8_t posKey = fields1[0];
     const uint8_t posKeyInS = fields2[0];
-    while (sortedItr1->hasNext()) {
-        sortedItr1->next();
-        Term_t v = sortedItr1->getCurrentValue(posKey);
-        if (isFirst) {
-            currentKey = v;
-            isFirst = false;
-        } else {
-            if (currentKey != v) {
-                keys.push_back(std::make_pair(currentKey, currentValue));
+    ColumnBatch batch1(sortedItr1->getNColumns());
+    size_t n;
+    while ((n = sortedItr1->nextBatch(batch1.columns, BATCH_ROWS)) > 0) {
+        const Term_t *keyValues = batch1.columns[posKey];
+        const Term_t *blockValues = batch1.columns[posBlocks];
+        for (size_t r = 0; r < n; ++r) {
+            Term_t v = keyValues[r];
+            if (isFirst) {
                 currentKey = v;
-                currentValue = 0;
+                isFirst = false;
+            } else {
+                if (currentKey != v) {
+                    keys.push_back(std::make_pair(currentKey, currentValue));
+                    currentKey = v;
+                    currentValue = 0;
+                }
             }
-        }
 
-        uint8_t idxBlock = 0;
-        while (valBlocks[idxBlock] < sortedItr1->getCurrentValue(posBlocks)) {
-            idxBlock++;
+            uint8_t idxBlock = 0;
+            while (valBlocks[idxBlock] < blockValues[r]) {
+                idxBlock++;
+            }
+            currentValue |= 1 << idxBlock;
         }
-        currentValue |= 1 << idxBlock;
     }
     if (!isFirst) {
         keys.push_back(std::make_pair(currentKey, currentValue));
@@ -1693,25 +1814,31 @@ void JoinExecutor::do_merge_join_fasteralgo(FCInternalTableItr * sortedItr1,
     for (int i = 0; i < counts.size(); i++) {
         counts[i] = 0;
     }
-    while (itr != keys.end() && sortedItr2->hasNext()) {
-        sortedItr2->next();
-        while (sortedItr2->getCurrentValue(posKeyInS) < itr->first && sortedItr2->hasNext()) {
-            sortedItr2->next();
-        }
-        while (itr != keys.end() && itr->first < sortedItr2->getCurrentValue(posKeyInS)) {
-            itr++;
-        }
-        if (itr != keys.end() && itr->first == sortedItr2->getCurrentValue(posKeyInS)) {
-            uint64_t v = itr->second;
-            uint8_t idx = 0;
-            while (v != 0) {
-                if (v & 1) {
-                    //Output the derivation
-                    output->processResultsAtPos(idx, 0, sortedItr2->getCurrentValue(posToCopy), false);
-                    counts[idx]++;
+    ColumnBatch batch2(sortedItr2->getNColumns());
+    while (itr != keys.end() &&
+            (n = sortedItr2->nextBatch(batch2.columns, BATCH_ROWS)) > 0) {
+        const Term_t *keyValues = batch2.columns[posKeyInS];
+        const Term_t *copyValues = batch2.columns[posToCopy];
+        for (size_t r = 0; r < n && itr != keys.end(); ++r) {
+            //Rows smaller than the current key do not match
+            if (keyValues[r] < itr->first) {
+                continue;
+            }
+            while (itr != keys.end() && itr->first < keyValues[r]) {
+                itr++;
+            }
+            if (itr != keys.end() && itr->first == keyValues[r]) {
+                uint64_t v = itr->second;
+                uint8_t idx = 0;
+                while (v != 0) {
+                    if (v & 1) {
+                        //Output the derivation
+                        output->processResultsAtPos(idx, 0, copyValues[r], false);
+                        counts[idx]++;
+                    }
+                    v = (v >> 1);
+                    idx++;
                 }
-                v = (v >> 1);
-                idx++;
             }
         }
     }
@@ -1749,81 +1876,90 @@ void JoinExecutor::do_merge_join_fasteralgo(FCInternalTableItr * sortedItr1,
     }
 }
 
+//Every task joins a chunk of the left side and writes in its own Output
 struct CreateParallelMergeJoiner {
-    const std::vector<const std::vector<Term_t> *> vectors;
+    const std::vector<const ColumnView *> vectors;
     FCInternalTableItr *sortedItr2;
     const std::vector<uint8_t> &fields1;
     const std::vector<uint8_t> &fields2;
     const uint8_t posBlocks;
     const uint8_t nValBlocks;
     const Term_t *valBlocks;
-    ResultJoinProcessor *output;
-    std::mutex *m;
+    const std::vector<Output *> &outputs;
+    const size_t chunk;
+    const size_t n;
 
-    CreateParallelMergeJoiner(const std::vector<const std::vector<Term_t> *> &vectors,
+    CreateParallelMergeJoiner(const std::vector<const ColumnView *> &vectors,
             FCInternalTableItr *sortedItr2,
             const std::vector<uint8_t> &fields1,
             const std::vector<uint8_t> &fields2,
             const uint8_t posBlocks,
             const uint8_t nValBlocks,
             const Term_t *valBlocks,
-            ResultJoinProcessor *output,
-            std::mutex *m) :
+            const std::vector<Output *> &outputs,
+            const size_t chunk,
+            const size_t n) :
         vectors(vectors), sortedItr2(sortedItr2),
         fields1(fields1), fields2(fields2), posBlocks(posBlocks),
-        nValBlocks(nValBlocks), valBlocks(valBlocks), output(output), m(m) {
+        nValBlocks(nValBlocks), valBlocks(valBlocks), outputs(outputs),
+        chunk(chunk), n(n) {
         }
 
     void operator()(const ParallelRange& r) const {
-        LOG(TRACEL) << "Parallel merge joiner: r.begin = " << r.begin() << ", r.end = " << r.end();
-        FCInternalTableItr *itr1 = new VectorFCInternalTableItr(vectors, r.begin(), r.end());
-        Output out(output, m);
-        FCInternalTableItr *itr2 = sortedItr2->copy();
-
-        JoinExecutor::do_merge_join_classicalgo(itr1, itr2, fields1,
-                fields2, posBlocks, valBlocks, &out);
-
-        out.flush();
-        delete itr2;
-        delete itr1;
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            const size_t begin = t * chunk;
+            const size_t end = std::min(n, begin + chunk);
+            LOG(TRACEL) << "Parallel merge joiner: begin = " << begin << ", end = " << end;
+            FCInternalTableItr *itr1 = new VectorFCInternalTableItr(vectors, begin, end);
+            FCInternalTableItr *itr2 = sortedItr2->copy();
+
+            JoinExecutor::do_merge_join_classicalgo(itr1, itr2, fields1,
+                    fields2, posBlocks, valBlocks, outputs[t]);
+
+            delete itr2;
+            delete itr1;
+        }
     }
 };
 
 struct CreateParallelMergeJoinerVectors {
-    const std::vector<const std::vector<Term_t> *> vectors;
-    const std::vector<const std::vector<Term_t> *> vectors2;
+    const std::vector<const ColumnView *> vectors;
+    const std::vector<const ColumnView *> vectors2;
     const std::vector<uint8_t> &fields1;
     const std::vector<uint8_t> &fields2;
     const uint8_t posBlocks;
     const uint8_t nValBlocks;
     const Term_t *valBlocks;
-    ResultJoinProcessor *output;
-    std::mutex *m;
+    const std::vector<Output *> &outputs;
+    const size_t chunk;
+    const size_t n;
 
-    CreateParallelMergeJoinerVectors(const std::vector<const std::vector<Term_t> *> &vectors,
-            const std::vector<const std::vector<Term_t> *> vectors2,
+    CreateParallelMergeJoinerVectors(const std::vector<const ColumnView *> &vectors,
+            const std::vector<const ColumnView *> vectors2,
             const std::vector<uint8_t> &fields1,
             const std::vector<uint8_t> &fields2,
             const uint8_t posBlocks,
             const uint8_t nValBlocks,
             const Term_t *valBlocks,
-            ResultJoinProcessor *output,
-            std::mutex *m) :
+            const std::vector<Output *> &outputs,
+            const size_t chunk,
+            const size_t n) :
         vectors(vectors), vectors2(vectors2),
         fields1(fields1), fields2(fields2), posBlocks(posBlocks),
-        nValBlocks(nValBlocks), valBlocks(valBlocks), output(output), m(m) {
+        nValBlocks(nValBlocks), valBlocks(valBlocks), outputs(outputs),
+        chunk(chunk), n(n) {
         }
 
     void operator()(const ParallelRange& r) const {
-        LOG(TRACEL) << "Parallel vector merge joiner: r.begin = " << r.begin() << ", r.end = " << r.end();
-        Output out(output, m);
-
-        JoinExecutor::do_merge_join_classicalgo(vectors, r.begin(), r.end(),
-                vectors2, 0, vectors2[0]->size(),
-                fields1, fields2,
-                posBlocks, valBlocks, &out);
-
-        out.flush();
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            const size_t begin = t * chunk;
+            const size_t end = std::min(n, begin + chunk);
+            LOG(TRACEL) << "Parallel vector merge joiner: begin = " << begin << ", end = " << end;
+            JoinExecutor::do_merge_join_classicalgo(vectors, begin, end,
+                    vectors2, 0, vectors2[0]->size(),
+                    fields1, fields2,
+                    posBlocks, valBlocks, outputs[t]);
+        }
     }
 };
 
@@ -1833,7 +1969,7 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
         const std::vector<uint8_t> &fields1, const uint8_t *posOtherVars,
         const std::vector<Term_t> *valuesOtherVars,
         const std::vector<uint8_t> &fields2, ResultJoinProcessor * output,
-        int nthreads) {
+        JoinTimings &timings, int nthreads) {
 
     //Only one additional variable is allowed to have low cardinality
     const uint8_t posBlocks = posOtherVars == NULL ? 0 : posOtherVars[0];
@@ -1853,7 +1989,6 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
     startS = std::chrono::system_clock::now();
 
     size_t chunks = 0;
-    std::mutex m;
 
     size_t totalsize2 = 0;
     for (auto t2 : tables2) {
@@ -1884,7 +2019,7 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
        }
        */
 
-    std::vector<const std::vector<Term_t> *> vectors;
+    std::vector<const ColumnView *> vectors;
     vectors = sortedItr1->getAllVectors(nthreads);
 
     size_t totalsize1 = filteredT1->getNRows();
@@ -1903,6 +2038,7 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
     VectorFCInternalTableItr *itr1 = new VectorFCInternalTableItr(vectors, 0, totalsize1);
 
     secS = std::chrono::system_clock::now() - startS;
+    timings.sort += secS.count();
 
 #if DEBUG
     LOG(TRACEL) << "do_merge_join: time sorting the left relation: " << secS.count() * 1000;
@@ -1912,7 +2048,7 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
     bool faster = (fields1.size() == 1 && valBlocks != NULL && output->getNCopyFromFirst() == 1
             && output->getPosFromFirst()[0].second == posBlocks && output->getNCopyFromSecond() == 1);
 
-    Output *out = new Output(output, NULL);
+    Output *out = new Output(output, false);
 
     for (auto t2 : tables2) {
         if (! first) {
@@ -1933,7 +2069,7 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
             sortedItr2 = t2->getIterator();
         }
         bool vector2Supported = true;
-        std::vector<const std::vector<Term_t> *> vectors2 = sortedItr2->getAllVectors(nthreads);
+        std::vector<const ColumnView *> vectors2 = sortedItr2->getAllVectors(nthreads);
         /*
            std::vector<std::shared_ptr<Column>> cols = sortedItr2->getAllColumns();
            int ncols = (int) sortedItr2->getNColumns();
@@ -1950,6 +2086,7 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
            }
            */
         secS = std::chrono::system_clock::now() - startS;
+        timings.sort += secS.count();
         FCInternalTableItr *itr2 = sortedItr2;
         size_t t2Size = t2->getNRows();
         if (faster) {
@@ -1967,21 +2104,24 @@ void JoinExecutor::do_mergejoin(const FCInternalTable * filteredT1,
             LOG(TRACEL) << "totalsize1 = " << totalsize1 << ", t2Size = " << t2Size;
             if (/* vectorSupported && */ nthreads > 1 && totalsize1 > 1 && (totalsize1 + t2Size) > 4096 /* ? */) {
                 LOG(TRACEL) << "Chunk size = " << chunks << ", t2->getNRows() = " << t2Size;
+                const size_t ntasks = (totalsize1 + chunks - 1) / chunks;
+                std::vector<Output *> outputs;
+                for (size_t i = 0; i < ntasks; ++i) {
+                    outputs.push_back(new Output(output, true));
+                }
                 if (vector2Supported) {
-                    //tbb::parallel_for(tbb::blocked_range<int>(0, totalsize1, chunks),
-                    //        CreateParallelMergeJoinerVectors(vectors, vectors2, fields1, fields2, posBlocks, nValBlocks, valBlocks, output, &m));
-                    ParallelTasks::parallel_for(0, totalsize1, chunks,
+                    ParallelTasks::parallel_for(0, ntasks, 1,
                             CreateParallelMergeJoinerVectors(vectors, vectors2,
                                 fields1, fields2, posBlocks, nValBlocks,
-                                valBlocks, output, &m));
+                                valBlocks, outputs, chunks, totalsize1));
                 } else {
-                    //tbb::parallel_for(tbb::blocked_range<int>(0, totalsize1, chunks),
-                    //        CreateParallelMergeJoiner(vectors, sortedItr2, fields1, fields2, posBlocks, nValBlocks, valBlocks, output, &m));
-                    ParallelTasks::parallel_for(0, totalsize1, chunks,
+                    ParallelTasks::parallel_for(0, ntasks, 1,
                             CreateParallelMergeJoiner(vectors, sortedItr2,
                                 fields1, fields2, posBlocks, nValBlocks,
-                                valBlocks, output, &m));
+                                valBlocks, outputs, chunks, totalsize1));
                 }
+                //Keep the order of the chunks
+                Output::flushAll(outputs);
             } else {
                 JoinExecutor::do_merge_join_classicalgo(vectors, 0, totalsize1,
                         vectors2, 0, t2Size,
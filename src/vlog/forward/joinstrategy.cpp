@@ -0,0 +1,125 @@
+#include <vlog/joinstrategy.h>
+
+#include <algorithm>
+#include <cmath>
+
+static double sortUnits(const double n) {
+    return n * std::log2(n + 2);
+}
+
+static void average(double &v, const double measured) {
+    v = (1 - JOINSTRATEGY_ALPHA) * v + JOINSTRATEGY_ALPHA * measured;
+}
+
+JoinStrategyStats::JoinStrategyStats() : buildNs(JOINSTRATEGY_BUILD_NS),
+    probeNs(JOINSTRATEGY_PROBE_NS), sortNs(JOINSTRATEGY_SORT_NS),
+    mergeNs(JOINSTRATEGY_MERGE_NS), partitionNs(JOINSTRATEGY_PARTITION_NS),
+    nSwitches(0), last(MERGEJOIN) {
+    for (int i = 0; i < JOINSTRATEGY_N; ++i) {
+        count[i] = 0;
+        seconds[i] = 0;
+    }
+}
+
+double JoinStrategyStats::cost(const JoinStrategy strategy,
+        const double left, const double right, const bool rightSorted,
+        const int nthreads) const {
+    if (strategy == HASHJOIN) {
+        return (buildNs + probeNs) * left;
+    } else if (strategy == MERGEJOIN) {
+        double sort = sortUnits(left);
+        if (!rightSorted) {
+            sort += sortUnits(right);
+        }
+        return sortNs * sort + mergeNs * (left + right);
+    } else {
+        return partitionNs * (left + right) / std::max(1, nthreads);
+    }
+}
+
+void JoinStrategyStats::update(const JoinStrategy strategy,
+        const double left, const double right, const bool rightSorted,
+        const int nthreads, const JoinTimings &timings, const double seconds) {
+    if (count[0] + count[1] + count[2] > 0 && strategy != last) {
+        nSwitches++;
+    }
+    last = strategy;
+    count[strategy]++;
+    this->seconds[strategy] += seconds;
+    if (left + right < JOINSTRATEGY_MIN_ROWS || left == 0) {
+        return;
+    }
+
+    if (strategy == HASHJOIN) {
+        const double rest = std::max(0.0, seconds - timings.build) * 1e9;
+        average(buildNs, timings.build * 1e9 / left);
+        average(probeNs, rest / left);
+    } else if (strategy == MERGEJOIN) {
+        const double rest = std::max(0.0, seconds - timings.sort) * 1e9;
+        double units = sortUnits(left);
+        if (!rightSorted) {
+            units += sortUnits(right);
+        }
+        average(sortNs, timings.sort * 1e9 / units);
+        average(mergeNs, rest / (left + right));
+    } else {
+        average(partitionNs, seconds * 1e9 * std::max(1, nthreads) /
+                (left + right));
+    }
+}
+
+JoinStrategy JoinStrategies::choose(const size_t ruleid,
+        const size_t literal, const bool *available, const size_t left,
+        const size_t right, const bool rightSorted, const int nthreads) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const JoinStrategyStats &s = stats[std::make_pair(ruleid, literal)];
+    double costs[JOINSTRATEGY_N];
+    int best = -1;
+    for (int i = 0; i < JOINSTRATEGY_N; ++i) {
+        if (available[i]) {
+            costs[i] = s.cost((JoinStrategy) i, left, right, rightSorted,
+                    nthreads);
+            if (best == -1 || costs[i] < costs[best]) {
+                best = i;
+            }
+        }
+    }
+    //Try a strategy that was never measured if it is not much worse, since
+    //the defaults can be far off
+    for (int i = 0; i < JOINSTRATEGY_N; ++i) {
+        if (available[i] && i != best && s.count[i] == 0 &&
+                costs[i] <= costs[best] * JOINSTRATEGY_EXPLORE_FACTOR) {
+            return (JoinStrategy) i;
+        }
+    }
+    return (JoinStrategy) best;
+}
+
+double JoinStrategies::estimate(const size_t ruleid, const size_t literal,
+        const double left, const double right, const bool rightSorted,
+        const int nthreads) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const JoinStrategyStats &s = stats[std::make_pair(ruleid, literal)];
+    double best = s.cost((JoinStrategy) 0, left, right, rightSorted,
+            nthreads);
+    for (int i = 1; i < JOINSTRATEGY_N; ++i) {
+        best = std::min(best, s.cost((JoinStrategy) i, left, right,
+                    rightSorted, nthreads));
+    }
+    return best;
+}
+
+void JoinStrategies::record(const size_t ruleid, const size_t literal,
+        const JoinStrategy strategy, const size_t left, const size_t right,
+        const bool rightSorted, const int nthreads,
+        const JoinTimings &timings, const double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats[std::make_pair(ruleid, literal)].update(strategy, left, right,
+            rightSorted, nthreads, timings, seconds);
+}
+
+std::map<std::pair<size_t, size_t>, JoinStrategyStats>
+JoinStrategies::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,445 @@
+#include <vlog/leapfrog.h>
+#include <vlog/seminaiver.h>
+#include <vlog/resultjoinproc.h>
+#include <vlog/sortedints.h>
+#include <vlog/joinstrategy.h>
+#include <vlog/column.h>
+
+#include <kognac/logs.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//The rows of a literal, with the columns in the order in which the variables
+//are bound, sorted and without duplicates. The columns are either copied in
+//'owned' or borrowed from the vectors of a table
+struct TrieRelation {
+    std::vector<uint8_t> variables; //Positions in the order of the join
+    std::vector<const Term_t*> columns;
+    size_t nrows;
+    std::vector<std::vector<Term_t>> owned;
+    std::vector<std::shared_ptr<Column>> borrowed;
+
+    TrieRelation() : nrows(0) {
+    }
+
+    size_t size() const {
+        return nrows;
+    }
+};
+
+//Iterator over the trie of a TrieRelation. At depth d, it moves over the
+//distinct values of column d among the rows that share the values of the
+//columns before d
+class TrieIterator {
+    private:
+        const TrieRelation &rel;
+        int depth;
+        std::vector<size_t> pos, end;
+
+        size_t runEnd(const size_t p) const {
+            const Term_t *col = rel.columns[depth];
+            const Term_t key = col[p];
+            if (key == std::numeric_limits<Term_t>::max()) {
+                return end[depth];
+            }
+            return SortedInts::gallop(col, p, end[depth], key + 1);
+        }
+
+    public:
+        TrieIterator(const TrieRelation &rel) : rel(rel), depth(-1),
+        pos(rel.columns.size()), end(rel.columns.size()) {
+        }
+
+        void open() {
+            if (depth == -1) {
+                pos[0] = 0;
+                end[0] = rel.size();
+            } else {
+                end[depth + 1] = runEnd(pos[depth]);
+                pos[depth + 1] = pos[depth];
+            }
+            depth++;
+        }
+
+        void up() {
+            depth--;
+        }
+
+        bool atEnd() const {
+            return pos[depth] == end[depth];
+        }
+
+        Term_t key() const {
+            return rel.columns[depth][pos[depth]];
+        }
+
+        void next() {
+            pos[depth] = runEnd(pos[depth]);
+        }
+
+        void seek(const Term_t x) {
+            pos[depth] = SortedInts::gallop(rel.columns[depth], pos[depth],
+                    end[depth], x);
+        }
+};
+
+static bool lessIterator(const TrieIterator *i1, const TrieIterator *i2) {
+    return i1->key() < i2->key();
+}
+
+struct LeapfrogState {
+    std::vector<std::vector<TrieIterator*>> participants; //For every variable
+    std::vector<std::vector<TrieIterator*>> sorted; //Scratch space
+    std::vector<Term_t> bindings;
+    //After this variable, a single binding is enough (the others are not
+    //copied in the head)
+    int lastHeadVariable;
+    ResultJoinProcessor *output;
+
+    //Returns true if at least one binding was found
+    bool search(const size_t v) {
+        if (v == bindings.size()) {
+            output->processResults(0, bindings.data(),
+                    (FCInternalTableItr*) NULL, false);
+            return true;
+        }
+
+        std::vector<TrieIterator*> &its = sorted[v];
+        its = participants[v];
+        bool empty = false;
+        for (auto it : its) {
+            it->open();
+            empty |= it->atEnd();
+        }
+
+        bool found = false;
+        if (!empty) {
+            std::sort(its.begin(), its.end(), lessIterator);
+            const size_t k = its.size();
+            size_t p = 0;
+            Term_t max = its[k - 1]->key();
+            while (true) {
+                TrieIterator *it = its[p];
+                if (it->key() == max) {
+                    //All the iterators agree on the value
+                    bindings[v] = max;
+                    if (search(v + 1)) {
+                        found = true;
+                        if ((int) v > lastHeadVariable) {
+                            break;
+                        }
+                    }
+                    it->next();
+                } else {
+                    it->seek(max);
+                }
+                if (it->atEnd()) {
+                    break;
+                }
+                max = it->key();
+                p = (p + 1) % k;
+            }
+        }
+
+        for (auto it : participants[v]) {
+            it->up();
+        }
+        return found;
+    }
+};
+
+//Rows of a block, projected on the variables and sorted by them
+typedef std::vector<std::vector<Term_t>> TrieRun;
+
+static bool lessRow(const TrieRun &r1, const size_t p1,
+        const TrieRun &r2, const size_t p2) {
+    for (size_t c = 0; c < r1.size(); ++c) {
+        if (r1[c][p1] != r2[c][p2]) {
+            return r1[c][p1] < r2[c][p2];
+        }
+    }
+    return false;
+}
+
+static bool sameRow(const std::vector<const Term_t*> &columns,
+        const size_t p1, const size_t p2) {
+    for (const auto c : columns) {
+        if (c[p1] != c[p2]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Read the block sorted by the columns of the variables. The table sorts it
+//only if it is not already in that order (EDB tables and blocks sorted on
+//their first columns are not)
+static void readRun(std::shared_ptr<const FCInternalTable> table,
+        const std::vector<uint8_t> &columnOfVariable,
+        const std::vector<std::pair<uint8_t, uint8_t>> &repeated,
+        TrieRun &run, const int nthreads) {
+    run.resize(columnOfVariable.size());
+    FCInternalTableItr *itr = table->sortBy(columnOfVariable,
+            std::max(1, nthreads));
+    ColumnBatch batch(itr->getNColumns());
+    size_t n;
+    while ((n = itr->nextBatch(batch.columns, BATCH_ROWS)) > 0) {
+        for (size_t j = 0; j < n; ++j) {
+            bool ok = true;
+            for (const auto &r : repeated) {
+                if (batch.columns[r.first][j] != batch.columns[r.second][j]) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (ok) {
+                for (size_t c = 0; c < columnOfVariable.size(); ++c) {
+                    run[c].push_back(batch.columns[columnOfVariable[c]][j]);
+                }
+            }
+        }
+    }
+    table->releaseIterator(itr);
+}
+
+//Use the vectors of the table without copying them, if it is possible
+static bool borrowRun(std::shared_ptr<const FCInternalTable> table,
+        const std::vector<uint8_t> &columnOfVariable, TrieRelation &rel) {
+    FCInternalTableItr *itr = table->sortBy(columnOfVariable);
+    std::vector<std::shared_ptr<Column>> columns = itr->getColumn(
+            columnOfVariable.size(), columnOfVariable.data());
+    table->releaseIterator(itr);
+    std::vector<const Term_t*> values;
+    size_t nrows = 0;
+    for (const auto &c : columns) {
+        if (!c->isBackedByVector()) {
+            return false;
+        }
+        const std::vector<Term_t> &v = c->getVectorRef();
+        values.push_back(v.data());
+        nrows = v.size();
+    }
+    for (size_t i = 1; i < nrows; ++i) {
+        if (sameRow(values, i - 1, i)) {
+            return false;
+        }
+    }
+    rel.columns = values;
+    rel.nrows = nrows;
+    rel.borrowed = columns;
+    return true;
+}
+
+//Merge the sorted runs, removing the duplicates
+static void mergeRuns(std::vector<TrieRun> &runs, TrieRelation &rel) {
+    const size_t ncolumns = rel.variables.size();
+    std::vector<std::vector<Term_t>> &out = rel.owned;
+    out.resize(ncolumns);
+    if (runs.size() == 1) {
+        out.swap(runs[0]);
+    } else {
+        size_t total = 0;
+        for (const auto &run : runs) {
+            total += run.empty() ? 0 : run[0].size();
+        }
+        for (auto &c : out) {
+            c.reserve(total);
+        }
+        std::vector<size_t> pos(runs.size());
+        //Min-heap of the runs on their current row
+        auto greater = [&runs, &pos](const size_t r1, const size_t r2) {
+            return lessRow(runs[r2], pos[r2], runs[r1], pos[r1]);
+        };
+        std::vector<size_t> heap;
+        for (size_t r = 0; r < runs.size(); ++r) {
+            if (!runs[r].empty() && !runs[r][0].empty()) {
+                heap.push_back(r);
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), greater);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            const size_t r = heap.back();
+            for (size_t c = 0; c < ncolumns; ++c) {
+                out[c].push_back(runs[r][c][pos[r]]);
+            }
+            if (++pos[r] < runs[r][0].size()) {
+                std::push_heap(heap.begin(), heap.end(), greater);
+            } else {
+                heap.pop_back();
+                TrieRun().swap(runs[r]);
+            }
+        }
+    }
+
+    //The runs are sets, but the same row can appear in several of them or
+    //in the rows filtered on the repeated variables
+    size_t n = 0;
+    const size_t nrows = out.empty() ? 0 : out[0].size();
+    for (size_t i = 0; i < nrows; ++i) {
+        bool duplicate = n > 0;
+        for (size_t c = 0; c < ncolumns && duplicate; ++c) {
+            duplicate = out[c][i] == out[c][n - 1];
+        }
+        if (!duplicate) {
+            for (size_t c = 0; c < ncolumns; ++c) {
+                out[c][n] = out[c][i];
+            }
+            n++;
+        }
+    }
+    for (auto &c : out) {
+        c.resize(n);
+        rel.columns.push_back(c.data());
+    }
+    rel.nrows = n;
+}
+
+static void loadRelation(SemiNaiver *naiver, const Literal &literal,
+        const size_t min, const size_t max,
+        const std::vector<uint8_t> &variables,
+        TrieRelation &rel, const int nthreads) {
+    //The tables contain one column for every occurrence of a variable
+    std::vector<uint8_t> occurrences;
+    for (uint8_t i = 0; i < literal.getTupleSize(); ++i) {
+        const VTerm t = literal.getTermAtPos(i);
+        if (t.isVariable()) {
+            occurrences.push_back(t.getId());
+        }
+    }
+    std::vector<uint8_t> columnOfVariable;
+    for (uint8_t v = 0; v < variables.size(); ++v) {
+        auto p = std::find(occurrences.begin(), occurrences.end(),
+                variables[v]);
+        if (p != occurrences.end()) {
+            rel.variables.push_back(v);
+            columnOfVariable.push_back(p - occurrences.begin());
+        }
+    }
+    std::vector<std::pair<uint8_t, uint8_t>> repeated;
+    for (uint8_t i = 0; i < occurrences.size(); ++i) {
+        for (uint8_t j = i + 1; j < occurrences.size(); ++j) {
+            if (occurrences[i] == occurrences[j]) {
+                repeated.push_back(std::make_pair(i, j));
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<const FCInternalTable>> tables;
+    FCIterator itr = naiver->getTable(literal, min, max);
+    while (!itr.isEmpty()) {
+        tables.push_back(itr.getCurrentTable());
+        itr.moveNextCount();
+    }
+    if (tables.size() == 1 && repeated.empty() && !tables[0]->isEDB() &&
+            borrowRun(tables[0], columnOfVariable, rel)) {
+        return;
+    }
+    std::vector<TrieRun> runs(tables.size());
+    for (size_t i = 0; i < tables.size(); ++i) {
+        readRun(tables[i], columnOfVariable, repeated, runs[i], nthreads);
+    }
+    if (!runs.empty()) {
+        mergeRuns(runs, rel);
+    }
+}
+
+bool LeapfrogJoin::isApplicable(RuleExecutionPlan &plan, const Rule &rule) {
+    if (plan.plan.size() < LEAPFROG_MIN_LITERALS || rule.isExistential()) {
+        return false;
+    }
+    for (const auto lit : plan.plan) {
+        if (lit->getNVars() == 0) {
+            return false;
+        }
+    }
+    return !plan.hasCartesian() && plan.isCyclic();
+}
+
+double LeapfrogJoin::estimateCost(const std::vector<double> &cards,
+        const std::vector<bool> &sorted) {
+    const JoinStrategyStats constants;
+    double cost = 0;
+    for (size_t i = 0; i < cards.size(); ++i) {
+        if (!sorted[i]) {
+            cost += constants.sortNs * cards[i] * std::log2(cards[i] + 2);
+        }
+        cost += constants.mergeNs * cards[i];
+    }
+    return cost;
+}
+
+std::vector<uint8_t> LeapfrogJoin::getVariableOrder(
+        const RuleExecutionPlan &plan) {
+    std::vector<uint8_t> variables;
+    for (const auto lit : plan.plan) {
+        for (const auto v : lit->getAllVars()) {
+            if (std::find(variables.begin(), variables.end(), v) ==
+                    variables.end()) {
+                variables.push_back(v);
+            }
+        }
+    }
+    return variables;
+}
+
+std::vector<std::pair<uint8_t, uint8_t>> LeapfrogJoin::getPosFromFirst(
+        const std::vector<Literal> &heads,
+        const std::vector<uint8_t> &variables) {
+    std::vector<std::pair<uint8_t, uint8_t>> posFromFirst;
+    uint8_t countVars = 0;
+    for (const auto &head : heads) {
+        for (uint8_t i = 0; i < head.getTupleSize(); ++i) {
+            const VTerm t = head.getTermAtPos(i);
+            if (t.isVariable()) {
+                auto p = std::find(variables.begin(), variables.end(),
+                        t.getId());
+                posFromFirst.push_back(std::make_pair(countVars + i,
+                            (uint8_t) (p - variables.begin())));
+            }
+        }
+        countVars += head.getTupleSize();
+    }
+    return posFromFirst;
+}
+
+void LeapfrogJoin::join(SemiNaiver *naiver, const RuleExecutionPlan &plan,
+        const std::vector<std::pair<size_t, size_t>> &ranges,
+        const std::vector<uint8_t> &variables,
+        const std::vector<Literal> &heads,
+        ResultJoinProcessor *output, const int nthreads) {
+    std::vector<TrieRelation> relations(plan.plan.size());
+    for (size_t i = 0; i < plan.plan.size(); ++i) {
+        loadRelation(naiver, *plan.plan[i], ranges[i].first, ranges[i].second,
+                variables, relations[i], nthreads);
+        LOG(DEBUGL) << "Leapfrog: literal " << i << " has " <<
+            relations[i].size() << " distinct rows";
+        if (relations[i].size() == 0) {
+            return;
+        }
+    }
+
+    std::vector<TrieIterator> iterators;
+    iterators.reserve(relations.size());
+    for (const auto &rel : relations) {
+        iterators.push_back(TrieIterator(rel));
+    }
+    LeapfrogState state;
+    state.participants.resize(variables.size());
+    state.sorted.resize(variables.size());
+    state.bindings.resize(variables.size());
+    for (size_t i = 0; i < relations.size(); ++i) {
+        for (const auto v : relations[i].variables) {
+            state.participants[v].push_back(&iterators[i]);
+        }
+    }
+    state.lastHeadVariable = -1;
+    for (const auto &p : getPosFromFirst(heads, variables)) {
+        state.lastHeadVariable = std::max(state.lastHeadVariable,
+                (int) p.second);
+    }
+    state.output = output;
+    state.search(0);
+}
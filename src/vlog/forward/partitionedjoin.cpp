@@ -0,0 +1,226 @@
+#include <vlog/partitionedjoin.h>
+#include <vlog/joinprocessor.h>
+
+#include <trident/utils/parallel.h>
+
+#include <algorithm>
+#include <limits>
+
+#define PARTITIONEDJOIN_EMPTY std::numeric_limits<size_t>::max()
+
+static uint64_t hashKey(const std::vector<const ColumnView *> &vectors,
+        const std::vector<uint8_t> &fields, const size_t i) {
+    uint64_t h = 0;
+    for (const auto f : fields) {
+        h = (h ^ (uint64_t) (*vectors[f])[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    //Finalizer of splitmix64, the partition is taken from the top bits
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+static size_t partitionOf(const uint64_t h, const uint8_t bits) {
+    return bits == 0 ? 0 : (size_t) (h >> (64 - bits));
+}
+
+struct HashAndCount {
+    const std::vector<const ColumnView *> &vectors;
+    const std::vector<uint8_t> &fields;
+    const uint8_t bits;
+    uint64_t *hashes;
+    std::vector<size_t> *histograms;
+    const size_t chunk;
+    const size_t n;
+
+    HashAndCount(const std::vector<const ColumnView *> &vectors,
+            const std::vector<uint8_t> &fields, const uint8_t bits,
+            uint64_t *hashes, std::vector<size_t> *histograms,
+            const size_t chunk, const size_t n) : vectors(vectors),
+    fields(fields), bits(bits), hashes(hashes), histograms(histograms),
+    chunk(chunk), n(n) {
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            std::vector<size_t> &h = histograms[t];
+            std::fill(h.begin(), h.end(), 0);
+            const size_t end = std::min(n, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                hashes[i] = hashKey(vectors, fields, i);
+                h[partitionOf(hashes[i], bits)]++;
+            }
+        }
+    }
+};
+
+struct ScatterRows {
+    const uint64_t *hashes;
+    const uint8_t bits;
+    std::vector<size_t> *offsets;
+    HashPartitions &out;
+    const size_t chunk;
+    const size_t n;
+
+    ScatterRows(const uint64_t *hashes, const uint8_t bits,
+            std::vector<size_t> *offsets, HashPartitions &out,
+            const size_t chunk, const size_t n) : hashes(hashes), bits(bits),
+    offsets(offsets), out(out), chunk(chunk), n(n) {
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            size_t *o = offsets[t].data();
+            const size_t end = std::min(n, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                const size_t pos = o[partitionOf(hashes[i], bits)]++;
+                out.hashes[pos] = hashes[i];
+                out.rows[pos] = i;
+            }
+        }
+    }
+};
+
+struct JoinPartitions {
+    const std::vector<const ColumnView *> &left;
+    const std::vector<const ColumnView *> &right;
+    const std::vector<uint8_t> &fields1;
+    const std::vector<uint8_t> &fields2;
+    const HashPartitions &leftPartitions;
+    const HashPartitions &rightPartitions;
+    const std::vector<Output *> &outputs;
+
+    JoinPartitions(const std::vector<const ColumnView *> &left,
+            const std::vector<const ColumnView *> &right,
+            const std::vector<uint8_t> &fields1,
+            const std::vector<uint8_t> &fields2,
+            const HashPartitions &leftPartitions,
+            const HashPartitions &rightPartitions,
+            const std::vector<Output *> &outputs) : left(left), right(right),
+    fields1(fields1), fields2(fields2), leftPartitions(leftPartitions),
+    rightPartitions(rightPartitions), outputs(outputs) {
+    }
+
+    bool sameKey(const size_t r1, const size_t r2) const {
+        for (size_t i = 0; i < fields1.size(); ++i) {
+            if ((*left[fields1[i]])[r1] != (*right[fields2[i]])[r2]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void operator()(const ParallelRange& r) const {
+        std::vector<size_t> heads;
+        std::vector<size_t> next;
+        for (size_t p = r.begin(); p != r.end(); ++p) {
+            const size_t lstart = leftPartitions.start[p];
+            const size_t lsize = leftPartitions.start[p + 1] - lstart;
+            const size_t rstart = rightPartitions.start[p];
+            const size_t rend = rightPartitions.start[p + 1];
+            if (lsize == 0 || rstart == rend) {
+                continue;
+            }
+
+            //Build
+            size_t nbuckets = 1;
+            while (nbuckets < 2 * lsize) {
+                nbuckets <<= 1;
+            }
+            const uint64_t mask = nbuckets - 1;
+            heads.assign(nbuckets, PARTITIONEDJOIN_EMPTY);
+            next.resize(lsize);
+            for (size_t j = 0; j < lsize; ++j) {
+                const size_t b = leftPartitions.hashes[lstart + j] & mask;
+                next[j] = heads[b];
+                heads[b] = j;
+            }
+
+            //Probe
+            Output *out = outputs[p];
+            for (size_t i = rstart; i < rend; ++i) {
+                const uint64_t h = rightPartitions.hashes[i];
+                const size_t r2 = rightPartitions.rows[i];
+                for (size_t j = heads[h & mask]; j != PARTITIONEDJOIN_EMPTY;
+                        j = next[j]) {
+                    const size_t r1 = leftPartitions.rows[lstart + j];
+                    if (leftPartitions.hashes[lstart + j] != h ||
+                            !sameKey(r1, r2)) {
+                        continue;
+                    }
+                    out->processResults(0, left, r1, right, r2, false);
+                }
+            }
+        }
+    }
+};
+
+PartitionedHashJoin::PartitionedHashJoin(
+        const std::vector<const ColumnView *> &left,
+        const std::vector<uint8_t> &fields1,
+        const int nthreads) : left(left), fields1(fields1),
+    nthreads(std::max(1, nthreads)) {
+    bits = 0;
+    while (bits < PARTITIONEDJOIN_MAX_BITS && ((size_t) 1 << bits) <
+            (size_t) this->nthreads * PARTITIONEDJOIN_PARTITIONS_PER_THREAD) {
+        bits++;
+    }
+    partition(left, fields1, leftPartitions);
+}
+
+void PartitionedHashJoin::partition(
+        const std::vector<const ColumnView *> &vectors,
+        const std::vector<uint8_t> &fields,
+        HashPartitions &out) const {
+    const size_t n = vectors.empty() ? 0 : vectors[0]->size();
+    const size_t npartitions = (size_t) 1 << bits;
+    const size_t chunk = std::max((size_t) 1, (n + nthreads - 1) / nthreads);
+    std::vector<uint64_t> hashes(n);
+    std::vector<std::vector<size_t>> histograms(nthreads);
+    for (auto &h : histograms) {
+        h.resize(npartitions);
+    }
+    ParallelTasks::parallel_for(0, nthreads, 1,
+            HashAndCount(vectors, fields, bits, hashes.data(),
+                histograms.data(), chunk, n));
+
+    //Turn the counts in starting offsets, ordered by partition and then by
+    //thread
+    out.start.resize(npartitions + 1);
+    size_t offset = 0;
+    for (size_t p = 0; p < npartitions; ++p) {
+        out.start[p] = offset;
+        for (int t = 0; t < nthreads; ++t) {
+            const size_t count = histograms[t][p];
+            histograms[t][p] = offset;
+            offset += count;
+        }
+    }
+    out.start[npartitions] = offset;
+
+    out.hashes.resize(n);
+    out.rows.resize(n);
+    ParallelTasks::parallel_for(0, nthreads, 1,
+            ScatterRows(hashes.data(), bits, histograms.data(), out, chunk,
+                n));
+}
+
+void PartitionedHashJoin::join(
+        const std::vector<const ColumnView *> &right,
+        const std::vector<uint8_t> &fields2,
+        ResultJoinProcessor *output) const {
+    HashPartitions rightPartitions;
+    partition(right, fields2, rightPartitions);
+
+    const size_t npartitions = (size_t) 1 << bits;
+    std::vector<Output *> outputs;
+    for (size_t p = 0; p < npartitions; ++p) {
+        outputs.push_back(new Output(output, true));
+    }
+    ParallelTasks::parallel_for(0, npartitions, 1,
+            JoinPartitions(left, right, fields1, fields2, leftPartitions,
+                rightPartitions, outputs));
+
+    Output::flushAll(outputs);
+}
@@ -0,0 +1,250 @@
+#include <vlog/radixsort.h>
+#include <vlog/column.h>
+
+#include <trident/utils/parallel.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS 256
+
+struct PackedLayout {
+    uint8_t ncols;
+    Term_t min[RADIXSORT_MAX_COLUMNS];
+    uint64_t mask[RADIXSORT_MAX_COLUMNS];
+    uint8_t shift[RADIXSORT_MAX_COLUMNS];
+    uint8_t totalBits;
+};
+
+static uint8_t bitsFor(const uint64_t v) {
+    return v == 0 ? 0 : 64 - __builtin_clzll(v);
+}
+
+template<typename K>
+struct PackKeys {
+    const std::vector<const ColumnView *> &columns;
+    const PackedLayout &layout;
+    K *keys;
+    const size_t chunk;
+    const size_t n;
+
+    PackKeys(const std::vector<const ColumnView *> &columns,
+            const PackedLayout &layout, K *keys, const size_t chunk,
+            const size_t n) : columns(columns), layout(layout), keys(keys),
+    chunk(chunk), n(n) {
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            const size_t end = std::min(n, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                K key = 0;
+                for (uint8_t c = 0; c < layout.ncols; ++c) {
+                    key |= ((K) ((*columns[c])[i] - layout.min[c])) <<
+                        layout.shift[c];
+                }
+                keys[i] = key;
+            }
+        }
+    }
+};
+
+template<typename K>
+struct CountDigits {
+    const K *keys;
+    const uint8_t digitShift;
+    std::vector<size_t> *histograms;
+    const size_t chunk;
+    const size_t n;
+
+    CountDigits(const K *keys, const uint8_t digitShift,
+            std::vector<size_t> *histograms, const size_t chunk,
+            const size_t n) : keys(keys), digitShift(digitShift),
+    histograms(histograms), chunk(chunk), n(n) {
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            size_t *h = histograms[t].data();
+            memset(h, 0, sizeof(size_t) * RADIX_BUCKETS);
+            const size_t end = std::min(n, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                h[(size_t) (keys[i] >> digitShift) & (RADIX_BUCKETS - 1)]++;
+            }
+        }
+    }
+};
+
+template<typename K>
+struct ScatterKeys {
+    const K *src;
+    K *dst;
+    const uint8_t digitShift;
+    std::vector<size_t> *offsets;
+    const size_t chunk;
+    const size_t n;
+
+    ScatterKeys(const K *src, K *dst, const uint8_t digitShift,
+            std::vector<size_t> *offsets, const size_t chunk,
+            const size_t n) : src(src), dst(dst), digitShift(digitShift),
+    offsets(offsets), chunk(chunk), n(n) {
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            size_t *o = offsets[t].data();
+            const size_t end = std::min(n, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                const K key = src[i];
+                dst[o[(size_t) (key >> digitShift) & (RADIX_BUCKETS - 1)]++] =
+                    key;
+            }
+        }
+    }
+};
+
+template<typename K>
+struct UnpackKeys {
+    const K *keys;
+    const PackedLayout &layout;
+    std::vector<std::vector<Term_t>> &out;
+    const size_t chunk;
+    const size_t n;
+
+    UnpackKeys(const K *keys, const PackedLayout &layout,
+            std::vector<std::vector<Term_t>> &out, const size_t chunk,
+            const size_t n) : keys(keys), layout(layout), out(out),
+    chunk(chunk), n(n) {
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t t = r.begin(); t != r.end(); ++t) {
+            const size_t end = std::min(n, (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; ++i) {
+                const K key = keys[i];
+                for (uint8_t c = 0; c < layout.ncols; ++c) {
+                    out[c][i] = (Term_t) ((uint64_t) (key >> layout.shift[c]) &
+                            layout.mask[c]) + layout.min[c];
+                }
+            }
+        }
+    }
+};
+
+template<typename K>
+static void sortPacked(const std::vector<const ColumnView *> &columns,
+        const PackedLayout &layout, std::vector<std::vector<Term_t>> &out,
+        const bool filterDupl, const int nthreads) {
+    const size_t n = columns[0]->size();
+    const size_t chunk = (n + nthreads - 1) / nthreads;
+    std::vector<K> keys(n);
+    std::vector<K> tmp(n);
+
+    ParallelTasks::parallel_for(0, nthreads, 1,
+            PackKeys<K>(columns, layout, keys.data(), chunk, n));
+
+    std::vector<std::vector<size_t>> histograms(nthreads);
+    for (auto &h : histograms) {
+        h.resize(RADIX_BUCKETS);
+    }
+    K *src = keys.data();
+    K *dst = tmp.data();
+    for (uint8_t digitShift = 0; digitShift < layout.totalBits;
+            digitShift += RADIX_BITS) {
+        ParallelTasks::parallel_for(0, nthreads, 1,
+                CountDigits<K>(src, digitShift, histograms.data(), chunk, n));
+
+        //Turn the counts in starting offsets, ordered by digit and then by
+        //thread so that the pass is stable. Skip the digit if all the keys
+        //share it
+        size_t offset = 0;
+        bool skip = false;
+        for (size_t d = 0; d < RADIX_BUCKETS && !skip; ++d) {
+            size_t total = 0;
+            for (int t = 0; t < nthreads; ++t) {
+                total += histograms[t][d];
+            }
+            skip = total == n;
+        }
+        if (skip) {
+            continue;
+        }
+        for (size_t d = 0; d < RADIX_BUCKETS; ++d) {
+            for (int t = 0; t < nthreads; ++t) {
+                const size_t count = histograms[t][d];
+                histograms[t][d] = offset;
+                offset += count;
+            }
+        }
+        ParallelTasks::parallel_for(0, nthreads, 1,
+                ScatterKeys<K>(src, dst, digitShift, histograms.data(), chunk,
+                    n));
+        std::swap(src, dst);
+    }
+
+    size_t nout = n;
+    if (filterDupl) {
+        nout = std::unique(src, src + n) - src;
+    }
+    out.resize(layout.ncols);
+    for (auto &o : out) {
+        o.resize(nout);
+    }
+    const size_t outChunk = (nout + nthreads - 1) / nthreads;
+    ParallelTasks::parallel_for(0, nthreads, 1,
+            UnpackKeys<K>(src, layout, out, outChunk, nout));
+}
+
+bool RadixSort::sort(const std::vector<const ColumnView *> &columns,
+        std::vector<std::vector<Term_t>> &out,
+        const bool filterDupl, const int nthreads) {
+#if TERM_AS_STRUCT
+    return false;
+#else
+    if (columns.empty() || columns.size() > RADIXSORT_MAX_COLUMNS) {
+        return false;
+    }
+    PackedLayout layout;
+    layout.ncols = columns.size();
+    uint8_t bits[RADIXSORT_MAX_COLUMNS];
+    int totalBits = 0;
+    for (uint8_t c = 0; c < layout.ncols; ++c) {
+        const ColumnView &v = *columns[c];
+        if (v.empty()) {
+            return false;
+        }
+        Term_t min = v[0], max = v[0];
+        for (size_t i = 1; i < v.size(); ++i) {
+            const Term_t x = v[i];
+            min = std::min(min, x);
+            max = std::max(max, x);
+        }
+        layout.min[c] = min;
+        bits[c] = bitsFor(max - min);
+        layout.mask[c] = bits[c] == 64 ? ~0ull : (1ull << bits[c]) - 1;
+        totalBits += bits[c];
+    }
+    if (totalBits > 128) {
+        return false;
+    }
+    //The first column goes in the most significant bits
+    uint8_t shift = 0;
+    for (int c = layout.ncols - 1; c >= 0; --c) {
+        //A constant column takes no bits (and must not be shifted by the
+        //whole width of the key)
+        layout.shift[c] = bits[c] == 0 ? 0 : shift;
+        shift += bits[c];
+    }
+    layout.totalBits = totalBits;
+
+    const int threads = std::max(1, nthreads);
+    if (totalBits <= 64) {
+        sortPacked<uint64_t>(columns, layout, out, filterDupl, threads);
+    } else {
+        sortPacked<unsigned __int128>(columns, layout, out, filterDupl,
+                threads);
+    }
+    return true;
+#endif
+}
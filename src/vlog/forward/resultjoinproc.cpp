@@ -68,7 +68,7 @@ void InterTableJoinProcessor::processResults(const int blockid, const Term_t *fi
 }
 
 void InterTableJoinProcessor::processResults(std::vector<int> &blockid, Term_t *p,
-        std::vector<bool> &unique, std::mutex *m) {
+        std::vector<uint8_t> &unique, std::mutex *m) {
 
     int newBufsize = currentSegmentSize;
     for (int j = 0; j < blockid.size(); j++) {
@@ -117,8 +117,8 @@ void InterTableJoinProcessor::processResults(const int blockid, FCInternalTableI
 }
 
 void InterTableJoinProcessor::processResults(const int blockid,
-        const std::vector<const std::vector<Term_t> *> &vectors1, size_t i1,
-        const std::vector<const std::vector<Term_t> *> &vectors2, size_t i2,
+        const std::vector<const ColumnView *> &vectors1, size_t i1,
+        const std::vector<const ColumnView *> &vectors2, size_t i2,
         const bool unique) {
     for (int i = 0; i < nCopyFromFirst; i++) {
         row[posFromFirst[i].first] = (*vectors1[posFromFirst[i].second])[i1];
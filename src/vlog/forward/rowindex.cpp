@@ -0,0 +1,275 @@
+#include <vlog/rowindex.h>
+#include <vlog/fcinttable.h>
+#include <vlog/segment.h>
+
+#define ROWINDEX_INITIAL_SLOTS 1024
+#define ROWINDEX_ROW_MASK ((1ull << ROWINDEX_ROW_BITS) - 1)
+
+RowIndex::RowIndex(const uint8_t sizeRow) : sizeRow(sizeRow), nrows(0) {
+    fingerprints.resize(ROWINDEX_INITIAL_SLOTS);
+    entries.resize(ROWINDEX_INITIAL_SLOTS);
+}
+
+bool RowIndex::canIndex(std::shared_ptr<const FCInternalTable> table) {
+    return !table->isEDB() && !table->isEmpty() &&
+        table->supportsDirectAccess();
+}
+
+size_t RowIndex::getMemoryBytes() const {
+    return fingerprints.size() * sizeof(uint64_t) +
+        entries.size() * sizeof(uint64_t) +
+        sources.size() * (sizeof(Source) +
+                sizeRow * sizeof(std::shared_ptr<Column>));
+}
+
+uint64_t RowIndex::fingerprint(const Term_t *row) const {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        h = (h ^ (uint64_t) row[i]) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    //0 marks the empty slots
+    return h == 0 ? 1 : h;
+}
+
+bool RowIndex::equals(const uint64_t entry, const Term_t *row) const {
+    const Source &source = sources[entry >> ROWINDEX_ROW_BITS];
+    const size_t pos = entry & ROWINDEX_ROW_MASK;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        if (source.columns[i]->getValue(pos) != row[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t RowIndex::find(const Term_t *row, const uint64_t fp) const {
+    const size_t mask = fingerprints.size() - 1;
+    size_t slot = fp & mask;
+    while (fingerprints[slot] != 0) {
+        if (fingerprints[slot] == fp && equals(entries[slot], row)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void RowIndex::grow() {
+    std::vector<uint64_t> oldFingerprints(fingerprints.size() * 2);
+    std::vector<uint64_t> oldEntries(entries.size() * 2);
+    oldFingerprints.swap(fingerprints);
+    oldEntries.swap(entries);
+    const size_t mask = fingerprints.size() - 1;
+    for (size_t i = 0; i < oldFingerprints.size(); ++i) {
+        if (oldFingerprints[i] != 0) {
+            //The rows are distinct, no need to compare them
+            size_t slot = oldFingerprints[i] & mask;
+            while (fingerprints[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            fingerprints[slot] = oldFingerprints[i];
+            entries[slot] = oldEntries[i];
+        }
+    }
+}
+
+void RowIndex::erase(size_t slot) {
+    const size_t mask = fingerprints.size() - 1;
+    size_t i = slot;
+    while (true) {
+        i = (i + 1) & mask;
+        if (fingerprints[i] == 0) {
+            break;
+        }
+        //The entry can fill the hole only if its home slot is not between
+        //the hole and its current slot
+        const size_t home = fingerprints[i] & mask;
+        const bool between = slot < i ? (home > slot && home <= i) :
+            (home > slot || home <= i);
+        if (!between) {
+            fingerprints[slot] = fingerprints[i];
+            entries[slot] = entries[i];
+            slot = i;
+        }
+    }
+    fingerprints[slot] = 0;
+    nrows--;
+}
+
+uint32_t RowIndex::addSource(std::shared_ptr<const FCInternalTable> table,
+        std::vector<std::shared_ptr<Column>> &columns) {
+    uint32_t id;
+    if (!freeSources.empty()) {
+        id = freeSources.back();
+        freeSources.pop_back();
+    } else {
+        if (sources.size() == ROWINDEX_MAX_SOURCES) {
+            LOG(ERRORL) << "Too many tables in the row index";
+            throw 10;
+        }
+        id = sources.size();
+        sources.push_back(Source());
+    }
+    sources[id].table = table;
+    sources[id].columns.swap(columns);
+    if (table != NULL) {
+        sourceIds[table.get()] = id;
+    }
+    return id;
+}
+
+bool RowIndex::insert(const uint32_t source, const size_t pos,
+        const Term_t *row) {
+    const uint64_t fp = fingerprint(row);
+    size_t slot = find(row, fp);
+    if (fingerprints[slot] != 0) {
+        return false;
+    }
+    //Keep the load factor below 1/2
+    if (2 * (nrows + 1) > fingerprints.size()) {
+        grow();
+        slot = find(row, fp);
+    }
+    fingerprints[slot] = fp;
+    entries[slot] = ((uint64_t) source << ROWINDEX_ROW_BITS) | pos;
+    nrows++;
+    return true;
+}
+
+bool RowIndex::contains(const Term_t *row) const {
+    return fingerprints[find(row, fingerprint(row))] != 0;
+}
+
+//Call 'f' on every row of the columns, with its position
+template<typename F>
+static void scanRows(const std::vector<std::shared_ptr<Column>> &columns,
+        F f) {
+    const uint8_t sizeRow = columns.size();
+    std::vector<std::unique_ptr<ColumnReader>> readers;
+    for (const auto &c : columns) {
+        readers.push_back(c->getReader());
+    }
+    ColumnBatch batch(sizeRow);
+    std::vector<Term_t> row(sizeRow);
+    size_t pos = 0;
+    while (true) {
+        size_t n = readers[0]->nextBatch(batch.columns[0], BATCH_ROWS);
+        if (n == 0) {
+            break;
+        }
+        for (uint8_t i = 1; i < sizeRow; ++i) {
+            readers[i]->nextBatch(batch.columns[i], n);
+        }
+        for (size_t j = 0; j < n; ++j) {
+            for (uint8_t i = 0; i < sizeRow; ++i) {
+                row[i] = batch.columns[i][j];
+            }
+            f(pos++, row.data());
+        }
+    }
+}
+
+void RowIndex::insert(std::shared_ptr<const FCInternalTable> table) {
+    std::vector<std::shared_ptr<Column>> columns;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        columns.push_back(table->getColumn(i));
+    }
+    const uint32_t id = addSource(table, columns);
+    //A row that is already in another table keeps the entry of that table
+    scanRows(sources[id].columns, [this, id](const size_t pos,
+                const Term_t *row) {
+            insert(id, pos, row);
+            });
+}
+
+void RowIndex::remove(std::shared_ptr<const FCInternalTable> table) {
+    auto el = sourceIds.find(table.get());
+    if (el == sourceIds.end()) {
+        return;
+    }
+    const uint32_t id = el->second;
+    scanRows(sources[id].columns, [this, id](const size_t pos,
+                const Term_t *row) {
+            const uint64_t entry = ((uint64_t) id << ROWINDEX_ROW_BITS) | pos;
+            const size_t mask = fingerprints.size() - 1;
+            size_t slot = fingerprint(row) & mask;
+            while (fingerprints[slot] != 0) {
+                if (entries[slot] == entry) {
+                    erase(slot);
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+            });
+    sourceIds.erase(el);
+    sources[id].table.reset();
+    sources[id].columns.clear();
+    freeSources.push_back(id);
+}
+
+void RowIndex::replace(std::shared_ptr<const FCInternalTable> oldTable,
+        std::shared_ptr<const FCInternalTable> newTable) {
+    auto el = sourceIds.find(oldTable.get());
+    if (el == sourceIds.end()) {
+        return;
+    }
+    const uint32_t id = el->second;
+    sourceIds.erase(el);
+    Source &source = sources[id];
+    source.table = newTable;
+    for (uint8_t i = 0; i < sizeRow; ++i) {
+        source.columns[i] = newTable->getColumn(i);
+    }
+    sourceIds[newTable.get()] = id;
+}
+
+std::shared_ptr<const Segment> RowIndex::retain(
+        std::shared_ptr<const Segment> segment,
+        const bool duplicates) const {
+    if (segment->isEmpty()) {
+        return segment;
+    }
+    //The repeated rows of the segment are found with an index of the
+    //segment itself
+    std::unique_ptr<RowIndex> seen;
+    uint32_t segmentId = 0;
+    if (duplicates) {
+        seen = std::unique_ptr<RowIndex>(new RowIndex(sizeRow));
+        std::vector<std::shared_ptr<Column>> columns;
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            std::shared_ptr<Column> c = segment->getColumn(i);
+            if (!c->supportsDirectAccess()) {
+                std::vector<Term_t> values = c->getReader()->asVector();
+                ColumnWriter writer(values);
+                c = writer.getColumn();
+            }
+            columns.push_back(c);
+        }
+        segmentId = seen->addSource(std::shared_ptr<const FCInternalTable>(),
+                columns);
+    }
+    std::vector<Term_t> row(sizeRow);
+    SegmentInserter retainedValues(sizeRow);
+    bool removed = false;
+    size_t pos = 0;
+    std::unique_ptr<SegmentIterator> itr = segment->iterator();
+    while (itr->hasNext()) {
+        itr->next();
+        for (uint8_t i = 0; i < sizeRow; ++i) {
+            row[i] = itr->get(i);
+        }
+        if (contains(row.data()) ||
+                (duplicates && !seen->insert(segmentId, pos, row.data()))) {
+            removed = true;
+        } else {
+            retainedValues.addRow(*itr.get());
+        }
+        pos++;
+    }
+    itr->clear();
+    if (!removed) {
+        return segment;
+    }
+    return retainedValues.getSegment();
+}
@@ -2,6 +2,7 @@
 
 #include <set>
 #include <map>
+#include <algorithm>
 
 void RuleExecutionDetails::rearrangeLiterals(std::vector<const Literal*> &vector, const size_t idx) {
     //First go through all the elements before, to make sure that there is always at least one shared variable.
@@ -162,6 +163,9 @@ void RuleExecutionDetails::checkFilteringStrategy(
 }
 
 void RuleExecutionDetails::calculateNVarsInHeadFromEDB() {
+    posEDBVarsInHead.clear();
+    occEDBVarsInHead.clear();
+    edbLiteralPerHeadVars.clear();
     int globalCounter = 0;
     for (auto head : rule.getHeads()) {
         for (uint8_t i = 0; i < head.getTupleSize(); ++i) {
@@ -445,3 +449,69 @@ void RuleExecutionDetails::createExecutionPlans() {
         orderExecutions.push_back(p);
     }
 }
+
+bool RuleExecutionDetails::readsPredicate(
+        const std::vector<PredId_t> &preds) const {
+    for (const auto &lit : rule.getBody()) {
+        if (std::find(preds.begin(), preds.end(),
+                    lit.getPredicate().getId()) != preds.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RuleExecutionDetails::createExecutionPlans(
+        const std::vector<PredId_t> &deltaEDBs) {
+    createExecutionPlans();
+    std::map<uint8_t, std::vector<uint8_t>> dependenciesExtVars =
+        orderExecutions[0].dependenciesExtVars;
+    if (nIDBs == 0) {
+        //The plan over all the EDB tuples was already executed
+        orderExecutions.clear();
+    }
+
+    for (uint8_t k = 0; k < bodyLiterals.size(); ++k) {
+        const Literal *pivot = &bodyLiterals[k];
+        if (pivot->getPredicate().getType() != EDB ||
+                std::find(deltaEDBs.begin(), deltaEDBs.end(),
+                    pivot->getPredicate().getId()) == deltaEDBs.end()) {
+            continue;
+        }
+
+        RuleExecutionPlan p;
+        p.dependenciesExtVars = dependenciesExtVars;
+        p.plan.push_back(pivot);
+        for (uint8_t i = 0; i < bodyLiterals.size(); ++i) {
+            if (i != k) {
+                p.plan.push_back(&bodyLiterals[i]);
+            }
+        }
+        rearrangeLiterals(p.plan, 0);
+
+        auto &heads = rule.getHeads();
+        if (heads.size() == 1) {
+            RuleExecutionDetails::checkFilteringStrategy(
+                    *p.plan[p.plan.size() - 1], heads[0], p);
+            p.checkIfFilteringHashMapIsPossible(heads[0]);
+        }
+        p.calculateJoinsCoordinates(heads);
+
+        //The pivot reads only the new tuples, the updated atoms before it
+        //only the old ones (so that every combination is computed once),
+        //all the others everything
+        for (int i = 0; i < p.plan.size(); ++i) {
+            const Literal *l = p.plan[i];
+            if (l == pivot) {
+                p.ranges.push_back(std::make_pair(1, (size_t) - 1));
+            } else if (l < pivot && l->getPredicate().getType() == EDB &&
+                    std::find(deltaEDBs.begin(), deltaEDBs.end(),
+                        l->getPredicate().getId()) != deltaEDBs.end()) {
+                p.ranges.push_back(std::make_pair(0, 1));
+            } else {
+                p.ranges.push_back(std::make_pair(0, (size_t) - 1));
+            }
+        }
+        orderExecutions.push_back(p);
+    }
+}
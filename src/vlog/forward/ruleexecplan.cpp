@@ -4,6 +4,7 @@
 #include <kognac/logs.h>
 
 #include <set>
+#include <algorithm>
 
 void RuleExecutionPlan::checkIfFilteringHashMapIsPossible(const Literal &head) {
     //2 conditions: the last literal shares the same variables as the head in the same position and has the same constants
@@ -252,3 +253,54 @@ bool RuleExecutionPlan::hasCartesian() {
     }
     return false;
 }
+
+bool RuleExecutionPlan::isCyclic() const {
+    //GYO reduction: remove the variables that occur in one literal only and
+    //the literals whose variables all occur in another literal. The body is
+    //acyclic if at most one literal is left
+    std::vector<std::vector<uint8_t>> edges;
+    for (const auto lit : plan) {
+        edges.push_back(lit->getAllVars());
+    }
+    bool changed = true;
+    while (changed && edges.size() > 1) {
+        changed = false;
+        for (auto &edge : edges) {
+            for (int i = edge.size() - 1; i >= 0; --i) {
+                int count = 0;
+                for (const auto &other : edges) {
+                    if (std::find(other.begin(), other.end(), edge[i]) !=
+                            other.end()) {
+                        count++;
+                    }
+                }
+                if (count == 1) {
+                    edge.erase(edge.begin() + i);
+                    changed = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < edges.size(); ++i) {
+            bool contained = false;
+            for (size_t j = 0; j < edges.size() && !contained; ++j) {
+                if (i == j) {
+                    continue;
+                }
+                contained = true;
+                for (const auto v : edges[i]) {
+                    if (std::find(edges[j].begin(), edges[j].end(), v) ==
+                            edges[j].end()) {
+                        contained = false;
+                        break;
+                    }
+                }
+            }
+            if (contained) {
+                edges.erase(edges.begin() + i);
+                changed = true;
+                break;
+            }
+        }
+    }
+    return edges.size() > 1;
+}
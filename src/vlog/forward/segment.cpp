@@ -2,6 +2,7 @@
 #include <vlog/segment_support.h>
 #include <vlog/support.h>
 #include <vlog/fcinttable.h>
+#include <vlog/radixsort.h>
 
 //#include <tbb/parallel_for.h>
 
@@ -231,6 +232,31 @@ std::shared_ptr<Segment> Segment::sortBy(const std::vector<uint8_t> *fields,
     }
 }
 
+//Sort (and deduplicate, if requested) up to RADIXSORT_MAX_COLUMNS columns
+//with a radix sort on packed keys. Returns false if the comparator-based
+//sort should be used instead
+static bool radixSortColumns(const std::vector<std::shared_ptr<Column>> &varColumns,
+        std::vector<std::shared_ptr<Column>> &sortedColumns,
+        const bool filterDupl, const int nthreads) {
+    if (varColumns.size() > RADIXSORT_MAX_COLUMNS ||
+            varColumns[0]->size() < RADIXSORT_MIN_ROWS) {
+        return false;
+    }
+    std::vector<const ColumnView *> vectors =
+        Segment::getAllVectors(varColumns, nthreads);
+    std::vector<std::vector<Term_t>> out;
+    const bool sorted = RadixSort::sort(vectors, out, filterDupl, nthreads);
+    Segment::deleteAllVectors(varColumns, vectors);
+    if (!sorted) {
+        return false;
+    }
+    sortedColumns.push_back(ColumnWriter::getColumn(out[0], true));
+    for (size_t i = 1; i < out.size(); ++i) {
+        sortedColumns.push_back(ColumnWriter::getColumn(out[i], false));
+    }
+    return true;
+}
+
 std::shared_ptr<Segment> Segment::intsort(
         const std::vector<uint8_t> *fields) const {
     if (!isEmpty()) {
@@ -250,7 +276,9 @@ std::shared_ptr<Segment> Segment::intsort(
         if (varColumns.size() == 0) {
             return std::shared_ptr<Segment>(new Segment(nfields, columns));
         } else if (varColumns.size() == 1) {
-            sortedColumns.push_back(varColumns[0]->sort());
+            if (!radixSortColumns(varColumns, sortedColumns, false, 1)) {
+                sortedColumns.push_back(varColumns[0]->sort());
+            }
         } else {
             if (fields != NULL) {
                 //Rearrange the fields
@@ -282,9 +310,11 @@ std::shared_ptr<Segment> Segment::intsort(
                 idxVarColumns = newIdxVarColumns;
             }
 
-            if (varColumns.size() == 2) {
+            if (radixSortColumns(varColumns, sortedColumns, false, 1)) {
+                //Done
+            } else if (varColumns.size() == 2) {
                 //Populate the array
-                std::vector<const std::vector<Term_t> *> vectors = getAllVectors(varColumns);
+                std::vector<const ColumnView *> vectors = getAllVectors(varColumns);
                 std::vector<std::pair<Term_t, Term_t>> values;
                 size_t sz1 = vectors[0]->size();
                 size_t sz2 = vectors[1]->size();
@@ -306,7 +336,7 @@ std::shared_ptr<Segment> Segment::intsort(
                 sortedColumns.push_back(sortedColumnsInserters[1].getColumn());
             } else {
                 //Sort function
-                std::vector<const std::vector<Term_t> *> vectors = getAllVectors(varColumns);
+                std::vector<const ColumnView *> vectors = getAllVectors(varColumns);
                 SegmentSorter sorter(vectors);
 
                 const size_t allRows = vectors[0]->size();
@@ -393,7 +423,10 @@ std::shared_ptr<Segment> Segment::intsort(
             }
         } else if (varColumns.size() == 1) {
             //std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-            if (filterDupl) {
+            if (radixSortColumns(varColumns, sortedColumns, filterDupl,
+                        nthreads)) {
+                //Done
+            } else if (filterDupl) {
                 sortedColumns.push_back(varColumns[0]->sort_and_unique(nthreads));
             } else {
                 sortedColumns.push_back(varColumns[0]->sort(nthreads));
@@ -431,186 +464,190 @@ std::shared_ptr<Segment> Segment::intsort(
                 idxVarColumns = newIdxVarColumns;
             }
 
-            std::vector<const std::vector<Term_t> *> vectors = getAllVectors(varColumns, nthreads);
-
-            size_t sz = varColumns[0]->size();
-            std::vector<size_t> idxs;
-            idxs.reserve(sz);
-
-            size_t chunks = (sz + nthreads - 1) / nthreads;
-
-            /*
-               if (idxs.size() >= 1000000) {
-               tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
-               InitArray(idxs));
-               } else
-               */
-            {
-                for (size_t i = 0; i < sz; i++) {
-                    idxs.push_back(i);
+            if (!radixSortColumns(varColumns, sortedColumns, filterDupl,
+                        nthreads)) {
+                std::vector<const ColumnView *> vectors = getAllVectors(varColumns, nthreads);
+
+                size_t sz = varColumns[0]->size();
+                std::vector<size_t> idxs;
+                idxs.reserve(sz);
+
+                size_t chunks = (sz + nthreads - 1) / nthreads;
+
+                /*
+                   if (idxs.size() >= 1000000) {
+                   tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
+                   InitArray(idxs));
+                   } else
+                   */
+                {
+                    for (size_t i = 0; i < sz; i++) {
+                        idxs.push_back(i);
+                    }
                 }
-            }
 
-            if (varColumns.size() == 2) {
-                //Populate array
-                //std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-                const Term_t *rawv1 = &(*(vectors[0]))[0];
-                const Term_t *rawv2 = &(*(vectors[1]))[0];
+                if (varColumns.size() == 2) {
+                    //Populate array
+                    //std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+                    std::vector<Term_t> buffer1, buffer2;
+                    const Term_t *rawv1 = vectors[0]->contiguous(buffer1);
+                    const Term_t *rawv2 = vectors[1]->contiguous(buffer2);
 
-                //std::chrono::duration<double> sec1 = std::chrono::system_clock::now() - start;
-                //LOG(WARNL) << "---- populate pairs vector =" << sec1.count() * 1000 << " " << varColumns[0]->size();
+                    //std::chrono::duration<double> sec1 = std::chrono::system_clock::now() - start;
+                    //LOG(WARNL) << "---- populate pairs vector =" << sec1.count() * 1000 << " " << varColumns[0]->size();
 
-                //Sort
-                //start = std::chrono::system_clock::now();
-                PairComparator pc(rawv1, rawv2);
+                    //Sort
+                    //start = std::chrono::system_clock::now();
+                    PairComparator pc(rawv1, rawv2);
 
-                if (idxs.size() > 1000) {
-                    ParallelTasks::sort_int(idxs.begin(), idxs.end(), pc, nthreads);
-                } else {
-                    std::sort(idxs.begin(), idxs.end(), pc);
-                }
-                //sec1 = std::chrono::system_clock::now() - start;
-                //LOG(WARNL) << "---- parallel sort =" << sec1.count() * 1000 << " " << nthreads;
-
-                //Copy back sorted columns
-                //start = std::chrono::system_clock::now();
-                if (!filterDupl) {
-                    std::vector<Term_t> out1;
-                    std::vector<Term_t> out2;
-                    // Not sure if it makes sense to do this in parallel at all
-                    if (chunks < 10000) {
-                        // Sequential version
-                        out1.reserve(sz);
-                        out2.reserve(sz);
-                        for (size_t i = 0; i < sz; i++) {
-                            out1.push_back(rawv1[idxs[i]]);
-                            out2.push_back( rawv2[idxs[i]]);
-                        }
+                    if (idxs.size() > 1000) {
+                        ParallelTasks::sort_int(idxs.begin(), idxs.end(), pc, nthreads);
                     } else {
-                        // Parallel version
-                        out1.resize(sz);
-                        out2.resize(sz);
-                        //tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
-                        //        CreateColumns2(idxs, rawv1, rawv2, out1, out2));
-                        ParallelTasks::parallel_for(0, idxs.size(), chunks,
-                                CreateColumns2(idxs, rawv1, rawv2, out1, out2));
+                        std::sort(idxs.begin(), idxs.end(), pc);
                     }
-                    sortedColumns.push_back(ColumnWriter::getColumn(out1, true));
-                    sortedColumns.push_back(ColumnWriter::getColumn(out2, false));
-                } else {
-                    // Not sure if it makes sense to do this in parallel at all
-                    if (chunks < 10000) {
-                        // Sequential version
-                        Term_t prev1 = (Term_t) - 1;
-                        Term_t prev2 = (Term_t) - 1;
+                    //sec1 = std::chrono::system_clock::now() - start;
+                    //LOG(WARNL) << "---- parallel sort =" << sec1.count() * 1000 << " " << nthreads;
+
+                    //Copy back sorted columns
+                    //start = std::chrono::system_clock::now();
+                    if (!filterDupl) {
                         std::vector<Term_t> out1;
                         std::vector<Term_t> out2;
-                        for (size_t i = 0; i < idxs.size(); i++) {
-                            const Term_t value1 =  rawv1[idxs[i]];
-                            const Term_t value2 =  rawv2[idxs[i]];
-                            if (value1 != prev1 || value2 != prev2) {
-                                out1.push_back(value1);
-                                out2.push_back(value2);
+                        // Not sure if it makes sense to do this in parallel at all
+                        if (chunks < 10000) {
+                            // Sequential version
+                            out1.reserve(sz);
+                            out2.reserve(sz);
+                            for (size_t i = 0; i < sz; i++) {
+                                out1.push_back(rawv1[idxs[i]]);
+                                out2.push_back( rawv2[idxs[i]]);
                             }
-                            prev1 = value1;
-                            prev2 = value2;
+                        } else {
+                            // Parallel version
+                            out1.resize(sz);
+                            out2.resize(sz);
+                            //tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
+                            //        CreateColumns2(idxs, rawv1, rawv2, out1, out2));
+                            ParallelTasks::parallel_for(0, idxs.size(), chunks,
+                                    CreateColumns2(idxs, rawv1, rawv2, out1, out2));
                         }
                         sortedColumns.push_back(ColumnWriter::getColumn(out1, true));
                         sortedColumns.push_back(ColumnWriter::getColumn(out2, false));
                     } else {
-                        // Parallel version
-                        std::vector<std::pair<size_t, std::vector<Term_t>>> ranges1;
-                        std::vector<std::pair<size_t, std::vector<Term_t>>> ranges2;
-                        std::mutex m;
-                        //tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
-                        //        CreateColumnsNoDupl2(idxs, rawv1, rawv2,
-                        //            ranges1, ranges2, m));
-                        ParallelTasks::parallel_for(0, idxs.size(), chunks,
-                                CreateColumnsNoDupl2(idxs, rawv1, rawv2,
-                                    ranges1, ranges2, m));
-
-                        size_t totalSize = 0;
-                        for (size_t i = 0; i < ranges1.size(); ++i) {
-                            totalSize += ranges1[i].second.size();
-                        }
-                        std::vector<Term_t> out1;
-                        std::vector<Term_t> out2;
-                        out1.reserve(totalSize);
-                        out2.reserve(totalSize);
-
-                        //Sort the ranges
-                        std::vector<int> idxRanges;
-                        for (int i = 0; i < ranges1.size(); ++i) {
-                            idxRanges.push_back(i);
-                        }
-                        std::sort(idxRanges.begin(), idxRanges.end(),
-                                CompareRanges(ranges1));
-                        for (int i = 0; i < ranges1.size(); ++i) {
-                            size_t idx = idxRanges[i];
-                            std::vector<Term_t> &vals1 = ranges1[idx].second;
-                            std::vector<Term_t> &vals2 = ranges2[idx].second;
-                            assert(ranges1[idx].first == ranges2[idx].first);
-                            assert(vals1.size() == vals2.size());
-                            for (size_t idxtocopy = 0; idxtocopy < vals1.size();
-                                    idxtocopy++) {
-                                out1.push_back(vals1[idxtocopy]);
-                                out2.push_back(vals2[idxtocopy]);
+                        // Not sure if it makes sense to do this in parallel at all
+                        if (chunks < 10000) {
+                            // Sequential version
+                            Term_t prev1 = (Term_t) - 1;
+                            Term_t prev2 = (Term_t) - 1;
+                            std::vector<Term_t> out1;
+                            std::vector<Term_t> out2;
+                            for (size_t i = 0; i < idxs.size(); i++) {
+                                const Term_t value1 =  rawv1[idxs[i]];
+                                const Term_t value2 =  rawv2[idxs[i]];
+                                if (value1 != prev1 || value2 != prev2) {
+                                    out1.push_back(value1);
+                                    out2.push_back(value2);
+                                }
+                                prev1 = value1;
+                                prev2 = value2;
+                            }
+                            sortedColumns.push_back(ColumnWriter::getColumn(out1, true));
+                            sortedColumns.push_back(ColumnWriter::getColumn(out2, false));
+                        } else {
+                            // Parallel version
+                            std::vector<std::pair<size_t, std::vector<Term_t>>> ranges1;
+                            std::vector<std::pair<size_t, std::vector<Term_t>>> ranges2;
+                            std::mutex m;
+                            //tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
+                            //        CreateColumnsNoDupl2(idxs, rawv1, rawv2,
+                            //            ranges1, ranges2, m));
+                            ParallelTasks::parallel_for(0, idxs.size(), chunks,
+                                    CreateColumnsNoDupl2(idxs, rawv1, rawv2,
+                                        ranges1, ranges2, m));
+
+                            size_t totalSize = 0;
+                            for (size_t i = 0; i < ranges1.size(); ++i) {
+                                totalSize += ranges1[i].second.size();
                             }
+                            std::vector<Term_t> out1;
+                            std::vector<Term_t> out2;
+                            out1.reserve(totalSize);
+                            out2.reserve(totalSize);
+
+                            //Sort the ranges
+                            std::vector<int> idxRanges;
+                            for (int i = 0; i < ranges1.size(); ++i) {
+                                idxRanges.push_back(i);
+                            }
+                            std::sort(idxRanges.begin(), idxRanges.end(),
+                                    CompareRanges(ranges1));
+                            for (int i = 0; i < ranges1.size(); ++i) {
+                                size_t idx = idxRanges[i];
+                                std::vector<Term_t> &vals1 = ranges1[idx].second;
+                                std::vector<Term_t> &vals2 = ranges2[idx].second;
+                                assert(ranges1[idx].first == ranges2[idx].first);
+                                assert(vals1.size() == vals2.size());
+                                for (size_t idxtocopy = 0; idxtocopy < vals1.size();
+                                        idxtocopy++) {
+                                    out1.push_back(vals1[idxtocopy]);
+                                    out2.push_back(vals2[idxtocopy]);
+                                }
+                            }
+                            sortedColumns.push_back(ColumnWriter::getColumn(out1, true));
+                            sortedColumns.push_back(ColumnWriter::getColumn(out2, false));
                         }
-                        sortedColumns.push_back(ColumnWriter::getColumn(out1, true));
-                        sortedColumns.push_back(ColumnWriter::getColumn(out2, false));
                     }
-                }
-                //sec1 = std::chrono::system_clock::now() - start;
-                //LOG(WARNL) << "---- copy back =" << sec1.count() * 1000 << " " << nthreads;
-            } else {
-                //Sort function
-                SegmentSorter sorter(vectors);
-
-                if (nthreads > 1 && idxs.size() > 1000) {
-                    ParallelTasks::sort_int(idxs.begin(), idxs.end(), std::ref(sorter), nthreads);
+                    //sec1 = std::chrono::system_clock::now() - start;
+                    //LOG(WARNL) << "---- copy back =" << sec1.count() * 1000 << " " << nthreads;
                 } else {
-                    std::sort(idxs.begin(), idxs.end(), std::ref(sorter));
-                }
-                // LOG(TRACEL) << "Sort done.";
-                //
-                if (! filterDupl) {
-                    std::vector<std::vector<Term_t>> out(varColumns.size());
-                    // Not sure if it makes sense to do this in parallel at all
-                    if (nthreads <= 1 || chunks < 10000) {
-                        // Sequential version
-                        for (size_t i = 0; i < idxs.size(); i++) {
-                            for (int j = 0; j < out.size(); j++) {
-                                out[j].push_back((*vectors[j])[idxs[i]]);
+                    //Sort function
+                    SegmentSorter sorter(vectors);
+
+                    if (nthreads > 1 && idxs.size() > 1000) {
+                        ParallelTasks::sort_int(idxs.begin(), idxs.end(), std::ref(sorter), nthreads);
+                    } else {
+                        std::sort(idxs.begin(), idxs.end(), std::ref(sorter));
+                    }
+                    // LOG(TRACEL) << "Sort done.";
+                    //
+                    if (! filterDupl) {
+                        std::vector<std::vector<Term_t>> out(varColumns.size());
+                        // Not sure if it makes sense to do this in parallel at all
+                        if (nthreads <= 1 || chunks < 10000) {
+                            // Sequential version
+                            for (size_t i = 0; i < idxs.size(); i++) {
+                                for (int j = 0; j < out.size(); j++) {
+                                    out[j].push_back((*vectors[j])[idxs[i]]);
+                                }
+                            }
+                        } else {
+                            // Parallel version
+                            for (int i = 0; i < out.size(); i++) {
+                                out[i].resize(idxs.size());
                             }
+                            //tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
+                            //        CreateColumns(idxs, vectors, out));
+                            ParallelTasks::parallel_for(0, idxs.size(), chunks,
+                                    CreateColumns(idxs, vectors, out));
                         }
-                    } else {
-                        // Parallel version
-                        for (int i = 0; i < out.size(); i++) {
-                            out[i].resize(idxs.size());
+                        sortedColumns.push_back(ColumnWriter::getColumn(out[0], true));
+                        for (int i = 1; i < out.size(); i++) {
+                            sortedColumns.push_back(ColumnWriter::getColumn(out[i], false));
                         }
-                        //tbb::parallel_for(tbb::blocked_range<size_t>(0, idxs.size(), chunks),
-                        //        CreateColumns(idxs, vectors, out));
-                        ParallelTasks::parallel_for(0, idxs.size(), chunks,
-                                CreateColumns(idxs, vectors, out));
-                    }
-                    sortedColumns.push_back(ColumnWriter::getColumn(out[0], true));
-                    for (int i = 1; i < out.size(); i++) {
-                        sortedColumns.push_back(ColumnWriter::getColumn(out[i], false));
+                    } else {
+                        // TODO!
+                        throw 10;
                     }
-                } else {
-                    // TODO!
-                    throw 10;
                 }
+                deleteAllVectors(varColumns, vectors);
             }
-            deleteAllVectors(varColumns, vectors);
         }
 
         //Reconstruct all the fields
         std::vector<std::shared_ptr<Column>> allSortedColumns;
 
-        assert(varColumns.size() > 0);
-        size_t newsize = varColumns[0]->size();
+        assert(sortedColumns.size() > 0);
+        size_t newsize = sortedColumns[0]->size();
 
         for (uint8_t i = 0; i < nfields; ++i) {
             bool isVar = false;
@@ -728,6 +765,34 @@ void SegmentInserter::addRow(FCInternalTableItr *itr, const uint8_t *posToCopy)
     }
 }
 
+void SegmentInserter::addRows(Term_t **rows, const size_t n) {
+    if (n == 0) {
+        return;
+    }
+    if (segmentSorted) {
+        assert(nfields > 0);
+        //Compare every row with the previous one, the first with the last
+        //row that was added
+        for (size_t i = columns[0].isEmpty() ? 1 : 0; i < n && segmentSorted;
+                ++i) {
+            for (uint8_t j = 0; j < nfields; ++j) {
+                const Term_t prev = i == 0 ? columns[j].lastValue() :
+                    rows[j][i - 1];
+                if (rows[j][i] < prev) {
+                    segmentSorted = false;
+                    break;
+                } else if (rows[j][i] > prev) {
+                    break;
+                }
+            }
+        }
+    }
+
+    for (uint8_t j = 0; j < nfields; ++j) {
+        columns[j].add(rows[j], n);
+    }
+}
+
 void SegmentInserter::addRow(const Term_t *row) {
     if (segmentSorted) {
         assert(nfields > 0);
@@ -1763,18 +1828,22 @@ std::shared_ptr<const Segment> SegmentInserter::retain(
     }
 
     std::unique_ptr<SegmentIterator> Segment::iterator() const {
-        std::vector<const std::vector<Term_t> *> vectors;
+        std::vector<const ColumnView *> vectors;
         bool vectorSupported = true;
         for (int i = 0; i < nfields; i++) {
-            if (! columns[i]->isBackedByVector()) {
+            const Term_t *data = columns[i]->getData();
+            if (data == NULL) {
                 vectorSupported = false;
                 break;
             } else {
-                vectors.push_back(&columns[i]->getVectorRef());
+                vectors.push_back(new ColumnView(data, columns[i]->size()));
             }
         }
         if (vectorSupported) {
-            return std::unique_ptr<VectorSegmentIterator>(new VectorSegmentIterator(vectors, 0, vectors[0]->size(), NULL));
+            return std::unique_ptr<VectorSegmentIterator>(new VectorSegmentIterator(vectors, 0, vectors[0]->size(), new std::vector<bool>(nfields, true)));
+        }
+        for (auto v : vectors) {
+            delete v;
         }
 
         return std::unique_ptr<SegmentIterator>(
@@ -1782,18 +1851,9 @@ std::shared_ptr<const Segment> SegmentInserter::retain(
     }
 
     std::unique_ptr<VectorSegmentIterator> Segment::vectorIterator() const {
-        std::vector<const std::vector<Term_t> *> vectors;
-        std::vector<bool> allocated;
+        std::vector<const ColumnView *> vectors;
         for (int i = 0; i < nfields; i++) {
-            if (! columns[i]->isBackedByVector()) {
-                std::vector<Term_t> *v = new std::vector<Term_t>();
-                *v = columns[i]->getReader()->asVector();
-                allocated.push_back(true);
-                vectors.push_back(v);
-            } else {
-                vectors.push_back(&columns[i]->getVectorRef());
-                allocated.push_back(false);
-            }
+            vectors.push_back(columns[i]->getView());
         }
-        return std::unique_ptr<VectorSegmentIterator>(new VectorSegmentIterator(vectors, 0, vectors[0]->size(), new std::vector<bool>(allocated)));
+        return std::unique_ptr<VectorSegmentIterator>(new VectorSegmentIterator(vectors, 0, vectors[0]->size(), new std::vector<bool>(nfields, true)));
     }
@@ -6,6 +6,9 @@
 #include <vlog/filterer.h>
 #include <vlog/finalresultjoinproc.h>
 #include <vlog/extresultjoinproc.h>
+#include <vlog/fcstore.h>
+#include <vlog/leapfrog.h>
+#include <vlog/joinorder.h>
 #include <trident/model/table.h>
 #include <kognac/consts.h>
 #include <kognac/utils.h>
@@ -16,6 +19,7 @@
 #include <memory>
 #include <sstream>
 #include <unordered_set>
+#include <algorithm>
 
 void SemiNaiver::createGraphRuleDependency(std::vector<int> &nodes,
         std::vector<std::pair<int, int>> &edges) {
@@ -28,14 +32,19 @@ void SemiNaiver::createGraphRuleDependency(std::vector<int> &nodes,
     std::vector<int> *definedBy = new std::vector<int>[MAX_NPREDS];
     for (int i = 0; i < rules.size(); i++) {
         Rule ri = rules[i];
-        PredId_t pred = ri.getFirstHead().getPredicate().getId();
         std::vector<Literal> body = ri.getBody();
         for (std::vector<Literal>::const_iterator itr = body.begin(); itr != body.end(); ++itr) {
             Predicate p = itr->getPredicate();
             if (p.getType() == IDB) {
                 // Only add "interesting" rules: ones that have an IDB predicate in the RHS.
                 nodes.push_back(i);
-                definedBy[pred].push_back(i);
+                // Rules with multiple heads define all of them
+                for (const auto &head : ri.getHeads()) {
+                    std::vector<int> &def = definedBy[head.getPredicate().getId()];
+                    if (def.empty() || def.back() != i) {
+                        def.push_back(i);
+                    }
+                }
                 LOG(INFOL) << " Rule " << i << ": " << ri.tostring(program, &layer);
                 break;
             }
@@ -66,6 +75,34 @@ void SemiNaiver::createGraphRuleDependency(std::vector<int> &nodes,
     delete[] definedBy;
 }
 
+void SemiNaiver::computeDependentRules(
+        const std::vector<RuleExecutionDetails> &ruleset,
+        std::vector<std::vector<int>> &dependents) {
+    //The graph uses the IDs of the rules in the program. Map them to the
+    //positions in the ruleset we are going to execute.
+    std::vector<int> nodes;
+    std::vector<std::pair<int, int>> edges;
+    createGraphRuleDependency(nodes, edges);
+
+    std::unordered_map<int, int> posRule;
+    for (int i = 0; i < ruleset.size(); ++i) {
+        posRule.insert(std::make_pair((int) ruleset[i].ruleid, i));
+    }
+
+    dependents.clear();
+    dependents.resize(ruleset.size());
+    for (const auto &edge : edges) {
+        auto from = posRule.find(edge.first);
+        auto to = posRule.find(edge.second);
+        if (from != posRule.end() && to != posRule.end()) {
+            std::vector<int> &deps = dependents[from->second];
+            if (std::find(deps.begin(), deps.end(), to->second) == deps.end()) {
+                deps.push_back(to->second);
+            }
+        }
+    }
+}
+
 string set_to_string(std::unordered_set<int> s) {
     ostringstream oss("");
     for (std::unordered_set<int>::const_iterator k = s.begin(); k != s.end(); ++k) {
@@ -81,9 +118,14 @@ SemiNaiver::SemiNaiver(std::vector<Rule> ruleset, EDBLayer &layer,
     opt_filtering(opt_filtering),
     multithreaded(multithreaded),
     restrictedChase(restrictedChase),
+    sccEvaluation(false),
+    compactBlocks(false),
+    maxMemory(0),
+    nSpilledBlocks(0),
     running(false),
     layer(layer),
     program(program),
+    iteration(0),
     nthreads(nthreads) {
 
         TableFilterer::setOptIntersect(opt_intersect);
@@ -257,12 +299,45 @@ void SemiNaiver::run(size_t lastExecution, size_t it) {
     for (auto el : allIDBRules)
         LOG(DEBUGL) << el.rule.tostring(program, &layer);
 
-    //Setup the datastructures to handle the chase
-    std::vector<RuleExecutionDetails> allrules;
-    std::copy(allEDBRules.begin(), allEDBRules.end(), std::back_inserter(allrules));
-    std::copy(allIDBRules.begin(), allIDBRules.end(), std::back_inserter(allrules));
-    chaseMgmt = std::shared_ptr<ChaseMgmt>(new ChaseMgmt(allrules,
-                restrictedChase));
+    //Setup the datastructures to handle the chase. An incremental run must
+    //continue to use the one of the previous run
+    if (deltaEDBs.empty() || chaseMgmt == NULL) {
+        std::vector<RuleExecutionDetails> allrules;
+        std::copy(allEDBRules.begin(), allEDBRules.end(), std::back_inserter(allrules));
+        std::copy(allIDBRules.begin(), allIDBRules.end(), std::back_inserter(allrules));
+        chaseMgmt = std::shared_ptr<ChaseMgmt>(new ChaseMgmt(allrules,
+                    restrictedChase));
+    }
+
+    if (!deltaEDBs.empty()) {
+        //Incremental run: the EDB rules only look at the new facts, the
+        //IDB rules also at the new facts of their EDB atoms
+        for (auto &r : allIDBRules) {
+            r.createExecutionPlans(deltaEDBs);
+            r.failedBecauseEmpty = false;
+        }
+        for (auto &r : allEDBRules) {
+            r.createExecutionPlans(deltaEDBs);
+            r.lastExecution = lastExecution;
+        }
+    }
+    if (!dredRules.empty()) {
+        //DRed run: the rules that lost their derivations start from scratch,
+        //the others only look at what is derived from now on
+        for (auto &r : allIDBRules) {
+            if (dredRules.count(r.ruleid)) {
+                r.lastExecution = 0;
+            }
+            r.failedBecauseEmpty = false;
+        }
+        for (auto &r : allEDBRules) {
+            if (dredRules.count(r.ruleid)) {
+                r.lastExecution = 0;
+            } else {
+                r.orderExecutions.clear();
+            }
+        }
+    }
 #if DEBUG
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     LOG(DEBUGL) << "Runtime ruleset optimization ms = " << sec.count() * 1000;
@@ -271,6 +346,7 @@ void SemiNaiver::run(size_t lastExecution, size_t it) {
     //Used for statistics
     std::vector<StatIteration> costRules;
 
+    compactBlocks = !(restrictedChase && program->areExistentialRules());
     if (restrictedChase && program->areExistentialRules()) {
         //Split the program: First execute the rules without existential
         //quantifiers, then all the others
@@ -355,6 +431,159 @@ bool SemiNaiver::executeUntilSaturation(
         std::vector<RuleExecutionDetails> &ruleset,
         std::vector<StatIteration> &costRules,
         bool fixpoint) {
+    if (sccEvaluation) {
+        return executeSCCsUntilSaturation(ruleset, costRules, fixpoint);
+    }
+    std::vector<int> positions;
+    for (int i = 0; i < ruleset.size(); ++i) {
+        positions.push_back(i);
+    }
+    return saturateRules(ruleset, positions, costRules, fixpoint);
+}
+
+void SemiNaiver::computeSCCs(const std::vector<std::vector<int>> &dependents,
+        std::vector<std::vector<int>> &components) {
+    //Tarjan's algorithm (iterative, to avoid deep recursions on long
+    //chains of rules). Components are produced so that a component only
+    //depends on the ones that come before it.
+    const int nrules = dependents.size();
+    std::vector<int> index(nrules, -1);
+    std::vector<int> lowlink(nrules, 0);
+    std::vector<bool> onStack(nrules, false);
+    std::vector<int> stack;
+    int counter = 0;
+
+    components.clear();
+    for (int root = 0; root < nrules; ++root) {
+        if (index[root] != -1) {
+            continue;
+        }
+        //Pairs <rule, next dependent to visit>
+        std::vector<std::pair<int, size_t>> work;
+        work.push_back(std::make_pair(root, 0));
+        index[root] = lowlink[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while (!work.empty()) {
+            const int v = work.back().first;
+            const size_t next = work.back().second;
+            if (next < dependents[v].size()) {
+                work.back().second++;
+                const int w = dependents[v][next];
+                if (index[w] == -1) {
+                    index[w] = lowlink[w] = counter++;
+                    stack.push_back(w);
+                    onStack[w] = true;
+                    work.push_back(std::make_pair(w, 0));
+                } else if (onStack[w]) {
+                    lowlink[v] = std::min(lowlink[v], index[w]);
+                }
+            } else {
+                work.pop_back();
+                if (!work.empty()) {
+                    const int parent = work.back().first;
+                    lowlink[parent] = std::min(lowlink[parent], lowlink[v]);
+                }
+                if (lowlink[v] == index[v]) {
+                    std::vector<int> component;
+                    int w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        onStack[w] = false;
+                        component.push_back(w);
+                    } while (w != v);
+                    //Keep the original order of the rules inside the component
+                    std::sort(component.begin(), component.end());
+                    components.push_back(component);
+                }
+            }
+        }
+    }
+    //Tarjan emits the components in reverse topological order
+    std::reverse(components.begin(), components.end());
+}
+
+bool SemiNaiver::executeSCCsUntilSaturation(
+        std::vector<RuleExecutionDetails> &ruleset,
+        std::vector<StatIteration> &costRules,
+        bool fixpoint) {
+    std::vector<std::vector<int>> dependents;
+    computeDependentRules(ruleset, dependents);
+    std::vector<std::vector<int>> components;
+    computeSCCs(dependents, components);
+    LOG(INFOL) << "Evaluating " << ruleset.size() << " rules in " <<
+        components.size() << " strongly connected components";
+
+    bool newDer = false;
+    for (int i = 0; i < components.size(); ++i) {
+        const std::vector<int> &component = components[i];
+        //A single rule that does not read its own head: the inputs are
+        //already saturated, so one execution is enough.
+        bool cyclic = component.size() > 1;
+        if (!cyclic) {
+            const std::vector<int> &deps = dependents[component[0]];
+            cyclic = std::find(deps.begin(), deps.end(), component[0]) !=
+                deps.end();
+        }
+        LOG(DEBUGL) << "Component " << i << ": " << component.size() <<
+            " rules, cyclic=" << cyclic;
+        //Once the component is saturated, it is never visited again:
+        //everything it reads is derived by this or earlier components.
+        newDer |= saturateRules(ruleset, component, costRules,
+                fixpoint && cyclic);
+    }
+    return newDer;
+}
+
+void SemiNaiver::compactTables(
+        const std::vector<RuleExecutionDetails> &ruleset) {
+    if (!compactBlocks) {
+        return;
+    }
+    //A rule reads the blocks before its last execution all together, so
+    //they can be merged. A rule that never ran reads everything at its
+    //first execution
+    std::unordered_map<PredId_t, size_t> maxIterations;
+    std::unordered_set<PredId_t> heads;
+    for (const auto &r : ruleset) {
+        for (const auto &head : r.rule.getHeads()) {
+            heads.insert(head.getPredicate().getId());
+        }
+        if (r.lastExecution == 0) {
+            continue;
+        }
+        for (const auto &lit : r.rule.getBody()) {
+            const PredId_t id = lit.getPredicate().getId();
+            auto itr = maxIterations.find(id);
+            if (itr == maxIterations.end()) {
+                maxIterations.insert(std::make_pair(id, r.lastExecution));
+            } else if (r.lastExecution < itr->second) {
+                itr->second = r.lastExecution;
+            }
+        }
+    }
+    for (const auto id : heads) {
+        FCTable *table = predicatesTables[id];
+        if (table == NULL) {
+            continue;
+        }
+        auto itr = maxIterations.find(id);
+        const size_t removed = table->compact(
+                itr == maxIterations.end() ? iteration : itr->second);
+        if (removed > 0) {
+            LOG(DEBUGL) << "Compacted " << removed + 1 << " blocks of " <<
+                program->getPredicateName(id);
+        }
+    }
+}
+
+bool SemiNaiver::saturateRules(
+        std::vector<RuleExecutionDetails> &ruleset,
+        const std::vector<int> &positions,
+        std::vector<StatIteration> &costRules,
+        bool fixpoint) {
     size_t currentRule = 0;
     uint32_t rulesWithoutDerivation = 0;
 
@@ -365,42 +594,46 @@ bool SemiNaiver::executeUntilSaturation(
     std::chrono::system_clock::time_point round_start = std::chrono::system_clock::now();
     do {
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-        bool response = executeRule(ruleset[currentRule],
+        bool response = executeRule(ruleset[positions[currentRule]],
                 iteration,
                 NULL);
         newDer |= response;
         std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
         StatIteration stat;
         stat.iteration = iteration;
-        stat.rule = &ruleset[currentRule].rule;
+        stat.rule = &ruleset[positions[currentRule]].rule;
         stat.time = sec.count() * 1000;
         stat.derived = response;
         costRules.push_back(stat);
-        ruleset[currentRule].lastExecution = iteration++;
+        ruleset[positions[currentRule]].lastExecution = iteration++;
+        compactTables(ruleset);
+        spillTables();
 
         if (response) {
-            if (ruleset[currentRule].rule.isRecursive()) {
+            if (ruleset[positions[currentRule]].rule.isRecursive()) {
                 //Is the rule recursive? Go until saturation...
                 int recursiveIterations = 0;
                 do {
                     // LOG(INFOL) << "Iteration " << iteration;
                     start = std::chrono::system_clock::now();
                     recursiveIterations++;
-                    response = executeRule(ruleset[currentRule],
+                    response = executeRule(ruleset[positions[currentRule]],
                             iteration,
                             NULL);
                     newDer |= response;
                     stat.iteration = iteration;
-                    ruleset[currentRule].lastExecution = iteration++;
+                    ruleset[positions[currentRule]].lastExecution = iteration++;
+                    compactTables(ruleset);
+                    spillTables();
                     sec = std::chrono::system_clock::now() - start;
                     ++recursiveIterations;
-                    stat.rule = &ruleset[currentRule].rule;
+                    stat.rule = &ruleset[positions[currentRule]].rule;
                     stat.time = sec.count() * 1000;
                     stat.derived = response;
                     costRules.push_back(stat);
                 } while (response);
                     LOG(DEBUGL) << "Rules " <<
-                        ruleset[currentRule].rule.tostring(program, &layer) <<
+                        ruleset[positions[currentRule]].rule.tostring(program, &layer) <<
                         "  required " << recursiveIterations << " to saturate";
             }
             rulesWithoutDerivation = 0;
@@ -409,7 +642,7 @@ bool SemiNaiver::executeUntilSaturation(
             rulesWithoutDerivation++;
         }
 
-        currentRule = (currentRule + 1) % ruleset.size();
+        currentRule = (currentRule + 1) % positions.size();
 
         if (currentRule == 0) {
 #ifdef DEBUG
@@ -418,7 +651,7 @@ bool SemiNaiver::executeUntilSaturation(
             round_start = std::chrono::system_clock::now();
             //CODE FOR Statistics
             LOG(INFOL) << "Finish pass over the rules. Step=" << iteration << ". RulesWithDerivation=" <<
-                nRulesOnePass << " out of " << ruleset.size() << " Derivations so far " << countAllIDBs();
+                nRulesOnePass << " out of " << positions.size() << " Derivations so far " << countAllIDBs();
 	    printCountAllIDBs("After step " + to_string(iteration) + ": ");
             nRulesOnePass = 0;
 
@@ -443,7 +676,7 @@ bool SemiNaiver::executeUntilSaturation(
             if (!fixpoint)
                 break;
         }
-    } while (rulesWithoutDerivation != ruleset.size());
+    } while (rulesWithoutDerivation != positions.size());
                     return newDer;
 }
 
@@ -473,7 +706,10 @@ void SemiNaiver::storeOnFiles(std::string path, const bool decompress,
 			bool first = true;
                         for (uint8_t m = 0; m < sizeRow; ++m) {
                             if (decompress || csv) {
-                                if (layer.getDictText(iitr->getCurrentValue(m), buffer)) {
+                                size_t len;
+                                const char *text = layer.getDictText(
+                                        iitr->getCurrentValue(m), buffer, len);
+                                if (text != NULL) {
 				    if (csv) {
 					if (first) {
 					    first = false;
@@ -483,7 +719,7 @@ void SemiNaiver::storeOnFiles(std::string path, const bool decompress,
 				    } else {
 					row += "\t";
 				    }
-				    row += string(buffer);
+				    row.append(text, len);
                                 } else {
                                     std::string t = program->getFromAdditional(iitr->getCurrentValue(m));
                                     if (t == std::string("")) {
@@ -519,6 +755,218 @@ void SemiNaiver::storeOnFiles(std::string path, const bool decompress,
     }
 }
 
+void SemiNaiver::clearJoinOrders() {
+    std::lock_guard<std::mutex> lock(joinOrdersMutex);
+    joinOrders.clear();
+    edbDistinct.clear();
+}
+
+void SemiNaiver::addEDBFacts(const Predicate pred,
+        std::shared_ptr<const Segment> facts) {
+    if (pred.getType() != EDB) {
+        LOG(ERRORL) << "Facts can only be added to EDB predicates";
+        throw 10;
+    }
+    if (iteration == 0) {
+        LOG(ERRORL) << "New facts can only be added after a materialization";
+        throw 10;
+    }
+    if (facts->isEmpty()) {
+        return;
+    }
+    clearJoinOrders();
+
+    //Make sure the table contains the original relation, so that the new
+    //facts are in a block after it
+    VTuple t(pred.getCardinality());
+    for (uint8_t i = 0; i < t.getSize(); ++i) {
+        t.set(VTerm(i + 1, 0), i);
+    }
+    Literal mostGenericLiteral(pred, t);
+    getTableFromEDBLayer(mostGenericLiteral);
+    FCTable *table = getTable(pred.getId(), pred.getCardinality());
+
+    std::shared_ptr<const Segment> newFacts = SegmentInserter::unique(
+            facts->sortBy(NULL));
+    newFacts = table->retainFrom(newFacts, false, nthreads);
+    if (newFacts->isEmpty()) {
+        LOG(DEBUGL) << "All the facts are already known";
+        return;
+    }
+    LOG(DEBUGL) << "Adding " << newFacts->getNRows() << " new facts to " <<
+        program->getPredicateName(pred.getId()) << " in iteration " <<
+        iteration;
+    std::shared_ptr<const FCInternalTable> delta(new InmemoryFCInternalTable(
+                pred.getCardinality(), iteration, true, newFacts));
+    table->add(delta, mostGenericLiteral, 0, NULL, 0, iteration, true,
+            nthreads);
+    if (std::find(deltaEDBs.begin(), deltaEDBs.end(), pred.getId()) ==
+            deltaEDBs.end()) {
+        deltaEDBs.push_back(pred.getId());
+    }
+}
+
+void SemiNaiver::runIncremental() {
+    if (deltaEDBs.empty()) {
+        LOG(INFOL) << "No new EDB facts to propagate";
+        return;
+    }
+    if (program->areExistentialRules() && chaseMgmt == NULL) {
+        LOG(ERRORL) << "With existential rules the incremental run must "
+            "follow a materialization in the same process";
+        throw 10;
+    }
+    //The new facts are in the blocks of iteration 'iteration'
+    run(iteration, iteration + 1);
+    deltaEDBs.clear();
+}
+
+void SemiNaiver::removeEDBFacts(const Predicate pred,
+        std::shared_ptr<const Segment> facts) {
+    if (pred.getType() != EDB) {
+        LOG(ERRORL) << "Facts can only be removed from EDB predicates";
+        throw 10;
+    }
+    if (iteration == 0) {
+        LOG(ERRORL) << "Facts can only be removed after a materialization";
+        throw 10;
+    }
+    if (facts->isEmpty()) {
+        return;
+    }
+    clearJoinOrders();
+
+    VTuple t(pred.getCardinality());
+    for (uint8_t i = 0; i < t.getSize(); ++i) {
+        t.set(VTerm(i + 1, 0), i);
+    }
+    Literal mostGenericLiteral(pred, t);
+    getTableFromEDBLayer(mostGenericLiteral);
+    FCTable *table = getTable(pred.getId(), pred.getCardinality());
+
+    std::shared_ptr<const Segment> oldFacts = SegmentInserter::unique(
+            facts->sortBy(NULL));
+    std::shared_ptr<const FCInternalTable> rows(new InmemoryFCInternalTable(
+                pred.getCardinality(), 0, true, oldFacts));
+    const size_t removed = table->removeRows(rows, nthreads);
+    LOG(DEBUGL) << "Removed " << removed << " facts from " <<
+        program->getPredicateName(pred.getId());
+    if (removed > 0 && std::find(removedEDBs.begin(), removedEDBs.end(),
+                pred.getId()) == removedEDBs.end()) {
+        removedEDBs.push_back(pred.getId());
+    }
+}
+
+void SemiNaiver::runDRed() {
+    if (removedEDBs.empty()) {
+        LOG(INFOL) << "No removed EDB facts to propagate";
+        return;
+    }
+    if (program->areExistentialRules()) {
+        LOG(ERRORL) << "Removing facts is not supported with existential "
+            "rules";
+        throw 10;
+    }
+
+    //Predicates that might have lost some derivations
+    std::vector<PredId_t> affected = removedEDBs;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto *rules : { &allEDBRules, &allIDBRules }) {
+            for (const auto &r : *rules) {
+                if (!r.readsPredicate(affected)) {
+                    continue;
+                }
+                for (const auto &head : r.rule.getHeads()) {
+                    PredId_t id = head.getPredicate().getId();
+                    if (std::find(affected.begin(), affected.end(), id) ==
+                            affected.end()) {
+                        affected.push_back(id);
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    //Over-delete: keep only the blocks of the rules that do not read an
+    //affected predicate. All the rules that derive an affected predicate
+    //are evaluated again, so that the facts they lost are re-derived
+    std::vector<const RuleExecutionDetails*> safeRules;
+    for (const auto *rules : { &allEDBRules, &allIDBRules }) {
+        for (const auto &r : *rules) {
+            if (!r.readsPredicate(affected)) {
+                safeRules.push_back(&r);
+            }
+            for (const auto &head : r.rule.getHeads()) {
+                if (std::find(affected.begin(), affected.end(),
+                            head.getPredicate().getId()) != affected.end()) {
+                    dredRules.insert(r.ruleid);
+                }
+            }
+            //The facts added with addEDBFacts are picked up by evaluating
+            //the rules that read them from scratch as well
+            if (r.readsPredicate(deltaEDBs)) {
+                dredRules.insert(r.ruleid);
+            }
+        }
+    }
+    size_t overdeleted = 0;
+    for (const auto id : affected) {
+        if (program->isPredicateIDB(id) && predicatesTables[id] != NULL) {
+            overdeleted += predicatesTables[id]->retainBlocksFrom(safeRules);
+        }
+    }
+    LOG(INFOL) << "DRed: " << affected.size() << " affected predicates, " <<
+        overdeleted << " facts deleted, " << dredRules.size() <<
+        " rules to re-evaluate";
+
+    //Re-derive
+    deltaEDBs.clear();
+    run(iteration, iteration + 1);
+    dredRules.clear();
+    removedEDBs.clear();
+}
+
+void SemiNaiver::storeOnMmapFiles(std::string path) {
+    FCStore::store(path, program, predicatesTables);
+}
+
+size_t SemiNaiver::loadFromMmapFiles(std::string path) {
+    size_t lastIteration = 0;
+    std::unordered_set<PredId_t> loaded;
+    for (const auto &rule : program->getAllRules()) {
+        for (const auto &head : rule.getHeads()) {
+            const Predicate pred = head.getPredicate();
+            if (!loaded.insert(pred.getId()).second) {
+                continue;
+            }
+            std::string file = path + "/" +
+                program->getPredicateName(pred.getId()) + FCSTORE_EXT;
+            if (!Utils::exists(file)) {
+                continue;
+            }
+            FCTable *table = getTable(pred.getId(), pred.getCardinality());
+            if (!table->isEmpty()) {
+                LOG(ERRORL) << "The table of " <<
+                    program->getPredicateName(pred.getId()) <<
+                    " is not empty, cannot load the snapshot";
+                throw 10;
+            }
+            std::vector<FCBlock> blocks = FCStore::load(file, pred);
+            for (const auto &block : blocks) {
+                table->addBlock(block);
+                lastIteration = std::max(lastIteration, block.iteration);
+            }
+            LOG(DEBUGL) << "Loaded " << blocks.size() << " blocks for " <<
+                program->getPredicateName(pred.getId());
+        }
+    }
+    iteration = lastIteration + 1;
+    return lastIteration;
+}
+
 bool _sortCards(const std::pair<uint8_t, size_t> &v1, const std::pair<uint8_t, size_t> &v2) {
     return v1.second < v2.second;
 }
@@ -559,15 +1007,15 @@ bool SemiNaiver::checkIfAtomsAreEmpty(const RuleExecutionDetails &ruleDetails,
 }
 
 struct CreateParallelFirstAtom {
-    const std::vector<const std::vector<Term_t> *> vectors;
+    const std::vector<const ColumnView *> vectors;
     const std::vector<Output *> outputs;
     const size_t chunksz;
     const size_t sz;
     const bool uniqueResults;
-    const std::vector<Term_t> *fvfirst;
-    const std::vector<Term_t> *fvsecond;
+    const ColumnView *fvfirst;
+    const ColumnView *fvsecond;
 
-    CreateParallelFirstAtom(const std::vector<const std::vector<Term_t> *> vectors,
+    CreateParallelFirstAtom(const std::vector<const ColumnView *> vectors,
             const std::pair<uint8_t, uint8_t> *fv,
             const std::vector<Output *> outputs, const size_t chunksz,
             const size_t sz, const bool uniqueResults) :
@@ -717,17 +1165,16 @@ void SemiNaiver::processRuleFirstAtom(const uint8_t nBodyLiterals,
                 fv = &psColumnsToFilter;
             }
 
-            std::vector<const std::vector<Term_t> *> vectors;
+            std::vector<const ColumnView *> vectors;
             vectors = interitr->getAllVectors(nthreads);
 
             if (vectors.size() > 0) {
                 size_t sz = vectors[0]->size();
                 int chunksz = (sz + nthreads - 1) / nthreads;
                 if (nthreads > 1 && chunksz > 1024) {
-                    std::mutex m;
                     std::vector<Output *> outputs;
                     for (int i = 0; i < nthreads; i++) {
-                        outputs.push_back(new Output(joinOutput, &m));
+                        outputs.push_back(new Output(joinOutput, true));
                     }
                     //tbb::parallel_for(tbb::blocked_range<int>(0, nthreads, 1),
                     //        CreateParallelFirstAtom(vectors, fv, outputs, chunksz, sz, uniqueResults));
@@ -735,13 +1182,10 @@ void SemiNaiver::processRuleFirstAtom(const uint8_t nBodyLiterals,
                             CreateParallelFirstAtom(vectors, fv, outputs,
                                 chunksz, sz, uniqueResults));
                     // Maintain order of outputs, so:
-                    for (int i = 0; i < nthreads; i++) {
-                        outputs[i]->flush();
-                        delete outputs[i];
-                    }
+                    Output::flushAll(outputs);
                 } else {
-                    const std::vector<Term_t> *fvfirst = NULL;
-                    const std::vector<Term_t> *fvsecond = NULL;
+                    const ColumnView *fvfirst = NULL;
+                    const ColumnView *fvsecond = NULL;
                     if (fv != NULL) {
                         fvfirst = vectors[fv->first];
                         fvsecond = vectors[fv->second];
@@ -853,6 +1297,154 @@ void SemiNaiver::reorderPlan(RuleExecutionPlan &plan,
     }
 }
 
+size_t SemiNaiver::estimateDistinct(const Literal &literal, const size_t min,
+        const size_t max, const uint8_t pos) {
+    const PredId_t id = literal.getPredicate().getId();
+    size_t estimate = (size_t) -1;
+    FCTable *table = predicatesTables[id];
+    if (table != NULL) {
+        estimate = table->estimateDistinct(pos, min, max);
+    }
+    if (literal.getPredicate().getType() == EDB && min == 0) {
+        //The EDB layer counts them exactly. It can be expensive, so the
+        //count is kept until addEDBFacts or removeEDBFacts change the facts
+        std::string key = std::to_string(id) + " " + std::to_string(pos);
+        for (uint8_t i = 0; i < literal.getTupleSize(); ++i) {
+            const VTerm t = literal.getTermAtPos(i);
+            key += t.isVariable() ? " ?" + std::to_string(t.getId()) :
+                " " + std::to_string(t.getValue());
+        }
+        std::lock_guard<std::mutex> lock(joinOrdersMutex);
+        auto itr = edbDistinct.find(key);
+        if (itr == edbDistinct.end()) {
+            itr = edbDistinct.insert(std::make_pair(key,
+                        layer.getCardinalityColumn(literal, pos))).first;
+        }
+        estimate = std::min(estimate, itr->second);
+    }
+    return estimate;
+}
+
+bool SemiNaiver::preferLeapfrog(const RuleExecutionDetails &ruleDetails,
+        const RuleExecutionPlan &plan, const std::vector<double> &estimates) {
+    const size_t n = plan.plan.size();
+    if (estimates.size() != n) {
+        //No estimates of the intermediate results: a cyclic body can
+        //produce too many of them
+        return true;
+    }
+    std::vector<double> cards;
+    std::vector<bool> sorted;
+    double binary = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Literal *literal = plan.plan[i];
+        size_t min = plan.ranges[i].first, max = plan.ranges[i].second;
+        if (min == 1)
+            min = ruleDetails.lastExecution;
+        if (max == 1)
+            max = ruleDetails.lastExecution - 1;
+        const double card = estimateCardinality(*literal, min, max);
+        cards.push_back(card);
+        sorted.push_back(literal->getPredicate().getType() == EDB);
+        if (i > 0) {
+            const size_t posLiteral = literal -
+                &(ruleDetails.bodyLiterals[0]);
+            binary += joinStrategies.estimate(ruleDetails.ruleid, posLiteral,
+                    estimates[i - 1], card, false,
+                    multithreaded ? nthreads : 1);
+            //The intermediate results are materialized
+            binary += JOINSTRATEGY_MERGE_NS * estimates[i];
+        }
+    }
+    const double leapfrog = LeapfrogJoin::estimateCost(cards, sorted);
+    LOG(DEBUGL) << "Rule " << ruleDetails.ruleid << ": leapfrog join est. " <<
+        (size_t) leapfrog << "ns, binary joins est. " << (size_t) binary <<
+        "ns";
+    return leapfrog < binary;
+}
+
+bool SemiNaiver::optimizeJoinOrder(const RuleExecutionDetails &ruleDetails,
+        const int orderExecution, RuleExecutionPlan &plan,
+        const std::vector<size_t> &cards,
+        const std::vector<Literal> &heads,
+        std::vector<double> &estimates) {
+    const size_t n = plan.plan.size();
+    if (n < JOINORDER_MIN_LITERALS || n > JOINORDER_MAX_LITERALS) {
+        return false;
+    }
+
+    //Reuse the last order if the cardinalities did not change much
+    const std::pair<size_t, int> key(ruleDetails.ruleid, orderExecution);
+    std::vector<uint8_t> order;
+    {
+        std::lock_guard<std::mutex> lock(joinOrdersMutex);
+        auto itr = joinOrders.find(key);
+        if (itr != joinOrders.end() && itr->second.cards.size() == n) {
+            bool similar = true;
+            for (size_t i = 0; i < n && similar; ++i) {
+                const double c1 = std::max<size_t>(cards[i], 1);
+                const double c2 = std::max<size_t>(itr->second.cards[i], 1);
+                similar = c1 < c2 * JOINORDER_REPLAN_FACTOR &&
+                    c2 < c1 * JOINORDER_REPLAN_FACTOR;
+            }
+            if (similar) {
+                order = itr->second.order;
+                estimates = itr->second.estimates;
+            }
+        }
+    }
+
+    if (order.empty()) {
+        std::vector<JoinOrderStats> stats(n);
+        for (size_t i = 0; i < n; ++i) {
+            const Literal *literal = plan.plan[i];
+            size_t min = plan.ranges[i].first, max = plan.ranges[i].second;
+            if (min == 1)
+                min = ruleDetails.lastExecution;
+            if (max == 1)
+                max = ruleDetails.lastExecution - 1;
+            stats[i].card = cards[i];
+            std::vector<uint8_t> vars;
+            for (uint8_t j = 0; j < literal->getTupleSize(); ++j) {
+                const VTerm t = literal->getTermAtPos(j);
+                if (t.isVariable() && std::find(vars.begin(), vars.end(),
+                            t.getId()) == vars.end()) {
+                    vars.push_back(t.getId());
+                    stats[i].distinct.push_back(std::make_pair(t.getId(),
+                                (double) estimateDistinct(*literal, min, max,
+                                    j)));
+                }
+            }
+        }
+        order = JoinOrder::optimize(plan.plan, stats, estimates);
+        if (order.empty()) {
+            return false;
+        }
+
+        std::stringstream ss;
+        for (size_t i = 0; i < n; ++i) {
+            ss << " " << plan.plan[order[i]]->tostring(program, &layer) <<
+                " (est. " << (size_t) estimates[i] << ")";
+        }
+        LOG(DEBUGL) << "Join order of rule " << ruleDetails.ruleid <<
+            ", plan " << orderExecution << ":" << ss.str();
+
+        std::lock_guard<std::mutex> lock(joinOrdersMutex);
+        JoinOrderCache &cached = joinOrders[key];
+        cached.cards = cards;
+        cached.order = order;
+        cached.estimates = estimates;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (order[i] != i) {
+            plan = plan.reorder(order, heads);
+            break;
+        }
+    }
+    return true;
+}
+
 FCTable *SemiNaiver::getTable(const PredId_t pred, const uint8_t card) {
     FCTable *endTable;
     if (predicatesTables[pred] != NULL) {
@@ -947,7 +1539,11 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
         }
 
         //Reorder the list of atoms depending on the observed cardinalities
-        reorderPlan(plan, cards, heads);
+        std::vector<double> estimates;
+        if (!optimizeJoinOrder(ruleDetails, orderExecution, plan, cards,
+                    heads, estimates)) {
+            reorderPlan(plan, cards, heads);
+        }
 
 #ifdef DEBUG
         std::string listLiterals = "EXEC COMB: ";
@@ -961,6 +1557,62 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
 
         /*******************************************************************/
 
+        if (LeapfrogJoin::isApplicable(plan, ruleDetails.rule) &&
+                preferLeapfrog(ruleDetails, plan, estimates)) {
+            //Cyclic body: bind one variable at a time instead of
+            //materializing the intermediate joins
+            LOG(DEBUGL) << "Executing leapfrog join";
+            std::vector<std::pair<size_t, size_t>> ranges;
+            for (uint8_t i = 0; i < nBodyLiterals; ++i) {
+                size_t min = plan.ranges[i].first;
+                size_t max = plan.ranges[i].second;
+                if (min == 1)
+                    min = ruleDetails.lastExecution;
+                if (max == 1)
+                    max = ruleDetails.lastExecution - 1;
+                ranges.push_back(std::make_pair(min, max));
+            }
+            std::vector<uint8_t> variables =
+                LeapfrogJoin::getVariableOrder(plan);
+            std::vector<std::pair<uint8_t, uint8_t>> posFromFirst =
+                LeapfrogJoin::getPosFromFirst(heads, variables);
+            std::vector<std::pair<uint8_t, uint8_t>> posFromSecond;
+            ResultJoinProcessor *joinOutput = NULL;
+            if (heads.size() == 1) {
+                FCTable *table = getTable(heads[0].getPredicate().getId(),
+                        heads[0].getPredicate().getCardinality());
+                joinOutput = new SingleHeadFinalRuleProcessor(
+                        posFromFirst, posFromSecond, listDerivations,
+                        table, heads[0], 0, &ruleDetails,
+                        (uint8_t) orderExecution, iteration,
+                        finalResultContainer == NULL,
+                        !multithreaded ? -1 : nthreads);
+            } else {
+                joinOutput = new FinalRuleProcessor(
+                        posFromFirst, posFromSecond, listDerivations,
+                        heads, &ruleDetails,
+                        (uint8_t) orderExecution, iteration,
+                        finalResultContainer == NULL,
+                        !multithreaded ? -1 : nthreads, this);
+            }
+
+            std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+            LeapfrogJoin::join(this, plan, ranges, variables, heads,
+                    joinOutput, multithreaded ? nthreads : -1);
+            durationJoin += std::chrono::system_clock::now() - start;
+
+            std::chrono::system_clock::time_point startC =
+                std::chrono::system_clock::now();
+            joinOutput->consolidate(true);
+            durationConsolidation += std::chrono::system_clock::now() - startC;
+            if (finalResultContainer) {
+                finalResultContainer->push_back(joinOutput);
+            } else {
+                delete joinOutput;
+            }
+            continue;
+        }
+
         std::shared_ptr<const FCInternalTable> currentResults;
         int optimalOrderIdx = 0;
 
@@ -1088,6 +1740,12 @@ bool SemiNaiver::executeRule(RuleExecutionDetails &ruleDetails,
             //Prepare for the processing of the next atom (if any)
             if (!lastLiteral && ! first) {
                 currentResults = ((InterTableJoinProcessor*)joinOutput)->getTable();
+                if (!estimates.empty()) {
+                    LOG(DEBUGL) << "Atom " << optimalOrderIdx <<
+                        ": estimated " << (size_t) estimates[optimalOrderIdx] <<
+                        " rows, actual " << (currentResults == NULL ? 0 :
+                                currentResults->getNRows());
+                }
             }
             if (lastLiteral && finalResultContainer) {
                 finalResultContainer->push_back(joinOutput);
@@ -1275,7 +1933,18 @@ FCIterator SemiNaiver::getTable(const Literal & literal,
     //BEGIN -- Get the table that correspond to the current literal
     //std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     if (literal.getPredicate().getType() == EDB) {
-        return getTableFromEDBLayer(literal);
+        FCIterator itr = getTableFromEDBLayer(literal);
+        if (min > 0 || max != (size_t) - 1) {
+            //Only part of the blocks: either the original relation or the
+            //facts added with addEDBFacts
+            FCTable *table = predicatesTables[literal.getPredicate().getId()];
+            if (literal.getNUniqueVars() < literal.getTupleSize()) {
+                return table->filter(literal, nthreads)->read(min, max);
+            } else {
+                return table->read(min, max);
+            }
+        }
+        return itr;
     } else {
         /*if (currentIDBpred == 0) {
           literalItr = getTableFromIDBLayer(literal, ruleDetails.lastExecution);
@@ -1380,6 +2049,139 @@ void SemiNaiver::printCountAllIDBs(string prefix) {
     LOG(INFOL) << prefix << "Total # derivations: " << c;
 }
 
+void SemiNaiver::spillTables() {
+    if (maxMemory == 0 || iteration <= SEMINAIVER_SPILL_WINDOW) {
+        return;
+    }
+    //The tables keep their totals up to date, so the blocks are scanned
+    //only when the budget is exceeded
+    size_t used = 0;
+    std::vector<FCTable*> tables;
+    std::vector<std::pair<size_t, FCTable*>> indexes;
+    for (PredId_t i = 0; i < MAX_NPREDS; ++i) {
+        FCTable *table = predicatesTables[i];
+        if (table != NULL && program->isPredicateIDB(i)) {
+            size_t uncompressed;
+            used += table->getMemoryBytes(uncompressed);
+            const size_t indexBytes = table->getIndexMemoryBytes();
+            if (indexBytes > 0) {
+                used += indexBytes;
+                indexes.push_back(std::make_pair(indexBytes, table));
+            }
+            tables.push_back(table);
+        }
+    }
+    //The decompressed chunks kept for the joins are the cheapest to get back
+    const size_t cached = Column::getCachedViewBytes();
+    if (used + cached > maxMemory) {
+        const size_t freed = Column::evictViews(std::min(cached,
+                    used + cached - maxMemory));
+        used += cached > freed ? cached - freed : 0;
+        LOG(DEBUGL) << "Dropped " << freed << " bytes of cached columns";
+    } else {
+        used += cached;
+    }
+    if (used <= maxMemory) {
+        return;
+    }
+
+    std::vector<FCSpillCandidate> candidates;
+    for (const auto table : tables) {
+        table->getSpillCandidates(iteration - SEMINAIVER_SPILL_WINDOW,
+                candidates);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+            [](const FCSpillCandidate &a, const FCSpillCandidate &b) {
+            return a.lastRead < b.lastRead || (a.lastRead == b.lastRead &&
+                    a.iteration < b.iteration);
+            });
+    const size_t before = used;
+    size_t n = 0;
+    for (const auto &c : candidates) {
+        if (used <= maxMemory) {
+            break;
+        }
+        const size_t freed = c.table->spill(c.block, spillDir);
+        if (freed > 0) {
+            used = used > freed ? used - freed : 0;
+            n++;
+        }
+    }
+    nSpilledBlocks += n;
+    LOG(DEBUGL) << "Spilled " << n << " blocks, " << (before - used) <<
+        " bytes (" << nSpilledBlocks << " blocks in total)";
+
+    //The hash indexes of the rows only make retainFrom faster. Drop the
+    //largest ones if spilling was not enough
+    std::sort(indexes.begin(), indexes.end());
+    while (used > maxMemory && !indexes.empty()) {
+        const size_t freed = indexes.back().second->dropIndex();
+        indexes.pop_back();
+        used = used > freed ? used - freed : 0;
+        LOG(DEBUGL) << "Dropped a row index of " << freed << " bytes";
+    }
+    if (used > maxMemory) {
+        LOG(WARNL) << "The memory budget is exceeded (" << used <<
+            " bytes) and no other block can be spilled";
+    }
+}
+
+void SemiNaiver::printMemoryIDBs() {
+    size_t total = 0;
+    size_t totalUncompressed = 0;
+    for (PredId_t i = 0; i < MAX_NPREDS; ++i) {
+        if (predicatesTables[i] != NULL && program->isPredicateIDB(i)) {
+            size_t uncompressed;
+            const size_t bytes = predicatesTables[i]->getMemoryBytes(
+                    uncompressed);
+            if (uncompressed == 0) {
+                continue;
+            }
+            LOG(INFOL) << "Memory of " << program->getPredicateName(i) <<
+                ": " << bytes << " bytes (" << uncompressed <<
+                " uncompressed)";
+            total += bytes;
+            totalUncompressed += uncompressed;
+        }
+    }
+    LOG(INFOL) << "Total memory of the IDB columns: " << total <<
+        " bytes (" << totalUncompressed << " uncompressed)";
+}
+
+void SemiNaiver::printJoinStatistics() {
+    const char *names[JOINSTRATEGY_N] = { "hash", "merge", "partitioned" };
+    size_t count[JOINSTRATEGY_N] = { 0, 0, 0 };
+    double seconds[JOINSTRATEGY_N] = { 0, 0, 0 };
+    size_t nSwitches = 0;
+    for (const auto &el : joinStrategies.getStats()) {
+        const JoinStrategyStats &s = el.second;
+        std::stringstream stream;
+        for (int i = 0; i < JOINSTRATEGY_N; ++i) {
+            stream << " " << names[i] << "=" << s.count[i] << " (" <<
+                s.seconds[i] * 1000 << "ms)";
+            count[i] += s.count[i];
+            seconds[i] += s.seconds[i];
+        }
+        LOG(DEBUGL) << "Rule " << el.first.first << " literal " <<
+            el.first.second << ":" << stream.str() << " switches=" <<
+            s.nSwitches << " ns build=" << s.buildNs << " probe=" <<
+            s.probeNs << " sort=" << s.sortNs << " merge=" << s.mergeNs <<
+            " partition=" << s.partitionNs;
+        nSwitches += s.nSwitches;
+    }
+    std::stringstream stream;
+    for (int i = 0; i < JOINSTRATEGY_N; ++i) {
+        stream << " " << names[i] << "=" << count[i] << " (" <<
+            seconds[i] * 1000 << "ms)";
+    }
+    LOG(INFOL) << "Joins:" << stream.str() << " Strategy switches: " <<
+        nSwitches;
+    LOG(INFOL) << "Column chunks cached for the joins: " <<
+        Column::getCachedViewBytes() / (1024 * 1024) << " MB";
+    LOG(INFOL) << "Peak size of the buffered results of a parallel join: " <<
+        Output::getPeakBufferedBytes() / (1024 * 1024) << " MB";
+}
+
 std::pair<uint8_t, uint8_t> SemiNaiver::removePosConstants(
         std::pair<uint8_t, uint8_t> columns,
         const Literal &literal) {
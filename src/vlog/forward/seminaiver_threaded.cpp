@@ -9,48 +9,52 @@ bool SemiNaiverThreaded::executeUntilSaturation(
         std::vector<StatIteration> &costRules,
         bool fixpoint) {
 
-    //Create n threads
-    std::vector<std::thread> threads(interRuleThreads);
-    bool anotherRound;
-    bool newDer = false;
-    do {
-        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-        //LOG(INFOL) << "Creating threads ...";
-        //Create a shared datastructure to record the execution of the rules
-        StatusRuleExecution_ThreadSafe status(ruleset.size());
-
-        //Execute the rules on multiple threads
-        size_t iterationBeginBlock = iteration;
-        for (int i = 0; i < interRuleThreads; ++i) {
-            threads[i] = std::thread(&SemiNaiverThreaded::runThread,
-                    this,
-                    std::ref(ruleset),
-                    &status,
-                    &costRules,
-                    iterationBeginBlock);
-        }
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
-        //Wait until all threads are finished
-        for (int i = 0; i < interRuleThreads; ++i) {
-            threads[i].join();
-        }
+    //Which rules should be re-executed when a rule derives something new
+    std::vector<std::vector<int>> dependents;
+    computeDependentRules(ruleset, dependents);
 
-        //Copy all the derivations produced by the rules in the KB
-        anotherRound = false;
-        // anotherRound = doGlobalConsolidation(status);
-        for (int i = 0; i < MAX_NPREDS; i++) {
-            marked[i] = newMarked[i];
-            if (marked[i]) {
-                anotherRound = true;
-            }
-            newMarked[i] = false;
-        }
+    //Initially all the rules must be executed. Spread them over the deques
+    //of the threads, keeping the order computed in the constructor.
+    StatusRuleExecution_ThreadSafe status(ruleset.size(), interRuleThreads);
+    for (int i = 0; i < ruleset.size(); ++i) {
+        status.schedule(i, i % interRuleThreads);
+    }
+
+    //There is no barrier between the rounds anymore: a thread that derives
+    //new tuples schedules the rules that depend on them, and all threads stop
+    //when no rule is left. This reaches the same fixpoint: a rule is queued
+    //again whenever one of its body predicates gets a new delta after the
+    //rule started (startRule clears the flag before the rule reads its
+    //inputs), and it reads all the blocks added since its last execution.
+    //So when nothing is pending, no rule can derive anything new. The only
+    //"barrier" left is per predicate: the locks of a rule are taken for
+    //the whole execution, so it never sees a delta that is half written.
+    std::vector<std::thread> threads(interRuleThreads);
+    std::unique_ptr<bool[]> newDers(new bool[interRuleThreads]);
+    for (int i = 0; i < interRuleThreads; ++i) {
+        newDers[i] = false;
+        threads[i] = std::thread(&SemiNaiverThreaded::runThread,
+                this,
+                i,
+                std::ref(ruleset),
+                std::cref(dependents),
+                &status,
+                &costRules,
+                fixpoint,
+                &newDers[i]);
+    }
+
+    //Wait until all threads are finished
+    bool newDer = false;
+    for (int i = 0; i < interRuleThreads; ++i) {
+        threads[i].join();
+        newDer |= newDers[i];
+    }
 
-        //LOG(INFOL) << "Another round = " << anotherRound;
-        std::chrono::duration<double> sec2 = std::chrono::system_clock::now() - start;
-        LOG(WARNL) << "--Time round " << sec2.count() * 1000 << " " << iteration;
-        newDer |= anotherRound;
-    } while (anotherRound);
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "--Time saturation " << sec.count() * 1000 << " " << iteration;
     return newDer;
 }
 
@@ -123,8 +127,6 @@ bool SemiNaiverThreaded::doGlobalConsolidation(
                 if (!newseg->isEmpty()) {
                     (*cont)->consolidateSegment(newseg);
                     response = true;
-                    newMarked[p->first] = true;
-                    marked[p->first] = true;
                 }
                 //std::chrono::duration<double> sec2 = std::chrono::system_clock::now() - startC;
                 //LOG(WARNL) << "--Time conso" << sec2.count() * 1000;
@@ -138,21 +140,20 @@ bool SemiNaiverThreaded::doGlobalConsolidation(
 }
 
 void SemiNaiverThreaded::runThread(
+        const int threadId,
         std::vector<RuleExecutionDetails> &ruleset,
+        const std::vector<std::vector<int>> &dependents,
         StatusRuleExecution_ThreadSafe *status,
         std::vector<StatIteration> *costRules,
-        size_t lastExec) {
-
-    int ruleToExecute = status->getRuleIDToExecute();
-    SemiNaiver_Threadlocal *data = new SemiNaiver_Threadlocal();
-    thread_data.reset(data);
+        const bool fixpoint,
+        bool *newDer) {
 
+    SemiNaiver_Threadlocal data;
     std::vector<ResultJoinProcessor*> res;
 
+    int ruleToExecute = status->getRuleIDToExecute(threadId);
     while (ruleToExecute != -1) {
 
-        //Get atomic iteration
-        data->iteration = getAtomicIteration();
         Literal headLiteral = ruleset[ruleToExecute].rule.getFirstHead();
         PredId_t idHeadPredicate = headLiteral.getPredicate().getId();
         std::vector<PredId_t> predicates;
@@ -163,20 +164,37 @@ void SemiNaiverThreaded::runThread(
                 predicates.push_back(itr->getPredicate().getId());
             }
         }
-        // Sort predicates, to avoid deadlock
+        // Sort predicates, to avoid deadlock. A predicate can appear more
+        // than once (e.g., the head of a recursive rule), lock it only once.
         std::sort(predicates.begin(), predicates.end());
+        predicates.erase(std::unique(predicates.begin(), predicates.end()),
+                predicates.end());
+
+        //Do not wait for the locks: if another thread is working on the same
+        //predicates, park the rule until that thread releases them and pick
+        //another one.
+        const uint64_t releases = status->getReleases();
+        if (!tryLock(predicates, idHeadPredicate)) {
+            status->park(ruleToExecute, threadId, releases);
+            ruleToExecute = status->getRuleIDToExecute(threadId);
+            continue;
+        }
+        status->startRule(ruleToExecute);
 
-        lock(predicates, idHeadPredicate);
+        //The iteration is taken only after the locks are acquired, so
+        //that the blocks of every table are added in increasing order
+        //of iteration.
+        data.iteration = getAtomicIteration();
 
         //Execute the rule
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
         bool response = executeRule(ruleset[ruleToExecute],
-                data->iteration,
+                data.iteration,
                 // &res);
         NULL);
         std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
         StatIteration stat;
-        stat.iteration = data->iteration;
+        stat.iteration = data.iteration;
         stat.rule = &ruleset[ruleToExecute].rule;
         stat.time = sec.count() * 1000;
         stat.derived = response;
@@ -186,29 +204,26 @@ void SemiNaiverThreaded::runThread(
         costRules->push_back(stat);
         mutexInsert.unlock();
 
-        //Change it to "lastExecution"
-        // ruleset[ruleToExecute].lastExecution = lastExec;
-        ruleset[ruleToExecute].lastExecution = data->iteration;
+        ruleset[ruleToExecute].lastExecution = data.iteration;
 
+        bool derived = response;
         if (response) {
-            newMarked[idHeadPredicate] = true;
-            marked[idHeadPredicate] = true;
             if (ruleset[ruleToExecute].rule.isRecursive()) {
                 int recursiveIterations = 0;
                 do {
                     // LOG(INFOL) << "Iteration " << iteration;
-                    data->iteration = getAtomicIteration();
+                    data.iteration = getAtomicIteration();
                     start = std::chrono::system_clock::now();
                     recursiveIterations++;
                     response = executeRule(ruleset[ruleToExecute],
-                            data->iteration,
+                            data.iteration,
                             // &res);
                     NULL);
 
-                    ruleset[ruleToExecute].lastExecution = data->iteration;
+                    ruleset[ruleToExecute].lastExecution = data.iteration;
                     sec = std::chrono::system_clock::now() - start;
                     ++recursiveIterations;
-                    stat.iteration = data->iteration;
+                    stat.iteration = data.iteration;
                     stat.rule = &ruleset[ruleToExecute].rule;
                     stat.time = sec.count() * 1000;
                     stat.derived = response;
@@ -226,8 +241,26 @@ void SemiNaiverThreaded::runThread(
         }
 
         unlock(predicates, idHeadPredicate);
+        status->released(threadId);
+
+        //The delta of the head predicate changed: the rules that read it
+        //must be executed again. They go in our own deque, other threads
+        //can steal them.
+        if (derived) {
+            *newDer = true;
+            if (fixpoint) {
+                for (const auto dep : dependents[ruleToExecute]) {
+                    //A recursive rule was already run until saturation
+                    if (dep != ruleToExecute ||
+                            !ruleset[ruleToExecute].rule.isRecursive()) {
+                        status->schedule(dep, threadId);
+                    }
+                }
+            }
+        }
+        status->finishRule(ruleToExecute);
 
-        ruleToExecute = status->getRuleIDToExecute();
+        ruleToExecute = status->getRuleIDToExecute(threadId);
     }
 
     //Register the derivations
@@ -252,25 +285,142 @@ void SemiNaiverThreaded::saveStatistics(StatsRule &stats) {
     SemiNaiver::saveStatistics(stats);
 }
 
-StatusRuleExecution_ThreadSafe::StatusRuleExecution_ThreadSafe(const int nrules)
-    : rulecount(0), nrules(nrules) {
+StatusRuleExecution_ThreadSafe::StatusRuleExecution_ThreadSafe(const int nrules,
+        const int nqueues)
+    : nqueues(nqueues), queues(new RuleQueue[nqueues]),
+    nrules(nrules), queued(new std::atomic<bool>[nrules]), pending(0),
+    available(0), releases(0) {
+        for (int i = 0; i < nrules; ++i) {
+            queued[i] = false;
+        }
+    }
+
+bool StatusRuleExecution_ThreadSafe::schedule(const int ruleid,
+        const int queue) {
+    if (queued[ruleid].exchange(true)) {
+        //Already waiting. It will see the new derivations anyway
+        return false;
+    }
+    pending++;
+    push(ruleid, queue, false);
+    notify(false);
+    return true;
+}
+
+void StatusRuleExecution_ThreadSafe::push(const int ruleid, const int queue,
+        const bool front) {
+    std::lock_guard<std::mutex> lock(queues[queue].mutex);
+    if (front) {
+        queues[queue].rules.push_front(ruleid);
+    } else {
+        queues[queue].rules.push_back(ruleid);
+    }
+    available++;
+}
+
+void StatusRuleExecution_ThreadSafe::notify(const bool all) {
+    //Taking the mutex makes sure that a thread that is about to sleep
+    //either sees the change or is already waiting
+    {
+        std::lock_guard<std::mutex> lock(mutexWait);
+    }
+    if (all) {
+        wakeup.notify_all();
+    } else {
+        wakeup.notify_one();
+    }
+}
+
+void StatusRuleExecution_ThreadSafe::park(const int ruleid, const int queue,
+        const uint64_t releasesSeen) {
+    {
+        std::lock_guard<std::mutex> lock(mutexWait);
+        if (releases.load() == releasesSeen) {
+            //The thread that holds the locks will put it back
+            parked.push_back(ruleid);
+            return;
+        }
+    }
+    //Put it at the front, so that the owner first tries other rules
+    push(ruleid, queue, true);
+    notify(false);
+}
+
+void StatusRuleExecution_ThreadSafe::released(const int queue) {
+    std::vector<int> rules;
+    {
+        std::lock_guard<std::mutex> lock(mutexWait);
+        releases++;
+        rules.swap(parked);
+    }
+    if (!rules.empty()) {
+        for (const auto ruleid : rules) {
+            push(ruleid, queue, false);
+        }
+        notify(true);
+    }
+}
+
+bool StatusRuleExecution_ThreadSafe::pop(const int queue, int &ruleid) {
+    std::lock_guard<std::mutex> lock(queues[queue].mutex);
+    if (queues[queue].rules.empty()) {
+        return false;
     }
+    ruleid = queues[queue].rules.back();
+    queues[queue].rules.pop_back();
+    available--;
+    return true;
+}
 
+bool StatusRuleExecution_ThreadSafe::steal(const int queue, int &ruleid) {
+    for (int i = 1; i < nqueues; ++i) {
+        RuleQueue &victim = queues[(queue + i) % nqueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.rules.empty()) {
+            ruleid = victim.rules.front();
+            victim.rules.pop_front();
+            available--;
+            return true;
+        }
+    }
+    return false;
+}
 
-int StatusRuleExecution_ThreadSafe::getRuleIDToExecute() {
+int StatusRuleExecution_ThreadSafe::getRuleIDToExecute(const int queue) {
     //Return -1 if no rule is available. Otherwise return the ID of the rule to
     //execute.
-    std::lock_guard<std::mutex> lock(mutexRules);
-    if (rulecount == nrules) {
-        return -1;
+    int ruleid;
+    while (true) {
+        if (pop(queue, ruleid) || steal(queue, ruleid)) {
+            LOG(DEBUGL) << "Got rule " << ruleid;
+            return ruleid;
+        }
+        //Some rule is still running (or parked) and might schedule other
+        //rules: sleep until something is queued
+        std::unique_lock<std::mutex> lock(mutexWait);
+        if (pending.load() == 0) {
+            return -1;
+        }
+        if (available.load() == 0) {
+            wakeup.wait(lock);
+        }
+    }
+}
+
+void StatusRuleExecution_ThreadSafe::startRule(const int ruleid) {
+    //From now on, new derivations require another execution of the rule
+    queued[ruleid] = false;
+}
+
+void StatusRuleExecution_ThreadSafe::finishRule(const int ruleid) {
+    if (--pending == 0) {
+        notify(true);
     }
-    LOG(DEBUGL) << "Got rule " << rulecount;
-    return rulecount++;
 }
 
 void StatusRuleExecution_ThreadSafe::registerDerivations(
         ResultJoinProcessor *res) {
-    std::lock_guard<std::mutex> lock(mutexRules);
+    std::lock_guard<std::mutex> lock(mutexDerivations);
     tmpderivations.push_back(res);
 }
 
@@ -314,6 +464,7 @@ bool SemiNaiverThreaded::tryLock(std::vector<PredId_t> &predicates, PredId_t idH
                             mutexes[*itr1].unlock(); //Previously it was a shared lock
                         }
                     }
+                    prev = *itr1;
                 }
                 return false;
             }
@@ -0,0 +1,163 @@
+#include <vlog/sortedints.h>
+#include <vlog/column.h>
+
+#include <algorithm>
+
+#if !TERM_AS_STRUCT && __TERM_TYPE_IS_UINT64_T && defined(__GNUC__) && \
+    defined(__x86_64__)
+#define SORTEDINTS_SIMD 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (*SearchFn)(const Term_t *, size_t, const size_t, const Term_t);
+
+static size_t lowerBoundScalar(const Term_t *v, size_t pos, const size_t n,
+        const Term_t x) {
+    while (pos < n && v[pos] < x) {
+        pos++;
+    }
+    return pos;
+}
+
+#ifdef SORTEDINTS_SIMD
+//The instructions compare signed integers. Flipping the sign bit of both
+//operands gives the unsigned order
+#define SIGNBIT 0x8000000000000000ull
+
+__attribute__((target("sse4.2")))
+static size_t lowerBoundSSE(const Term_t *v, size_t pos, const size_t n,
+        const Term_t x) {
+    const __m128i sign = _mm_set1_epi64x(SIGNBIT);
+    const __m128i key = _mm_xor_si128(_mm_set1_epi64x(x), sign);
+    while (pos + 2 <= n) {
+        __m128i block = _mm_loadu_si128((const __m128i*) (v + pos));
+        block = _mm_xor_si128(block, sign);
+        //Lanes with v[i] < x. Since v is sorted, they are a prefix
+        const int mask = _mm_movemask_pd(_mm_castsi128_pd(
+                    _mm_cmpgt_epi64(key, block)));
+        if (mask != 3) {
+            return pos + __builtin_popcount(mask);
+        }
+        pos += 2;
+    }
+    return lowerBoundScalar(v, pos, n, x);
+}
+
+__attribute__((target("avx2")))
+static size_t lowerBoundAVX2(const Term_t *v, size_t pos, const size_t n,
+        const Term_t x) {
+    const __m256i sign = _mm256_set1_epi64x(SIGNBIT);
+    const __m256i key = _mm256_xor_si256(_mm256_set1_epi64x(x), sign);
+    while (pos + 4 <= n) {
+        __m256i block = _mm256_loadu_si256((const __m256i*) (v + pos));
+        block = _mm256_xor_si256(block, sign);
+        const int mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+                    _mm256_cmpgt_epi64(key, block)));
+        if (mask != 15) {
+            return pos + __builtin_popcount(mask);
+        }
+        pos += 4;
+    }
+    return lowerBoundScalar(v, pos, n, x);
+}
+#endif
+
+static SearchFn chooseLinearKernel(const char **name) {
+#ifdef SORTEDINTS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return lowerBoundAVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        *name = "sse4.2";
+        return lowerBoundSSE;
+    }
+#endif
+    *name = "scalar";
+    return lowerBoundScalar;
+}
+
+static const char *linearKernelName = "scalar";
+static const SearchFn linearKernel = chooseLinearKernel(&linearKernelName);
+
+const char *SortedInts::getKernelName() {
+    return linearKernelName;
+}
+
+size_t SortedInts::lowerBound(const Term_t *v, size_t pos, const size_t n,
+        const Term_t x) {
+    return linearKernel(v, pos, n, x);
+}
+
+size_t SortedInts::gallop(const Term_t *v, size_t pos, const size_t n,
+        const Term_t x) {
+    if (pos >= n || v[pos] >= x) {
+        return pos;
+    }
+    //v[pos] < x. Double the step until we overshoot, then binary search
+    size_t step = 1;
+    while (pos + step < n && v[pos + step] < x) {
+        pos += step;
+        step <<= 1;
+    }
+    const size_t end = std::min(pos + step + 1, n);
+    return std::lower_bound(v + pos + 1, v + end, x) - v;
+}
+
+static SearchFn chooseSearch(const size_t n, const size_t other) {
+    if (n > (size_t) SORTEDINTS_GALLOP_RATIO * other) {
+        return SortedInts::gallop;
+    }
+    return linearKernel;
+}
+
+void SortedInts::intersection(const Term_t *v1, const size_t n1,
+        const Term_t *v2, const size_t n2, ColumnWriter &writer) {
+    //Scan the smaller array and search in the other one
+    const Term_t *a = v1, *b = v2;
+    size_t na = n1, nb = n2;
+    if (na > nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    const SearchFn search = chooseSearch(nb, na);
+    size_t j = 0;
+    for (size_t i = 0; i < na; ++i) {
+        j = search(b, j, nb, a[i]);
+        if (j == nb) {
+            return;
+        }
+        if (b[j] == a[i]) {
+            writer.add(a[i]);
+            j++;
+        }
+    }
+}
+
+uint64_t SortedInts::countMatches(const Term_t *v1, const size_t n1,
+        const Term_t *v2, const size_t n2) {
+    const SearchFn search1 = chooseSearch(n1, n2);
+    const SearchFn search2 = chooseSearch(n2, n1);
+    uint64_t count = 0;
+    size_t i = 0, j = 0;
+    while (i < n1 && j < n2) {
+        const Term_t x = v2[j];
+        i = search1(v1, i, n1, x);
+        if (i == n1) {
+            break;
+        }
+        if (v1[i] == x) {
+            //Count the whole run of x in v2
+            size_t end = j + 1;
+            while (end < n2 && v2[end] == x) {
+                end++;
+            }
+            count += end - j;
+            j = end;
+        } else {
+            j = search2(v2, j, n2, v1[i]);
+        }
+    }
+    return count;
+}
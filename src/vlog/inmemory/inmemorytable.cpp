@@ -1,41 +1,238 @@
 #include <vlog/inmemory/inmemorytable.h>
 #include <vlog/fcinttable.h>
+#include <vlog/fcstore.h>
 
 #include <kognac/utils.h>
+#include <trident/utils/parallel.h>
 
-InmemoryDict singletonDict;
+#include <algorithm>
+#include <functional>
+#include <cstring>
+
+Dictionary singletonDict;
 
 void dump() {
     ofstream ofs;
     ofs.open("dict", ofstream::out | ofstream::trunc);
-    for (uint64_t i = 1; i <= singletonDict.getNTerms(); i++) {
-	ofs << i << "\t" << singletonDict.get(i) << "\n";
+    for (uint64_t i = 1; i <= singletonDict.size(); i++) {
+	ofs << i << "\t" << singletonDict.getRawValue(i) << "\n";
     }
     ofs.close();
 }
 
-bool InmemoryDict::getID(const char *text, uint64_t sizetext, uint64_t &id) {
-    string v = string(text, sizetext);
-    if (invdict.count(v)) {
-        id = invdict[v];
-        return true;
-    } else {
-        return false;
+//Term of a CSV file, pointing inside the mapped file
+struct CSVTerm {
+    const char *text;
+    size_t len;
+    CSVTerm(const char *text, const size_t len) : text(text), len(len) {
+    }
+    bool operator==(const CSVTerm &other) const {
+        return len == other.len && memcmp(text, other.text, len) == 0;
+    }
+};
+
+struct CSVTermHasher {
+    size_t operator()(const CSVTerm &t) const {
+        //FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < t.len; ++i) {
+            h = (h ^ (uint8_t) t.text[i]) * 1099511628211ull;
+        }
+        return h;
+    }
+};
+
+//Rows of a chunk of the file. The terms get local ids in the order in which
+//they first appear, 'ids' maps them to the ids of the dictionary
+struct CSVChunk {
+    const char *begin;
+    const char *end;
+    std::vector<Term_t> rows;
+    std::vector<CSVTerm> terms;
+    std::vector<Term_t> ids;
+    size_t nrows;
+    size_t offset;
+    bool wrongArity;
+    CSVChunk(const char *begin, const char *end) : begin(begin), end(end),
+    nrows(0), offset(0), wrongArity(false) {
+    }
+};
+
+//Call f for every field of the line [p, eol). A trailing comma does not add
+//an empty field
+template<class F>
+static void splitCSVLine(const char *p, const char *eol, F &f) {
+    while (true) {
+        const char *delim = (const char*) memchr(p, ',', eol - p);
+        if (delim == NULL) {
+            f(p, eol - p);
+            return;
+        }
+        f(p, delim - p);
+        p = delim + 1;
+        if (p == eol) {
+            return;
+        }
     }
 }
 
-bool InmemoryDict::getText(uint64_t id, char *text) {
-    if (dict.count(id)) {
-        auto &str = dict[id];
-        strcpy(text, str.c_str());
-        return true;
-    } else {
-        return false;
+struct ParseCSVChunks {
+    std::vector<CSVChunk> &chunks;
+    const uint8_t arity;
+
+    ParseCSVChunks(std::vector<CSVChunk> &chunks, const uint8_t arity) :
+        chunks(chunks), arity(arity) {
+        }
+
+    struct AddField {
+        CSVChunk &chunk;
+        std::unordered_map<CSVTerm, Term_t, CSVTermHasher> &map;
+        size_t n;
+        AddField(CSVChunk &chunk,
+                std::unordered_map<CSVTerm, Term_t, CSVTermHasher> &map) :
+            chunk(chunk), map(map), n(0) {
+            }
+        void operator()(const char *text, const size_t len) {
+            CSVTerm t(text, len);
+            auto itr = map.find(t);
+            if (itr == map.end()) {
+                itr = map.insert(std::make_pair(t,
+                            (Term_t) chunk.terms.size())).first;
+                chunk.terms.push_back(t);
+            }
+            chunk.rows.push_back(itr->second);
+            n++;
+        }
+    };
+
+    void parse(CSVChunk &chunk) const {
+        std::unordered_map<CSVTerm, Term_t, CSVTermHasher> map;
+        const char *p = chunk.begin;
+        while (p < chunk.end) {
+            const char *eol = (const char*) memchr(p, '\n', chunk.end - p);
+            if (eol == NULL) {
+                eol = chunk.end;
+            }
+            if (eol > p) {
+                AddField add(chunk, map);
+                splitCSVLine(p, eol, add);
+                if (add.n != arity) {
+                    chunk.wrongArity = true;
+                    return;
+                }
+                chunk.nrows++;
+            }
+            p = eol + 1;
+        }
+    }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t c = r.begin(); c != r.end(); ++c) {
+            parse(chunks[c]);
+        }
     }
+};
+
+struct FillCSVColumns {
+    std::vector<CSVChunk> &chunks;
+    std::vector<std::vector<Term_t>> &values;
+    const uint8_t arity;
+
+    FillCSVColumns(std::vector<CSVChunk> &chunks,
+            std::vector<std::vector<Term_t>> &values, const uint8_t arity) :
+        chunks(chunks), values(values), arity(arity) {
+        }
+
+    void operator()(const ParallelRange& r) const {
+        for (size_t c = r.begin(); c != r.end(); ++c) {
+            CSVChunk &chunk = chunks[c];
+            for (uint8_t j = 0; j < arity; ++j) {
+                Term_t *out = values[j].data() + chunk.offset;
+                const Term_t *in = chunk.rows.data() + j;
+                for (size_t i = 0; i < chunk.nrows; ++i) {
+                    out[i] = chunk.ids[in[i * arity]];
+                }
+            }
+            std::vector<Term_t>().swap(chunk.rows);
+        }
+    }
+};
+
+struct CountFields {
+    size_t n;
+    CountFields() : n(0) {
+    }
+    void operator()(const char *text, const size_t len) {
+        n++;
+    }
+};
+
+uint8_t InmemoryTable::loadCSV(const string &tablefile, int nthreads,
+        Dictionary &dict, std::vector<std::vector<Term_t>> &values) {
+    uint8_t arity = 0;
+    nthreads = std::max(1, nthreads);
+    MmapFile file(tablefile);
+    const char *data = file.getData();
+    const char *end = data + file.getLength();
+
+    //The arity is the number of fields of the first line
+    const char *p = data;
+    while (p < end && *p == '\n') {
+        p++;
+    }
+    if (p < end) {
+        const char *eol = (const char*) memchr(p, '\n', end - p);
+        CountFields count;
+        splitCSVLine(p, eol == NULL ? end : eol, count);
+        arity = (uint8_t) count.n;
+    }
+
+    //Split the file in chunks that end at a newline
+    std::vector<CSVChunk> chunks;
+    const size_t chunkSize = std::max((size_t) INMEMORY_CSV_MINCHUNK,
+            (size_t) (end - p) / (nthreads * INMEMORY_CSV_CHUNKS_PER_THREAD));
+    while (p < end) {
+        const char *e = p + std::min(chunkSize, (size_t) (end - p));
+        if (e < end) {
+            e = (const char*) memchr(e, '\n', end - e);
+            e = e == NULL ? end : e + 1;
+        }
+        chunks.push_back(CSVChunk(p, e));
+        p = e;
+    }
+    ParallelTasks::parallel_for(0, chunks.size(), 1,
+            ParseCSVChunks(chunks, arity));
+
+    //Assign the ids chunk by chunk, so they are the same as if the file
+    //were read sequentially
+    size_t nrows = 0;
+    for (auto &chunk : chunks) {
+        if (chunk.wrongArity) {
+            LOG(ERRORL) << "The rows of " << tablefile <<
+                " do not all have " << (int) arity << " fields";
+            throw 10;
+        }
+        chunk.offset = nrows;
+        nrows += chunk.nrows;
+        chunk.ids.resize(chunk.terms.size());
+        for (size_t i = 0; i < chunk.terms.size(); ++i) {
+            chunk.ids[i] = dict.getOrAdd(chunk.terms[i].text,
+                    chunk.terms[i].len);
+        }
+        std::vector<CSVTerm>().swap(chunk.terms);
+    }
+
+    values.resize(arity);
+    for (auto &v : values) {
+        v.resize(nrows);
+    }
+    ParallelTasks::parallel_for(0, chunks.size(), 1,
+            FillCSVColumns(chunks, values, arity));
+    return arity;
 }
 
 InmemoryTable::InmemoryTable(string repository, string tablename,
-        PredId_t predid) {
+        PredId_t predid, int nthreads) {
     arity = 0;
 //    string schemaFile = repository + "/" + tablename + ".schema";
 //    ifstream ifs;
@@ -52,40 +249,21 @@ InmemoryTable::InmemoryTable(string repository, string tablename,
     //Load the table in the database
     string tablefile = repository + "/" + tablename + ".csv";
     if (Utils::exists(tablefile)) {
-	ifstream ifs;
-        ifs.open(tablefile);
-        string line;
-        std::vector<std::vector<Term_t>> vectors;
 	LOG(DEBUGL) << "Reading " << tablefile;
-        while(std::getline(ifs, line)) {
-            //Parse the row
-	    int i = 0;
-	    while (line.length() > 0) {
-                auto delim = line.find(',');
-                string sn = line.substr(0, delim);
-		if (arity == 0 && vectors.size() <= i) {
-		    std::vector<Term_t> v;
-		    vectors.push_back(v);
-		}
-                vectors[i].push_back(singletonDict.getOrAdd(sn));
-		if (delim == std::string::npos) {
-		    line = "";
-		} else {
-		    line = line.substr(delim + 1);
-		}
-		i++;
-            }
-	    if (arity == 0) {
-		arity = i;
-	    }
-        }
+        std::vector<std::vector<Term_t>> values;
+        arity = loadCSV(tablefile, nthreads, singletonDict, values);
+        LOG(DEBUGL) << "Terms in the dictionary: " << singletonDict.size() <<
+            " (" << singletonDict.getMemoryBytes() /
+            std::max((size_t) 1, singletonDict.size()) << " bytes/term)";
         std::vector<std::shared_ptr<Column>> columns;
         for(uint8_t i = 0; i < arity; ++i) {
-            columns.push_back(std::shared_ptr<Column>(new InmemoryColumn(
-                            vectors[i])));
+            //A constant column is sorted, and is stored compressed
+            const bool constant = std::adjacent_find(values[i].begin(),
+                    values[i].end(), std::not_equal_to<Term_t>()) ==
+                values[i].end();
+            columns.push_back(ColumnWriter::getColumn(values[i], constant));
         }
         segment = std::shared_ptr<Segment>(new Segment(arity, columns));
-        ifs.close();
     } else {
 	LOG(WARNL) << "tablefile " << tablefile << " does not exist";
         segment = NULL;
@@ -451,8 +629,12 @@ bool InmemoryTable::getDictText(const uint64_t id, char *text) {
     return singletonDict.getText(id, text);
 }
 
+const char *InmemoryTable::getDictTextPtr(const uint64_t id, size_t &len) {
+    return singletonDict.get(id, len);
+}
+
 uint64_t InmemoryTable::getNTerms() {
-    return singletonDict.getNTerms();
+    return singletonDict.size();
 }
 
 uint8_t InmemoryTable::getArity() const {
@@ -534,6 +716,28 @@ Term_t InmemoryIterator::getElementAt(const uint8_t p) {
     return iterator->get(p);
 }
 
+size_t InmemoryIterator::nextBatch(Term_t **out, const uint8_t ncolumns,
+        const uint8_t *positions, const size_t maxRows) {
+    //Copy straight from the segment if all its columns are requested in order
+    bool direct = !skipDuplicatedFirst && iterator &&
+        ncolumns == segment->getNColumns();
+    for (uint8_t i = 0; i < ncolumns && direct; ++i) {
+        direct = positions[i] == i;
+    }
+    if (!direct) {
+        return EDBIterator::nextBatch(out, ncolumns, positions, maxRows);
+    }
+    if (hasNextChecked && !hasNextValue) {
+        return 0;
+    }
+    const size_t n = iterator->nextBatch(out, maxRows);
+    if (n > 0) {
+        isFirst = false;
+    }
+    hasNextChecked = false;
+    return n;
+}
+
 PredId_t InmemoryIterator::getPredicateID() {
     return predid;
 }
@@ -85,6 +85,8 @@ MAPIIterator::MAPIIterator(Mapi con, string tableName,
 
     LOG(DEBUGL) << "SQL query (MAPIIterator): " << sqlQuery;
 
+    //Transfer the rows SQLTABLE_BATCH at a time
+    mapi_cache_limit(con, SQLTABLE_BATCH);
     handle = MAPITable::doquery(con, sqlQuery);
 
     columns = fieldsTable.size();
@@ -121,6 +123,8 @@ MAPIIterator::MAPIIterator(Mapi con, string sqlQuery,
 
     LOG(DEBUGL) << "SQL query (MAPIIterator): " << sqlQuery;
 
+    //Transfer the rows SQLTABLE_BATCH at a time
+    mapi_cache_limit(con, SQLTABLE_BATCH);
     handle = MAPITable::doquery(con, sqlQuery);
 
     columns = fieldsTable.size();
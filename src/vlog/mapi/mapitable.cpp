@@ -3,6 +3,8 @@
 #include <vlog/mapi/mapiiterator.h>
 
 #include <unistd.h>
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -68,6 +70,50 @@ MAPITable::MAPITable(string host, int port, string user, string pwd, string dbna
     }
 }
 
+void MAPITable::executeUpdate(const string &sql) {
+    LOG(DEBUGL) << "SQL: " << sql;
+    update(con, sql);
+}
+
+EDBIterator *MAPITable::executeQuery(const string &sql, const Literal &query,
+	const uint8_t ncolumns) {
+    return new MAPIIterator(con, sql, std::vector<string>(ncolumns), query);
+}
+
+void MAPITable::createTempTable(const string &name,
+	const uint8_t ncolumns) {
+    //The rows must survive the commit of insertTempRows
+    string sql = "CREATE LOCAL TEMPORARY TABLE " + name + " (" + tempTableColumns(ncolumns) + ") ON COMMIT PRESERVE ROWS";
+    LOG(DEBUGL) << "SQL create temp table: " << sql;
+    update(con, sql);
+}
+
+void MAPITable::insertTempRows(const string &name, const uint8_t ncolumns,
+	const std::vector<Term_t> &rows) {
+    const size_t nrows = rows.size() / ncolumns;
+    LOG(DEBUGL) << "Insert " << nrows << " rows in " << name;
+
+    //MAPI has no parameter arrays: every statement inserts SQLTABLE_BATCH
+    //rows
+    update(con, "START TRANSACTION");
+    for (size_t start = 0; start < nrows; start += SQLTABLE_BATCH) {
+	const size_t end = std::min(nrows, start + (size_t) SQLTABLE_BATCH);
+	string sql = "INSERT INTO " + name + " VALUES ";
+	for (size_t r = start; r < end; r++) {
+	    sql += r > start ? ", (" : "(";
+	    for (int i = 0; i < ncolumns; i++) {
+		if (i > 0) {
+		    sql += ", ";
+		}
+		sql += to_string(rows[r * ncolumns + i]);
+	    }
+	    sql += ")";
+	}
+	update(con, sql);
+    }
+    update(con, "COMMIT");
+}
+
 uint64_t MAPITable::getSize() {
 
     string query = "SELECT COUNT(*) as c from " + tablename;
@@ -99,6 +145,8 @@ void MAPITable::query(QSQQuery *query, TupleTable *outputTable,
     uint8_t *pos = query->getPosToCopy();
     uint64_t row[npos];
     EDBIterator *iter;
+    //Dropped when the query returns
+    std::unique_ptr<TempTable> temp;
 
     if (posToFilter == NULL || posToFilter->size() == 0) {
 	iter = getIterator(*l);
@@ -128,69 +176,12 @@ void MAPITable::query(QSQQuery *query, TupleTable *outputTable,
 
 	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
 	    // Somewhat arbitrary threshold
-	    // Create temporary table
-	    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i) + " BIGINT";
-	    }
-	    sqlCreateTable += ", PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    sqlCreateTable += ")";
-	    LOG(DEBUGL) << "SQL create temp table: " << sqlCreateTable;
-	    update(con, sqlCreateTable);
-
-	    // Insert values into table
-	    LOG(DEBUGL) << "START TRANSACTION";
-	    update(con, "START TRANSACTION");
-
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		string addition = "INSERT INTO temp VALUES (";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? ", " : "";
-		    addition += pref + to_string(*itr);
-		}
-		addition += ")";
-		LOG(DEBUGL) << "SQL insert into temp table: " << addition;
-		update(con, addition);
-	    }
-
-	    LOG(DEBUGL) << "COMMIT";
-	    update(con, "COMMIT");
-	    
-	    /*
-	    sqlCreateTable = "ALTER TABLE temp ADD CONSTRAINT pkey PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    LOG(DEBUGL) << "alter table: add primary key: " << sqlCreateTable;
-	    update(con, sqlCreateTable);
-	    */
+	    // Load the values in a temporary table
+	    temp.reset(new TempTable(this, posToFilter->size(),
+			*valuesToFilter));
 
 	    // Finish the query.
-	    sqlQuery += "EXISTS (SELECT * FROM temp WHERE ";
-
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i != 0) {
-		    sqlQuery += " AND ";
-		}
-		sqlQuery += tablename + "." + fieldTables[posToFilter->at(i)] + " = temp.x" + to_string(i);
-	    }
-
-	    sqlQuery += ")";
+	    sqlQuery += tempTableToSQLQuery(temp->getName(), *posToFilter);
 	} else {
 	    bool first = true;
 	    sqlQuery += "(";
@@ -227,11 +218,6 @@ void MAPITable::query(QSQQuery *query, TupleTable *outputTable,
     iter->clear();
     delete iter;
     LOG(DEBUGL) << "query gave " << count << " results";
-
-    if (valuesToFilter != NULL && valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	LOG(DEBUGL) << "DROP TABLE temp";
-	update(con, "DROP TABLE temp");
-    }
 }
 
 size_t MAPITable::getCardinality(const Literal &q) {
@@ -9,6 +9,8 @@
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -41,6 +43,8 @@ void MySQLTable::query(QSQQuery *query, TupleTable *outputTable,
     uint64_t row[npos];
     int count = 0;
     EDBIterator *iter;
+    //Dropped when the query returns
+    std::unique_ptr<TempTable> temp;
     if (posToFilter == NULL || posToFilter->size() == 0) {
 	iter = getIterator(*l);
     } else {
@@ -65,71 +69,12 @@ void MySQLTable::query(QSQQuery *query, TupleTable *outputTable,
 
 	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
 	    // Somewhat arbitrary threshold
-	    // Create temporary table
-	    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i) + " BIGINT";
-	    }
-	    sqlCreateTable += ")";
-	    sql::Statement *stmt;
-	    stmt = con->createStatement();
-	    LOG(DEBUGL) << "SQL create temp table: " << sqlCreateTable;
-	    MYSQLCALL(stmt->execute(sqlCreateTable))
-	    delete stmt;
-
-	    // Insert values into table
-	    stmt = con->createStatement();
-	    LOG(DEBUGL) << "START TRANSACTION";
-	    stmt->execute("START TRANSACTION");
-	    delete stmt;
-
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		string addition = "INSERT INTO temp VALUES (";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? ", " : "";
-		    addition += pref + to_string(*itr);
-		}
-		addition += ")";
-		LOG(DEBUGL) << "SQL insert into temp table: " << addition;
-		stmt = con->createStatement();
-		stmt->execute(addition);
-		delete stmt;
-	    }
-
-	    stmt = con->createStatement();
-	    LOG(DEBUGL) << "COMMIT";
-	    stmt->execute("COMMIT");
-	    delete stmt;
-	    
-	    sqlCreateTable = "ALTER TABLE temp ADD CONSTRAINT pkey PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    stmt = con->createStatement();
-	    LOG(DEBUGL) << "alter table: add primary key";
-	    stmt->execute(sqlCreateTable);
-	    delete stmt;
-
+	    // Load the values in a temporary table
+	    temp.reset(new TempTable(this, posToFilter->size(),
+			*valuesToFilter));
 
 	    // Finish the query.
-	    sqlQuery += "EXISTS (SELECT * FROM temp WHERE ";
-
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i != 0) {
-		    sqlQuery += " AND ";
-		}
-		sqlQuery += tablename + "." + fieldTables[posToFilter->at(i)] + " = temp.x" + to_string(i);
-	    }
-
-	    sqlQuery += ")";
+	    sqlQuery += tempTableToSQLQuery(temp->getName(), *posToFilter);
 	} else {
 	    bool first = true;
 	    sqlQuery += "(";
@@ -165,13 +110,63 @@ void MySQLTable::query(QSQQuery *query, TupleTable *outputTable,
     iter->clear();
     delete iter;
     LOG(DEBUGL) << "query gave " << count << " results";
+}
+
+void MySQLTable::executeUpdate(const string &sql) {
+    LOG(DEBUGL) << "SQL: " << sql;
+    sql::Statement *stmt = con->createStatement();
+    MYSQLCALL(stmt->execute(sql))
+    delete stmt;
+}
+
+EDBIterator *MySQLTable::executeQuery(const string &sql, const Literal &query,
+	const uint8_t ncolumns) {
+    //The connector reads the whole result at once
+    return new MySQLIterator(con, sql, query);
+}
 
-    if (valuesToFilter != NULL && valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	sql::Statement *stmt = con->createStatement();
-	LOG(DEBUGL) << "DROP TABLE temp";
-	stmt->execute("DROP TABLE temp");
+//Placeholders in one prepared statement are limited to 65535
+#define MYSQL_MAX_PARAMS 65535
+
+void MySQLTable::insertTempRows(const string &name, const uint8_t ncolumns,
+	const std::vector<Term_t> &rows) {
+    const size_t nrows = rows.size() / ncolumns;
+    const size_t batch = std::min((size_t) SQLTABLE_BATCH,
+	    (size_t) MYSQL_MAX_PARAMS / ncolumns);
+    LOG(DEBUGL) << "Insert " << nrows << " rows in " << name;
+
+    //A prepared statement that inserts 'batch' rows at a time. The last
+    //rows get a statement of their own
+    sql::PreparedStatement *stmt = NULL;
+    size_t stmtRows = 0;
+    con->setAutoCommit(false);
+    for (size_t start = 0; start < nrows; start += batch) {
+	const size_t n = std::min(batch, nrows - start);
+	if (n != stmtRows) {
+	    string sql = "INSERT INTO " + name + " VALUES ";
+	    for (size_t r = 0; r < n; r++) {
+		sql += r > 0 ? ", (" : "(";
+		for (int i = 0; i < ncolumns; i++) {
+		    sql += i > 0 ? ", ?" : "?";
+		}
+		sql += ")";
+	    }
+	    if (stmt != NULL) {
+		delete stmt;
+	    }
+	    MYSQLCALL(stmt = con->prepareStatement(sql))
+	    stmtRows = n;
+	}
+	for (size_t j = 0; j < n * ncolumns; j++) {
+	    stmt->setUInt64(j + 1, rows[start * ncolumns + j]);
+	}
+	MYSQLCALL(stmt->executeUpdate())
+    }
+    if (stmt != NULL) {
 	delete stmt;
     }
+    con->commit();
+    con->setAutoCommit(true);
 }
 
 uint64_t MySQLTable::getSize() {
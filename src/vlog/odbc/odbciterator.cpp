@@ -79,20 +79,7 @@ ODBCIterator::ODBCIterator(SQLHANDLE con, string tableName,
 	posFirstVar = -1;
     }
 
-    LOG(DEBUGL) << "SQL query: " << sqlQuery;
-
-    ODBCTable::check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-    ODBCTable::check(SQLExecDirectA(stmt, (SQLCHAR *) sqlQuery.c_str(), SQL_NTS), "execute query");
-    SQLNumResultCols(stmt, &columns);
-    indicator = new SQLLEN[columns];
-    values = new SQLUBIGINT[columns];
-    for (int i = 0; i < columns; i++) {
-	ODBCTable::check(SQLBindCol(stmt, i + 1, SQL_C_UBIGINT, &values[i], sizeof(SQLUBIGINT), &indicator[i]), "SQLBindCol");
-    }
-    SQLRETURN ret = SQLFetch(stmt);
-    ODBCTable::check(ret, "SQLFetch");
-    hasNextValue = ret != SQL_NO_DATA;
-    hasNextChecked = true;
+    execute(con, sqlQuery);
 }
 
 
@@ -118,39 +105,56 @@ ODBCIterator::ODBCIterator(SQLHANDLE con, string sqlQuery,
 	posFirstVar = -1;
     }
 
+    execute(con, sqlQuery);
+}
+
+
+
+void ODBCIterator::execute(SQLHANDLE con, const string &sqlQuery) {
     LOG(DEBUGL) << "SQL query: " << sqlQuery;
 
     ODBCTable::check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
+    ODBCTable::check(SQLSetStmtAttr(stmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER) SQL_BIND_BY_COLUMN, 0), "bind rows by column");
+    ODBCTable::check(SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) (SQLULEN) SQLTABLE_BATCH, 0), "set the row array size");
+    ODBCTable::check(SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &nfetched, 0), "set the fetched rows pointer");
     ODBCTable::check(SQLExecDirectA(stmt, (SQLCHAR *) sqlQuery.c_str(), SQL_NTS), "execute query");
     SQLNumResultCols(stmt, &columns);
-    indicator = new SQLLEN[columns];
-    values = new SQLUBIGINT[columns];
+    indicator = new SQLLEN[(size_t) columns * SQLTABLE_BATCH];
+    values = new SQLUBIGINT[(size_t) columns * SQLTABLE_BATCH];
     for (int i = 0; i < columns; i++) {
-	ODBCTable::check(SQLBindCol(stmt, i + 1, SQL_C_UBIGINT, &values[i], sizeof(SQLUBIGINT), &indicator[i]), "SQLBindCol");
+	ODBCTable::check(SQLBindCol(stmt, i + 1, SQL_C_UBIGINT, &values[(size_t) i * SQLTABLE_BATCH], sizeof(SQLUBIGINT), &indicator[(size_t) i * SQLTABLE_BATCH]), "SQLBindCol");
     }
-    SQLRETURN ret = SQLFetch(stmt);
-    ODBCTable::check(ret, "SQLFetch");
-    hasNextValue = ret != SQL_NO_DATA;
+    nfetched = 0;
+    currentRow = 0;
+    hasNextValue = fetch();
     hasNextChecked = true;
 }
 
-
+bool ODBCIterator::fetch() {
+    if (currentRow + 1 < nfetched) {
+	currentRow++;
+	return true;
+    }
+    SQLRETURN ret = SQLFetch(stmt);
+    ODBCTable::check(ret, "SQLFetch");
+    if (ret == SQL_NO_DATA) {
+	nfetched = 0;
+    }
+    currentRow = 0;
+    return nfetched > 0;
+}
 
 bool ODBCIterator::hasNext() {
     if (hasNextChecked) {
 	return hasNextValue;
     }
     if (isFirst || ! skipDuplicatedFirst) {
-	SQLRETURN ret = SQLFetch(stmt);
-	ODBCTable::check(ret, "SQLFetch");
-	hasNextValue = ret != SQL_NO_DATA;
+	hasNextValue = fetch();
     } else {
 	Term_t oldval = getElementAt(posFirstVar);
 	bool stop = false;
 	while (! stop) {
-	    SQLRETURN ret = SQLFetch(stmt);
-	    ODBCTable::check(ret, "SQLFetch");
-	    hasNextValue = ret != SQL_NO_DATA;
+	    hasNextValue = fetch();
 	    if (hasNextValue) {
 		if (getElementAt(posFirstVar) != oldval) {
 		    stop = true;
@@ -180,8 +184,8 @@ void ODBCIterator::next() {
 
 void ODBCIterator::clear() {
     if (indicator != NULL) {
-	delete indicator;
-	delete values;
+	delete[] indicator;
+	delete[] values;
 	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
     }
     indicator = NULL;
@@ -196,8 +200,9 @@ void ODBCIterator::skipDuplicatedFirstColumn() {
 
 Term_t ODBCIterator::getElementAt(const uint8_t p) {
     // LOG(DEBUGL) << "ODBCIterator::getElementAt()";
-    if (indicator[p] != SQL_NULL_DATA) {
-	return values[p];
+    const size_t i = (size_t) p * SQLTABLE_BATCH + currentRow;
+    if (indicator[i] != SQL_NULL_DATA) {
+	return values[i];
     }
     throw 10;
 }
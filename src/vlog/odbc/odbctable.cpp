@@ -3,6 +3,8 @@
 #include <vlog/odbc/odbciterator.h>
 
 #include <unistd.h>
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -46,6 +48,8 @@ void ODBCTable::query(QSQQuery *query, TupleTable *outputTable,
     uint8_t *pos = query->getPosToCopy();
     uint64_t row[npos];
     EDBIterator *iter;
+    //Dropped when the query returns
+    std::unique_ptr<TempTable> temp;
 
     if (posToFilter == NULL || posToFilter->size() == 0) {
 	iter = getIterator(*l);
@@ -75,80 +79,12 @@ void ODBCTable::query(QSQQuery *query, TupleTable *outputTable,
 
 	if (valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
 	    // Somewhat arbitrary threshold
-	    // Create temporary table
-	    string sqlCreateTable = "CREATE TEMPORARY TABLE temp (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i) + " BIGINT";
-	    }
-	    sqlCreateTable += ", PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    sqlCreateTable += ")";
-	    SQLHANDLE stmt;
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    LOG(DEBUGL) << "SQL create temp table: " << sqlCreateTable;
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) sqlCreateTable.c_str(), SQL_NTS), "create temp table");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-
-	    // Insert values into table
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    LOG(DEBUGL) << "START TRANSACTION";
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) "START TRANSACTION", SQL_NTS), "start transaction");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-
-	    for (std::vector<Term_t>::iterator itr = valuesToFilter->begin();
-		    itr != valuesToFilter->end();) {
-		string addition = "INSERT INTO temp VALUES (";
-		for (int i = 0; i < posToFilter->size(); i++, itr++) {
-		    string pref = i > 0 ? ", " : "";
-		    addition += pref + to_string(*itr);
-		}
-		addition += ")";
-		LOG(DEBUGL) << "SQL insert into temp table: " << addition;
-		check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-		check(SQLExecDirectA(stmt, (SQLCHAR *) addition.c_str(), SQL_NTS), "addition");
-		SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-	    }
-
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    LOG(DEBUGL) << "COMMIT";
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) "COMMIT", SQL_NTS), "commit");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-	    
-	    /*
-	    sqlCreateTable = "ALTER TABLE temp ADD CONSTRAINT pkey PRIMARY KEY (";
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i > 0) {
-		    sqlCreateTable += ", ";
-		}
-		sqlCreateTable += "x" + to_string(i);
-	    }
-	    sqlCreateTable += ")";
-	    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	    LOG(DEBUGL) << "alter table: add primary key: " << sqlCreateTable;
-	    check(SQLExecDirectA(stmt, (SQLCHAR *) sqlCreateTable.c_str(), SQL_NTS), "alter table");
-	    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
-	    */
+	    // Load the values in a temporary table
+	    temp.reset(new TempTable(this, posToFilter->size(),
+			*valuesToFilter));
 
 	    // Finish the query.
-	    sqlQuery += "EXISTS (SELECT * FROM temp WHERE ";
-
-	    for (int i = 0; i < posToFilter->size(); i++) {
-		if (i != 0) {
-		    sqlQuery += " AND ";
-		}
-		sqlQuery += tablename + "." + fieldTables[posToFilter->at(i)] + " = temp.x" + to_string(i);
-	    }
-
-	    sqlQuery += ")";
+	    sqlQuery += tempTableToSQLQuery(temp->getName(), *posToFilter);
 	} else {
 	    bool first = true;
 	    sqlQuery += "(";
@@ -185,14 +121,65 @@ void ODBCTable::query(QSQQuery *query, TupleTable *outputTable,
     iter->clear();
     delete iter;
     LOG(DEBUGL) << "query gave " << count << " results";
+}
+
+void ODBCTable::executeUpdate(const string &sql) {
+    LOG(DEBUGL) << "SQL: " << sql;
+    SQLHANDLE stmt;
+    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
+    check(SQLExecDirectA(stmt, (SQLCHAR *) sql.c_str(), SQL_NTS), "execute update");
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+}
+
+EDBIterator *ODBCTable::executeQuery(const string &sql, const Literal &query,
+	const uint8_t ncolumns) {
+    return new ODBCIterator(con, sql, query);
+}
+
+void ODBCTable::insertTempRows(const string &name, const uint8_t ncolumns,
+	const std::vector<Term_t> &rows) {
+    const size_t nrows = rows.size() / ncolumns;
+    LOG(DEBUGL) << "Insert " << nrows << " rows in " << name;
 
-    if (valuesToFilter != NULL && valuesToFilter->size() > TEMP_TABLE_THRESHOLD) {
-	SQLHANDLE stmt;
-	check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
-	LOG(DEBUGL) << "DROP TABLE temp";
-	check(SQLExecDirectA(stmt, (SQLCHAR *) "DROP TABLE temp", SQL_NTS), "drop temp table");
+    //A prepared statement executed with arrays of SQLTABLE_BATCH parameters,
+    //one array per column
+    string sql = "INSERT INTO " + name + " VALUES (";
+    for (int i = 0; i < ncolumns; i++) {
+	sql += i > 0 ? ", ?" : "?";
+    }
+    sql += ")";
+    std::vector<SQLUBIGINT> params((size_t) ncolumns * SQLTABLE_BATCH);
+
+    check(SQLSetConnectAttr(con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, 0), "disable autocommit");
+    SQLHANDLE stmt;
+    check(SQLAllocHandle(SQL_HANDLE_STMT, con, &stmt), "allocate statement handle");
+    check(SQLPrepare(stmt, (SQLCHAR *) sql.c_str(), SQL_NTS), "prepare insert");
+    check(SQLSetStmtAttr(stmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER) SQL_PARAM_BIND_BY_COLUMN, 0), "bind parameters by column");
+    for (int i = 0; i < ncolumns; i++) {
+	check(SQLBindParameter(stmt, i + 1, SQL_PARAM_INPUT, SQL_C_UBIGINT, SQL_BIGINT, 0, 0, &params[(size_t) i * SQLTABLE_BATCH], sizeof(SQLUBIGINT), NULL), "SQLBindParameter");
+    }
+    try {
+	for (size_t start = 0; start < nrows; start += SQLTABLE_BATCH) {
+	    const size_t n = std::min((size_t) SQLTABLE_BATCH, nrows - start);
+	    for (size_t r = 0; r < n; r++) {
+		for (int i = 0; i < ncolumns; i++) {
+		    params[(size_t) i * SQLTABLE_BATCH + r] = rows[(start + r) * ncolumns + i];
+		}
+	    }
+	    check(SQLSetStmtAttr(stmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) (SQLULEN) n, 0), "set the number of rows");
+	    check(SQLExecute(stmt), "insert in temp table");
+	}
+    } catch (...) {
+	//Leave the connection in autocommit mode, so that the temporary table
+	//can be dropped
 	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	SQLEndTran(SQL_HANDLE_DBC, con, SQL_ROLLBACK);
+	SQLSetConnectAttr(con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, 0);
+	throw;
     }
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    check(SQLEndTran(SQL_HANDLE_DBC, con, SQL_COMMIT), "commit");
+    check(SQLSetConnectAttr(con, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, 0), "enable autocommit");
 }
 
 uint64_t ODBCTable::getSize() {
@@ -701,7 +701,11 @@ TupleIterator *Reasoner::getMaterializationIterator(Literal &query,
             edb, &program, true, true,
             false, -1, false);
 
-    sn->run();
+    if (matSnapshot != "") {
+        sn->loadFromMmapFiles(matSnapshot);
+    } else {
+        sn->run();
+    }
 
     //To use if the flag returnOnlyVars is set to false
     uint64_t outputTuple[3];    // Used in trident method, so no Term_t